@@ -349,44 +349,26 @@ void matchFileWithLicenses(const string& sContent, unsigned long pFileId, Copyri
 /**
  * \brief Get the file contents, scan for statements and save findings to database
  *
- * Reads the file contents of the pFileId and send it for scanning to matchFileWithLicenses().
- *
- * If the pfile is not found for pFileId, bails with error code 8.
+ * Reads the file contents of the pFile and send it for scanning to matchFileWithLicenses().
  *
  * If the pfile is not found in repository, bails with error code 7.
  * \param state           State of the agent
  * \param agentId         Agent id
- * \param pFileId         pFile to be scanned
+ * \param pFile           pFile to be scanned, with its repository path
  * \param databaseHandler Database handler used by agent
  */
-void matchPFileWithLicenses(CopyrightState const& state, int agentId, unsigned long pFileId, CopyrightDatabaseHandler& databaseHandler)
+void matchPFileWithLicenses(CopyrightState const& state, int agentId, const fo::PFileInfo& pFile, CopyrightDatabaseHandler& databaseHandler)
 {
-  char* pFile = databaseHandler.getPFileNameForFileId(pFileId);
-
-  if (!pFile)
-  {
-    cout << "File not found " << pFileId << endl;
-    bail(8);
-  }
-
-  char* fileName = NULL;
-  {
-#pragma omp critical (repo_mk_path)
-    fileName = fo_RepMkPath("files", pFile);
-  }
-  if (fileName)
+  if (!pFile.path.empty())
   {
     string s;
-    ReadFileToString(fileName, s);
+    ReadFileToString(pFile.path, s);
 
-    matchFileWithLicenses(s, pFileId, state, agentId, databaseHandler);
-
-    free(fileName);
-    free(pFile);
+    matchFileWithLicenses(s, pFile.id, state, agentId, databaseHandler);
   }
   else
   {
-    cout << "PFile not found in repo " << pFileId << endl;
+    cout << "PFile not found in repo " << pFile.id << endl;
     bail(7);
   }
 }
@@ -396,6 +378,9 @@ void matchPFileWithLicenses(CopyrightState const& state, int agentId, unsigned l
  *
  * The agent runs in parallel with the help of omp.
  * A new thread is created for every pfile.
+ *
+ * The pfiles and their repository paths are resolved with one streamed
+ * query before the threads start, so the threads only read and scan.
  * \param state           State of the agent
  * \param agentId         Agent id
  * \param uploadId        Upload id to be processed
@@ -404,24 +389,24 @@ void matchPFileWithLicenses(CopyrightState const& state, int agentId, unsigned l
  */
 bool processUploadId(const CopyrightState& state, int agentId, int uploadId, CopyrightDatabaseHandler& databaseHandler)
 {
-  vector<unsigned long> fileIds = databaseHandler.queryFileIdsForUpload(agentId, uploadId);
+  vector<fo::PFileInfo> pFiles = databaseHandler.queryPFilesForScan(agentId, uploadId);
 
 #pragma omp parallel
   {
     CopyrightDatabaseHandler threadLocalDatabaseHandler(databaseHandler.spawn());
 
-    size_t pFileCount = fileIds.size();
+    size_t pFileCount = pFiles.size();
 #pragma omp for
     for (size_t it = 0; it < pFileCount; ++it)
     {
-      unsigned long pFileId = fileIds[it];
+      const fo::PFileInfo& pFile = pFiles[it];
 
-      if (pFileId == 0)
+      if (pFile.id == 0)
       {
         continue;
       }
 
-      matchPFileWithLicenses(state, agentId, pFileId, threadLocalDatabaseHandler);
+      matchPFileWithLicenses(state, agentId, pFile, threadLocalDatabaseHandler);
 
       fo_scheduler_heart(1);
     }
@@ -308,39 +308,36 @@ bool CopyrightDatabaseHandler::createTableClearing() const
 }
 
 /**
- * \brief Get the list of pfile ids on which the given agent has no findings for a given upload
+ * \brief Get the list of pfiles on which the given agent has no findings for a given upload
  * \param agentId  Agent id to be removed from result
  * \param uploadId Upload id to scan for files
- * \return List of pfiles on which the given agent has no findings
+ * \return List of pfiles on which the given agent has no findings, with their repository paths
+ * \sa fo::AgentDatabaseHandler::queryPFiles()
  */
-std::vector<unsigned long> CopyrightDatabaseHandler::queryFileIdsForUpload(int agentId, int uploadId)
+std::vector<fo::PFileInfo> CopyrightDatabaseHandler::queryPFilesForScan(int agentId, int uploadId)
 {
   std::string uploadTreeTableName = queryUploadTreeTableName(uploadId);
 
-  fo_dbManager_PreparedStatement* preparedStatement =
-      fo_dbManager_PrepareStamement(dbManager.getStruct_dbManager(),
-          ("queryFileIdsForUpload:" IDENTITY "Agent" + uploadTreeTableName).c_str(),
-          ("SELECT pfile_pk"
-            " FROM ("
-            "  SELECT distinct(pfile_fk) AS PF"
-            "  FROM " + uploadTreeTableName +
-            "  WHERE upload_fk = $1 and (ufile_mode&x'3C000000'::int)=0"
-            " ) AS SS "
-          "LEFT OUTER JOIN " IDENTITY " ON (PF = pfile_fk AND agent_fk = $2) "
+  return queryPFiles(
+    ("queryPFilesForScan:" IDENTITY "Agent" + uploadTreeTableName).c_str(),
+    "SELECT pfile_pk, pfile_sha1 || '.' || pfile_md5 || '.' || pfile_size, pfile_size"
+    " FROM ("
+    "  SELECT distinct(pfile_fk) AS PF"
+    "  FROM " + uploadTreeTableName +
+    "  WHERE upload_fk = $1 and (ufile_mode&x'3C000000'::int)=0"
+    " ) AS SS "
+    "LEFT OUTER JOIN " IDENTITY " ON (PF = pfile_fk AND agent_fk = $2) "
 #ifdef IDENTITY_COPYRIGHT
-          "LEFT OUTER JOIN author AS au ON (PF = au.pfile_fk AND au.agent_fk = $2) "
+    "LEFT OUTER JOIN author AS au ON (PF = au.pfile_fk AND au.agent_fk = $2) "
 #endif
-          "INNER JOIN pfile ON (PF = pfile_pk) "
+    "INNER JOIN pfile ON (PF = pfile_pk) "
 #ifdef IDENTITY_COPYRIGHT
-          "WHERE copyright.copyright_pk IS NULL AND au.author_pk IS NULL;").c_str(),
+    "WHERE copyright.copyright_pk IS NULL AND au.author_pk IS NULL",
 #else
-          "WHERE " IDENTITY "_pk IS NULL OR agent_fk <> $2;").c_str(),
+    "WHERE " IDENTITY "_pk IS NULL OR agent_fk <> $2",
 #endif
-          int, int);
-  QueryResult queryResult = dbManager.execPrepared(preparedStatement,
-      uploadId, agentId);
-
-  return queryResult.getSimpleResults<unsigned long>(0, fo::stringToUnsignedLong);
+    "int, int",
+    uploadId, agentId);
 }
 
 /**
@@ -0,0 +1,197 @@
+/**************************************************************
+libfosscopy: Copy files with the fastest method the kernel offers.
+
+Copyright (C) 2026 Siemens AG
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License version 2.1 as published by the Free Software Foundation.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.0
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**************************************************************/
+/*!
+ * \file
+ * \brief Copy the content of one file descriptor to an other.
+ *
+ * The strategies are tried from the cheapest to the most expensive:
+ *  -# FICLONE, on btrfs and XFS the new file shares the blocks of the source
+ *  -# copy_file_range(), the data never leaves the kernel and NFS or
+ *     overlay file systems can offload the copy
+ *  -# read()/write() through a large buffer
+ *
+ * A strategy that is not supported by the file systems involved fails
+ * before copying anything, so the next one simply starts where the failed
+ * one stopped.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "libfosscopy.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+/*!
+ \brief Try to clone the whole source into the (empty) destination.
+ \param Fin  Source file descriptor
+ \param Fout Destination file descriptor
+ \return 0 if the file was cloned, -1 otherwise.
+ */
+static int _CopyClone(int Fin, int Fout)
+{
+#ifdef FICLONE
+  return (ioctl(Fout, FICLONE, Fin) == 0 ? 0 : -1);
+#else
+  return (-1);
+#endif
+} /* _CopyClone() */
+
+/*!
+ \brief Copy with copy_file_range() until the end of the source.
+ \param Fin  Source file descriptor
+ \param Fout Destination file descriptor
+ \param Copied Set to the number of bytes copied
+ \return 0 if the end of the source was reached, -1 if copy_file_range() is
+         not usable for these files (errno is set).
+ */
+static int _CopyRange(int Fin, int Fout, off_t* Copied)
+{
+  *Copied = 0;
+#ifdef SYS_copy_file_range
+  ssize_t Len;
+
+  for (;;)
+  {
+    Len = syscall(SYS_copy_file_range, Fin, NULL, Fout, NULL, FO_COPY_BUFSIZE * 16, 0);
+    if (Len == 0) return (0);
+    if (Len < 0)
+    {
+      if (errno == EINTR) continue;
+      return (-1);
+    }
+    *Copied += Len;
+  }
+#else
+  errno = ENOSYS;
+  return (-1);
+#endif
+} /* _CopyRange() */
+
+/*!
+ \brief Copy with read()/write() until the end of the source.
+ \param Fin  Source file descriptor
+ \param Fout Destination file descriptor
+ \return 0 on success, -1 on failure (errno is set).
+ */
+static int _CopyBuffer(int Fin, int Fout)
+{
+  char* Buf;
+  ssize_t LenIn, LenOut, Wrote;
+
+  Buf = malloc(FO_COPY_BUFSIZE);
+  if (!Buf) return (-1);
+
+  for (;;)
+  {
+    LenIn = read(Fin, Buf, FO_COPY_BUFSIZE);
+    if (LenIn == 0) break;
+    if (LenIn < 0)
+    {
+      if (errno == EINTR) continue;
+      free(Buf);
+      return (-1);
+    }
+
+    for (LenOut = 0; LenOut < LenIn; LenOut += Wrote)
+    {
+      Wrote = write(Fout, Buf + LenOut, LenIn - LenOut);
+      if (Wrote < 0 && errno == EINTR)
+      {
+        Wrote = 0;
+        continue;
+      }
+      if (Wrote <= 0)
+      {
+        if (Wrote == 0) errno = ENOSPC;
+        free(Buf);
+        return (-1);
+      }
+    }
+  }
+
+  free(Buf);
+  return (0);
+} /* _CopyBuffer() */
+
+/*!
+ \brief Copy everything from the current position of Fin to Fout.
+
+ Fout should be a newly created, empty file. Cloning is only tried when
+ both files are regular files and the source is read from the start.
+ \param Fin  Source file descriptor, opened for reading
+ \param Fout Destination file descriptor, opened for writing
+ \param[out] Strategy If not NULL, set to the FO_COPY_* strategy that
+             copied the data
+ \return 0 on success, -1 on failure (errno is set).
+ */
+int fo_CopyFd(int Fin, int Fout, int* Strategy)
+{
+  struct stat StatIn, StatOut;
+  off_t Copied = 0;
+  int Regular;
+
+  if (Strategy) *Strategy = FO_COPY_NONE;
+
+  Regular = (fstat(Fin, &StatIn) == 0 && S_ISREG(StatIn.st_mode) &&
+    fstat(Fout, &StatOut) == 0 && S_ISREG(StatOut.st_mode));
+
+  if (Regular && StatOut.st_size == 0 && lseek(Fin, 0, SEEK_CUR) == 0 &&
+    _CopyClone(Fin, Fout) == 0)
+  {
+    if (Strategy) *Strategy = FO_COPY_CLONE;
+    return (0);
+  }
+
+  /* whatever copy_file_range() did not copy (unsupported, stopped early on
+   * a pseudo file) is copied through the buffer */
+  if (Regular) _CopyRange(Fin, Fout, &Copied);
+  if (Strategy && Copied > 0) *Strategy = FO_COPY_RANGE;
+
+  if (_CopyBuffer(Fin, Fout) != 0) return (-1);
+
+  if (Strategy && *Strategy == FO_COPY_NONE) *Strategy = FO_COPY_BUFFER;
+  return (0);
+} /* fo_CopyFd() */
+
+/*!
+ \brief Get a printable name for a FO_COPY_* strategy.
+ \param Strategy The strategy returned by fo_CopyFd()
+ \return The name, never NULL.
+ */
+const char* fo_CopyStrategyName(int Strategy)
+{
+  switch (Strategy)
+  {
+    case FO_COPY_CLONE: return ("clone");
+    case FO_COPY_RANGE: return ("copy_file_range");
+    case FO_COPY_BUFFER: return ("buffer");
+    default: return ("none");
+  }
+} /* fo_CopyStrategyName() */
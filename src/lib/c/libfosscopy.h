@@ -0,0 +1,34 @@
+/**************************************************************
+libfosscopy: Copy files with the fastest method the kernel offers.
+
+Copyright (C) 2026 Siemens AG
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License version 2.1 as published by the Free Software Foundation.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.0
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+**************************************************************/
+
+#ifndef LIBFOSSCOPY_H
+#define LIBFOSSCOPY_H
+
+/** Strategies used by fo_CopyFd(), from fastest to slowest */
+#define FO_COPY_NONE   0  ///< Nothing was copied
+#define FO_COPY_CLONE  1  ///< Reflink, the copy shares the blocks of the source (FICLONE)
+#define FO_COPY_RANGE  2  ///< Copy inside the kernel (copy_file_range)
+#define FO_COPY_BUFFER 3  ///< read()/write() through a large buffer
+
+#define FO_COPY_BUFSIZE 0x100000  ///< Size of the buffer for FO_COPY_BUFFER (1M)
+
+int fo_CopyFd(int Fin, int Fout, int* Strategy);
+const char* fo_CopyStrategyName(int Strategy);
+
+#endif /* LIBFOSSCOPY_H */
@@ -22,6 +22,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <stdarg.h>
 #include <string.h>
 #include <ctype.h>
+#include <signal.h>
+#include <unistd.h>
 #include <libfossdbmanager.h>
 #include <libfossdb.h>
 
@@ -33,6 +35,20 @@ typedef struct
   char* fmt;  ///< Printf format string for the parameter
 } param;
 
+/** Profile of one statement, see fo_dbManager_setProfiling() */
+typedef struct
+{
+  char* name;             ///< Statement name, or printf format of the query
+  int prepared;           ///< 1 for prepared statements, 0 for printf queries
+  guint64 calls;          ///< Number of executions
+  guint64 errors;         ///< Executions that failed
+  guint64 rows;           ///< Rows returned or affected
+  gint64 totalTime;       ///< Time spent executing, in microseconds
+  gint64 maxTime;         ///< Slowest execution, in microseconds
+  gint64 prepareTime;     ///< Time spent in PQprepare(), in microseconds
+  guint64 histogram[FO_DBPROFILE_BUCKETS]; ///< Executions by log2 of the microseconds
+} statementProfile;
+
 /** Prepared statements */
 struct fo_dbmanager_preparedstatement
 {
@@ -40,6 +56,7 @@ struct fo_dbmanager_preparedstatement
   param* params;  ///< Query parameters
   char* name;     ///< Name of the prepared statement
   int paramc;     ///< Number of paramenters
+  statementProfile* profile; ///< Profile of the statement, NULL when not profiling
 };
 
 /** Database manager object */
@@ -50,8 +67,16 @@ struct fo_dbmanager
   char* dbConf;         ///< DB conf file location
   FILE* logFile;        ///< FOSSology log file pointer
   int ignoreWarns;      ///< Set to ignore warnings from logging
+  GHashTable* profile;  ///< Hash table of statementProfile, NULL when not profiling
+  char* profileFile;    ///< Where the profile is dumped, NULL for stderr
+  guint64 connects;     ///< Connections opened for this manager
+  gint64 connectTime;   ///< Time spent waiting for them, in microseconds
+  int profileDumps;     ///< Value of profileDumpRequests at the last dump
 };
 
+/** Number of SIGUSR2 received, see fo_dbManager_setProfiling() */
+static volatile sig_atomic_t profileDumpRequests = 0;
+
 /** Print the log in logfile or stdout */
 #define LOG(level, str, ...) \
   do {\
@@ -90,6 +115,30 @@ static void cachedPrepared_free(gpointer ptr)
   free(stmt);
 }
 
+/**
+ * \brief Free a statement profile
+ *
+ * The function is used in initializing the profile hash table.
+ * \param ptr Pointer for statementProfile object
+ */
+static void profile_free(gpointer ptr)
+{
+  statementProfile* profile = ptr;
+  g_free(profile->name);
+  g_free(profile);
+}
+
+/**
+ * \brief Signal handler requesting a profile dump from every profiling manager
+ *
+ * The dump itself happens on the next query, outside of the handler.
+ * \param signo Signal number
+ */
+static void profile_signal(int signo)
+{
+  profileDumpRequests++;
+}
+
 /**
  * \brief Receive notice/warning from Postgres and print in log
  * \param arg DB manager
@@ -137,9 +186,22 @@ fo_dbManager* fo_dbManager_new(PGconn* dbConnection)
   result->logFile = NULL;
   result->dbConf = NULL;
   result->ignoreWarns = 0;
+  result->profile = NULL;
+  result->profileFile = NULL;
+  result->connects = 0;
+  result->connectTime = 0;
+  result->profileDumps = profileDumpRequests;
 
   PQsetNoticeReceiver(dbConnection, noticeReceiver, result);
 
+  if (getenv(FO_DBPROFILE_ENV))
+  {
+    const char* profileFile = getenv(FO_DBPROFILE_ENV);
+    fo_dbManager_setProfiling(result, 1);
+    if (*profileFile && strcmp(profileFile, "-"))
+      result->profileFile = g_strdup(profileFile);
+  }
+
   return result;
 }
 
@@ -152,6 +214,7 @@ fo_dbManager* fo_dbManager_new(PGconn* dbConnection)
  * instance will be completely independent (they are connection-local). The new
  * instance has the default logging attached and not share the log of the
  * originating instance, if needed set it with fo_dbManager_setLogFile().
+ * Profiling is inherited, the time to connect is accounted to the new instance.
  *
  * \b Example
  * \code
@@ -171,10 +234,18 @@ fo_dbManager* fo_dbManager_fork(fo_dbManager* dbManager)
 {
   fo_dbManager* result = NULL;
   char* error = NULL;
+  gint64 start = g_get_monotonic_time();
   PGconn* newDbConnection = fo_dbconnect(dbManager->dbConf, &error);
   if (newDbConnection)
   {
     result = fo_dbManager_new_withConf(newDbConnection, dbManager->dbConf);
+    if (dbManager->profile)
+    {
+      fo_dbManager_setProfiling(result, 1);
+      if (dbManager->profileFile && !result->profileFile)
+        result->profileFile = g_strdup(dbManager->profileFile);
+    }
+    fo_dbManager_addConnectTime(result, g_get_monotonic_time() - start);
   } else
   {
     LOG_FATAL("Can not open connection\n%s\nWhile forking dbManager using config: '%s'\n",
@@ -226,10 +297,278 @@ PGconn* fo_dbManager_getWrappedConnection(fo_dbManager* dbManager)
   return dbManager->dbConnection;
 }
 
+/**
+ * \brief Get the profile of a statement, creating it on first use
+ * \param dbManager DB manager that is profiling
+ * \param name      Name of the prepared statement or format of the query
+ * \param prepared  1 for a prepared statement, 0 for a printf query
+ * \return The profile, owned by the DB manager
+ */
+static statementProfile* profile_get(fo_dbManager* dbManager, const char* name, int prepared)
+{
+  statementProfile* profile = g_hash_table_lookup(dbManager->profile, name);
+  if (!profile)
+  {
+    profile = g_new0(statementProfile, 1);
+    profile->name = g_strdup(name);
+    profile->prepared = prepared;
+    g_hash_table_insert(dbManager->profile, profile->name, profile);
+  }
+  return profile;
+}
+
+/**
+ * \brief Account one execution to a statement profile
+ * \param profile Profile to update
+ * \param elapsed Execution time in microseconds
+ * \param result  Result of the execution, NULL on failure
+ */
+static void profile_record(statementProfile* profile, gint64 elapsed, PGresult* result)
+{
+  int bucket = 0;
+  gint64 t;
+
+  for (t = elapsed; t > 1 && bucket < FO_DBPROFILE_BUCKETS - 1; t >>= 1)
+    bucket++;
+
+  profile->calls++;
+  profile->totalTime += elapsed;
+  if (elapsed > profile->maxTime)
+    profile->maxTime = elapsed;
+  profile->histogram[bucket]++;
+
+  if (!result || PQresultStatus(result) == PGRES_FATAL_ERROR)
+    profile->errors++;
+  else if (PQresultStatus(result) == PGRES_TUPLES_OK)
+    profile->rows += PQntuples(result);
+  else
+    profile->rows += strtoull(PQcmdTuples(result), NULL, 10);
+}
+
+/**
+ * \brief Estimate a percentile of the execution time from the histogram
+ * \param profile  Profile to read
+ * \param fraction Percentile as a fraction, e.g. 0.99
+ * \return Upper bound of the histogram bucket holding the percentile, in microseconds
+ */
+static gint64 profile_percentile(statementProfile* profile, double fraction)
+{
+  guint64 seen = 0;
+  int bucket;
+
+  for (bucket = 0; bucket < FO_DBPROFILE_BUCKETS - 1; bucket++)
+  {
+    seen += profile->histogram[bucket];
+    if (seen >= fraction * profile->calls)
+      break;
+  }
+  if (bucket == FO_DBPROFILE_BUCKETS - 1)
+    return profile->maxTime;
+  return ((gint64) 2) << bucket;
+}
+
+/**
+ * \brief Sort statement profiles by decreasing total time
+ */
+static gint profile_compare(gconstpointer a, gconstpointer b)
+{
+  const statementProfile* profileA = *(statementProfile* const*) a;
+  const statementProfile* profileB = *(statementProfile* const*) b;
+  if (profileA->totalTime != profileB->totalTime)
+    return profileA->totalTime < profileB->totalTime ? 1 : -1;
+  return strcmp(profileA->name, profileB->name);
+}
+
+/**
+ * \brief Turn the per statement profiling on or off
+ *
+ * While profiling, the DB manager keeps for every prepared statement name,
+ * and for every printf format given to fo_dbManager_Exec_printf(), the
+ * number of executions, failures and rows, the total and maximal execution
+ * time and a histogram of execution times in powers of two microseconds.
+ * The time spent connecting (see fo_dbManager_addConnectTime()) is kept too.
+ *
+ * The profile is dumped by fo_dbManager_free(), and by the next query after
+ * the agent receives SIGUSR2 (unless the agent handles SIGUSR2 itself).
+ * Setting the environment variable FO_DBPROFILE turns profiling on for every
+ * DB manager, its value is the file the profile is appended to ("" or "-"
+ * for stderr).
+ *
+ * Turning profiling off discards the profile.
+ * \param dbManager DB manager to be updated
+ * \param enable    New value
+ * \sa fo_dbManager_dumpProfile()
+ */
+void fo_dbManager_setProfiling(fo_dbManager* dbManager, int enable)
+{
+  static int signalInstalled = 0;
+
+  if (enable && !dbManager->profile)
+  {
+    dbManager->profile = g_hash_table_new_full(g_str_hash, g_str_equal,
+      NULL, // the key is the same pointer as profile->name
+      profile_free);
+    dbManager->profileDumps = profileDumpRequests;
+
+    if (!signalInstalled)
+    {
+      struct sigaction current;
+      signalInstalled = 1;
+      if (sigaction(SIGUSR2, NULL, &current) == 0 && current.sa_handler == SIG_DFL)
+      {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = profile_signal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGUSR2, &action, NULL);
+      }
+    }
+  } else if (!enable && dbManager->profile)
+  {
+    g_hash_table_unref(dbManager->profile);
+    dbManager->profile = NULL;
+  }
+
+  if (dbManager->profile)
+  {
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, dbManager->cachedPrepared);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+    {
+      fo_dbManager_PreparedStatement* stmt = value;
+      stmt->profile = profile_get(dbManager, stmt->name, 1);
+    }
+  } else
+  {
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, dbManager->cachedPrepared);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+      ((fo_dbManager_PreparedStatement*) value)->profile = NULL;
+  }
+}
+
+/**
+ * \brief Check if a DB manager is profiling
+ * \param dbManager DB manager
+ * \return 1 if profiling, 0 otherwise
+ */
+int fo_dbManager_isProfiling(fo_dbManager* dbManager)
+{
+  return dbManager->profile != NULL;
+}
+
+/**
+ * \brief Account the time spent waiting for a database connection
+ *
+ * Does nothing when not profiling.
+ * \param dbManager DB manager using the connection
+ * \param elapsed   Time spent connecting, in microseconds
+ */
+void fo_dbManager_addConnectTime(fo_dbManager* dbManager, gint64 elapsed)
+{
+  if (!dbManager->profile)
+    return;
+  dbManager->connects++;
+  dbManager->connectTime += elapsed;
+}
+
+/**
+ * \brief Print the profile of a DB manager
+ *
+ * Prints one line per statement, slowest total first, followed by the
+ * non empty buckets of its histogram as `<upper bound in us>:<count>`.
+ * \param dbManager DB manager that is profiling
+ * \param out       Where to print
+ */
+void fo_dbManager_dumpProfile(fo_dbManager* dbManager, FILE* out)
+{
+  GPtrArray* profiles;
+  GHashTableIter iter;
+  gpointer value;
+  guint i;
+  int bucket;
+
+  if (!dbManager->profile)
+    return;
+
+  profiles = g_ptr_array_new();
+  g_hash_table_iter_init(&iter, dbManager->profile);
+  while (g_hash_table_iter_next(&iter, NULL, &value))
+    g_ptr_array_add(profiles, value);
+  g_ptr_array_sort(profiles, profile_compare);
+
+  fprintf(out, "dbManager profile of %s pid %d: %" G_GUINT64_FORMAT " connects, %.3f ms waiting for connections\n",
+    g_get_prgname() ? g_get_prgname() : "agent", (int) getpid(),
+    dbManager->connects, dbManager->connectTime / 1000.0);
+  fprintf(out, "%12s %8s %12s %12s %10s %10s %10s %10s %10s  %s\n",
+    "calls", "errors", "rows", "total ms", "mean us", "p50 us", "p99 us", "max us", "prep us", "statement");
+
+  for (i = 0; i < profiles->len; i++)
+  {
+    statementProfile* profile = g_ptr_array_index(profiles, i);
+    char* name = g_strdup(profile->name);
+    g_strdelimit(name, "\n\r\t", ' ');
+
+    fprintf(out, "%12" G_GUINT64_FORMAT " %8" G_GUINT64_FORMAT " %12" G_GUINT64_FORMAT " %12.3f %10" G_GINT64_FORMAT
+      " %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT "  %s%s\n",
+      profile->calls, profile->errors, profile->rows, profile->totalTime / 1000.0,
+      profile->calls ? profile->totalTime / (gint64) profile->calls : 0,
+      profile_percentile(profile, 0.5), profile_percentile(profile, 0.99), profile->maxTime,
+      profile->prepareTime, profile->prepared ? "" : "printf: ", name);
+    g_free(name);
+
+    if (profile->calls)
+    {
+      fprintf(out, "%12s", "");
+      for (bucket = 0; bucket < FO_DBPROFILE_BUCKETS; bucket++)
+        if (profile->histogram[bucket])
+          fprintf(out, " %s%" G_GINT64_FORMAT ":%" G_GUINT64_FORMAT,
+            bucket == FO_DBPROFILE_BUCKETS - 1 ? ">" : "",
+            bucket == FO_DBPROFILE_BUCKETS - 1 ? ((gint64) 1) << bucket : ((gint64) 2) << bucket,
+            profile->histogram[bucket]);
+      fprintf(out, "\n");
+    }
+  }
+  fflush(out);
+  g_ptr_array_free(profiles, TRUE);
+}
+
+/**
+ * \brief Dump the profile where FO_DBPROFILE asks for it
+ * \param dbManager DB manager that is profiling
+ */
+static void profile_dumpToFile(fo_dbManager* dbManager)
+{
+  FILE* out = NULL;
+
+  if (dbManager->profileFile)
+    out = fopen(dbManager->profileFile, "a");
+  fo_dbManager_dumpProfile(dbManager, out ? out : stderr);
+  if (out)
+    fclose(out);
+}
+
+/**
+ * \brief Dump the profile if a SIGUSR2 arrived since the last dump
+ * \param dbManager DB manager in use
+ */
+static inline void profile_checkSignal(fo_dbManager* dbManager)
+{
+  if (dbManager->profile && dbManager->profileDumps != profileDumpRequests)
+  {
+    dbManager->profileDumps = profileDumpRequests;
+    profile_dumpToFile(dbManager);
+  }
+}
+
 /**
  * \brief Un-allocate the memory from a DB manager
  *
  * The function applies following actions on the manager before calling free
+ * -# Dump the profile, if profiling
  * -# Unref the cached table
  * -# Free the DB conf file location
  * -# Close the log file FP
@@ -237,6 +576,12 @@ PGconn* fo_dbManager_getWrappedConnection(fo_dbManager* dbManager)
  */
 void fo_dbManager_free(fo_dbManager* dbManager)
 {
+  if (dbManager->profile)
+  {
+    profile_dumpToFile(dbManager);
+    g_hash_table_unref(dbManager->profile);
+  }
+  g_free(dbManager->profileFile);
   g_hash_table_unref(dbManager->cachedPrepared);
   if (dbManager->dbConf)
     free(dbManager->dbConf);
@@ -517,19 +862,39 @@ int fo_dbManager_exists(fo_dbManager* dbManager, const char* type, const char* n
  */
 PGresult* fo_dbManager_Exec_printf(fo_dbManager* dbManager, const char* sqlQueryStringFormat, ...)
 {
-  char* sqlQueryString;
-  PGconn* dbConnection = dbManager->dbConnection;
-
   va_list argptr;
   va_start(argptr, sqlQueryStringFormat);
-  sqlQueryString = g_strdup_vprintf(sqlQueryStringFormat, argptr);
+  PGresult* result = fo_dbManager_Exec_vprintf(dbManager, sqlQueryStringFormat, argptr);
   va_end(argptr);
+
+  return result;
+}
+
+/**
+ * \brief Execute a SQL query in a printf format
+ * \param dbManager             DB manager to use
+ * \param sqlQueryStringFormat  Query format like printf
+ * \param args                  Values for the format
+ * \return PGreult object on success;\n
+ * NULL on error (also writes to log);
+ * \sa fo_dbManager_Exec_printf()
+ */
+PGresult* fo_dbManager_Exec_vprintf(fo_dbManager* dbManager, const char* sqlQueryStringFormat, va_list args)
+{
+  char* sqlQueryString;
+  PGconn* dbConnection = dbManager->dbConnection;
+
+  sqlQueryString = g_strdup_vprintf(sqlQueryStringFormat, args);
   if (sqlQueryString == NULL)
   {
     return NULL;
   }
 
+  profile_checkSignal(dbManager);
+  gint64 start = dbManager->profile ? g_get_monotonic_time() : 0;
   PGresult* result = PQexec(dbConnection, sqlQueryString);
+  if (dbManager->profile)
+    profile_record(profile_get(dbManager, sqlQueryStringFormat, 0), g_get_monotonic_time() - start, result);
 
   if (!result)
   {
@@ -623,6 +988,8 @@ PGresult* fo_dbManager_ExecPreparedv(fo_dbManager_PreparedStatement* preparedSta
   g_free(printedStatement);
   g_free(params);
 #endif
+  profile_checkSignal(dbManager);
+  gint64 start = preparedStatement->profile ? g_get_monotonic_time() : 0;
   PGresult* result = PQexecPrepared(dbConnection,
     preparedStatement->name,
     preparedStatement->paramc,
@@ -630,6 +997,8 @@ PGresult* fo_dbManager_ExecPreparedv(fo_dbManager_PreparedStatement* preparedSta
     NULL,
     NULL,
     0);
+  if (preparedStatement->profile)
+    profile_record(preparedStatement->profile, g_get_monotonic_time() - start, result);
 
   if (!result)
   {
@@ -838,11 +1207,15 @@ fo_dbManager_PreparedStatement* fo_dbManager_PrepareStamement_str(
 
   result->dbManager = dbManager;
   result->name = g_strdup(name);
+  result->profile = NULL;
 
   int failure = 0;
+  gint64 elapsed = 0;
   if (parseParamStr(result, paramtypes))
   {
+    gint64 start = g_get_monotonic_time();
     PGresult* prepareResult = PQprepare(dbConnection, result->name, query, 0, NULL);
+    elapsed = g_get_monotonic_time() - start;
 
     if (!prepareResult)
     {
@@ -881,6 +1254,11 @@ fo_dbManager_PreparedStatement* fo_dbManager_PrepareStamement_str(
   } else
   {
     g_hash_table_insert(cachedPrepared, result->name, result);
+    if (dbManager->profile)
+    {
+      result->profile = profile_get(dbManager, result->name, 1);
+      result->profile->prepareTime += elapsed;
+    }
   }
 
   return result;
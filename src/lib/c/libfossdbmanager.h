@@ -21,8 +21,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <libpq-fe.h>
 #include <stdarg.h>
+#include <stdio.h>
 #include <glib.h>
 
+#define FO_DBPROFILE_ENV "FO_DBPROFILE"  ///< Environment variable turning profiling on, see fo_dbManager_setProfiling()
+#define FO_DBPROFILE_BUCKETS 24          ///< Histogram buckets, the last one holds executions above 2^23 us
+
 typedef struct fo_dbmanager_preparedstatement fo_dbManager_PreparedStatement;
 typedef struct fo_dbmanager fo_dbManager;
 
@@ -39,6 +43,12 @@ int fo_dbManager_begin(fo_dbManager* dbManager);
 int fo_dbManager_commit(fo_dbManager* dbManager);
 int fo_dbManager_rollback(fo_dbManager* dbManager);
 PGresult* fo_dbManager_Exec_printf(fo_dbManager* dbManager, const char* sqlQueryStringFormat, ...);
+PGresult* fo_dbManager_Exec_vprintf(fo_dbManager* dbManager, const char* sqlQueryStringFormat, va_list args);
+
+void fo_dbManager_setProfiling(fo_dbManager* dbManager, int enable);
+int fo_dbManager_isProfiling(fo_dbManager* dbManager);
+void fo_dbManager_addConnectTime(fo_dbManager* dbManager, gint64 elapsed);
+void fo_dbManager_dumpProfile(fo_dbManager* dbManager, FILE* out);
 
 /*!
  * \fn fo_dbManager_PreparedStatement* fo_dbManager_PrepareStatement (fo_dbManager* dbManager, const char* name, const char* query, ...)
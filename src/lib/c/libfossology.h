@@ -35,6 +35,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <stdio.h>
 #include "libfossscheduler.h"
 #include "libfossrepo.h"
+#include "libfosscopy.h"
 #include "libfossdb.h"
 #include "libfossagent.h"
 #include "sqlCopy.h"
@@ -24,6 +24,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.0
  */
 
 #include "libfossrepo.h"
+#include "libfosscopy.h"
 #include "libfossscheduler.h"
 #include "fossconfig.h"
 
@@ -814,7 +815,8 @@ RepMmapStruct* fo_RepMmap(char* Type, char* Filename)
 /*!
  \brief Import a file into the repository.
 
- This is a REALLY FAST copy.
+ This is a REALLY FAST copy. The file is copied with fo_CopyFd(), which
+ uses reflinks or in-kernel copies when the file system supports them.
  \param Source Source filename
  \param Type Type of data.
  \param Filename The destination filename
@@ -827,14 +829,8 @@ int fo_RepImport(char* Source, char* Type, char* Filename, int Link)
   {
     chmod(Source, S_ISGID | S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH); /* change mode */
   }
-  /*** code uses read/write ***/
-  /*** Could use mmap, but it isn't noticably faster and could have
-  problems with multi-gig files ***/
-  int LenIn, LenOut;
-  int i;
-  char Buf[0x80000]; /* 80K blocks */
-  char vBuf[0x80000]; /* 80K blocks */
-  FILE* Fin;
+  int Fin;
+  int Strategy;
   FILE* Fout;
   char* FoutPath;
 
@@ -857,45 +853,39 @@ int fo_RepImport(char* Source, char* Type, char* Filename, int Link)
   } /* try a hard link */
 
   /* hard route: actually copy the file */
-  Fin = fopen(Source, "rb");
-  if (!Fin)
+  Fin = open(Source, O_RDONLY);
+  if (Fin < 0)
   {
     fprintf(stderr, "ERROR: Unable to open source file '%s'\n", Source);
     return (1);
   }
-  setvbuf(Fin, vBuf, _IOFBF, sizeof(vBuf));
 
   Fout = fo_RepFwriteTmp(Type, Filename, "I"); /* tmp = ".I" for importing... */
   if (!Fout)
   {
     fprintf(stderr, "ERROR: Invalid -- type='%s' filename='%s'\n", Type, Filename);
-    fclose(Fin);
+    close(Fin);
     return (2);
   }
 
-  LenIn = fread(Buf,1,sizeof(Buf),Fin);
-  while(LenIn > 0)
+  if (fo_CopyFd(Fin, fileno(Fout), &Strategy) != 0)
   {
-    LenOut=0;
-    while(LenOut < LenIn)
+    /*** Oh no!  Write failed! ***/
+    fprintf(stderr, "ERROR: Write failed -- type='%s' filename='%s': %s\n", Type, Filename, strerror(errno));
+    fo_RepFclose(Fout);
+    close(Fin);
+    FoutPath = fo_RepMkPathTmp(Type, Filename, "I", 1);
+    if (FoutPath)
     {
-      i = fwrite(Buf+LenOut,1,LenIn - LenOut,Fout);
-      LenOut += i;
-      if (i == 0)
-      {
-        /*** Oh no!  Write failed! ***/
-        fclose(Fout);
-        fo_RepFclose(Fout);
-        fo_RepRemove(Type,Filename);
-        fprintf(stderr,"ERROR: Write failed -- type='%s' filename='%s'\n",Type,Filename);
-        fclose(Fin);
-        return(3);
-      }
+      unlink(FoutPath);
+      free(FoutPath);
     }
-    LenIn = fread(Buf,1,sizeof(Buf),Fin);
+    return (3);
   }
+  if (TVERBOSE) LOG_DEBUG("fo_RepImport %s/%s: copied with %s", Type, Filename, fo_CopyStrategyName(Strategy));
+
   fo_RepFclose(Fout);
-  fclose(Fin);
+  close(Fin);
   fo_RepRenameTmp(Type, Filename, "I"); /* mv .I to real name */
   return (0);
 } /* fo_RepImport() */
@@ -29,8 +29,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 /* unix includes */
 #include <stdio.h>
+#include <errno.h>
 #include <getopt.h>
 #include <libgen.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
 #include <glib.h>
 
 /* ************************************************************************** */
@@ -38,7 +43,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 /* ************************************************************************** */
 
 volatile gint items_processed; ///< The number of items processed by the agent
-volatile int alive;            ///< If the agent has updated with a hearbeat
+volatile gint alive;           ///< If the agent has updated with a hearbeat
 char buffer[2048];   ///< The last thing received from the scheduler
 int valid;           ///< If the information stored in buffer is valid
 int sscheduler;      ///< Whether the agent was started by the scheduler
@@ -47,6 +52,31 @@ int groupID;         ///< The id of the group of the user that created the job
 int jobId;           ///< The id of the job
 char* module_name = NULL;   ///< The name of the agent
 
+static pthread_t heartbeat_thread;     ///< Thread sending the heartbeat
+static pthread_mutex_t heartbeat_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t heartbeat_cond = PTHREAD_COND_INITIALIZER;
+static int heartbeat_running = 0;      ///< If the heartbeat thread should keep running
+static int heartbeat_interval = ALARM_SECS; ///< Seconds between two heartbeats
+
+/**
+* @brief A counter or gauge reported to the scheduler with METRIC:
+*
+* The name and kind never change once the entry is counted in metrics_count,
+* dirty and value are only accessed atomically.
+*/
+typedef struct
+{
+  char name[FO_METRIC_NAME + 1]; ///< Name of the metric
+  char kind;                     ///< 'c' for a counter, 'g' for a gauge
+  gint dirty;                    ///< If the value changed since it was last sent
+  gint64 value;                  ///< Total for a counter, last value for a gauge
+} fo_metric;
+
+static fo_metric metrics[FO_METRIC_MAX]; ///< Metrics of this agent
+static gint metrics_count = 0;           ///< Number of entries used in metrics
+static gint64 db_connect_time = 0;       ///< Microseconds spent opening the database connection
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER; ///< Serializes creating metrics
+
 /** Check for an agent in DB */
 const static char* sql_check = "\
   SELECT * FROM agent \
@@ -78,21 +108,250 @@ int agent_verbose;
 /**
 * @brief Internal function to send a heartbeat to the
 * scheduler along with the number of items processed.
- *
- * \note Agents should NOT call this function directly.
- * \note This is the alarm SIGALRM function.
+*
+* The alive flag is read and cleared in one atomic step, so a call to
+* fo_scheduler_heart() is never lost between two heartbeats.
+*
+* \note Agents should NOT call this function directly.
+* \note This is called from the heartbeat thread.
 * @return void
- * @todo These functions are not safe for a signal handler
 */
 void fo_heartbeat()
 {
   int processed = g_atomic_int_get(&items_processed);
-  // TODO these functions are not safe for a signal handler
-  fprintf(stdout, "HEART: %d %d\n", processed, alive);
+  int was_alive = g_atomic_int_compare_and_exchange(&alive, TRUE, FALSE);
+
+  fprintf(stdout, "HEART: %d %d\n", processed, was_alive);
   fflush(stdout);
   fflush(stderr);
-  alarm(ALARM_SECS);
-  alive = FALSE;
+}
+
+/**
+* @brief Internal function to send every metric that changed since the last
+*        call to the scheduler.
+*
+* Each metric is sent on its own line as "METRIC: <name> <c|g> <value>".
+* Counters are sent as running totals, so the scheduler simply keeps the last
+* value it received. Since this is only called together with the heartbeat,
+* the scheduler never sees more than one update per metric and interval.
+*
+* \note Agents should NOT call this function directly.
+*/
+static void fo_metric_flush()
+{
+  int i, count;
+
+  count = g_atomic_int_get(&metrics_count);
+  for (i = 0; i < count; i++)
+  {
+    /* an update after this is sent with the next heartbeat */
+    if (!g_atomic_int_compare_and_exchange(&metrics[i].dirty, 1, 0))
+      continue;
+    fprintf(stdout, "METRIC: %s %c %" G_GINT64_FORMAT "\n",
+      metrics[i].name, metrics[i].kind, __atomic_load_n(&metrics[i].value, __ATOMIC_RELAXED));
+  }
+}
+
+/**
+* @brief Internal function to send the load of the host to the scheduler.
+*
+* The message is "LOAD: <load> <memory> <rss>", where load is the one minute
+* load average in percent of the cpus of the host, memory the available memory
+* in MB and rss the resident memory of the agent in MB. The scheduler uses it
+* to choose the host of the next agents and to learn how much memory the agent
+* needs. Nothing is sent if /proc cannot be read.
+*
+* \note Agents should NOT call this function directly.
+*/
+static void fo_load_report()
+{
+  FILE* file;
+  char line[128];
+  double loadavg = -1;
+  long memory = -1;
+  unsigned long size, rss = 0;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if ((file = fopen("/proc/loadavg", "r")) != NULL)
+  {
+    if (fscanf(file, "%lf", &loadavg) != 1)
+      loadavg = -1;
+    fclose(file);
+  }
+
+  if ((file = fopen("/proc/meminfo", "r")) != NULL)
+  {
+    while (memory < 0 && fgets(line, sizeof(line), file) != NULL)
+      if (sscanf(line, "MemAvailable: %ld kB", &memory) != 1)
+        memory = -1;
+    fclose(file);
+  }
+
+  if (loadavg < 0 || memory < 0)
+    return;
+
+  if ((file = fopen("/proc/self/statm", "r")) != NULL)
+  {
+    if (fscanf(file, "%lu %lu", &size, &rss) != 2)
+      rss = 0;
+    fclose(file);
+  }
+
+  fprintf(stdout, "LOAD: %d %ld %lu\n", (int) (100 * loadavg / MAX(cpus, 1)), memory / 1024,
+    rss * sysconf(_SC_PAGESIZE) / (1024 * 1024));
+}
+
+/**
+* @brief Find a metric among the first count entries.
+*
+* @param name   the name of the metric
+* @param kind   'c' for a counter, 'g' for a gauge
+* @param count  the number of entries to search
+* @param found  set if an entry with the name exists
+* @return the metric or NULL if there is none of this kind
+*/
+static fo_metric* fo_metric_find(const char* name, char kind, int count, int* found)
+{
+  int i;
+
+  for (i = 0; i < count; i++)
+  {
+    if (strcmp(metrics[i].name, name) == 0)
+    {
+      *found = 1;
+      return (metrics[i].kind == kind) ? &metrics[i] : NULL;
+    }
+  }
+  *found = 0;
+  return NULL;
+}
+
+/**
+* @brief Find or create a metric.
+*
+* Existing metrics are found without locking, metrics_lock is only taken to
+* create a new one. A new entry is filled in before metrics_count is raised,
+* so the entries below metrics_count are complete for every thread.
+*
+* @param name  the name of the metric, only [A-Za-z0-9_.] are allowed
+* @param kind  'c' for a counter, 'g' for a gauge
+* @return the metric or NULL if the name is invalid or there is no room left
+*/
+static fo_metric* fo_metric_get(const char* name, char kind)
+{
+  fo_metric* metric;
+  const char* c;
+  int count, found;
+
+  metric = fo_metric_find(name, kind, g_atomic_int_get(&metrics_count), &found);
+  if (found)
+    return metric;
+
+  if (name[0] == '\0' || strlen(name) > FO_METRIC_NAME)
+    return NULL;
+  for (c = name; *c; c++)
+    if (!g_ascii_isalnum(*c) && *c != '_' && *c != '.')
+      return NULL;
+
+  pthread_mutex_lock(&metrics_lock);
+  count = g_atomic_int_get(&metrics_count);
+  metric = fo_metric_find(name, kind, count, &found);
+  if (!found && count < FO_METRIC_MAX)
+  {
+    metric = &metrics[count];
+    strcpy(metric->name, name);
+    metric->kind = kind;
+    metric->dirty = 0;
+    metric->value = 0;
+    g_atomic_int_set(&metrics_count, count + 1);
+  }
+  pthread_mutex_unlock(&metrics_lock);
+  return metric;
+}
+
+/**
+* @brief Body of the heartbeat thread, sends a heartbeat every
+*        heartbeat_interval seconds until fo_heartbeat_stop() is called.
+*
+* @param unused
+* @return NULL
+*/
+static void* fo_heartbeat_loop(void* unused)
+{
+  struct timespec deadline;
+
+  pthread_mutex_lock(&heartbeat_lock);
+  while (heartbeat_running)
+  {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += heartbeat_interval;
+    while (heartbeat_running &&
+      pthread_cond_timedwait(&heartbeat_cond, &heartbeat_lock, &deadline) != ETIMEDOUT);
+
+    if (!heartbeat_running)
+      break;
+
+    pthread_mutex_unlock(&heartbeat_lock);
+    /* keep the lines of the agent threads out of the middle of ours */
+    flockfile(stdout);
+    fo_metric_flush();
+    fo_load_report();
+    fo_heartbeat();
+    funlockfile(stdout);
+    pthread_mutex_lock(&heartbeat_lock);
+  }
+  pthread_mutex_unlock(&heartbeat_lock);
+
+  return NULL;
+}
+
+/**
+* @brief Start the heartbeat thread.
+*
+* The interval defaults to ALARM_SECS and can be changed with
+* agent_heartbeat_interval in the SCHEDULER group of fossology.conf. All
+* signals are blocked in the thread so that they keep going to the agent.
+*/
+static void fo_heartbeat_start()
+{
+  sigset_t all, old;
+
+  if (heartbeat_running)
+    return;
+
+  heartbeat_interval = ALARM_SECS;
+  if (fo_config_has_key(sysconfig, "SCHEDULER", "agent_heartbeat_interval"))
+    heartbeat_interval = atoi(fo_config_get(sysconfig, "SCHEDULER", "agent_heartbeat_interval", NULL));
+  if (heartbeat_interval <= 0)
+    heartbeat_interval = ALARM_SECS;
+
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  heartbeat_running = 1;
+  if (pthread_create(&heartbeat_thread, NULL, fo_heartbeat_loop, NULL) != 0)
+  {
+    heartbeat_running = 0;
+    LOG_ERROR("unable to start the heartbeat thread: %s", strerror(errno));
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+/**
+* @brief Stop the heartbeat thread and wait for it to finish.
+*/
+static void fo_heartbeat_stop()
+{
+  pthread_mutex_lock(&heartbeat_lock);
+  if (!heartbeat_running)
+  {
+    pthread_mutex_unlock(&heartbeat_lock);
+    return;
+  }
+  heartbeat_running = 0;
+  pthread_cond_signal(&heartbeat_cond);
+  pthread_mutex_unlock(&heartbeat_lock);
+
+  pthread_join(heartbeat_thread, NULL);
 }
 
 /**
@@ -156,6 +415,10 @@ void fo_check_agentdb(PGconn* db_conn)
 * @brief This function must be called by agents to let the scheduler know they
 * are alive and how many items they have processed.
 *
+* This only updates atomic counters, so it is cheap to call from any number
+* of threads. The heartbeat thread reports the counters to the scheduler and
+* flushes stdout and stderr.
+*
 * @param i   This is the number of itmes processed since the last call to
 * fo_scheduler_heart()
 *
@@ -164,10 +427,83 @@ void fo_check_agentdb(PGconn* db_conn)
 void fo_scheduler_heart(int i)
 {
   g_atomic_int_add(&items_processed, i);
-  alive = TRUE;
+  g_atomic_int_set(&alive, TRUE);
+}
 
+/**
+* @brief Write one log line for the scheduler, used by the LOG_* macros.
+*
+* The line is written while holding the lock of stdout, so the heartbeat
+* thread cannot write into the middle of it.
+*
+* @param level    the level the line starts with, e.g. "ERROR"
+* @param file     the source file of the caller, NULL to leave out the location
+* @param line     the line in the source file
+* @param pqError  a postgresql error message to append, or NULL
+* @param format   printf-style format of the message
+*/
+void fo_scheduler_log(const char* level, const char* file, int line, const char* pqError,
+  const char* format, ...)
+{
+  va_list args;
+
+  flockfile(stdout);
+  if (file)
+    fprintf(stdout, "%s %s.%d: ", level, file, line);
+  else
+    fprintf(stdout, "%s ", level);
+  va_start(args, format);
+  vfprintf(stdout, format, args);
+  va_end(args);
+  if (pqError)
+    fprintf(stdout, "%s postgresql error: %s\n", level, pqError);
+  else
+    fprintf(stdout, "\n");
   fflush(stdout);
-  fflush(stderr);
+  funlockfile(stdout);
+}
+
+/**
+* @brief Add to a counter that is reported to the scheduler.
+*
+* Counters only go up, e.g. bytes scanned or milliseconds spent in the
+* database. The total is sent to the scheduler with the next heartbeat, so
+* this is cheap enough to call for every processed item.
+*
+* @param name   name of the counter, only [A-Za-z0-9_.] are allowed
+* @param value  the amount to add
+* @return void
+*/
+void fo_scheduler_metric_add(const char* name, gint64 value)
+{
+  fo_metric* metric;
+
+  if ((metric = fo_metric_get(name, 'c')) != NULL)
+  {
+    __atomic_add_fetch(&metric->value, value, __ATOMIC_RELAXED);
+    g_atomic_int_set(&metric->dirty, 1);
+  }
+}
+
+/**
+* @brief Set a gauge that is reported to the scheduler.
+*
+* Gauges describe the current state of the agent, e.g. the size of a queue.
+* Only the last value set before the next heartbeat is sent.
+*
+* @param name   name of the gauge, only [A-Za-z0-9_.] are allowed
+* @param value  the new value
+* @return void
+*/
+void fo_scheduler_metric_set(const char* name, gint64 value)
+{
+  fo_metric* metric;
+
+  if ((metric = fo_metric_get(name, 'g')) != NULL)
+  {
+    __atomic_store_n(&metric->value, value, __ATOMIC_RELAXED);
+    g_atomic_int_set(&metric->dirty, 1);
+  }
 }
 
 /**
@@ -268,7 +604,9 @@ void fo_scheduler_connect_conf(int* argc, char** argv, PGconn** db_conn, char**
   if (db_conn)
   {
     db_config = g_strdup_printf("%s/Db.conf", sysconfigdir);
+    db_connect_time = g_get_monotonic_time();
     (*db_conn) = fo_dbconnect(db_config, &db_error);
+    db_connect_time = g_get_monotonic_time() - db_connect_time;
     if (db_conf)
       *db_conf = db_config;
     else
@@ -297,14 +635,14 @@ void fo_scheduler_connect_conf(int* argc, char** argv, PGconn** db_conn, char**
     fflush(stdout);
 
     /* set up the heartbeat() */
-    signal(SIGALRM, fo_heartbeat);
-    alarm(ALARM_SECS);
+    alive = TRUE;
+    fo_heartbeat_start();
   }
 
   fflush(stdout);
   fflush(stderr);
 
-  alive = TRUE;
+  g_atomic_int_set(&alive, TRUE);
 }
 
 /**
@@ -336,6 +674,9 @@ void fo_scheduler_connect(int* argc, char** argv, PGconn** db_conn)
 /**
  * @brief Make a connection from an agent to the scheduler and create a DB
  * manager as well.
+ *
+ * When the DB manager is profiling, the time spent opening the connection is
+ * accounted to it.
  * @param[out] dbManager New DB manager
  */
 void fo_scheduler_connect_dbMan(int* argc, char** argv, fo_dbManager** dbManager)
@@ -344,6 +685,7 @@ void fo_scheduler_connect_dbMan(int* argc, char** argv, fo_dbManager** dbManager
   PGconn* dbConnection;
   fo_scheduler_connect_conf(argc, argv, &dbConnection, &dbConf);
   *dbManager = fo_dbManager_new_withConf(dbConnection, dbConf);
+  fo_dbManager_addConnectTime(*dbManager, db_connect_time);
   free(dbConf);
 }
 
@@ -361,6 +703,8 @@ void fo_scheduler_disconnect(int retcode)
     /* send "CLOSED" to the scheduler */
     if (sscheduler)
     {
+      fo_heartbeat_stop();
+      fo_metric_flush();
       fo_heartbeat();
       fprintf(stdout, "\nBYE %d\n", retcode);
       fflush(stdout);
@@ -404,6 +748,10 @@ void fo_scheduler_disconnect(int retcode)
 *     - a new line must be received, perform same task (i.e. recursive call)
 *   - check for "END" from scheduler, if received print OK and recurse
 *     - this is used to simplify communications within the scheduler
+*   - check for "JOB" from scheduler, if received switch to the new job
+*     - an idle agent kept by the scheduler is given its next job this way,
+*       fo_scheduler_jobId(), fo_scheduler_userID() and fo_scheduler_groupID()
+*       return the new values afterwards
 *   - return whatever has been received
 *
 * @return char* for the next thing to analyze, NULL if there is nothing
@@ -422,12 +770,26 @@ char* fo_scheduler_next()
       break;
     if (strncmp(buffer, "END", 3) == 0)
     {
+      /* the scheduler may give the agent to another job after this */
+      fo_metric_flush();
       fprintf(stdout, "\nOK\n");
       fflush(stdout);
       fflush(stderr);
       valid = 0;
       continue;
     }
+    else if (strncmp(buffer, "JOB ", 4) == 0)
+    {
+      sscanf(&buffer[4], "%d %d %d", &jobId, &userID, &groupID);
+      g_atomic_int_set(&items_processed, 0);
+      /* no metric is updated between two jobs */
+      pthread_mutex_lock(&metrics_lock);
+      g_atomic_int_set(&metrics_count, 0);
+      pthread_mutex_unlock(&metrics_lock);
+      agent_verbose = 0;
+      valid = 0;
+      continue;
+    }
     else if (strncmp(buffer, "VERBOSE", 7) == 0)
     {
       agent_verbose = atoi(&buffer[8]);
@@ -472,6 +834,31 @@ char* fo_scheduler_current()
   return valid ? buffer : NULL;
 }
 
+/**
+* @brief Get the range of pfiles the agent should process.
+*
+* The scheduler splits runonpfile jobs into chunks and hands them to several
+* agents at once. The data of a chunk is the upload id followed by the range,
+* `"<upload> PFILES <first>-<last>"`, so atoi(fo_scheduler_current()) still
+* returns the upload. An agent that supports chunks only processes the pfiles
+* with `pfile_pk BETWEEN first AND last` of the upload, every other pfile is
+* processed by another agent.
+*
+* @param[out] first the first pfile_pk of the chunk
+* @param[out] last  the last pfile_pk of the chunk
+* @return 1 if the current data is a chunk, 0 if the agent should process the
+*         whole upload.
+*/
+int fo_scheduler_chunk(long* first, long* last)
+{
+  char* range;
+
+  if (!valid || (range = strstr(buffer, " PFILES ")) == NULL)
+    return 0;
+
+  return sscanf(range + 8, "%ld-%ld", first, last) == 2;
+}
+
 /**
 * @brief Sets something special about the agent within the scheduler.
 *
@@ -37,6 +37,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define ALARM_SECS 30
 
+#define FO_METRIC_MAX  32   ///< Maximum number of distinct metrics per agent
+#define FO_METRIC_NAME 63   ///< Maximum length of a metric name
+
 
 /* ************************************************************************** */
 /* **** Data Types ********************************************************** */
@@ -83,30 +86,21 @@ extern char* sysconfigdir;
  * @param ... standard printf-style function call
  */
 #define LOG_FATAL(...) { \
-            fprintf(stdout, "FATAL %s.%d: ", __FILE__, __LINE__); \
-            fprintf(stdout, __VA_ARGS__); \
-            fprintf(stdout, "\n"); \
-            fflush(stdout); }
+            fo_scheduler_log("FATAL", __FILE__, __LINE__, NULL, __VA_ARGS__); }
 /**
  * Log Postgres fatal error
  * @param pg_r Postgres error code
  * @param ... standard printf-style function call
  */
 #define LOG_PQ_FATAL(pg_r, ...) { \
-            fprintf(stdout, "FATAL %s.%d: ", __FILE__, __LINE__); \
-            fprintf(stdout, __VA_ARGS__); \
-            fprintf(stdout, "FATAL postgresql error: %s\n", PQresultErrorMessage(pg_r)); \
-            fflush(stdout); }
+            fo_scheduler_log("FATAL", __FILE__, __LINE__, PQresultErrorMessage(pg_r), __VA_ARGS__); }
 
 /**
  * Log general error
  * @param ... standard printf-style function call
  */
 #define LOG_ERROR(...) { \
-            fprintf(stdout, "ERROR %s.%d: ", __FILE__, __LINE__); \
-            fprintf(stdout, __VA_ARGS__); \
-            fprintf(stdout, "\n"); \
-            fflush(stdout); }
+            fo_scheduler_log("ERROR", __FILE__, __LINE__, NULL, __VA_ARGS__); }
 
 /**
  * Log Postgres general error
@@ -114,40 +108,28 @@ extern char* sysconfigdir;
  * @param ... standard printf-style function call
  */
 #define LOG_PQ_ERROR(pg_r, ...) { \
-            fprintf(stdout, "ERROR %s.%d: ", __FILE__, __LINE__); \
-            fprintf(stdout, __VA_ARGS__); \
-            fprintf(stdout, "ERROR postgresql error: %s\n", PQresultErrorMessage(pg_r)); \
-            fflush(stdout); }
+            fo_scheduler_log("ERROR", __FILE__, __LINE__, PQresultErrorMessage(pg_r), __VA_ARGS__); }
 
 /**
  * Log warnings
  * @param ... standard printf-style function call
  */
 #define LOG_WARNING(...) { \
-            fprintf(stdout, "WARNING %s.%d: ", __FILE__, __LINE__); \
-            fprintf(stdout, __VA_ARGS__); \
-            fprintf(stdout, "\n"); \
-            fflush(stdout); }
+            fo_scheduler_log("WARNING", __FILE__, __LINE__, NULL, __VA_ARGS__); }
 
 /**
  * Log debugging messages
  * @param ... standard printf-style function call
  */
 #define LOG_DEBUG(...) { \
-            fprintf(stdout, "DEBUG %s.%d: ", __FILE__, __LINE__); \
-            fprintf(stdout, __VA_ARGS__); \
-            fprintf(stdout, "\n"); \
-            fflush(stdout); }
+            fo_scheduler_log("DEBUG", __FILE__, __LINE__, NULL, __VA_ARGS__); }
 
 /**
  * Log notice messages
  * @param ... standard printf-style function call
  */
 #define LOG_NOTICE(...) { \
-            fprintf(stdout, "NOTICE %s.%d: ", __FILE__, __LINE__); \
-            fprintf(stdout, __VA_ARGS__); \
-            fprintf(stdout, "\n"); \
-            fflush(stdout); }
+            fo_scheduler_log("NOTICE", __FILE__, __LINE__, NULL, __VA_ARGS__); }
 
 #define TVERBOSE   agent_verbose              ///< Agent verbose set
 #define TVERBOSE0 (agent_verbose & (1 << 0))  ///< Verbose level 0
@@ -197,12 +179,13 @@ extern char* sysconfigdir;
 * @param ... standard printf-style function call
 */
 #define NOTIFY_EMAIL(...)         \
-    fprintf(stdout, "EMAIL ");    \
-    fprintf(stdout, __VA_ARGS__); \
-    fprintf(stdout, "\n");        \
-    fflush(stdout)
+    fo_scheduler_log("EMAIL", NULL, 0, NULL, __VA_ARGS__)
 
 void fo_scheduler_heart(int i);
+void fo_scheduler_log(const char* level, const char* file, int line, const char* pqError,
+  const char* format, ...) __attribute__((format(printf, 5, 6)));
+void fo_scheduler_metric_add(const char* name, gint64 value);
+void fo_scheduler_metric_set(const char* name, gint64 value);
 void fo_scheduler_connect(int* argc, char** argv, PGconn** db_conn);
 void fo_scheduler_connect_dbMan(int* argc, char** argv, fo_dbManager** dbManager);
 void fo_scheduler_disconnect(int retcode);
@@ -213,6 +196,7 @@ char* fo_scheduler_next();
 /* ************************************************************************** */
 
 char* fo_scheduler_current();
+int fo_scheduler_chunk(long* first, long* last);
 int fo_scheduler_userID();
 int fo_scheduler_groupID();
 int fo_scheduler_jobId();
@@ -0,0 +1,183 @@
+/*********************************************************************
+Copyright (C) 2026 Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*********************************************************************/
+
+/**
+* @file
+* @brief Unit tests for the fosscopy library section of libfossology.
+*/
+
+/* includes for files that will be tested */
+#include <libfosscopy.h>
+
+/* library includes */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* cunit includes */
+#include <libfocunit.h>
+
+#define COPY_SRC "fosscopy_src.tmp"
+#define COPY_DST "fosscopy_dst.tmp"
+#define COPY_LEN (3 * FO_COPY_BUFSIZE + 17)
+
+/* ************************************************************************** */
+/* *** local functions ****************************************************** */
+/* ************************************************************************** */
+
+/**
+* @brief Check that COPY_DST holds the same Len bytes as Data
+*/
+static int same_content(const char* Data, size_t Len)
+{
+  char* Buf = malloc(Len + 1);
+  ssize_t Read;
+  int Fd, rc;
+
+  Fd = open(COPY_DST, O_RDONLY);
+  Read = read(Fd, Buf, Len + 1);
+  close(Fd);
+
+  rc = (Read == (ssize_t) Len && memcmp(Buf, Data, Len) == 0);
+  free(Buf);
+  return rc;
+}
+
+/* ************************************************************************** */
+/* *** test cases *********************************************************** */
+/* ************************************************************************** */
+
+/**
+* @brief Copy a regular file larger than the copy buffer.
+* @test
+* -# Create a file of several buffers
+* -# Call fo_CopyFd() and check the strategy is set
+* -# Check the content of the copy
+*/
+void test_fo_CopyFd_file()
+{
+  char* Data = malloc(COPY_LEN);
+  int Fin, Fout, Strategy, rc;
+  ssize_t Wrote;
+  size_t i;
+
+  for (i = 0; i < COPY_LEN; i++)
+    Data[i] = (char) (i * 31 + i / 4096);
+
+  Fout = open(COPY_SRC, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  Wrote = write(Fout, Data, COPY_LEN);
+  FO_ASSERT_EQUAL((int) Wrote, COPY_LEN);
+  close(Fout);
+
+  Fin = open(COPY_SRC, O_RDONLY);
+  Fout = open(COPY_DST, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  rc = fo_CopyFd(Fin, Fout, &Strategy);
+  FO_ASSERT_EQUAL(rc, 0);
+  FO_ASSERT_NOT_EQUAL(Strategy, FO_COPY_NONE);
+  close(Fin);
+  close(Fout);
+
+  FO_ASSERT_TRUE(same_content(Data, COPY_LEN));
+
+  unlink(COPY_SRC);
+  unlink(COPY_DST);
+  free(Data);
+}
+
+/**
+* @brief Copy from a pipe, which can only be copied through the buffer.
+* @test
+* -# Write into a pipe
+* -# Call fo_CopyFd() with the read end and check the strategy is FO_COPY_BUFFER
+* -# Check the content of the copy
+*/
+void test_fo_CopyFd_pipe()
+{
+  const char Data[] = "copied through the buffer\n";
+  int Pipe[2], Fout, Strategy, rc;
+  ssize_t Wrote;
+
+  rc = pipe(Pipe);
+  FO_ASSERT_EQUAL(rc, 0);
+  Wrote = write(Pipe[1], Data, strlen(Data));
+  FO_ASSERT_EQUAL((int) Wrote, (int) strlen(Data));
+  close(Pipe[1]);
+
+  Fout = open(COPY_DST, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  rc = fo_CopyFd(Pipe[0], Fout, &Strategy);
+  FO_ASSERT_EQUAL(rc, 0);
+  FO_ASSERT_EQUAL(Strategy, FO_COPY_BUFFER);
+  close(Pipe[0]);
+  close(Fout);
+
+  FO_ASSERT_TRUE(same_content(Data, strlen(Data)));
+
+  unlink(COPY_DST);
+}
+
+/**
+* @brief Copying into a read only descriptor must fail.
+* @test
+* -# Call fo_CopyFd() with a destination opened for reading
+* -# Check that -1 is returned
+*/
+void test_fo_CopyFd_error()
+{
+  const char Data[] = "data";
+  int Fin, Fout, rc;
+  ssize_t Wrote;
+
+  Fout = open(COPY_SRC, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  Wrote = write(Fout, Data, strlen(Data));
+  FO_ASSERT_EQUAL((int) Wrote, (int) strlen(Data));
+  close(Fout);
+
+  Fin = open(COPY_SRC, O_RDONLY);
+  Fout = open(COPY_SRC, O_RDONLY);
+  rc = fo_CopyFd(Fin, Fout, NULL);
+  FO_ASSERT_EQUAL(rc, -1);
+  close(Fin);
+  close(Fout);
+
+  unlink(COPY_SRC);
+}
+
+/**
+* @brief Check the names of the strategies.
+*/
+void test_fo_CopyStrategyName()
+{
+  FO_ASSERT_STRING_EQUAL(fo_CopyStrategyName(FO_COPY_CLONE), "clone");
+  FO_ASSERT_STRING_EQUAL(fo_CopyStrategyName(FO_COPY_RANGE), "copy_file_range");
+  FO_ASSERT_STRING_EQUAL(fo_CopyStrategyName(FO_COPY_BUFFER), "buffer");
+  FO_ASSERT_STRING_EQUAL(fo_CopyStrategyName(-1), "none");
+}
+
+/* ************************************************************************** */
+/* *** cunit test info ****************************************************** */
+/* ************************************************************************** */
+
+CU_TestInfo fosscopy_testcases[] =
+  {
+    {"fo_CopyFd() file", test_fo_CopyFd_file},
+    {"fo_CopyFd() pipe", test_fo_CopyFd_pipe},
+    {"fo_CopyFd() error", test_fo_CopyFd_error},
+    {"fo_CopyStrategyName()", test_fo_CopyStrategyName},
+    CU_TEST_INFO_NULL
+  };
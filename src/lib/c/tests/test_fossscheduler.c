@@ -231,12 +231,11 @@ void test_scheduler_connect()
   FO_ASSERT_PTR_NOT_NULL(tmp);
   FO_ASSERT_STRING_EQUAL(tmp, "OK\n");
 
-  ualarm(10, 0);
-  usleep(20);
+  fo_heartbeat();
 
   FO_ASSERT_STRING_EQUAL(
     fgets(buffer, sizeof(buffer), read_from),
-    "HEART: 0\n");
+    "HEART: 0 1\n");
 }
 
 /**
@@ -354,6 +353,49 @@ void test_scheduler_current()
   FO_ASSERT_PTR_NULL(fo_scheduler_current());
 }
 
+/**
+* @brief Tests getting the pfile range of a chunk.
+* @test
+* -# Send data without a range and check that fo_scheduler_chunk() returns 0
+* -# Send the data of a chunk and check the range it returns
+* @return void
+*/
+void test_scheduler_chunk()
+{
+  long first = 0, last = 0;
+
+  write_con("6\n");
+  FO_ASSERT_PTR_NOT_NULL(fo_scheduler_next());
+  FO_ASSERT_FALSE(fo_scheduler_chunk(&first, &last));
+
+  write_con("6 PFILES 10-20\n");
+  FO_ASSERT_PTR_NOT_NULL(fo_scheduler_next());
+  FO_ASSERT_TRUE(fo_scheduler_chunk(&first, &last));
+  FO_ASSERT_EQUAL(atoi(fo_scheduler_current()), 6);
+  FO_ASSERT_EQUAL(first, 10);
+  FO_ASSERT_EQUAL(last, 20);
+}
+
+/**
+* @brief Tests giving a new job to an agent that is kept by the scheduler.
+* @test
+* -# Send `JOB 42 3 4\n` followed by data to the scheduler
+* -# Check that fo_scheduler_next() returns the data
+* -# Check the job, user and group ids of the new job
+* @return void
+*/
+void test_scheduler_job()
+{
+  write_con("JOB 42 3 4\n");
+  write_con("7\n");
+
+  FO_ASSERT_STRING_EQUAL(fo_scheduler_next(), "7");
+  FO_ASSERT_EQUAL(fo_scheduler_jobId(), 42);
+  FO_ASSERT_EQUAL(fo_scheduler_userID(), 3);
+  FO_ASSERT_EQUAL(fo_scheduler_groupID(), 4);
+  FO_ASSERT_EQUAL(items_processed, 0);
+}
+
 /**
 * @brief Tests the scheduler disconnection function.
 * @test
@@ -379,7 +421,7 @@ void test_scheduler_disconnect()
 * -# Send heart beat 1 using fo_scheduler_heart() and check if items_processed
 * is updated.
 * -# Send heart beat 10 and check if items_processed is updated with 11.
-* -# Send `SIGALRM` and check if scheduler returns `HEART: 11`.
+* -# Send a heartbeat and check if scheduler returns `HEART: 11 1`.
 * @return void
 */
 void test_scheduler_heart()
@@ -390,13 +432,40 @@ void test_scheduler_heart()
   fo_scheduler_heart(10);
   FO_ASSERT_EQUAL(items_processed, 11);
 
-  signal(SIGALRM, fo_heartbeat);
-  ualarm(10, 0);
-  usleep(20);
+  fo_heartbeat();
+
+  FO_ASSERT_STRING_EQUAL(
+    fgets(buffer, sizeof(buffer), read_from),
+    "HEART: 11 1\n");
+
+  /* the alive flag is cleared by the heartbeat */
+  fo_heartbeat();
 
   FO_ASSERT_STRING_EQUAL(
     fgets(buffer, sizeof(buffer), read_from),
-    "HEART: 11\n");
+    "HEART: 11 0\n");
+}
+
+/**
+* @brief Test that the LOG_* macros write their message as one line.
+* @test
+* -# Log a warning and a postgresql error.
+* -# Check that each arrives on stdout in the format the scheduler parses.
+* @return void
+*/
+void test_scheduler_log()
+{
+  char expected[256];
+  int line;
+
+  line = __LINE__; LOG_WARNING("warning %d", 1);
+  snprintf(expected, sizeof(expected), "WARNING %s.%d: warning 1\n", __FILE__, line);
+  FO_ASSERT_STRING_EQUAL(fgets(buffer, sizeof(buffer), read_from), expected);
+
+  line = __LINE__; LOG_PQ_ERROR(NULL, "query %s ", "failed");
+  snprintf(expected, sizeof(expected), "ERROR %s.%d: query failed ERROR postgresql error: %s\n",
+    __FILE__, line, PQresultErrorMessage(NULL));
+  FO_ASSERT_STRING_EQUAL(fgets(buffer, sizeof(buffer), read_from), expected);
 }
 
 /* ************************************************************************** */
@@ -414,8 +483,11 @@ CU_TestInfo fossscheduler_testcases[] =
     {"fossscheduler next version", test_scheduler_next_version},
     {"fossscheduler next oth", test_scheduler_next_oth},
     {"fossscheduler current", test_scheduler_current},
+    {"fossscheduler chunk", test_scheduler_chunk},
+    {"fossscheduler job", test_scheduler_job},
     {"fossscheduler disconnect", test_scheduler_disconnect},
     {"fossscheduler heat", test_scheduler_heart},
+    {"fossscheduler log", test_scheduler_log},
     {"fossscheduler tear down", tear_down},
     CU_TEST_INFO_NULL
   };
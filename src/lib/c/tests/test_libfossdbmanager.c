@@ -948,6 +948,68 @@ void test_parsing()
   g_array_free(result, TRUE);
 }
 
+void test_profiling()
+{
+  PGconn* pgConn;
+  char* ErrorBuf;
+
+  pgConn = fo_dbconnect(dbConf, &ErrorBuf);
+  fo_dbManager* dbManager = fo_dbManager_new(pgConn);
+  CU_ASSERT_FALSE(fo_dbManager_isProfiling(dbManager));
+  fo_dbManager_setProfiling(dbManager, 1);
+  CU_ASSERT_TRUE(fo_dbManager_isProfiling(dbManager));
+
+  char* testTableName = TESTTABLE;
+  if (_getTestTable(dbManager, &testTableName, "a int"))
+  {
+    char* queryInsert = g_strdup_printf("INSERT INTO %s (a) VALUES($1)", testTableName);
+    fo_dbManager_PreparedStatement* stmtInsert = fo_dbManager_PrepareStamement(
+      dbManager,
+      "testprofiling:insert",
+      queryInsert,
+      int
+    );
+    g_free(queryInsert);
+
+    int i;
+    for (i = 0; i < 4; i++)
+    {
+      PGresult* insert = fo_dbManager_ExecPrepared(stmtInsert, i);
+      CU_ASSERT_PTR_NOT_NULL(insert);
+      if (insert)
+        PQclear(insert);
+    }
+    PGresult* select = fo_dbManager_Exec_printf(dbManager, "SELECT a FROM %s", testTableName);
+    CU_ASSERT_PTR_NOT_NULL(select);
+    if (select)
+      PQclear(select);
+
+    char* dump = NULL;
+    size_t dumpSize = 0;
+    FILE* out = open_memstream(&dump, &dumpSize);
+    fo_dbManager_dumpProfile(dbManager, out);
+    fclose(out);
+
+    GRegex* insertLine = g_regex_new(" +4 +0 +4 .* testprofiling:insert\n", 0, 0, NULL);
+    GRegex* selectLine = g_regex_new(" +1 +0 +4 .* printf: SELECT a FROM %s\n", 0, 0, NULL);
+    CU_ASSERT_TRUE(g_regex_match(insertLine, dump, 0, NULL));
+    CU_ASSERT_TRUE(g_regex_match(selectLine, dump, 0, NULL));
+    g_regex_unref(insertLine);
+    g_regex_unref(selectLine);
+    free(dump);
+
+    fo_dbManager_Exec_printf(dbManager, "DROP TABLE %s", testTableName);
+  } else
+  {
+    CU_FAIL("could not get test table");
+  }
+
+  fo_dbManager_setProfiling(dbManager, 0);
+  CU_ASSERT_FALSE(fo_dbManager_isProfiling(dbManager));
+  fo_dbManager_free(dbManager);
+  PQfinish(pgConn);
+}
+
 /* ************************************************************************** */
 /* *** cunit test info ****************************************************** */
 /* ************************************************************************** */
@@ -962,5 +1024,6 @@ CU_TestInfo libfossdbmanager_testcases[] =
 //    { "performance test", test_perf },
     {"fork dbManager", test_fork},
     {"fork dbManager without configuration", test_fork_error},
+    {"profiling", test_profiling},
     CU_TEST_INFO_NULL
   };
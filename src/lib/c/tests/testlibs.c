@@ -30,6 +30,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 char* dbConf;
 
 extern CU_TestInfo fossconfig_testcases[];
+extern CU_TestInfo fosscopy_testcases[];
 extern CU_TestInfo fossscheduler_testcases[];
 extern CU_TestInfo libfossdb_testcases[];
 extern CU_TestInfo libfossdbmanager_testcases[];
@@ -45,6 +46,7 @@ CU_SuiteInfo suites[] =
   {
     {"Testing libfossdb", NULL, NULL, NULL, NULL, libfossdb_testcases},
     {"Testing fossconfig", NULL, NULL, NULL, NULL, fossconfig_testcases},
+    {"Testing fosscopy", NULL, NULL, NULL, NULL, fosscopy_testcases},
     {"Testing libfossdbmanger", NULL, NULL, NULL, NULL, libfossdbmanager_testcases},
     // TODO fix { "Testing fossscheduler", NULL, NULL, fossscheduler_testcases },
     CU_SUITE_INFO_NULL
@@ -54,6 +56,7 @@ CU_SuiteInfo suites[] =
   {
     {"Testing libfossdb", NULL, NULL, libfossdb_testcases},
     {"Testing fossconfig", NULL, NULL, fossconfig_testcases},
+    {"Testing fosscopy", NULL, NULL, fosscopy_testcases},
     {"Testing libfossdbmanger", NULL, NULL, libfossdbmanager_testcases},
     // TODO fix { "Testing fossscheduler", NULL, NULL, fossscheduler_testcases },
     CU_SUITE_INFO_NULL
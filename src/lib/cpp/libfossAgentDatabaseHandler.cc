@@ -19,10 +19,16 @@
 #include "libfossAgentDatabaseHandler.hpp"
 #include "libfossUtils.hpp"
 
+#include <cstdarg>
+
 extern "C" {
 #include "libfossagent.h"
+#include "libfossrepo.h"
 }
 
+/** Rows fetched per round trip by fo::AgentDatabaseHandler::queryPFiles() */
+#define PFILE_FETCH_SIZE 10000
+
 /**
  * \file
  * \brief DB utility functions for agents
@@ -114,3 +120,113 @@ std::string fo::AgentDatabaseHandler::queryUploadTreeTableName(int uploadId)
 {
   return std::string(getUploadTreeTableName(dbManager.getStruct_dbManager(), uploadId));
 }
+
+/**
+ * \brief Get the pfiles of an upload with their names, sizes and paths
+ *
+ * Returns the same files as queryFileIdsVectorForUpload(), so agents get
+ * their work list and the repository paths in one query instead of calling
+ * getPFileNameForFileId() for every file.
+ * \param uploadId Upload id to fetch from
+ * \return The pfiles of the upload, empty on error
+ * \sa queryPFiles()
+ */
+std::vector<fo::PFileInfo> fo::AgentDatabaseHandler::queryPFilesForUpload(int uploadId)
+{
+  std::string uploadTreeTableName = queryUploadTreeTableName(uploadId);
+
+  /* only uploadtree_a is shared between uploads, see queryFileIdsForUpload() */
+  if (uploadTreeTableName == "uploadtree_a")
+    return queryPFiles(
+      ("queryPFilesForUpload." + uploadTreeTableName).c_str(),
+      "SELECT pfile_pk, pfile_sha1 || '.' || pfile_md5 || '.' || pfile_size, pfile_size"
+      " FROM pfile WHERE pfile_pk IN ("
+      "  SELECT pfile_fk FROM " + uploadTreeTableName +
+      "  WHERE upload_fk = $1 AND (ufile_mode&x'3C000000'::int)=0"
+      ")",
+      "int", uploadId);
+
+  return queryPFiles(
+    ("queryPFilesForUpload." + uploadTreeTableName).c_str(),
+    "SELECT pfile_pk, pfile_sha1 || '.' || pfile_md5 || '.' || pfile_size, pfile_size"
+    " FROM pfile WHERE pfile_pk IN ("
+    "  SELECT pfile_fk FROM " + uploadTreeTableName +
+    "  WHERE (ufile_mode&x'3C000000'::int)=0"
+    ")",
+    "");
+}
+
+/**
+ * \brief Run a pfile query and resolve the repository paths of its results
+ *
+ * The query must return pfile_pk, the pfile name (`SHA1.MD5.SIZE`) and
+ * pfile_size, in this order. It is prepared as the declaration of a cursor,
+ * so its parameters stay bound, and streamed in a transaction of its own,
+ * PFILE_FETCH_SIZE rows per round trip. The paths are derived with
+ * fo_RepMkPath() here, before agents start their worker threads, so the
+ * threads need neither the database nor the repo_mk_path critical section
+ * to find their files.
+ * \param queryName  Name of the prepared statement, unique for the query
+ * \param query      Query returning pfile_pk, pfile name and pfile_size
+ * \param paramTypes Types of the query parameters, as for fo_dbManager_PrepareStamement()
+ * \param ...        Values of the query parameters
+ * \return The pfiles, empty on error
+ */
+std::vector<fo::PFileInfo> fo::AgentDatabaseHandler::queryPFiles(const char* queryName, const std::string& query,
+  const char* paramTypes, ...) const
+{
+  std::vector<PFileInfo> result;
+
+  fo_dbManager_PreparedStatement* declareCursor = fo_dbManager_PrepareStamement_str(
+    dbManager.getStruct_dbManager(),
+    queryName,
+    ("DECLARE pfile_cursor NO SCROLL CURSOR FOR " + query).c_str(),
+    paramTypes
+  );
+  if (!declareCursor || !dbManager.begin())
+    return result;
+
+  va_list args;
+  va_start(args, paramTypes);
+  QueryResult cursor(fo_dbManager_ExecPreparedv(declareCursor, args));
+  va_end(args);
+  if (!cursor)
+  {
+    dbManager.rollback();
+    return result;
+  }
+
+  while (true)
+  {
+    QueryResult batch = dbManager.queryPrintf("FETCH %d FROM pfile_cursor", PFILE_FETCH_SIZE);
+    if (!batch)
+    {
+      dbManager.rollback();
+      return std::vector<PFileInfo>();
+    }
+
+    int rowCount = batch.getRowCount();
+    for (int i = 0; i < rowCount; i++)
+    {
+      std::vector<std::string> row = batch.getRow(i);
+      PFileInfo pFile;
+      pFile.id = fo::stringToUnsignedLong(row[0].c_str());
+      pFile.name = row[1];
+      pFile.size = fo::stringToUnsignedLong(row[2].c_str());
+
+      char* path = fo_RepMkPath("files", &pFile.name[0]);
+      if (path)
+      {
+        pFile.path = path;
+        free(path);
+      }
+      result.push_back(pFile);
+    }
+
+    if (rowCount < PFILE_FETCH_SIZE)
+      break;
+  }
+
+  dbManager.commit();
+  return result;
+}
@@ -18,6 +18,7 @@
 #ifndef LIBFOSS_AGENT_DATABASE_HANDLER_HPP_
 #define LIBFOSS_AGENT_DATABASE_HANDLER_HPP_
 
+#include <string>
 #include <vector>
 
 #include "libfossdbmanagerclass.hpp"
@@ -29,6 +30,18 @@
 
 namespace fo
 {
+  /**
+   * \struct PFileInfo
+   * \brief A pfile to scan, with its repository path
+   */
+  struct PFileInfo
+  {
+    unsigned long id;       ///< pfile_pk
+    std::string name;       ///< File name in the repository (`SHA1.MD5.SIZE`)
+    unsigned long size;     ///< pfile_size
+    std::string path;       ///< Path in the repository, empty if it could not be derived
+  };
+
   /**
    * \class AgentDatabaseHandler
    * \brief Database handler for agents
@@ -38,6 +51,8 @@ namespace fo
 
   protected:
     DbManager dbManager;        ///< DbManager to use
+
+    std::vector<PFileInfo> queryPFiles(const char* queryName, const std::string& query, const char* paramTypes, ...) const;
   public:
     AgentDatabaseHandler(DbManager dbManager);
     AgentDatabaseHandler(AgentDatabaseHandler&& other);
@@ -58,6 +73,7 @@ namespace fo
     char* getPFileNameForFileId(unsigned long pfileId) const;
     std::string queryUploadTreeTableName(int uploadId);
     std::vector<unsigned long> queryFileIdsVectorForUpload(int uploadId) const;
+    std::vector<PFileInfo> queryPFilesForUpload(int uploadId);
   };
 }
 
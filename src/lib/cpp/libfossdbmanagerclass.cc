@@ -157,18 +157,15 @@ bool DbManager::rollback() const
  * placeholder in queryFormat).
  * \param queryFormat Printf styled string format
  * \return QueryResult
- * \sa fo_dbManager_Exec_printf()
+ * \sa fo_dbManager_Exec_vprintf()
  */
 QueryResult DbManager::queryPrintf(const char* queryFormat, ...) const
 {
   va_list args;
   va_start(args, queryFormat);
-  char* queryString = g_strdup_vprintf(queryFormat, args);
+  QueryResult result(fo_dbManager_Exec_vprintf(getStruct_dbManager(), queryFormat, args));
   va_end(args);
 
-  QueryResult result(fo_dbManager_Exec_printf(getStruct_dbManager(), queryString));
-
-  g_free(queryString);
   return result;
 }
 
@@ -198,4 +195,35 @@ void DbManager::ignoreWarnings(bool b) const
   fo_dbManager_ignoreWarnings(getStruct_dbManager(), b);
 }
 
+/**
+ * Turn the per statement profiling of the connection on or off
+ *
+ * Agents get it without calling this when FO_DBPROFILE is set, the profile
+ * is dumped when the last copy of this DbManager is destroyed.
+ * \param b True to profile
+ * \sa fo_dbManager_setProfiling()
+ */
+void DbManager::setProfiling(bool b) const
+{
+  fo_dbManager_setProfiling(getStruct_dbManager(), b);
+}
 
+/**
+ * Check if the connection is profiled
+ * \return True if profiling, false otherwise
+ * \sa fo_dbManager_isProfiling()
+ */
+bool DbManager::isProfiling() const
+{
+  return fo_dbManager_isProfiling(getStruct_dbManager()) != 0;
+}
+
+/**
+ * Print the profile of the connection
+ * \param out Where to print
+ * \sa fo_dbManager_dumpProfile()
+ */
+void DbManager::dumpProfile(FILE* out) const
+{
+  fo_dbManager_dumpProfile(getStruct_dbManager(), out);
+}
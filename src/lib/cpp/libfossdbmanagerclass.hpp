@@ -74,6 +74,9 @@ namespace fo
     bool commit() const;
     bool rollback() const;
     void ignoreWarnings(bool) const;
+    void setProfiling(bool) const;
+    bool isProfiling() const;
+    void dumpProfile(FILE* out) const;
 
     QueryResult queryPrintf(const char* queryFormat, ...) const;
     QueryResult execPrepared(fo_dbManager_PreparedStatement* stmt, ...) const;
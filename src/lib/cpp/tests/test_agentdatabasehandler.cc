@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2026, Siemens AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libfodbreposysconf.h>
+#include "libfossrepo.h"
+#include "libfossscheduler.h"
+}
+
+#include "libfossdbmanagerclass.hpp"
+#include "libfossAgentDatabaseHandler.hpp"
+
+/**
+ * \file
+ * \brief Test case for the agent database handler
+ */
+
+/**
+ * \class FoLibCPPAgentDatabaseHandlerTest
+ * \brief Test cases for fo::AgentDatabaseHandler
+ */
+class FoLibCPPAgentDatabaseHandlerTest : public CPPUNIT_NS::TestFixture {
+CPPUNIT_TEST_SUITE(FoLibCPPAgentDatabaseHandlerTest);
+    CPPUNIT_TEST(test_queryPFilesForUpload);
+    CPPUNIT_TEST(test_queryPFilesForUploadEmpty);
+  CPPUNIT_TEST_SUITE_END();
+private:
+  fo::DbManager* dbManager;       ///< Object for DbManager
+
+  /**
+   * Create the tables read by fo::AgentDatabaseHandler::queryPFilesForUpload()
+   *
+   * Upload 1 has one file more than a cursor batch and a directory, upload 2
+   * has nothing.
+   */
+  void createUploads(fo::DbManager& manager) {
+    CPPUNIT_ASSERT(manager.queryPrintf("CREATE TABLE upload(upload_pk integer, uploadtree_tablename text)"));
+    CPPUNIT_ASSERT(manager.queryPrintf(
+      "CREATE TABLE pfile(pfile_pk integer, pfile_sha1 text, pfile_md5 text, pfile_size bigint)"));
+    CPPUNIT_ASSERT(manager.queryPrintf(
+      "CREATE TABLE uploadtree_a(upload_fk integer, pfile_fk integer, ufile_mode integer)"));
+
+    CPPUNIT_ASSERT(manager.queryPrintf("INSERT INTO upload VALUES (1, 'uploadtree_a'), (2, 'uploadtree_a')"));
+    CPPUNIT_ASSERT(manager.queryPrintf(
+      "INSERT INTO pfile SELECT i, 'sha' || i, 'md5', i FROM generate_series(1, 10002) AS i"));
+    CPPUNIT_ASSERT(manager.queryPrintf(
+      "INSERT INTO uploadtree_a SELECT 1, i, 0 FROM generate_series(1, 10001) AS i"));
+    CPPUNIT_ASSERT(manager.queryPrintf(
+      "INSERT INTO uploadtree_a VALUES (1, 10002, x'20000000'::int)"));
+  }
+
+public:
+  /**
+   * Create the test environment and open its repository
+   */
+  void setUp() {
+    dbManager = new fo::DbManager(createTestEnvironment("", NULL, 0));
+
+    std::string confFile = std::string(get_sysconfdir()) + "/fossology.conf";
+    sysconfig = fo_config_load(&confFile[0], NULL);
+    CPPUNIT_ASSERT(sysconfig);
+    CPPUNIT_ASSERT(fo_RepOpenFull(sysconfig));
+  }
+
+  /**
+   * Close the repository and destroy the test environment
+   */
+  void tearDown() {
+    fo_RepClose();
+    fo_config_free(sysconfig);
+    sysconfig = NULL;
+
+    delete dbManager;
+    // dbManager connection is already closed by destructor
+    dropTestEnvironment(NULL, "", NULL);
+  }
+
+  /**
+   * Test to check fo::AgentDatabaseHandler::queryPFilesForUpload()
+   * \test
+   * -# Create an upload with more files than a cursor fetches at once.
+   * -# Call fo::AgentDatabaseHandler::queryPFilesForUpload().
+   * -# Check that every file but the directory is returned once.
+   * -# Check the name, size and repository path of a file.
+   */
+  void test_queryPFilesForUpload() {
+    fo::DbManager manager = dbManager->spawn();
+    createUploads(manager);
+
+    fo::AgentDatabaseHandler databaseHandler(manager);
+    std::vector<fo::PFileInfo> pFiles = databaseHandler.queryPFilesForUpload(1);
+
+    CPPUNIT_ASSERT_EQUAL(10001, (int) pFiles.size());
+
+    std::vector<int> ids;
+    for (const fo::PFileInfo& pFile : pFiles)
+      ids.push_back(pFile.id);
+    std::sort(ids.begin(), ids.end());
+    std::vector<int> expected;
+    for (int i = 1; i <= 10001; i++)
+      expected.push_back(i);
+    CPPUNIT_ASSERT(expected == ids);
+
+    std::vector<fo::PFileInfo>::iterator pFile = std::find_if(pFiles.begin(), pFiles.end(),
+      [](const fo::PFileInfo& p) { return p.id == 5; });
+    CPPUNIT_ASSERT(pFile != pFiles.end());
+    CPPUNIT_ASSERT_EQUAL(std::string("sha5.md5.5"), pFile->name);
+    CPPUNIT_ASSERT_EQUAL(5ul, pFile->size);
+    CPPUNIT_ASSERT_EQUAL(std::string(get_sysconfdir()) + "/repo/files/sha5.md5.5", pFile->path);
+
+    /* the cursor lives in a transaction of its own */
+    CPPUNIT_ASSERT(manager.begin());
+    CPPUNIT_ASSERT(manager.commit());
+  }
+
+  /**
+   * Test to check fo::AgentDatabaseHandler::queryPFilesForUpload() on an
+   * upload without files
+   * \test
+   * -# Create an upload without files.
+   * -# Call fo::AgentDatabaseHandler::queryPFilesForUpload() twice, to also
+   *    run the cached statement.
+   * -# Check that no file is returned.
+   */
+  void test_queryPFilesForUploadEmpty() {
+    fo::DbManager manager = dbManager->spawn();
+    createUploads(manager);
+
+    fo::AgentDatabaseHandler databaseHandler(manager);
+
+    CPPUNIT_ASSERT(databaseHandler.queryPFilesForUpload(2).empty());
+    CPPUNIT_ASSERT(databaseHandler.queryPFilesForUpload(2).empty());
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FoLibCPPAgentDatabaseHandlerTest);
@@ -48,6 +48,7 @@ CPPUNIT_TEST_SUITE(FoLibCPPTest);
     CPPUNIT_TEST(test_transactions);
     CPPUNIT_TEST(test_runBadCommandQueryCheckIfError);
     CPPUNIT_TEST(test_runSchedulerConnectConstructor);
+    CPPUNIT_TEST(test_profiling);
   CPPUNIT_TEST_SUITE_END();
 private:
   fo::DbManager* dbManager;       ///< Object for DbManager
@@ -278,6 +279,45 @@ public:
     CPPUNIT_ASSERT(system((std::string("rm -rf '") + sysConf + "/mods-enabled'").c_str()) >= 0);
   }
 
+  /**
+   * Test to check the profiling of a DbManager
+   * \test
+   * -# Spawn a new DbManager and turn profiling on.
+   * -# Execute a prepared statement and a printf query.
+   * -# Dump the profile with fo::DbManager::dumpProfile().
+   * -# Check the calls and rows of both statements.
+   */
+  void test_profiling() {
+    fo::DbManager manager = dbManager->spawn();
+    CPPUNIT_ASSERT(!manager.isProfiling());
+    manager.setProfiling(true);
+    CPPUNIT_ASSERT(manager.isProfiling());
+
+    CPPUNIT_ASSERT(manager.queryPrintf("CREATE TABLE tbl(col integer)"));
+    fo_dbManager_PreparedStatement* preparedStatement = fo_dbManager_PrepareStamement(
+      manager.getStruct_dbManager(),
+      "test",
+      "INSERT INTO tbl(col) VALUES ($1)",
+      int
+    );
+    for (int i = 0; i < 3; ++i) {
+      CPPUNIT_ASSERT(manager.execPrepared(preparedStatement, i));
+    }
+    CPPUNIT_ASSERT(manager.queryPrintf("SELECT * FROM tbl WHERE col < %d", 10));
+
+    char* dump = NULL;
+    size_t dumpSize = 0;
+    FILE* out = open_memstream(&dump, &dumpSize);
+    manager.dumpProfile(out);
+    fclose(out);
+    std::string profile(dump);
+    free(dump);
+
+    CPPUNIT_ASSERT(g_regex_match_simple(" +3 +0 +3 .* test\n", profile.c_str(), G_REGEX_MULTILINE, (GRegexMatchFlags) 0));
+    CPPUNIT_ASSERT(g_regex_match_simple(" +1 +0 +3 .* printf: SELECT \\* FROM tbl WHERE col < %d\n",
+      profile.c_str(), G_REGEX_MULTILINE, (GRegexMatchFlags) 0));
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(FoLibCPPTest);
@@ -148,7 +148,9 @@ function JobAddJob($userId, $groupId, $job_name, $upload_pk=0, $priority=0)
  * @param string $jq_type Name of agent (should match the name in agent.conf
  * @param string $jq_args Arguments to pass to the agent in the form of
  * <tt>$jq_args="folder_pk='$Folder' name='$Name' description='$Desc' ...";</tt>
- * @param string $jq_runonpfile Column name
+ * @param string $jq_runonpfile If not empty, the scheduler splits the pfiles of
+ *        the upload in $jq_args into chunks that several agents process at once,
+ *        see fo_scheduler_chunk()
  * @param array  $Depends Array of jq_pk's this jobqueue is dependent on.
  * @param string $host    Host required for the job
  * @param string $jq_cmd_args  Command line arguments
@@ -222,6 +224,12 @@ function JobQueueAdd($job_pk, $jq_type, $jq_args, $jq_runonpfile, $Depends, $hos
     }
   }
 
+  /* Wake up the scheduler, the notification is delivered on commit */
+  $sql = "NOTIFY fossology_jobs";
+  $result = pg_query($PG_CONN, $sql);
+  DBCheckResult($result, $sql, __FILE__, __LINE__);
+  pg_free_result($result);
+
   /* Commit the jobqueue and jobdepends changes */
   $sql = "COMMIT";
   $result = pg_query($PG_CONN, $sql);
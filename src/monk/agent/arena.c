@@ -0,0 +1,158 @@
+/*
+Copyright (C) 2026, Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_CHUNK_SIZE (256 * 1024)
+#define ARENA_ALIGNMENT 16
+#define ARENA_ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1))
+#define ARENA_ARRAY_CAPACITY 16
+
+struct ArenaChunk {
+  ArenaChunk* next;
+  size_t size;
+  size_t used;
+  /* long double for the same alignment malloc() gives */
+  long double data[];
+};
+
+typedef struct {
+  /* first, so that the ArenaArray is the GArray handed out */
+  GArray array;
+  guint capacity;
+  guint elementSize;
+} ArenaArray;
+
+static ArenaChunk* chunk_new(size_t size, ArenaChunk* next) {
+  ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + size);
+  if (!chunk)
+    return NULL;
+  chunk->next = next;
+  chunk->size = size;
+  chunk->used = 0;
+  return chunk;
+}
+
+Arena* arena_new() {
+  Arena* arena = malloc(sizeof(Arena));
+  if (!arena)
+    return NULL;
+  arena->first = chunk_new(ARENA_CHUNK_SIZE, NULL);
+  if (!arena->first) {
+    free(arena);
+    return NULL;
+  }
+  arena->current = arena->first;
+  arena->failed = 0;
+  return arena;
+}
+
+void arena_free(Arena* arena) {
+  if (!arena)
+    return;
+
+  ArenaChunk* chunk = arena->first;
+  while (chunk) {
+    ArenaChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  free(arena);
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+  size = ARENA_ALIGN(size);
+
+  ArenaChunk* chunk = arena->current;
+  if (chunk->size - chunk->used < size) {
+    /* chunks after the current one are left over by arena_release(), reuse them if they are big enough */
+    if (chunk->next && chunk->next->size >= size) {
+      chunk = chunk->next;
+    } else {
+      ArenaChunk* newChunk = chunk_new(MAX(size, ARENA_CHUNK_SIZE), chunk->next);
+      if (!newChunk) {
+        arena->failed = 1;
+        return NULL;
+      }
+      chunk->next = newChunk;
+      chunk = newChunk;
+    }
+    chunk->used = 0;
+    arena->current = chunk;
+  }
+
+  void* result = (char*) chunk->data + chunk->used;
+  chunk->used += size;
+  return result;
+}
+
+ArenaMark arena_mark(const Arena* arena) {
+  return (ArenaMark) { .chunk = arena->current, .used = arena->current->used };
+}
+
+void arena_release(Arena* arena, ArenaMark mark) {
+  arena->current = mark.chunk;
+  arena->current->used = mark.used;
+}
+
+void arena_reset(Arena* arena) {
+  ArenaChunk* chunk = arena->first->next;
+  while (chunk) {
+    ArenaChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena->first->next = NULL;
+  arena->first->used = 0;
+  arena->current = arena->first;
+  arena->failed = 0;
+}
+
+GArray* arena_array_new(Arena* arena, guint elementSize) {
+  ArenaArray* result = arena_alloc(arena, sizeof(ArenaArray));
+  if (!result)
+    return NULL;
+  result->array.data = arena_alloc(arena, ARENA_ARRAY_CAPACITY * elementSize);
+  if (!result->array.data)
+    return NULL;
+  result->array.len = 0;
+  result->capacity = ARENA_ARRAY_CAPACITY;
+  result->elementSize = elementSize;
+  return &result->array;
+}
+
+int arena_array_append(Arena* arena, GArray* array, const void* element) {
+  ArenaArray* arenaArray = (ArenaArray*) array;
+  const guint elementSize = arenaArray->elementSize;
+
+  if (array->len == arenaArray->capacity) {
+    /* the old data stays in the arena until it is released */
+    gchar* data = arena_alloc(arena, 2 * arenaArray->capacity * elementSize);
+    if (!data)
+      return 0;
+    memcpy(data, array->data, array->len * elementSize);
+    array->data = data;
+    arenaArray->capacity *= 2;
+  }
+
+  memcpy(array->data + array->len * elementSize, element, elementSize);
+  array->len++;
+  return 1;
+}
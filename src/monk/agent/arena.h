@@ -0,0 +1,59 @@
+/*
+Copyright (C) 2026, Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef MONK_AGENT_ARENA_H
+#define MONK_AGENT_ARENA_H
+
+#include <glib.h>
+#include <stddef.h>
+
+/* bump allocator for everything found in a file, each thread has one and resets it after every file */
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct Arena {
+  ArenaChunk* first;
+  ArenaChunk* current;
+  /* set when an allocation failed, cleared by arena_reset() */
+  int failed;
+} Arena;
+
+/* everything allocated after the mark is released by arena_release() */
+typedef struct {
+  ArenaChunk* chunk;
+  size_t used;
+} ArenaMark;
+
+/* NULL if it could not be allocated */
+Arena* arena_new();
+void arena_free(Arena* arena);
+
+/* NULL if a new chunk could not be allocated, the arena is left as it was */
+void* arena_alloc(Arena* arena, size_t size);
+
+ArenaMark arena_mark(const Arena* arena);
+void arena_release(Arena* arena, ArenaMark mark);
+
+/* releases everything, only the first chunk is kept */
+void arena_reset(Arena* arena);
+
+/* GArray with its data in the arena, read it as any other GArray but do not g_array_free() it */
+GArray* arena_array_new(Arena* arena, guint elementSize);
+/* 0 if the array could not grow, it is left as it was */
+int arena_array_append(Arena* arena, GArray* array, const void* element);
+
+#endif // MONK_AGENT_ARENA_H
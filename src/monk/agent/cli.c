@@ -33,33 +33,44 @@ int matchCliFileWithLicenses(MonkState* state, const Licenses* licenses, int arg
   File file;
   file.id = argi;
   file.fileName = argv[argi];
+  file.arena = state->arena;
   if (!readTokensFromFile(file.fileName, &(file.tokens), DELIMITERS))
     return 0;
 
   int result = matchFileWithLicenses(state, &file, licenses, &cliCallbacks);
 
   tokens_free(file.tokens);
+  if (file.arena)
+    arena_reset(file.arena);
 
   return result;
 }
 
 int handleCliMode(MonkState* state, const Licenses* licenses, int argc, char** argv, int fileOptInd) {
+  int threadError = 0;
 #ifdef MONK_MULTI_THREAD
   #pragma omp parallel
 #endif
   {
     MonkState threadLocalStateStore = *state;
     MonkState* threadLocalState = &threadLocalStateStore;
+    threadLocalState->arena = arena_new();
+    if (!threadLocalState->arena)
+      threadError = 1;
 
 #ifdef MONK_MULTI_THREAD
     #pragma omp for schedule(dynamic)
 #endif
     for (int fileId = fileOptInd; fileId < argc; fileId++) {
+      if (threadError)
+        continue;
       matchCliFileWithLicenses(threadLocalState, licenses, fileId, argv);
     }
+
+    arena_free(threadLocalState->arena);
   }
 
-  return 1;
+  return !threadError;
 }
 
 int cli_onNoMatch(MonkState* state, const File* file) {
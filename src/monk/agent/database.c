@@ -51,6 +51,24 @@ PGresult* queryAllLicenses(fo_dbManager* dbManager) {
   );
 }
 
+/* changes whenever a license of queryAllLicenses() is added, removed or edited */
+char* queryLicensesChecksum(fo_dbManager* dbManager) {
+  PGresult* checksumResult = fo_dbManager_Exec_printf(
+    dbManager,
+    "select md5(string_agg(rf_pk || ' ' || rf_shortname || ' ' || md5(rf_text), ',' order by rf_pk))"
+    " from " LICENSE_REF_TABLE " where rf_detector_type = 1 and rf_active = 'true'"
+  );
+
+  if (!checksumResult)
+    return NULL;
+
+  char* result = NULL;
+  if (PQntuples(checksumResult) == 1 && !PQgetisnull(checksumResult, 0, 0))
+    result = g_strdup(PQgetvalue(checksumResult, 0, 0));
+  PQclear(checksumResult);
+  return result;
+}
+
 char* getLicenseTextForLicenseRefId(fo_dbManager* dbManager, long refId) {
   PGresult* licenseTextResult = fo_dbManager_ExecPrepared(
     fo_dbManager_PrepareStamement(
@@ -21,6 +21,99 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "_squareVisitor.h"
 #include <stdlib.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DIFF_X86
+#include <immintrin.h>
+#endif
+
+/* the offsets of the square visitor are smaller than this */
+#define VISITOR_SIZE MAX_ALLOWED_DIFF_LENGTH
+/* the first offsets are the closest ones, cheaper to check one by one */
+#define VISITOR_PREFIX 64
+/* longest run of adjacent matches for which all offsets are checked at once */
+#define BATCH_MAX_RUN 64
+#define BATCH_WIDTH (VISITOR_SIZE + BATCH_MAX_RUN)
+#define BATCH_WORDS ((BATCH_WIDTH + 63) / 64)
+
+typedef void (*CompareRow)(const uint32_t* hashes, const uint32_t* lengths, size_t from, size_t len,
+                           uint32_t hash, uint32_t length, uint64_t* bits);
+
+static DiffVisit visit;
+/* 1 + index in the square visitor of each offset, 0 if it is not visited */
+static uint32_t* visitorRank;
+
+static void initVisit() {
+  static gsize initialized = 0;
+  if (g_once_init_enter(&initialized)) {
+    visitorRank = calloc(VISITOR_SIZE * VISITOR_SIZE, sizeof(uint32_t));
+    for (unsigned int i = 0; i < SQUARE_VISITOR_LENGTH; i++)
+      visitorRank[squareVisitorX[i] * VISITOR_SIZE + squareVisitorY[i]] = i + 1;
+    visit = diff_bestVisit();
+    g_once_init_leave(&initialized, 1);
+  }
+}
+
+DiffVisit diff_bestVisit() {
+#ifdef DIFF_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return DIFF_VISIT_AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return DIFF_VISIT_SSE2;
+#endif
+  return DIFF_VISIT_SCALAR;
+}
+
+int diff_setVisit(DiffVisit newVisit) {
+  initVisit();
+  if (newVisit > diff_bestVisit())
+    return 0;
+  visit = newVisit;
+  return 1;
+}
+
+/* sets the bit of every token from "from" on with the same hash and length */
+static void compareRowScalar(const uint32_t* hashes, const uint32_t* lengths, size_t from, size_t len,
+                             uint32_t hash, uint32_t length, uint64_t* bits) {
+  for (size_t x = from; x < len; x++)
+    if ((hashes[x] == hash) && (lengths[x] == length))
+      bits[x / 64] |= (uint64_t) 1 << (x % 64);
+}
+
+#ifdef DIFF_X86
+__attribute__((target("sse2")))
+static void compareRowSse2(const uint32_t* hashes, const uint32_t* lengths, size_t from, size_t len,
+                           uint32_t hash, uint32_t length, uint64_t* bits) {
+  const __m128i hashVector = _mm_set1_epi32((int) hash);
+  const __m128i lengthVector = _mm_set1_epi32((int) length);
+
+  size_t x = from;
+  for (; x + 4 <= len; x += 4) {
+    __m128i equal = _mm_and_si128(
+      _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (hashes + x)), hashVector),
+      _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (lengths + x)), lengthVector));
+    bits[x / 64] |= (uint64_t) _mm_movemask_ps(_mm_castsi128_ps(equal)) << (x % 64);
+  }
+  compareRowScalar(hashes, lengths, x, len, hash, length, bits);
+}
+
+__attribute__((target("avx2")))
+static void compareRowAvx2(const uint32_t* hashes, const uint32_t* lengths, size_t from, size_t len,
+                           uint32_t hash, uint32_t length, uint64_t* bits) {
+  const __m256i hashVector = _mm256_set1_epi32((int) hash);
+  const __m256i lengthVector = _mm256_set1_epi32((int) length);
+
+  size_t x = from;
+  for (; x + 8 <= len; x += 8) {
+    __m256i equal = _mm256_and_si256(
+      _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (hashes + x)), hashVector),
+      _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (lengths + x)), lengthVector));
+    bits[x / 64] |= (uint64_t) _mm256_movemask_ps(_mm256_castsi256_ps(equal)) << (x % 64);
+  }
+  compareRowSse2(hashes, lengths, x, len, hash, length, bits);
+}
+#endif
+
 int matchNTokens(const GArray* textTokens, size_t textStart, size_t textLength,
                  const GArray* searchTokens, size_t searchStart, size_t searchLength,
                  unsigned int numberOfWantedMatches) {
@@ -50,6 +143,93 @@ int matchNTokens(const GArray* textTokens, size_t textStart, size_t textLength,
   return 0;
 }
 
+/*
+ * the first offset of the square visitor from which minAdjacentMatches tokens
+ * match, as matchNTokens() for each of them but for all offsets at once:
+ *
+ *   the hashes and lengths of the tokens in reach are copied to contiguous
+ *   arrays and each token of the search is compared to all of them in one go,
+ *   each row of bits then tells which tokens of the text are equal to it
+ *
+ *   an offset matches if the bits on its diagonal are set for a run of
+ *   minAdjacentMatches tokens, past the end of the text or of the search they
+ *   count as equal since matchNTokens() only compares what is left
+ *
+ * textWidth and searchWidth are at most VISITOR_SIZE
+ */
+static int lookForDiffBatched(const GArray* textTokens, const GArray* searchTokens,
+                              size_t iText, size_t iSearch,
+                              size_t textWidth, size_t searchWidth,
+                              unsigned int minAdjacentMatches, CompareRow compareRow,
+                              size_t* textPos, size_t* searchPos) {
+  const size_t cols = textWidth + minAdjacentMatches - 1;
+  const size_t rows = searchWidth + minAdjacentMatches - 1;
+  const size_t words = (cols + 63) / 64;
+  const size_t textCols = MIN(cols, textTokens->len - iText);
+  const size_t searchRows = MIN(rows, searchTokens->len - iSearch);
+
+  uint32_t hashes[BATCH_WIDTH];
+  uint32_t lengths[BATCH_WIDTH];
+  for (size_t x = 0; x < textCols; x++) {
+    Token* textToken = tokens_index(textTokens, iText + x);
+    hashes[x] = textToken->hashedContent;
+    lengths[x] = textToken->length;
+  }
+
+  uint64_t pastText[BATCH_WORDS] = {0};
+  for (size_t x = textCols; x < cols; x++)
+    pastText[x / 64] |= (uint64_t) 1 << (x % 64);
+
+  uint64_t equal[BATCH_WIDTH][BATCH_WORDS];
+  for (size_t y = 0; y < rows; y++) {
+    if (y < searchRows) {
+      Token* searchToken = tokens_index(searchTokens, iSearch + y);
+      memcpy(equal[y], pastText, sizeof(uint64_t) * words);
+      compareRow(hashes, lengths, 0, textCols, searchToken->hashedContent, searchToken->length, equal[y]);
+    } else {
+      memset(equal[y], 0xff, sizeof(uint64_t) * words);
+    }
+  }
+
+  uint32_t bestRank = 0;
+  for (size_t y = 0; y < searchWidth; y++) {
+    for (size_t w = 0; w * 64 < textWidth; w++) {
+      uint64_t run = ~(uint64_t) 0;
+      for (unsigned int k = 0; (k < minAdjacentMatches) && run; k++) {
+        uint64_t diagonal = equal[y + k][w] >> k;
+        if ((k > 0) && (w + 1 < words))
+          diagonal |= equal[y + k][w + 1] << (64 - k);
+        run &= diagonal;
+      }
+      if (textWidth - w * 64 < 64)
+        run &= ((uint64_t) 1 << (textWidth - w * 64)) - 1;
+
+      while (run) {
+        size_t x = w * 64 + __builtin_ctzll(run);
+        uint32_t rank = visitorRank[x * VISITOR_SIZE + y];
+        if (rank && (!bestRank || rank < bestRank))
+          bestRank = rank;
+        run &= run - 1;
+      }
+    }
+  }
+
+  if (!bestRank)
+    return 0;
+
+  *textPos = iText + squareVisitorX[bestRank - 1];
+  *searchPos = iSearch + squareVisitorY[bestRank - 1];
+  return 1;
+}
+
+static int setDiff(DiffMatchInfo* result, size_t iText, size_t iSearch, size_t textPos, size_t searchPos) {
+  result->search.start = searchPos;
+  result->search.length = searchPos - iSearch;
+  result->text.start = textPos;
+  result->text.length = textPos - iText;
+  return 1;
+}
+
 int lookForDiff(const GArray* textTokens, const GArray* searchTokens,
                        size_t iText, size_t iSearch,
                        unsigned int maxAllowedDiff, unsigned int minAdjacentMatches,
@@ -60,9 +240,15 @@ int lookForDiff(const GArray* textTokens, const GArray* searchTokens,
   size_t searchStopAt = MIN(iSearch + maxAllowedDiff, searchLength);
   size_t textStopAt = MIN(iText + maxAllowedDiff, textLength);
 
+  initVisit();
+  const DiffVisit currentVisit = visit;
+  const int batched = (currentVisit != DIFF_VISIT_EACH) &&
+    (minAdjacentMatches > 0) && (minAdjacentMatches <= BATCH_MAX_RUN);
+  const unsigned int each = batched ? MIN(VISITOR_PREFIX, SQUARE_VISITOR_LENGTH) : SQUARE_VISITOR_LENGTH;
+
   size_t textPos;
   size_t searchPos;
-  for (unsigned int i = 0; i < SQUARE_VISITOR_LENGTH; i++) {
+  for (unsigned int i = 0; i < each; i++) {
     textPos = iText + squareVisitorX[i];
     searchPos = iSearch + squareVisitorY[i];
 
@@ -70,20 +256,38 @@ int lookForDiff(const GArray* textTokens, const GArray* searchTokens,
       if (matchNTokens(textTokens, textPos, textLength,
                        searchTokens, searchPos, searchLength,
                        minAdjacentMatches))
-      {
-        result->search.start = searchPos;
-        result->search.length = searchPos - iSearch;
-        result->text.start = textPos;
-        result->text.length = textPos - iText;
-        return 1;
-      }
+        return setDiff(result, iText, iSearch, textPos, searchPos);
   }
 
+  if (!batched || (each == SQUARE_VISITOR_LENGTH) || (iText >= textStopAt) || (iSearch >= searchStopAt))
+    return 0;
+
+  CompareRow compareRow = compareRowScalar;
+#ifdef DIFF_X86
+  if (currentVisit == DIFF_VISIT_AVX2)
+    compareRow = compareRowAvx2;
+  else if (currentVisit == DIFF_VISIT_SSE2)
+    compareRow = compareRowSse2;
+#endif
+
+  if (lookForDiffBatched(textTokens, searchTokens, iText, iSearch,
+                         MIN(textStopAt - iText, VISITOR_SIZE), MIN(searchStopAt - iSearch, VISITOR_SIZE),
+                         minAdjacentMatches, compareRow, &textPos, &searchPos))
+    return setDiff(result, iText, iSearch, textPos, searchPos);
+
   return 0;
 }
 
+static int appendMatchInfo(GArray* matchedInfo, Arena* arena, const DiffMatchInfo* matchInfo) {
+  if (arena)
+    return arena_array_append(arena, matchedInfo, matchInfo);
+
+  g_array_append_vals(matchedInfo, matchInfo, 1);
+  return 1;
+}
+
 static int applyDiff(const DiffMatchInfo* diff,
-              GArray* matchedInfo,
+              GArray* matchedInfo, Arena* arena,
               size_t* additionsCounter, size_t* removedCounter,
               size_t* iText, size_t* iSearch) {
 
@@ -101,7 +305,8 @@ static int applyDiff(const DiffMatchInfo* diff,
   *iText = diff->text.start;
   *iSearch = diff->search.start;
 
-  g_array_append_val(matchedInfo, diffCopy);
+  if (!appendMatchInfo(matchedInfo, arena, &diffCopy))
+    return 0;
 
   *additionsCounter += diffCopy.text.length;
   *removedCounter += diffCopy.search.length;
@@ -109,7 +314,7 @@ static int applyDiff(const DiffMatchInfo* diff,
   return 1;
 }
 
-static void applyTailDiff(GArray* matchedInfo,
+static int applyTailDiff(GArray* matchedInfo, Arena* arena,
         size_t searchLength,
         size_t* removedCounter, size_t* additionsCounter,
         size_t* iText, size_t* iSearch) {
@@ -126,7 +331,7 @@ static void applyTailDiff(GArray* matchedInfo,
           .diffType = NULL
   };
 
-  applyDiff(&tailDiff, matchedInfo, additionsCounter, removedCounter, iText, iSearch);
+  return applyDiff(&tailDiff, matchedInfo, arena, additionsCounter, removedCounter, iText, iSearch);
 }
 
 static void initSimpleMatch(DiffMatchInfo* simpleMatch, size_t iText, size_t iSearch) {
@@ -145,12 +350,16 @@ static void initSimpleMatch(DiffMatchInfo* simpleMatch, size_t iText, size_t iSe
                           it will be updated to a value for a successive search
  @param maxAllowedDiff maximum number of Tokens that can be avoided
  @param minAdjacentMatches minimum number of adjacent matched Tokens that must be equal
+ @param arena where the result is allocated, NULL to malloc() it
 
  @return pointer to the result, or NULL on negative match. To be freed with diffResult_free
+         unless it is in the arena, a negative match leaves nothing in the arena.
+         If the arena runs out of memory the result is NULL and arena->failed is set
  ****************************************************/
 DiffResult* findMatchAsDiffs(const GArray* textTokens, const GArray* searchTokens,
                              size_t textStartPosition, size_t searchStartPosition,
-                             unsigned int maxAllowedDiff, unsigned int minAdjacentMatches) {
+                             unsigned int maxAllowedDiff, unsigned int minAdjacentMatches,
+                             Arena* arena) {
   size_t textLength = textTokens->len;
   size_t searchLength = searchTokens->len;
 
@@ -158,8 +367,22 @@ DiffResult* findMatchAsDiffs(const GArray* textTokens, const GArray* searchToken
     return NULL;
   }
 
-  DiffResult* result = malloc(sizeof(DiffResult));
-  result->matchedInfo = g_array_new(FALSE, FALSE, sizeof(DiffMatchInfo));
+  ArenaMark mark = { NULL, 0 };
+  DiffResult* result;
+  if (arena) {
+    mark = arena_mark(arena);
+    result = arena_alloc(arena, sizeof(DiffResult));
+    if (!result)
+      return NULL;
+    result->matchedInfo = arena_array_new(arena, sizeof(DiffMatchInfo));
+    if (!result->matchedInfo) {
+      arena_release(arena, mark);
+      return NULL;
+    }
+  } else {
+    result = malloc(sizeof(DiffResult));
+    result->matchedInfo = g_array_new(FALSE, FALSE, sizeof(DiffMatchInfo));
+  }
   GArray* matchedInfo = result->matchedInfo;
 
   size_t iText = textStartPosition;
@@ -169,6 +392,9 @@ DiffResult* findMatchAsDiffs(const GArray* textTokens, const GArray* searchToken
   size_t matchedCounter = 0;
   size_t additionsCounter = 0;
 
+  /* cleared when the arena could not hold the match info, the match is then dropped */
+  int allocated = 1;
+
   if (searchStartPosition > 0) {
     DiffMatchInfo licenseHeadDiff = (DiffMatchInfo) {
       .search = (DiffPoint) {
@@ -181,7 +407,7 @@ DiffResult* findMatchAsDiffs(const GArray* textTokens, const GArray* searchToken
       },
       .diffType = NULL
     };
-    applyDiff(&licenseHeadDiff, matchedInfo, &additionsCounter, &removedCounter, &iText, &iSearch);
+    allocated = applyDiff(&licenseHeadDiff, matchedInfo, arena, &additionsCounter, &removedCounter, &iText, &iSearch);
     iSearch = searchStartPosition;
   }
 
@@ -194,7 +420,7 @@ DiffResult* findMatchAsDiffs(const GArray* textTokens, const GArray* searchToken
     iText++;
   }
 
-  if (iText < textLength) {
+  if (allocated && (iText < textLength)) {
     DiffMatchInfo simpleMatch;
     simpleMatch.diffType = DIFF_TYPE_MATCH;
     initSimpleMatch(&simpleMatch, iText, iSearch);
@@ -211,7 +437,10 @@ DiffResult* findMatchAsDiffs(const GArray* textTokens, const GArray* searchToken
         iText++;
       } else {
         /* the previous tokens matched, here starts a difference */
-        g_array_append_val(matchedInfo, simpleMatch);
+        if (!appendMatchInfo(matchedInfo, arena, &simpleMatch)) {
+          allocated = 0;
+          break;
+        }
         initSimpleMatch(&simpleMatch, iText, iSearch);
 
         DiffMatchInfo diff;
@@ -219,10 +448,13 @@ DiffResult* findMatchAsDiffs(const GArray* textTokens, const GArray* searchToken
                         iText, iSearch,
                         maxAllowedDiff, minAdjacentMatches,
                         &diff)) {
-          applyDiff(&diff,
-                    matchedInfo,
-                    &additionsCounter, &removedCounter,
-                    &iText, &iSearch);
+          if (!applyDiff(&diff,
+                         matchedInfo, arena,
+                         &additionsCounter, &removedCounter,
+                         &iText, &iSearch)) {
+            allocated = 0;
+            break;
+          }
 
           simpleMatch.text.start = iText;
           simpleMatch.search.start = iSearch;
@@ -231,18 +463,22 @@ DiffResult* findMatchAsDiffs(const GArray* textTokens, const GArray* searchToken
         }
       }
     }
-    if (simpleMatch.text.length > 0) {
-      g_array_append_val(matchedInfo, simpleMatch);
+    if (allocated && (simpleMatch.text.length > 0)) {
+      allocated = appendMatchInfo(matchedInfo, arena, &simpleMatch);
     }
   }
 
-  if ((iSearch < searchLength) && (searchLength < maxAllowedDiff + iSearch)) {
-    applyTailDiff(matchedInfo, searchLength, &removedCounter, &additionsCounter, &iText, &iSearch);
+  if (allocated && (iSearch < searchLength) && (searchLength < maxAllowedDiff + iSearch)) {
+    allocated = applyTailDiff(matchedInfo, arena, searchLength, &removedCounter, &additionsCounter, &iText, &iSearch);
   }
 
-  if (matchedCounter + removedCounter != searchLength) {
-    g_array_free(matchedInfo, TRUE);
-    free(result);
+  if (!allocated || (matchedCounter + removedCounter != searchLength)) {
+    if (arena) {
+      arena_release(arena, mark);
+    } else {
+      g_array_free(matchedInfo, TRUE);
+      free(result);
+    }
 
     return NULL;
   } else {
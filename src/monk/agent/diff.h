@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "string_operations.h"
 #include "monk.h"
+#include "arena.h"
 
 typedef struct {
   size_t start;
@@ -42,6 +43,18 @@ typedef struct {
   unsigned short percentual;
 } DiffResult;
 
+/* how lookForDiff() checks the offsets of the square visitor */
+typedef enum {
+  DIFF_VISIT_EACH,   /* one offset after the other */
+  DIFF_VISIT_SCALAR, /* all offsets at once */
+  DIFF_VISIT_SSE2,   /* all offsets at once, with SSE2 */
+  DIFF_VISIT_AVX2    /* all offsets at once, with AVX2 */
+} DiffVisit;
+
+/* the best one the cpu supports is used by default, all of them give the same results */
+DiffVisit diff_bestVisit();
+int diff_setVisit(DiffVisit visit);
+
 int lookForDiff(const GArray* textTokens, const GArray* searchTokens,
                 size_t iText, size_t iSearch,
                 unsigned int maxAllowedDiff, unsigned int minAdjacentMatches,
@@ -53,7 +66,8 @@ int matchNTokens(const GArray* textTokens, size_t textStart, size_t textLength,
 
 DiffResult* findMatchAsDiffs(const GArray* textTokens, const GArray* searchTokens,
                              size_t textStartPosition, size_t searchStartPosition,
-                             unsigned int maxAllowedDiff, unsigned int minAdjacentMatches);
+                             unsigned int maxAllowedDiff, unsigned int minAdjacentMatches,
+                             Arena* arena);
 
 void diffResult_free(DiffResult* diffResult);
 
@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "license.h"
 #include "string_operations.h"
+#include "serialize.h"
 #include "monk.h"
 
 static char* ignoredLicenseNames[] = {"Void", "No_license_found"};
@@ -77,7 +78,8 @@ Licenses* extractLicenses(fo_dbManager* dbManager, PGresult* licensesResult, uns
 void licenses_free(Licenses* licenses) {
   if (licenses) {
     GArray* licenseArray = licenses->licenses;
-    for (guint i = 0; i < licenseArray->len; i++) {
+    /* the tokens and names of mapped licenses belong to the mapping */
+    for (guint i = 0; !licenses->mapped && i < licenseArray->len; i++) {
       License* license = license_index(licenseArray, i);
       tokens_free(license->tokens);
       if (license->shortname) {
@@ -96,6 +98,10 @@ void licenses_free(Licenses* licenses) {
     }
     g_array_free(indexes, TRUE);
 
+    if (licenses->mapped) {
+      unmapKnowledgebase(licenses->mapped);
+    }
+
     free(licenses);
   }
 }
@@ -127,6 +133,36 @@ uint32_t getKey(const GArray* tokens, unsigned minAdjacentMatches, unsigned sear
   return result;
 }
 
+/*
+ * the keys of all positions of tokens in one pass: getKey() is
+ *   2^n + sum(hash[start+i] << (n-1-i)) modulo 2^32
+ * so the key of the next window follows from the one before, only the last
+ * n-1 positions with a shorter window are computed with getKey()
+ */
+uint32_t* getKeys(const GArray* tokens, unsigned minAdjacentMatches) {
+  const guint len = tokens->len;
+  uint32_t* keys = malloc(sizeof(uint32_t) * (len > 0 ? len : 1));
+  if (!keys)
+    return NULL;
+
+  const uint32_t top = minAdjacentMatches < 32 ? (uint32_t) 1 << minAdjacentMatches : 0;
+
+  guint t = 0;
+  if (len > 0 && len >= minAdjacentMatches) {
+    keys[0] = getKey(tokens, minAdjacentMatches, 0);
+    for (t = 1; (t < len) && (t + minAdjacentMatches <= len); t++) {
+      Token* leaving = tokens_index(tokens, t - 1);
+      Token* entering = tokens_index(tokens, t - 1 + minAdjacentMatches);
+      keys[t] = (keys[t - 1] << 1) - top - leaving->hashedContent * top + entering->hashedContent;
+    }
+  }
+  for (; t < len; t++) {
+    keys[t] = getKey(tokens, minAdjacentMatches, t);
+  }
+
+  return keys;
+}
+
 Licenses* buildLicenseIndexes(GArray* licenses, unsigned minAdjacentMatches, unsigned maxLeadingDiff) {
   Licenses* result = malloc(sizeof(Licenses));
   if (!result)
@@ -171,25 +207,59 @@ Licenses* buildLicenseIndexes(GArray* licenses, unsigned minAdjacentMatches, uns
   result->shortLicenses = shortLicenses;
   result->indexes = indexes;
   result->minAdjacentMatches = minAdjacentMatches;
+  result->mapped = NULL;
 
   return result;
 }
 
+/* loads the licenses of the database, through the knowledge base cache
+ * cacheFile when the checksum of the license table is known */
+Licenses* loadLicenses(MonkState* state, const char* cacheFile, const char* checksum) {
+  Licenses* licenses = NULL;
+  if (checksum) {
+    licenses = mapKnowledgebase(cacheFile, checksum, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
+  }
+
+  if (!licenses) {
+    PGresult* licensesResult = queryAllLicenses(state->dbManager);
+    licenses = extractLicenses(state->dbManager, licensesResult, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
+    PQclear(licensesResult);
+
+    if (checksum) {
+      gchar* cacheDir = g_path_get_dirname(cacheFile);
+      if ((g_mkdir_with_parents(cacheDir, 0755) != 0 ||
+           !writeKnowledgebaseToFile(licenses, MAX_LEADING_DIFF, checksum, cacheFile)) &&
+          state->verbosity > 0) {
+        fprintf(stderr, "could not write knowledgebase cache %s\n", cacheFile);
+      }
+      g_free(cacheDir);
+    }
+  }
+
+  return licenses;
+}
+
 const GArray* getShortLicenseArray(const Licenses* licenses) {
   return licenses->shortLicenses;
 }
 
 const GArray* getLicenseArrayFor(const Licenses* licenses, unsigned searchPos, const GArray* searchedTokens, unsigned searchedStart) {
-  const GArray* indexes = licenses->indexes;
+  uint32_t key = getKey(searchedTokens, licenses->minAdjacentMatches, searchedStart);
+  return getLicenseArrayForKey(licenses, searchPos, key);
+}
 
-  guint minAdjacentMatches = licenses->minAdjacentMatches;
+const GArray* getLicenseArrayForKey(const Licenses* licenses, unsigned searchPos, uint32_t key) {
+  if (licenses->mapped) {
+    return getMappedLicenseArrayForKey(licenses, searchPos, key);
+  }
+
+  const GArray* indexes = licenses->indexes;
 
   if (indexes->len <= searchPos) {
     return licenses->licenses;
   }
 
   GHashTable* index = g_array_index(indexes, GHashTable*, searchPos);
-  uint32_t key = getKey(searchedTokens, minAdjacentMatches, searchedStart);
   GArray* result = g_hash_table_lookup(index, &key);
   return result;
 }
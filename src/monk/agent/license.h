@@ -30,7 +30,11 @@ int isIgnoredLicense(const License* license);
 Licenses* extractLicenses(fo_dbManager* dbManager, PGresult* licensesResult, unsigned minAdjacentMatches, unsigned maxLeadingDiff);
 Licenses* buildLicenseIndexes(GArray* licenses, unsigned minAdjacentMatches, unsigned maxLeadingDiff);
 void licenses_free(Licenses* licenses);
+Licenses* loadLicenses(MonkState* state, const char* cacheFile, const char* checksum);
+uint32_t getKey(const GArray* tokens, unsigned minAdjacentMatches, unsigned searchedStart);
+uint32_t* getKeys(const GArray* tokens, unsigned minAdjacentMatches);
 const GArray* getLicenseArrayFor(const Licenses* licenses, unsigned searchPos, const GArray* textTokens, unsigned textStart);
+const GArray* getLicenseArrayForKey(const Licenses* licenses, unsigned searchPos, uint32_t key);
 const GArray* getShortLicenseArray(const Licenses* licenses);
 
 
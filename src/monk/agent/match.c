@@ -21,19 +21,21 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "license.h"
 #include "file_operations.h"
 
-static inline void doFindAllMatches(const File* file, const GArray* licenseArray,
+static inline int doFindAllMatches(const File* file, const GArray* licenseArray,
                                     guint tPos, guint sPos,
                                     unsigned maxAllowedDiff, unsigned minAdjacentMatches,
                                     GArray* matches) {
   if (!licenseArray) {
     /* we hope to get here very often */
-    return;
+    return 1;
   }
 
   for (guint i = 0; i < licenseArray->len; i++) {
     License* license = license_index(licenseArray, i);
-    findDiffMatches(file, license, tPos, sPos, matches, maxAllowedDiff, minAdjacentMatches);
+    if (!findDiffMatches(file, license, tPos, sPos, matches, maxAllowedDiff, minAdjacentMatches))
+      return 0;
   }
+  return 1;
 }
 
 GArray* findAllMatchesBetween(const File* file, const Licenses* licenses,
@@ -43,17 +45,27 @@ GArray* findAllMatchesBetween(const File* file, const Licenses* licenses,
   const GArray* textTokens = file->tokens;
   const guint textLength = textTokens->len;
 
-  for (guint tPos = 0; tPos < textLength; tPos++) {
-    for (guint sPos = 0; sPos <= maxLeadingDiff; sPos++) {
-      const GArray* availableLicenses = getLicenseArrayFor(licenses, sPos, textTokens, tPos);
-      doFindAllMatches(file, availableLicenses, tPos, sPos, maxAllowedDiff, minAdjacentMatches, matches);
+  /* the same key is looked up for every sPos, compute them all at once */
+  uint32_t* keys = getKeys(textTokens, licenses->minAdjacentMatches);
+  if (!keys)
+    return filterNonOverlappingMatches(matches);
+
+  /* stops when the arena is out of memory, the caller sees it in file->arena->failed */
+  int ok = 1;
+  for (guint tPos = 0; ok && tPos < textLength; tPos++) {
+    for (guint sPos = 0; ok && sPos <= maxLeadingDiff; sPos++) {
+      const GArray* availableLicenses = getLicenseArrayForKey(licenses, sPos, keys[tPos]);
+      ok = doFindAllMatches(file, availableLicenses, tPos, sPos, maxAllowedDiff, minAdjacentMatches, matches);
     }
 
     /* now search short licenses only fully (i.e. maxAllowedDiff = 0, minAdjacentMatches = 1) */
     const GArray* shortLicenses = getShortLicenseArray(licenses);
-    doFindAllMatches(file, shortLicenses, tPos, 0, 0, 1, matches);
+    if (ok)
+      ok = doFindAllMatches(file, shortLicenses, tPos, 0, 0, 1, matches);
   }
 
+  free(keys);
+
   return filterNonOverlappingMatches(matches);
 }
 
@@ -72,7 +84,14 @@ void match_array_free(GArray* matches) {
 int matchFileWithLicenses(MonkState* state, const File* file, const Licenses* licenses, const MatchCallbacks* callbacks) {
   GArray* matches = findAllMatchesBetween(file, licenses,
           MAX_ALLOWED_DIFF_LENGTH, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
-  int result = processMatches(state, file, matches, callbacks);
+
+  int result;
+  if (file->arena && file->arena->failed) {
+    printf("out of memory matching file id=%ld\n", file->id);
+    result = 0;
+  } else {
+    result = processMatches(state, file, matches, callbacks);
+  }
 
   // we are done: free memory
   match_array_free(matches);
@@ -108,6 +127,7 @@ static char* getFileName(MonkState* state, long pFileId) {
 int matchPFileWithLicenses(MonkState* state, long pFileId, const Licenses* licenses, const MatchCallbacks* callbacks) {
   File file;
   file.id = pFileId;
+  file.arena = state->arena;
 
   file.fileName = getFileName(state, pFileId);
 
@@ -119,6 +139,8 @@ int matchPFileWithLicenses(MonkState* state, long pFileId, const Licenses* licen
       result = matchFileWithLicenses(state, &file, licenses, callbacks);
 
       tokens_free(file.tokens);
+      if (file.arena)
+        arena_reset(file.arena);
     }
 
     free(file.fileName);
@@ -415,16 +437,25 @@ int processMatches(MonkState* state, const File* file, const GArray* matches, co
   return result;
 }
 
-Match* diffResult2Match(DiffResult* diffResult, const License* license) {
-  Match* newMatch = malloc(sizeof(Match));
+Match* diffResult2Match(DiffResult* diffResult, const License* license, Arena* arena) {
+  Match* newMatch = arena ? arena_alloc(arena, sizeof(Match)) : malloc(sizeof(Match));
+  if (!newMatch)
+    return NULL;
   newMatch->license = license;
+  newMatch->inArena = (arena != NULL);
 
   /* it's full only if we have no diffs and the license was not truncated */
   if (diffResult->matchedInfo->len == 1 && (diffResult->matched == license->tokens->len)) {
     newMatch->type = MATCH_TYPE_FULL;
-    newMatch->ptr.full = malloc(sizeof(DiffPoint));
+    newMatch->ptr.full = arena ? arena_alloc(arena, sizeof(DiffPoint)) : malloc(sizeof(DiffPoint));
+    if (!newMatch->ptr.full) {
+      if (!arena)
+        free(newMatch);
+      return NULL;
+    }
     *(newMatch->ptr.full) = g_array_index(diffResult->matchedInfo, DiffMatchInfo, 0).text;
-    diffResult_free(diffResult);
+    if (!arena)
+      diffResult_free(diffResult);
   }
   else {
     newMatch->type = MATCH_TYPE_DIFF;
@@ -434,7 +465,7 @@ Match* diffResult2Match(DiffResult* diffResult, const License* license) {
   return newMatch;
 }
 
-void findDiffMatches(const File* file, const License* license,
+int findDiffMatches(const File* file, const License* license,
         size_t textStartPosition, size_t searchStartPosition,
         GArray* matches,
         unsigned int maxAllowedDiff, unsigned int minAdjacentMatches) {
@@ -442,22 +473,36 @@ void findDiffMatches(const File* file, const License* license,
   if (!matchNTokens(file->tokens, textStartPosition, file->tokens->len,
           license->tokens, searchStartPosition, license->tokens->len,
           minAdjacentMatches)) {
-    return;
+    return 1;
   }
 
+  Arena* arena = file->arena;
+  ArenaMark mark = { NULL, 0 };
+  if (arena)
+    mark = arena_mark(arena);
+
   DiffResult* diffResult = findMatchAsDiffs(file->tokens, license->tokens,
           textStartPosition, searchStartPosition,
-          maxAllowedDiff, minAdjacentMatches);
+          maxAllowedDiff, minAdjacentMatches, arena);
 
-  if (diffResult) {
-    Match* newMatch = diffResult2Match(diffResult, license);
+  if (!diffResult)
+    return !(arena && arena->failed);
 
-    if (match_rank(newMatch) > MIN_ALLOWED_RANK)
-      g_array_append_val(matches, newMatch);
-    else {
-      match_free(newMatch);
-    }
+  Match* newMatch = diffResult2Match(diffResult, license, arena);
+  if (!newMatch) {
+    if (arena)
+      arena_release(arena, mark);
+    return 0;
   }
+
+  if (match_rank(newMatch) > MIN_ALLOWED_RANK)
+    g_array_append_val(matches, newMatch);
+  else if (arena) {
+    arena_release(arena, mark);
+  } else {
+    match_free(newMatch);
+  }
+  return 1;
 }
 
 #if GLIB_CHECK_VERSION(2, 32, 0)
@@ -469,6 +514,9 @@ void match_destroyNotify(gpointer matchP) {
 #endif
 
 void match_free(Match* match) {
+  if (match->inArena)
+    return;
+
   if (match->type == MATCH_TYPE_DIFF) {
     diffResult_free(match->ptr.diff);
   }
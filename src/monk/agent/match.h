@@ -35,6 +35,8 @@ typedef struct {
     DiffResult* diff;
   } ptr;
   int type;
+  /* allocated in the arena of the file, match_free() leaves it there */
+  int inArena;
 } Match;
 
 typedef struct {
@@ -65,10 +67,11 @@ GArray* findAllMatchesBetween(const File* file, const Licenses* licenses, unsign
 int matchPFileWithLicenses(MonkState* state, long pFileId, const Licenses* licenses, const MatchCallbacks* callbacks);
 int matchFileWithLicenses(MonkState* state, const File* file, const Licenses* licenses, const MatchCallbacks* callbacks);
 
-void findDiffMatches(const File* file, const License* license,
-                     size_t textStartPosition, size_t searchStartPosition,
-                     GArray* matches,
-                     unsigned maxAllowedDiff, unsigned minAdjacentMatches);
+/* 0 if the match could not be allocated */
+int findDiffMatches(const File* file, const License* license,
+                    size_t textStartPosition, size_t searchStartPosition,
+                    GArray* matches,
+                    unsigned maxAllowedDiff, unsigned minAdjacentMatches);
 
 GArray* filterNonOverlappingMatches(GArray* matches);
 int match_partialComparator(const Match* thisMatch, const Match* otherMatch);
@@ -25,6 +25,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "serialize.h"
 #include <getopt.h>
 
+/* prebuilt knowledge base shared by the monk processes of a host */
+#define KNOWLEDGEBASE_CACHE PROJECTSTATEDIR "/monk/knowledgebase"
+
 void parseArguments(MonkState* state, int argc, char** argv, int* fileOptInd) {
   int c;
   static struct option long_options[] = {{"config", required_argument, 0, 'c'},
@@ -119,7 +122,8 @@ int main(int argc, char** argv) {
                            .verbosity = 0,
                            .knowledgebaseFile = NULL,
                            .json = 0,
-                           .ptr = NULL };
+                           .ptr = NULL,
+                           .arena = NULL };
   MonkState* state = &stateStore;
   parseArguments(state, argc, argv, &fileOptInd);
   int wasSuccessful = 1;
@@ -129,20 +133,20 @@ int main(int argc, char** argv) {
   }
 
   Licenses* licenses;
+  char* checksum = NULL;
   if (state->scanMode != MODE_CLI_OFFLINE) {
     int oldArgc = argc;
     fo_scheduler_connect_dbMan(&argc, argv, &(state->dbManager));
     fileOptInd = fileOptInd - oldArgc + argc;
 
-    PGresult* licensesResult = queryAllLicenses(state->dbManager);
-    licenses = extractLicenses(state->dbManager, licensesResult, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
-    PQclear(licensesResult);
+    checksum = queryLicensesChecksum(state->dbManager);
+    licenses = loadLicenses(state, KNOWLEDGEBASE_CACHE, checksum);
   } else {
     licenses = deserializeFromFile(state->knowledgebaseFile, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
   }
 
   if (state->scanMode == MODE_SCHEDULER) {
-    wasSuccessful = handleSchedulerMode(state, licenses);
+    wasSuccessful = handleSchedulerMode(state, &licenses, &checksum, KNOWLEDGEBASE_CACHE);
     scheduler_disconnect(state, ! wasSuccessful);
   } else if (state->scanMode == MODE_CLI ||
              state->scanMode == MODE_CLI_OFFLINE) {
@@ -155,10 +159,11 @@ int main(int argc, char** argv) {
     wasSuccessful = handleCliMode(state, licenses, argc, argv, fileOptInd);
   } else if (state->scanMode == MODE_EXPORT_KOWLEDGEBASE) {
     printf("Write knowledgebase to %s\n", state->knowledgebaseFile);
-    wasSuccessful = serializeToFile(licenses, state->knowledgebaseFile);
+    wasSuccessful = writeKnowledgebaseToFile(licenses, MAX_LEADING_DIFF, checksum, state->knowledgebaseFile);
   }
 
   licenses_free(licenses);
+  g_free(checksum);
 
   return ! wasSuccessful;
 }
@@ -59,6 +59,8 @@ typedef struct {
   char* knowledgebaseFile;
   int json;
   void* ptr;
+  /* per thread, see arena.h */
+  struct Arena* arena;
 } MonkState;
 
 typedef struct {
@@ -71,6 +73,8 @@ typedef struct {
   long id;
   char* fileName;
   GArray* tokens;
+  /* where the matches of the file are allocated, NULL to malloc() them */
+  struct Arena* arena;
 } File;
 
 typedef struct {
@@ -84,6 +88,9 @@ typedef struct {
 
   /* licenses shorter than what is needed to compute the germ are in this class */
   GArray* shortLicenses;
+
+  /* set if the licenses are views on a prebuilt knowledge base, see mapKnowledgebase() */
+  struct MappedKnowledgebase* mapped;
 } Licenses;
 
 #endif // MONK_AGENT_MONK_H
@@ -205,6 +205,9 @@ int bulk_identification(MonkState* state) {
 
       threadLocalState->dbManager = fo_dbManager_fork(state->dbManager);
       if (threadLocalState->dbManager) {
+        threadLocalState->arena = arena_new();
+        if (!threadLocalState->arena)
+          haveError = 1;
 #ifdef MONK_MULTI_THREAD
         #pragma omp for schedule(dynamic)
 #endif
@@ -221,6 +224,7 @@ int bulk_identification(MonkState* state) {
             haveError = 1;
           }
         }
+        arena_free(threadLocalState->arena);
         fo_dbManager_finish(threadLocalState->dbManager);
       } else {
         haveError = 1;
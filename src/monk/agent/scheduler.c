@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "common.h"
 #include "database.h"
+#include "license.h"
 
 MatchCallbacks schedulerCallbacks =
   { .onNo = sched_onNoMatch,
@@ -53,6 +54,9 @@ int processUploadId(MonkState* state, int uploadId, const Licenses* licenses) {
 
     threadLocalState->dbManager = fo_dbManager_fork(state->dbManager);
     if (threadLocalState->dbManager) {
+      threadLocalState->arena = arena_new();
+      if (!threadLocalState->arena)
+        threadError = 1;
       int count = PQntuples(fileIdResult);
 #ifdef MONK_MULTI_THREAD
       #pragma omp for schedule(dynamic)
@@ -76,6 +80,7 @@ int processUploadId(MonkState* state, int uploadId, const Licenses* licenses) {
           threadError = 1;
         }
       }
+      arena_free(threadLocalState->arena);
       fo_dbManager_finish(threadLocalState->dbManager);
     } else {
       threadError = 1;
@@ -86,23 +91,45 @@ int processUploadId(MonkState* state, int uploadId, const Licenses* licenses) {
   return !threadError;
 }
 
-int handleSchedulerMode(MonkState* state, const Licenses* licenses) {
+/* an agent kept idle by the scheduler may be given a job after the licenses
+ * were edited, reload them when the checksum of the license table changed */
+static void reloadChangedLicenses(MonkState* state, Licenses** licenses, char** checksum, const char* cacheFile) {
+  char* current = queryLicensesChecksum(state->dbManager);
+
+  if (!current || (*checksum && strcmp(current, *checksum) == 0)) {
+    g_free(current);
+    return;
+  }
+
+  licenses_free(*licenses);
+  *licenses = loadLicenses(state, cacheFile, current);
+  g_free(*checksum);
+  *checksum = current;
+}
+
+int handleSchedulerMode(MonkState* state, Licenses** licenses, char** checksum, const char* cacheFile) {
   /* scheduler mode */
   state->scanMode = MODE_SCHEDULER;
   queryAgentId(state, AGENT_NAME, AGENT_DESC);
 
+  int jobId = fo_scheduler_jobId();
   while (fo_scheduler_next() != NULL) {
     int uploadId = atoi(fo_scheduler_current());
 
     if (uploadId == 0) continue;
 
+    if (fo_scheduler_jobId() != jobId) {
+      jobId = fo_scheduler_jobId();
+      reloadChangedLicenses(state, licenses, checksum, cacheFile);
+    }
+
     int arsId = fo_WriteARS(fo_dbManager_getWrappedConnection(state->dbManager),
                             0, uploadId, state->agentId, AGENT_ARS, NULL, 0);
 
     if (arsId<=0)
       bail(state, 1);
 
-    if (!processUploadId(state, uploadId, licenses))
+    if (!processUploadId(state, uploadId, *licenses))
       bail(state, 2);
 
     fo_WriteARS(fo_dbManager_getWrappedConnection(state->dbManager),
@@ -21,7 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "match.h"
 
-int handleSchedulerMode(MonkState* state, const Licenses* licenses);
+int handleSchedulerMode(MonkState* state, Licenses** licenses, char** checksum, const char* cacheFile);
 
 int sched_onNoMatch(MonkState* state, const File* file);
 int sched_onFullMatch(MonkState* state, const File* file, const License* license, const DiffMatchInfo* matchInfo);
@@ -16,13 +16,20 @@ Copyright (C) 2018, TNG Technology Consulting GmbH
  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#define _GNU_SOURCE
 #include "serialize.h"
 
 #include "monk.h"
 #include "license.h"
 #include "string_operations.h"
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
 
 /*
  * serialization
@@ -89,6 +96,20 @@ Licenses* deserializeFromFile(char* filename, unsigned minAdjacentMatches, unsig
   if(fp == NULL) {
     exit(3);
   }
+
+  char magic[sizeof(((MappedHeader*) NULL)->magic)];
+  if (fread(magic, sizeof(magic), 1, fp) == 1 &&
+      memcmp(magic, KNOWLEDGEBASE_MAGIC, sizeof(magic)) == 0) {
+    fclose(fp);
+    Licenses* result = mapKnowledgebase(filename, NULL, minAdjacentMatches, maxLeadingDiff);
+    if (result == NULL) {
+      fprintf(stderr, "knowledgebase %s is invalid or of another version\n", filename);
+      exit(3);
+    }
+    return result;
+  }
+  rewind(fp);
+
   Licenses* result = deserialize(fp, minAdjacentMatches, maxLeadingDiff);
   fclose(fp);
   return result;
@@ -128,3 +149,329 @@ GArray* deserializeTokens(FILE* fp, guint tokensLen) {
 
   return tokens;
 }
+
+/*
+ * prebuilt knowledge base
+ */
+
+#define align8(offset) (((offset) + 7) & ~(uint64_t) 7)
+#define is_short(license, minAdjacentMatches) ( (license)->tokens->len <= (minAdjacentMatches) )
+
+/* returns the slot of key or the empty slot where it belongs, or 1 << indexBits
+ * if the table is full and has neither */
+static guint knowledgebaseProbe(const MappedSlot* table, guint indexBits, uint32_t key) {
+  const guint indexSize = 1u << indexBits;
+  guint slot = (key * 2654435761u) >> (32 - indexBits);
+  for (guint probes = 0; probes < indexSize; probes++) {
+    if (table[slot].count == 0 || table[slot].key == key) {
+      return slot;
+    }
+    slot = (slot + 1) & (indexSize - 1);
+  }
+  return indexSize;
+}
+
+static int writeAt(FILE* fp, uint64_t* pos, uint64_t offset, const void* data, size_t size) {
+  for (; *pos < offset; (*pos)++) {
+    if (fputc(0, fp) == EOF)
+      return 0;
+  }
+  if (size > 0 && fwrite(data, size, 1, fp) != 1)
+    return 0;
+  *pos += size;
+  return 1;
+}
+
+int writeKnowledgebaseToFile(const Licenses* licenses, unsigned maxLeadingDiff, const char* checksum, const char* filename) {
+  /* readers keep the file they mapped, so replace it only when complete */
+  gchar* tmpName = g_strdup_printf("%s.XXXXXX", filename);
+  int fd = g_mkstemp(tmpName);
+  if (fd < 0) {
+    g_free(tmpName);
+    return 0;
+  }
+
+  int retCode = 0;
+  FILE* fp = fdopen(fd, "w");
+  if (fp == NULL) {
+    close(fd);
+  } else {
+    retCode = writeKnowledgebase(licenses, maxLeadingDiff, checksum, fp);
+    retCode = (fclose(fp) == 0) && retCode;
+  }
+
+  retCode = retCode && (g_chmod(tmpName, 0644) == 0) && (g_rename(tmpName, filename) == 0);
+  if (!retCode) {
+    g_unlink(tmpName);
+  }
+  g_free(tmpName);
+  return retCode;
+}
+
+int writeKnowledgebase(const Licenses* licenses, unsigned maxLeadingDiff, const char* checksum, FILE* fp) {
+  const GArray* licenseArray = licenses->licenses;
+  const unsigned minAdjacentMatches = licenses->minAdjacentMatches;
+  const guint indexCount = maxLeadingDiff + 1;
+
+  MappedHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, KNOWLEDGEBASE_MAGIC, sizeof(header.magic));
+  header.version = KNOWLEDGEBASE_VERSION;
+  header.tokenSize = sizeof(Token);
+  header.minAdjacentMatches = minAdjacentMatches;
+  header.maxLeadingDiff = maxLeadingDiff;
+  if (checksum) {
+    strncpy(header.checksum, checksum, KNOWLEDGEBASE_CHECKSUM_LEN - 1);
+  }
+  header.licensesLen = licenseArray->len;
+
+  MappedLicense* mappedLicenses = g_new0(MappedLicense, licenseArray->len + 1);
+  guint indexed = 0;
+  for (guint i = 0; i < licenseArray->len; i++) {
+    License* license = license_index(licenseArray, i);
+    mappedLicenses[i].refId = license->refId;
+    mappedLicenses[i].tokensStart = header.tokensLen;
+    mappedLicenses[i].tokensLen = license->tokens->len;
+    mappedLicenses[i].shortname = header.stringsLen;
+    header.tokensLen += license->tokens->len;
+    header.stringsLen += strlen(license->shortname) + 1;
+    if (!is_short(license, minAdjacentMatches))
+      indexed++;
+  }
+
+  /* at most half full, as buildLicenseIndexes() every search position has all the long licenses */
+  header.indexBits = 4;
+  while (((guint) 1 << header.indexBits) < 2 * indexed) {
+    header.indexBits++;
+  }
+  /* at least twice the number of keys, a table is never full */
+  const guint indexSize = 1u << header.indexBits;
+  header.entriesLen = (uint64_t) indexCount * indexed;
+
+  MappedSlot* slots = g_new0(MappedSlot, indexCount * indexSize);
+  uint32_t* entries = g_new(uint32_t, header.entriesLen + 1);
+  guint* filled = g_new(guint, indexSize);
+  for (guint sPos = 0; sPos < indexCount; sPos++) {
+    MappedSlot* table = slots + sPos * indexSize;
+
+    for (guint i = 0; i < licenseArray->len; i++) {
+      License* license = license_index(licenseArray, i);
+      if (!is_short(license, minAdjacentMatches)) {
+        uint32_t key = getKey(license->tokens, minAdjacentMatches, sPos);
+        guint slot = knowledgebaseProbe(table, header.indexBits, key);
+        table[slot].key = key;
+        table[slot].count++;
+      }
+    }
+
+    uint32_t start = sPos * indexed;
+    for (guint slot = 0; slot < indexSize; slot++) {
+      table[slot].start = start;
+      start += table[slot].count;
+      filled[slot] = 0;
+    }
+
+    /* in order of the licenses, the buckets are the same as the ones of buildLicenseIndexes() */
+    for (guint i = 0; i < licenseArray->len; i++) {
+      License* license = license_index(licenseArray, i);
+      if (!is_short(license, minAdjacentMatches)) {
+        uint32_t key = getKey(license->tokens, minAdjacentMatches, sPos);
+        guint slot = knowledgebaseProbe(table, header.indexBits, key);
+        entries[table[slot].start + filled[slot]++] = i;
+      }
+    }
+  }
+  g_free(filled);
+
+  header.licensesOffset = align8(sizeof(MappedHeader));
+  header.tokensOffset = align8(header.licensesOffset + sizeof(MappedLicense) * header.licensesLen);
+  header.stringsOffset = align8(header.tokensOffset + sizeof(Token) * header.tokensLen);
+  header.slotsOffset = align8(header.stringsOffset + header.stringsLen);
+  header.entriesOffset = align8(header.slotsOffset + sizeof(MappedSlot) * indexCount * indexSize);
+  header.size = header.entriesOffset + sizeof(uint32_t) * header.entriesLen;
+
+  uint64_t pos = 0;
+  int retCode = writeAt(fp, &pos, 0, &header, sizeof(header)) &&
+    writeAt(fp, &pos, header.licensesOffset, mappedLicenses, sizeof(MappedLicense) * header.licensesLen);
+
+  for (guint i = 0; retCode && i < licenseArray->len; i++) {
+    GArray* tokens = license_index(licenseArray, i)->tokens;
+    retCode = writeAt(fp, &pos, i == 0 ? header.tokensOffset : pos, tokens->data, sizeof(Token) * tokens->len);
+  }
+  for (guint i = 0; retCode && i < licenseArray->len; i++) {
+    const char* shortname = license_index(licenseArray, i)->shortname;
+    retCode = writeAt(fp, &pos, i == 0 ? header.stringsOffset : pos, shortname, strlen(shortname) + 1);
+  }
+
+  retCode = retCode &&
+    writeAt(fp, &pos, header.slotsOffset, slots, sizeof(MappedSlot) * indexCount * indexSize) &&
+    writeAt(fp, &pos, header.entriesOffset, entries, sizeof(uint32_t) * header.entriesLen);
+
+  g_free(entries);
+  g_free(slots);
+  g_free(mappedLicenses);
+  return retCode;
+}
+
+static int knowledgebaseIsValid(const MappedKnowledgebase* mapped, const char* checksum,
+                                unsigned minAdjacentMatches, unsigned maxLeadingDiff) {
+  const MappedHeader* header = mapped->header;
+
+#define section_fits(offset, count, elementSize) \
+  ((offset) <= mapped->size && (count) <= (mapped->size - (offset)) / (elementSize))
+
+  return memcmp(header->magic, KNOWLEDGEBASE_MAGIC, sizeof(header->magic)) == 0 &&
+    header->version == KNOWLEDGEBASE_VERSION &&
+    header->tokenSize == sizeof(Token) &&
+    header->minAdjacentMatches == minAdjacentMatches &&
+    header->maxLeadingDiff == maxLeadingDiff &&
+    (checksum == NULL || strncmp(header->checksum, checksum, KNOWLEDGEBASE_CHECKSUM_LEN) == 0) &&
+    header->size == mapped->size &&
+    header->indexBits >= 4 && header->indexBits < 32 &&
+    section_fits(header->licensesOffset, header->licensesLen, sizeof(MappedLicense)) &&
+    section_fits(header->tokensOffset, header->tokensLen, sizeof(Token)) &&
+    section_fits(header->stringsOffset, header->stringsLen, 1) &&
+    (header->stringsLen == 0 || ((const char*) mapped->data)[header->stringsOffset + header->stringsLen - 1] == '\0') &&
+    section_fits(header->slotsOffset, ((uint64_t) maxLeadingDiff + 1) << header->indexBits, sizeof(MappedSlot)) &&
+    section_fits(header->entriesOffset, header->entriesLen, sizeof(uint32_t));
+
+#undef section_fits
+}
+
+static Licenses* knowledgebaseLicenses(MappedKnowledgebase* mapped) {
+  const MappedHeader* header = mapped->header;
+  const char* data = mapped->data;
+  const MappedLicense* mappedLicenses = (const MappedLicense*) (data + header->licensesOffset);
+  const Token* tokens = (const Token*) (data + header->tokensOffset);
+  const char* strings = data + header->stringsOffset;
+  const uint32_t* entries = (const uint32_t*) (data + header->entriesOffset);
+  const guint slotsLen = (header->maxLeadingDiff + 1) << header->indexBits;
+
+  mapped->slots = (const MappedSlot*) (data + header->slotsOffset);
+  mapped->tokenViews = g_new0(GArray, header->licensesLen + 1);
+  mapped->indexedLicenses = g_new(License, header->entriesLen + 1);
+  mapped->bucketViews = g_new0(GArray, slotsLen);
+
+  GArray* licenses = g_array_sized_new(TRUE, FALSE, sizeof(License), header->licensesLen);
+  GArray* shortLicenses = g_array_new(FALSE, FALSE, sizeof(License));
+  int valid = 1;
+
+  for (guint i = 0; i < header->licensesLen; i++) {
+    const MappedLicense* mappedLicense = &mappedLicenses[i];
+    valid = mappedLicense->tokensStart <= header->tokensLen &&
+      mappedLicense->tokensLen <= header->tokensLen - mappedLicense->tokensStart &&
+      mappedLicense->shortname < header->stringsLen;
+    if (!valid)
+      break;
+
+    GArray* tokenView = &mapped->tokenViews[i];
+    tokenView->data = (gchar*) (tokens + mappedLicense->tokensStart);
+    tokenView->len = mappedLicense->tokensLen;
+
+    License license = { .refId = mappedLicense->refId,
+                        .shortname = (gchar*) (strings + mappedLicense->shortname),
+                        .tokens = tokenView };
+    g_array_append_val(licenses, license);
+    if (is_short(&license, header->minAdjacentMatches)) {
+      g_array_append_val(shortLicenses, license);
+    }
+  }
+
+  for (guint i = 0; valid && i < header->entriesLen; i++) {
+    valid = entries[i] < header->licensesLen;
+    if (valid)
+      mapped->indexedLicenses[i] = *license_index(licenses, entries[i]);
+  }
+
+  /* every table needs an empty slot, or looking up a missing key would not end */
+  const guint indexMask = (1u << header->indexBits) - 1;
+  int hasEmptySlot = 0;
+  for (guint slot = 0; valid && slot < slotsLen; slot++) {
+    const MappedSlot* mappedSlot = &mapped->slots[slot];
+    valid = mappedSlot->start <= header->entriesLen &&
+      mappedSlot->count <= header->entriesLen - mappedSlot->start;
+    if (valid) {
+      mapped->bucketViews[slot].data = (gchar*) (mapped->indexedLicenses + mappedSlot->start);
+      mapped->bucketViews[slot].len = mappedSlot->count;
+    }
+    hasEmptySlot |= (mappedSlot->count == 0);
+    if ((slot & indexMask) == indexMask) {
+      valid = valid && hasEmptySlot;
+      hasEmptySlot = 0;
+    }
+  }
+
+  if (!valid) {
+    g_array_free(shortLicenses, TRUE);
+    g_array_free(licenses, TRUE);
+    return NULL;
+  }
+
+  Licenses* result = malloc(sizeof(Licenses));
+  if (!result) {
+    g_array_free(shortLicenses, TRUE);
+    g_array_free(licenses, TRUE);
+    return NULL;
+  }
+  result->licenses = licenses;
+  result->shortLicenses = shortLicenses;
+  result->indexes = g_array_new(FALSE, FALSE, sizeof(GHashTable*));
+  result->minAdjacentMatches = header->minAdjacentMatches;
+  result->mapped = mapped;
+  return result;
+}
+
+Licenses* mapKnowledgebase(const char* filename, const char* checksum, unsigned minAdjacentMatches, unsigned maxLeadingDiff) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat st;
+  void* data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(MappedHeader)) {
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+
+  MappedKnowledgebase* mapped = g_new0(MappedKnowledgebase, 1);
+  mapped->data = data;
+  mapped->size = st.st_size;
+  mapped->header = data;
+
+  Licenses* result = NULL;
+  if (knowledgebaseIsValid(mapped, checksum, minAdjacentMatches, maxLeadingDiff)) {
+    result = knowledgebaseLicenses(mapped);
+  }
+  if (!result) {
+    unmapKnowledgebase(mapped);
+  }
+  return result;
+}
+
+const GArray* getMappedLicenseArrayForKey(const Licenses* licenses, unsigned searchPos, uint32_t key) {
+  const MappedKnowledgebase* mapped = licenses->mapped;
+  const MappedHeader* header = mapped->header;
+
+  if (header->maxLeadingDiff < searchPos) {
+    return licenses->licenses;
+  }
+
+  const guint offset = searchPos << header->indexBits;
+  guint slot = knowledgebaseProbe(mapped->slots + offset, header->indexBits, key);
+  if (slot == (1u << header->indexBits) || mapped->slots[offset + slot].count == 0) {
+    return NULL;
+  }
+  return &mapped->bucketViews[offset + slot];
+}
+
+void unmapKnowledgebase(MappedKnowledgebase* mapped) {
+  g_free(mapped->bucketViews);
+  g_free(mapped->indexedLicenses);
+  g_free(mapped->tokenViews);
+  munmap(mapped->data, mapped->size);
+  g_free(mapped);
+}
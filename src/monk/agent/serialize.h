@@ -20,6 +20,7 @@ Copyright (C) 2018, TNG Technology Consulting GmbH
 #define MONK_AGENT_SERIALIZE_H
 
 #include "monk.h"
+#include <stdint.h>
 
 typedef struct {
   long refId;
@@ -27,6 +28,68 @@ typedef struct {
   guint tokensLen;
 } SerializingMeta;
 
+/*
+ * prebuilt knowledge base, mapped read-only by every monk process
+ *
+ * layout: MappedHeader, MappedLicense[licensesLen], Token[tokensLen],
+ *   the NUL terminated shortnames, MappedSlot[(maxLeadingDiff+1) << indexBits]
+ *   and the license numbers of the buckets, each section aligned to 8 bytes
+ *
+ * the index has one open addressed table for each search position, a slot is
+ * empty when count is 0 and the licenses with that key are
+ *   entries[start] .. entries[start+count-1]
+ *
+ * bump the version whenever the format or the tokenization changes
+ */
+#define KNOWLEDGEBASE_MAGIC "FOMONKKB"
+#define KNOWLEDGEBASE_VERSION 1
+#define KNOWLEDGEBASE_CHECKSUM_LEN 64
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t tokenSize;
+  uint32_t minAdjacentMatches;
+  uint32_t maxLeadingDiff;
+  char checksum[KNOWLEDGEBASE_CHECKSUM_LEN];
+  uint32_t licensesLen;
+  uint32_t indexBits;
+  uint64_t licensesOffset;
+  uint64_t tokensOffset;
+  uint64_t tokensLen;
+  uint64_t stringsOffset;
+  uint64_t stringsLen;
+  uint64_t slotsOffset;
+  uint64_t entriesOffset;
+  uint64_t entriesLen;
+  uint64_t size;
+} MappedHeader;
+
+typedef struct {
+  int64_t refId;
+  uint64_t tokensStart;
+  uint32_t tokensLen;
+  uint32_t shortname;
+} MappedLicense;
+
+typedef struct {
+  uint32_t key;
+  uint32_t start;
+  uint32_t count;
+} MappedSlot;
+
+typedef struct MappedKnowledgebase {
+  void* data;
+  size_t size;
+  const MappedHeader* header;
+  const MappedSlot* slots;
+
+  /* GArray views on the mapping, only the License arrays are private */
+  GArray* tokenViews;
+  License* indexedLicenses;
+  GArray* bucketViews;
+} MappedKnowledgebase;
+
 int serializeToFile(Licenses* licenses, char* filename);
 int serialize(Licenses* licenses, FILE* fp);
 int serializeGArray(GArray* licenses, FILE* fp);
@@ -39,4 +102,10 @@ Licenses* deserializeFromFile(char* filename, unsigned minAdjacentMatches, unsig
 Licenses* deserialize(FILE* fp, unsigned minAdjacentMatches, unsigned maxLeadingDiff);
 GArray* deserializeTokens(FILE* fp, guint tokensLen);
 
+int writeKnowledgebaseToFile(const Licenses* licenses, unsigned maxLeadingDiff, const char* checksum, const char* filename);
+int writeKnowledgebase(const Licenses* licenses, unsigned maxLeadingDiff, const char* checksum, FILE* fp);
+Licenses* mapKnowledgebase(const char* filename, const char* checksum, unsigned minAdjacentMatches, unsigned maxLeadingDiff);
+const GArray* getMappedLicenseArrayForKey(const Licenses* licenses, unsigned searchPos, uint32_t key);
+void unmapKnowledgebase(MappedKnowledgebase* mapped);
+
 #endif // MONK_AGENT_SERIALIZE_H
@@ -0,0 +1,516 @@
+/*
+Copyright (C) 2026, Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Microbenchmark of the matching of monk.
+ *
+ * Scans a corpus of files against a set of licenses, either a knowledge base
+ * exported with "monk -s" or every file of a directory taken as a license
+ * text. Every step is timed against the straightforward implementation it
+ * replaced and the results of both have to be identical, otherwise the
+ * benchmark fails. The diff steps match with each way lookForDiff() can
+ * check the square visitor against checking one offset after the other,
+ * the files of expectedDiff make them diff heavy. Loading compares reading
+ * the knowledge base and building the index against mapping the prebuilt
+ * one, the memory a fresh process needs for either is measured in a fresh
+ * process. The arena step scans all files on all threads at once, with the
+ * matches of every file allocated by malloc() against a per thread arena.
+ *
+ * Build and run it with "make bench", it is not part of the unit tests.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "monk.h"
+#include "license.h"
+#include "match.h"
+#include "diff.h"
+#include "serialize.h"
+#include "file_operations.h"
+
+typedef struct {
+  const char* name;
+  gint64 reference;
+  gint64 optimized;
+} BenchTimer;
+
+static void bench_report(BenchTimer* timer, unsigned repeat) {
+  printf("%-16s %10.2f ms %10.2f ms %8.2fx\n", timer->name,
+         timer->reference / 1e3 / repeat, timer->optimized / 1e3 / repeat,
+         timer->optimized > 0 ? (double) timer->reference / timer->optimized : 0);
+}
+
+/*
+ * licenses
+ */
+
+static Licenses* bench_licensesFromDir(const char* dirName) {
+  GDir* dir = g_dir_open(dirName, 0, NULL);
+  if (!dir)
+    return NULL;
+
+  GArray* licenses = g_array_new(TRUE, FALSE, sizeof(License));
+  const char* name;
+  while ((name = g_dir_read_name(dir))) {
+    char* fileName = g_build_filename(dirName, name, NULL);
+    License license = { .refId = licenses->len + 1 };
+    if (readTokensFromFile(fileName, &license.tokens, DELIMITERS)) {
+      license.shortname = g_strdup(name);
+      g_array_append_val(licenses, license);
+    }
+    g_free(fileName);
+  }
+  g_dir_close(dir);
+
+  return buildLicenseIndexes(licenses, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
+}
+
+/*
+ * keys of the license index
+ */
+
+static void bench_keys(const File* file, const Licenses* licenses, BenchTimer* timer) {
+  guint len = file->tokens->len;
+  uint32_t* reference = malloc(sizeof(uint32_t) * (len > 0 ? len : 1));
+
+  /* before, the key was computed again for every search position */
+  gint64 start = g_get_monotonic_time();
+  for (guint tPos = 0; tPos < len; tPos++)
+    for (unsigned sPos = 0; sPos <= MAX_LEADING_DIFF; sPos++)
+      reference[tPos] = getKey(file->tokens, licenses->minAdjacentMatches, tPos);
+  timer->reference += g_get_monotonic_time() - start;
+
+  start = g_get_monotonic_time();
+  uint32_t* keys = getKeys(file->tokens, licenses->minAdjacentMatches);
+  timer->optimized += g_get_monotonic_time() - start;
+
+  if (memcmp(reference, keys, sizeof(uint32_t) * len) != 0) {
+    fprintf(stderr, "ERROR: keys of %s differ\n", file->fileName);
+    exit(1);
+  }
+
+  free(keys);
+  free(reference);
+}
+
+/*
+ * matches
+ */
+
+static GArray* bench_findAllMatchesReference(const File* file, const Licenses* licenses) {
+  GArray* matches = g_array_new(FALSE, FALSE, sizeof(Match*));
+  const GArray* textTokens = file->tokens;
+
+  for (guint tPos = 0; tPos < textTokens->len; tPos++) {
+    for (guint sPos = 0; sPos <= MAX_LEADING_DIFF; sPos++) {
+      const GArray* availableLicenses = getLicenseArrayFor(licenses, sPos, textTokens, tPos);
+      for (guint i = 0; availableLicenses && i < availableLicenses->len; i++)
+        findDiffMatches(file, license_index(availableLicenses, i), tPos, sPos, matches,
+                        MAX_ALLOWED_DIFF_LENGTH, MIN_ADJACENT_MATCHES);
+    }
+
+    const GArray* shortLicenses = getShortLicenseArray(licenses);
+    for (guint i = 0; i < shortLicenses->len; i++)
+      findDiffMatches(file, license_index(shortLicenses, i), tPos, 0, matches, 0, 1);
+  }
+
+  return filterNonOverlappingMatches(matches);
+}
+
+static int bench_diffEquals(const DiffResult* a, const DiffResult* b) {
+  if (a->matched != b->matched || a->added != b->added || a->removed != b->removed ||
+      a->rank != b->rank || a->percentual != b->percentual ||
+      a->matchedInfo->len != b->matchedInfo->len)
+    return 0;
+
+  for (guint i = 0; i < a->matchedInfo->len; i++) {
+    DiffMatchInfo* infoA = &g_array_index(a->matchedInfo, DiffMatchInfo, i);
+    DiffMatchInfo* infoB = &g_array_index(b->matchedInfo, DiffMatchInfo, i);
+    if (infoA->text.start != infoB->text.start || infoA->text.length != infoB->text.length ||
+        infoA->search.start != infoB->search.start || infoA->search.length != infoB->search.length ||
+        strcmp(infoA->diffType, infoB->diffType) != 0)
+      return 0;
+  }
+
+  return 1;
+}
+
+static int bench_matchesEqual(const GArray* a, const GArray* b) {
+  if (a->len != b->len)
+    return 0;
+
+  for (guint i = 0; i < a->len; i++) {
+    const Match* matchA = match_array_index(a, i);
+    const Match* matchB = match_array_index(b, i);
+    if (matchA->license->refId != matchB->license->refId || matchA->type != matchB->type ||
+        match_getStart(matchA) != match_getStart(matchB) || match_getEnd(matchA) != match_getEnd(matchB))
+      return 0;
+    if (matchA->type == MATCH_TYPE_DIFF && !bench_diffEquals(matchA->ptr.diff, matchB->ptr.diff))
+      return 0;
+  }
+
+  return 1;
+}
+
+static unsigned bench_matches(const File* file, const Licenses* licenses, BenchTimer* timer) {
+  gint64 start = g_get_monotonic_time();
+  GArray* reference = bench_findAllMatchesReference(file, licenses);
+  timer->reference += g_get_monotonic_time() - start;
+
+  start = g_get_monotonic_time();
+  GArray* matches = findAllMatchesBetween(file, licenses,
+                                          MAX_ALLOWED_DIFF_LENGTH, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
+  timer->optimized += g_get_monotonic_time() - start;
+
+  if (!bench_matchesEqual(reference, matches)) {
+    fprintf(stderr, "ERROR: matches of %s differ\n", file->fileName);
+    exit(1);
+  }
+
+  unsigned result = matches->len;
+  match_array_free(reference);
+  match_array_free(matches);
+  return result;
+}
+
+/*
+ * diffs, checking all offsets of the square visitor at once
+ */
+
+static const char* bench_visitNames[] = { "diff each", "diff scalar", "diff sse2", "diff avx2" };
+
+static void bench_diff(const File* file, const Licenses* licenses, BenchTimer* timers) {
+  /* before, each offset was checked on its own */
+  diff_setVisit(DIFF_VISIT_EACH);
+  gint64 start = g_get_monotonic_time();
+  GArray* reference = findAllMatchesBetween(file, licenses,
+                                            MAX_ALLOWED_DIFF_LENGTH, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
+  gint64 referenceTime = g_get_monotonic_time() - start;
+
+  for (int visit = DIFF_VISIT_SCALAR; visit <= (int) diff_bestVisit(); visit++) {
+    diff_setVisit(visit);
+    start = g_get_monotonic_time();
+    GArray* matches = findAllMatchesBetween(file, licenses,
+                                            MAX_ALLOWED_DIFF_LENGTH, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
+    timers[visit].optimized += g_get_monotonic_time() - start;
+    timers[visit].reference += referenceTime;
+
+    if (!bench_matchesEqual(reference, matches)) {
+      fprintf(stderr, "ERROR: matches of %s differ with %s\n", file->fileName, bench_visitNames[visit]);
+      exit(1);
+    }
+    match_array_free(matches);
+  }
+
+  match_array_free(reference);
+  diff_setVisit(diff_bestVisit());
+}
+
+/*
+ * matches allocated in a per thread arena, reset after every file
+ */
+
+static gint64 bench_arenaScan(const File* files, int filesLen, const Licenses* licenses, unsigned repeat,
+                              int useArena) {
+  gint64 start = g_get_monotonic_time();
+#pragma omp parallel
+  {
+    Arena* arena = useArena ? arena_new() : NULL;
+
+#pragma omp for schedule(dynamic)
+    for (int i = 0; i < filesLen * (int) repeat; i++) {
+      File file = files[i % filesLen];
+      file.arena = arena;
+      GArray* matches = findAllMatchesBetween(&file, licenses,
+                                              MAX_ALLOWED_DIFF_LENGTH, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
+      match_array_free(matches);
+      if (arena)
+        arena_reset(arena);
+    }
+
+    if (arena)
+      arena_free(arena);
+  }
+  return g_get_monotonic_time() - start;
+}
+
+static void bench_arena(const Licenses* licenses, char** fileNames, int filesLen, unsigned repeat, BenchTimer* timer) {
+  File* files = calloc(filesLen > 0 ? filesLen : 1, sizeof(File));
+  int len = 0;
+  for (int i = 0; i < filesLen; i++) {
+    files[len] = (File) { .id = i, .fileName = fileNames[i] };
+    if (readTokensFromFile(files[len].fileName, &files[len].tokens, DELIMITERS))
+      len++;
+  }
+
+  Arena* arena = arena_new();
+  for (int i = 0; i < len; i++) {
+    File file = files[i];
+    GArray* reference = findAllMatchesBetween(&file, licenses,
+                                              MAX_ALLOWED_DIFF_LENGTH, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
+    file.arena = arena;
+    GArray* matches = findAllMatchesBetween(&file, licenses,
+                                            MAX_ALLOWED_DIFF_LENGTH, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
+    if (!bench_matchesEqual(reference, matches)) {
+      fprintf(stderr, "ERROR: matches of %s differ in the arena\n", file.fileName);
+      exit(1);
+    }
+    match_array_free(reference);
+    match_array_free(matches);
+    arena_reset(arena);
+  }
+  arena_free(arena);
+
+  timer->reference += bench_arenaScan(files, len, licenses, repeat, 0);
+  timer->optimized += bench_arenaScan(files, len, licenses, repeat, 1);
+
+  for (int i = 0; i < len; i++)
+    tokens_free(files[i].tokens);
+  free(files);
+}
+
+/*
+ * loading of the knowledge base
+ */
+
+static long bench_statusKb(const char* field) {
+  FILE* fp = fopen("/proc/self/status", "r");
+  if (!fp)
+    return 0;
+
+  char line[256];
+  long result = 0;
+  while (fgets(line, sizeof(line), fp)) {
+    if (strncmp(line, field, strlen(field)) == 0)
+      result = atol(line + strlen(field));
+  }
+  fclose(fp);
+  return result;
+}
+
+static Licenses* bench_loadLicenses(const char* fileName, int mapped) {
+  return mapped ?
+      mapKnowledgebase(fileName, NULL, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF) :
+      deserializeFromFile((char*) fileName, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
+}
+
+static GArray* bench_scanFile(const char* fileName, const Licenses* licenses) {
+  File file = { .id = 0, .fileName = (char*) fileName };
+  if (!readTokensFromFile(file.fileName, &file.tokens, DELIMITERS))
+    return NULL;
+
+  GArray* matches = findAllMatchesBetween(&file, licenses,
+                                          MAX_ALLOWED_DIFF_LENGTH, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF);
+  tokens_free(file.tokens);
+  return matches;
+}
+
+/* in a fresh process: kB of private and of file backed memory it needs to load the licenses and scan the files */
+static int bench_measureRss(const char* fileName, int mapped, char** files, int filesLen) {
+  long anon = bench_statusKb("RssAnon:");
+  long file = bench_statusKb("RssFile:");
+
+  Licenses* licenses = bench_loadLicenses(fileName, mapped);
+  if (!licenses)
+    return 1;
+  for (int i = 0; i < filesLen; i++) {
+    GArray* matches = bench_scanFile(files[i], licenses);
+    if (matches)
+      match_array_free(matches);
+  }
+
+  printf("%ld %ld\n", bench_statusKb("RssAnon:") - anon, bench_statusKb("RssFile:") - file);
+  return 0;
+}
+
+static void bench_rss(const char* fileName, int mapped, char** files, int filesLen, long rss[2]) {
+  int fds[2];
+  rss[0] = rss[1] = 0;
+  if (pipe(fds) != 0)
+    return;
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    char** args = calloc(filesLen + 4, sizeof(char*));
+    args[0] = "monk_bench";
+    args[1] = mapped ? "-M" : "-S";
+    args[2] = (char*) fileName;
+    memcpy(args + 3, files, sizeof(char*) * filesLen);
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execv("/proc/self/exe", args);
+    _exit(1);
+  }
+
+  close(fds[1]);
+  FILE* fp = fdopen(fds[0], "r");
+  if (pid < 0 || !fp || fscanf(fp, "%ld %ld", &rss[0], &rss[1]) != 2)
+    rss[0] = rss[1] = 0;
+  if (fp)
+    fclose(fp);
+  else
+    close(fds[0]);
+  if (pid > 0)
+    waitpid(pid, NULL, 0);
+}
+
+static void bench_load(const Licenses* licenses, char** files, int filesLen, unsigned repeat, BenchTimer* timer) {
+  char* streamName = g_build_filename(g_get_tmp_dir(), "monk_benchXXXXXX", NULL);
+  char* mappedName = g_build_filename(g_get_tmp_dir(), "monk_benchXXXXXX", NULL);
+  close(g_mkstemp(streamName));
+  close(g_mkstemp(mappedName));
+
+  if (!serializeToFile((Licenses*) licenses, streamName) ||
+      !writeKnowledgebaseToFile(licenses, MAX_LEADING_DIFF, NULL, mappedName)) {
+    fprintf(stderr, "ERROR: could not write the knowledge bases\n");
+    exit(1);
+  }
+
+  /* before, every process read the licenses and built the index itself */
+  for (unsigned r = 0; r < repeat; r++) {
+    gint64 start = g_get_monotonic_time();
+    Licenses* reference = bench_loadLicenses(streamName, 0);
+    timer->reference += g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    Licenses* mapped = bench_loadLicenses(mappedName, 1);
+    timer->optimized += g_get_monotonic_time() - start;
+
+    if (!mapped) {
+      fprintf(stderr, "ERROR: could not map the knowledge base\n");
+      exit(1);
+    }
+
+    for (int i = 0; r == 0 && i < filesLen; i++) {
+      GArray* referenceMatches = bench_scanFile(files[i], reference);
+      GArray* matches = bench_scanFile(files[i], mapped);
+      if (!referenceMatches)
+        continue;
+      if (!bench_matchesEqual(referenceMatches, matches)) {
+        fprintf(stderr, "ERROR: matches of %s with the mapped knowledge base differ\n", files[i]);
+        exit(1);
+      }
+      match_array_free(referenceMatches);
+      match_array_free(matches);
+    }
+
+    licenses_free(mapped);
+    licenses_free(reference);
+  }
+
+  long streamRss[2], mappedRss[2];
+  bench_rss(streamName, 0, files, filesLen, streamRss);
+  bench_rss(mappedName, 1, files, filesLen, mappedRss);
+  printf("rss of a process: %ld kB private, %ld kB shared; mapped: %ld kB private, %ld kB shared\n",
+         streamRss[0], streamRss[1], mappedRss[0], mappedRss[1]);
+
+  g_unlink(streamName);
+  g_unlink(mappedName);
+  g_free(streamName);
+  g_free(mappedName);
+}
+
+int main(int argc, char** argv) {
+  const char* knowledgebase = NULL;
+  const char* licenseDir = NULL;
+  const char* rssKnowledgebase = NULL;
+  int rssMapped = 0;
+  unsigned repeat = 1;
+  int c;
+
+  while ((c = getopt(argc, argv, "k:l:n:M:S:")) != -1) {
+    switch (c) {
+      /* internal, see bench_rss() */
+      case 'M': rssKnowledgebase = optarg; rssMapped = 1; break;
+      case 'S': rssKnowledgebase = optarg; rssMapped = 0; break;
+      case 'k': knowledgebase = optarg; break;
+      case 'l': licenseDir = optarg; break;
+      case 'n': repeat = atoi(optarg); break;
+      default: argc = 0; break;
+    }
+  }
+  if (rssKnowledgebase)
+    return bench_measureRss(rssKnowledgebase, rssMapped, argv + optind, argc - optind);
+
+  if (optind >= argc || (!knowledgebase == !licenseDir) || repeat < 1) {
+    fprintf(stderr, "Usage: %s [-n repeat] (-k knowledgebase | -l licensedir) file...\n", argv[0]);
+    fprintf(stderr, "  Matches every file against the licenses and times each step\n");
+    fprintf(stderr, "  against its reference implementation.\n");
+    fprintf(stderr, "  -k :: knowledge base exported with monk -s.\n");
+    fprintf(stderr, "  -l :: directory with one license text per file.\n");
+    fprintf(stderr, "  -n :: number of times every file is scanned (default 1).\n");
+    return 255;
+  }
+
+  Licenses* licenses = knowledgebase ?
+      deserializeFromFile((char*) knowledgebase, MIN_ADJACENT_MATCHES, MAX_LEADING_DIFF) :
+      bench_licensesFromDir(licenseDir);
+  if (!licenses) {
+    fprintf(stderr, "ERROR: could not load the licenses\n");
+    return 1;
+  }
+
+  BenchTimer keys = { .name = "keys" };
+  BenchTimer matching = { .name = "matching" };
+  BenchTimer loading = { .name = "loading" };
+  BenchTimer arena = { .name = "arena" };
+  BenchTimer diffs[DIFF_VISIT_AVX2 + 1];
+  for (int visit = 0; visit <= DIFF_VISIT_AVX2; visit++)
+    diffs[visit] = (BenchTimer) { .name = bench_visitNames[visit] };
+  unsigned long tokens = 0;
+  unsigned found = 0;
+  unsigned files = 0;
+
+  for (int i = optind; i < argc; i++) {
+    File file = { .id = i, .fileName = argv[i] };
+    if (!readTokensFromFile(file.fileName, &file.tokens, DELIMITERS))
+      continue;
+
+    for (unsigned r = 0; r < repeat; r++) {
+      bench_keys(&file, licenses, &keys);
+      found += bench_matches(&file, licenses, &matching);
+      bench_diff(&file, licenses, diffs);
+    }
+
+    tokens += file.tokens->len;
+    files++;
+    tokens_free(file.tokens);
+  }
+
+  printf("licenses: %u, files: %u, tokens: %lu, matches: %u, results identical\n",
+         licenses->licenses->len, files, tokens, found / repeat);
+  bench_arena(licenses, argv + optind, argc - optind, repeat, &arena);
+  bench_load(licenses, argv + optind, argc - optind, repeat, &loading);
+  printf("%-16s %13s %13s %9s\n", "step", "reference", "optimized", "speedup");
+  bench_report(&keys, repeat);
+  bench_report(&matching, repeat);
+  for (int visit = DIFF_VISIT_SCALAR; visit <= (int) diff_bestVisit(); visit++)
+    bench_report(&diffs[visit], repeat);
+  bench_report(&arena, repeat);
+  bench_report(&loading, repeat);
+
+  licenses_free(licenses);
+  return 0;
+}
@@ -0,0 +1,108 @@
+/*
+Copyright (C) 2026, Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <CUnit/CUnit.h>
+
+#include "arena.h"
+
+void test_arenaAlloc() {
+  Arena* arena = arena_new();
+
+  char* a = arena_alloc(arena, 1);
+  char* b = arena_alloc(arena, 3);
+  CU_ASSERT_EQUAL((uintptr_t) a % 16, 0);
+  CU_ASSERT_EQUAL((uintptr_t) b % 16, 0);
+  CU_ASSERT_NOT_EQUAL(a, b);
+
+  /* bigger than a chunk */
+  char* big = arena_alloc(arena, 1024 * 1024);
+  big[1024 * 1024 - 1] = 1;
+  CU_ASSERT_EQUAL((uintptr_t) big % 16, 0);
+
+  arena_reset(arena);
+  CU_ASSERT_EQUAL(arena_alloc(arena, 1), a);
+
+  arena_free(arena);
+}
+
+void test_arenaRelease() {
+  Arena* arena = arena_new();
+
+  arena_alloc(arena, 100);
+  ArenaMark mark = arena_mark(arena);
+  char* first = arena_alloc(arena, 100);
+  for (int i = 0; i < 10; i++)
+    arena_alloc(arena, 100 * 1024);
+
+  arena_release(arena, mark);
+  CU_ASSERT_EQUAL(arena_alloc(arena, 100), first);
+
+  /* the chunks after the mark are reused */
+  for (int i = 0; i < 10; i++)
+    arena_alloc(arena, 100 * 1024);
+
+  arena_free(arena);
+}
+
+void test_arenaArray() {
+  Arena* arena = arena_new();
+
+  GArray* array = arena_array_new(arena, sizeof(int));
+  CU_ASSERT_EQUAL(array->len, 0);
+
+  for (int i = 0; i < 1000; i++) {
+    arena_array_append(arena, array, &i);
+    arena_alloc(arena, 8);
+  }
+
+  CU_ASSERT_EQUAL(array->len, 1000);
+  for (int i = 0; i < 1000; i++) {
+    CU_ASSERT_EQUAL(g_array_index(array, int, i), i);
+  }
+
+  arena_free(arena);
+}
+
+void test_arenaAllocFailure() {
+  Arena* arena = arena_new();
+
+  char* a = arena_alloc(arena, 1);
+  CU_ASSERT_EQUAL(arena->failed, 0);
+
+  /* no malloc() can give that much */
+  CU_ASSERT_PTR_NULL(arena_alloc(arena, SIZE_MAX / 2));
+  CU_ASSERT_EQUAL(arena->failed, 1);
+
+  /* the arena is left usable */
+  char* b = arena_alloc(arena, 1);
+  CU_ASSERT_PTR_NOT_NULL(b);
+  CU_ASSERT_NOT_EQUAL(a, b);
+
+  arena_reset(arena);
+  CU_ASSERT_EQUAL(arena->failed, 0);
+
+  arena_free(arena);
+}
+
+CU_TestInfo arena_testcases[] = {
+  {"Testing arena allocation:", test_arenaAlloc},
+  {"Testing arena release to a mark:", test_arenaRelease},
+  {"Testing arrays in an arena:", test_arenaArray},
+  {"Testing failed arena allocation:", test_arenaAllocFailure},
+  CU_TEST_INFO_NULL
+};
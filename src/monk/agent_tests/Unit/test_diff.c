@@ -44,7 +44,7 @@ int token_search_diff(char* text, char* search, unsigned int maxAllowedDiff,
   GArray* removals = g_array_new(TRUE, FALSE, sizeof (size_t));
 
   size_t textStartPosition = 0;
-  DiffResult* diffResult = findMatchAsDiffs(tokenizedText, tokenizedSearch, textStartPosition, 0, maxAllowedDiff, 1);
+  DiffResult* diffResult = findMatchAsDiffs(tokenizedText, tokenizedSearch, textStartPosition, 0, maxAllowedDiff, 1, NULL);
   if(expectedAdditionsCount + expectedMatchCount + expectedRemovalsCount == 0) {
     CU_ASSERT_PTR_NULL(diffResult);
     result = diffResult != NULL;
@@ -302,7 +302,7 @@ int token_search(char* text, char* search, size_t expectedStart) {
 
   size_t matchStart = 0;
   size_t textStartPosition = 0;
-  DiffResult* diffResult = findMatchAsDiffs(tokenizedText, tokenizedSearch, textStartPosition, 0, 0, 1);
+  DiffResult* diffResult = findMatchAsDiffs(tokenizedText, tokenizedSearch, textStartPosition, 0, 0, 1, NULL);
 
   int matched = 0;
 
@@ -693,6 +693,73 @@ void test_lookForReplaces2() {
           0, 0, 0));
 }
 
+static unsigned nextRandom(unsigned* seed) {
+  *seed = *seed * 1103515245 + 12345;
+  return (*seed >> 16) & 0x7fff;
+}
+
+static void appendRandomWords(GString* text, unsigned* seed, unsigned count, unsigned words) {
+  static const char letters[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+  for (unsigned i = 0; i < count; i++) {
+    unsigned word = nextRandom(seed) % words;
+    g_string_append_printf(text, "%c%s^", letters[word % 36], word >= 36 ? "x" : "");
+  }
+}
+
+void test_lookForDiffVisits() {
+  unsigned seed = 42;
+
+  for (int i = 0; i < 400; i++) {
+    unsigned words = (i % 4 == 0) ? 2 + i % 3 : 10 + i % 60;
+    GString* common = g_string_new("");
+    GString* text = g_string_new("");
+    GString* search = g_string_new("");
+
+    appendRandomWords(common, &seed, 1 + nextRandom(&seed) % 20, words);
+    appendRandomWords(text, &seed, nextRandom(&seed) % 300, words);
+    g_string_append(text, common->str);
+    appendRandomWords(text, &seed, nextRandom(&seed) % 20, words);
+    appendRandomWords(search, &seed, nextRandom(&seed) % 300, words);
+    g_string_append(search, common->str);
+    appendRandomWords(search, &seed, nextRandom(&seed) % 20, words);
+
+    GArray* textTokens = tokenize(text->str, "^");
+    GArray* searchTokens = tokenize(search->str, "^");
+    size_t iText = nextRandom(&seed) % 10;
+    size_t iSearch = nextRandom(&seed) % 10;
+    unsigned int maxAllowedDiff = (i % 5 == 0) ? 20 : MAX_ALLOWED_DIFF_LENGTH + i % 2;
+    unsigned int minAdjacentMatches = i % 7;
+
+    DiffMatchInfo expected;
+    diff_setVisit(DIFF_VISIT_EACH);
+    int expectedRet = lookForDiff(textTokens, searchTokens, iText, iSearch,
+                                  maxAllowedDiff, minAdjacentMatches, &expected);
+
+    for (int visit = DIFF_VISIT_SCALAR; visit <= (int) diff_bestVisit(); visit++) {
+      DiffMatchInfo result;
+      CU_ASSERT_TRUE(diff_setVisit(visit));
+      int ret = lookForDiff(textTokens, searchTokens, iText, iSearch,
+                            maxAllowedDiff, minAdjacentMatches, &result);
+
+      CU_ASSERT_EQUAL(ret, expectedRet);
+      if (ret && expectedRet) {
+        CU_ASSERT_EQUAL(result.text.start, expected.text.start);
+        CU_ASSERT_EQUAL(result.text.length, expected.text.length);
+        CU_ASSERT_EQUAL(result.search.start, expected.search.start);
+        CU_ASSERT_EQUAL(result.search.length, expected.search.length);
+      }
+    }
+
+    g_array_free(textTokens, TRUE);
+    g_array_free(searchTokens, TRUE);
+    g_string_free(common, TRUE);
+    g_string_free(text, TRUE);
+    g_string_free(search, TRUE);
+  }
+
+  diff_setVisit(diff_bestVisit());
+}
+
 CU_TestInfo diff_testcases[] = {
   {"Testing token search:", test_token_search},
   {"Testing token diff functions, additions:", test_lookForAdditions},
@@ -702,6 +769,7 @@ CU_TestInfo diff_testcases[] = {
   {"Testing token diff functions, replaces correctly handles max diff: ", test_lookForReplacesNotOverflowing},
   {"Testing token diff functions, matchNTokens:", test_matchNTokens},
   {"Testing token diff functions, matchNTokens corner cases:", test_matchNTokensCorners},
+  {"Testing token diff functions, all visits of the square give the same diff:", test_lookForDiffVisits},
   {"Testing token search_diffs:", test_token_search_diffs},
   CU_TEST_INFO_NULL
 };
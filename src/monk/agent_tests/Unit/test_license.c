@@ -129,6 +129,24 @@ void test_indexLicenses() {
   tokens_free(textTokens);
 }
 
+void test_getKeys() {
+  GArray* tokens = tokenize("a^b^c^d^e^f^a^b^c^x^y^z^a", "^");
+  unsigned lengths[] = { 0, 1, 3, 4, 12, 13, 14, 40 };
+
+  for (unsigned n = 0; n < sizeof(lengths) / sizeof(unsigned); n++) {
+    uint32_t* keys = getKeys(tokens, lengths[n]);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(keys);
+
+    for (guint i = 0; i < tokens->len; i++) {
+      CU_ASSERT_EQUAL(keys[i], getKey(tokens, lengths[n], i));
+    }
+
+    free(keys);
+  }
+
+  tokens_free(tokens);
+}
+
 void assertTokens(GArray* tokens, ...) {
   va_list expptr;
   va_start(expptr, tokens);
@@ -284,5 +302,6 @@ CU_TestInfo license_testcases[] = {
   {"Testing extracting two licenses from DB:", test_extractLicenses_Two},
   {"Testing extracting an ignored license from DB:", test_extractLicenses_Ignored},
   {"Testing indexing of licenses:", test_indexLicenses},
+  {"Testing keys of all positions:", test_getKeys},
   CU_TEST_INFO_NULL
 };
@@ -36,6 +36,7 @@ File* getFileWithText(const char* text) {
   result->id = 42;
   result->tokens = tokenize(fileText, "^");
   result->fileName = testFileName;
+  result->arena = NULL;
   g_free(fileText);
 
   return result;
@@ -184,6 +185,39 @@ void test_findAllMatchesAllIncluded() {
   licenses_free(licenses);
 }
 
+void test_findAllMatchesInArena() {
+  File* file = getFileWithText("a^b^c^d^e^f^g");
+  Licenses* licenses = getNLicensesWithText(7, "a^b", "a^b^c^e", "d", "e", "f", "e^f^g", "a^x^y^z^w^v");
+  GArray* expected = findAllMatchesBetween(file, licenses, 20, 1, 0);
+
+  file->arena = arena_new();
+  for (int pass = 0; pass < 2; pass++) {
+    GArray* matches = findAllMatchesBetween(file, licenses, 20, 1, 0);
+
+    FO_ASSERT_EQUAL(matches->len, expected->len);
+    for (guint i = 0; i < MIN(matches->len, expected->len); i++) {
+      Match* match = match_array_index(matches, i);
+      Match* expectedMatch = match_array_index(expected, i);
+      FO_ASSERT_TRUE(match->inArena);
+      FO_ASSERT_EQUAL(match->type, expectedMatch->type);
+      FO_ASSERT_TRUE(_matchEquals(match, expectedMatch->license->refId,
+                                  match_getStart(expectedMatch), match_getEnd(expectedMatch)));
+      if (match->type == MATCH_TYPE_DIFF) {
+        CU_ASSERT_EQUAL(match->ptr.diff->matchedInfo->len, expectedMatch->ptr.diff->matchedInfo->len);
+      }
+    }
+
+    match_array_free(matches);
+    arena_reset(file->arena);
+  }
+  arena_free(file->arena);
+  file->arena = NULL;
+
+  matchesArray_free(expected);
+  file_free(file);
+  licenses_free(licenses);
+}
+
 void test_formatMatchArray() {
   DiffMatchInfo diff1 = (DiffMatchInfo){
     .diffType = "a",
@@ -234,6 +268,7 @@ Match* _matchWithARank(int type, double rank) {
   Match* result = malloc(sizeof(Match));
 
   result->type = type;
+  result->inArena = 0;
   if (type == MATCH_TYPE_DIFF) {
     result->ptr.diff = malloc(sizeof(DiffResult));
     result->ptr.diff->rank = rank;
@@ -649,6 +684,7 @@ CU_TestInfo match_testcases[] = {
   {"Testing match of all licenses with included full matches:", test_findAllMatchesAllIncluded},
   {"Testing match of all licenses with two included group:", test_findAllMatchesTwoGroups},
   {"Testing match of all licenses with two included group and diffs:", test_findAllMatchesTwoGroupsWithDiff},
+  {"Testing match of all licenses in an arena:", test_findAllMatchesInArena},
   {"Testing formatting the diff information output:", test_formatMatchArray},
   {"Testing filtering matches:", test_filterMatches},
   {"Testing filtering matches empty:", test_filterMatchesEmpty},
@@ -18,7 +18,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <libfocunit.h>
+#include <glib/gstdio.h>
 
 #include "serialize.h"
 #include "monk.h"
@@ -109,8 +111,84 @@ void test_roundtrip() {
   assert_Licenses(licenses, returnedLicenses);
 }
 
+void assert_LicenseArrays(const GArray* array1, const GArray* array2) {
+  CU_ASSERT_EQUAL(array1 == NULL, array2 == NULL);
+  if (array1 == NULL || array2 == NULL)
+    return;
+
+  CU_ASSERT_EQUAL(array1->len, array2->len);
+  for (guint i = 0; i < array1->len && i < array2->len; i++) {
+    assert_License(license_index(array1, i), license_index(array2, i));
+  }
+}
+
+void test_knowledgebase() {
+  Licenses* licenses = getNLicensesWithText2(6, "a^b", "a^b^c^d", "d", "e", "f", "e^f^g");
+  char* fileName = g_build_filename(g_get_tmp_dir(), "monk_knowledgebaseXXXXXX", NULL);
+  close(g_mkstemp(fileName));
+
+  CU_ASSERT_TRUE(writeKnowledgebaseToFile(licenses, 0, "checksum", fileName));
+
+  CU_ASSERT_PTR_NULL(mapKnowledgebase(fileName, "other", 1, 0));
+  CU_ASSERT_PTR_NULL(mapKnowledgebase(fileName, "checksum", 2, 0));
+  CU_ASSERT_PTR_NULL(mapKnowledgebase(fileName, "checksum", 1, 1));
+
+  Licenses* mappedLicenses = mapKnowledgebase(fileName, "checksum", 1, 0);
+  CU_ASSERT_PTR_NOT_NULL_FATAL(mappedLicenses);
+
+  assert_Licenses(licenses, mappedLicenses);
+  assert_LicenseArrays(getShortLicenseArray(licenses), getShortLicenseArray(mappedLicenses));
+
+  /* "a^b" and "a^b^c^d" share their key */
+  for (guint i = 0; i < licenses->licenses->len; i++) {
+    uint32_t key = getKey(license_index(licenses->licenses, i)->tokens, 1, 0);
+    assert_LicenseArrays(getLicenseArrayForKey(licenses, 0, key), getLicenseArrayForKey(mappedLicenses, 0, key));
+    assert_LicenseArrays(getLicenseArrayForKey(licenses, 1, key), getLicenseArrayForKey(mappedLicenses, 1, key));
+  }
+  CU_ASSERT_EQUAL(getLicenseArrayForKey(mappedLicenses, 0, getKey(license_index(licenses->licenses, 0)->tokens, 1, 0))->len, 2);
+  CU_ASSERT_PTR_NULL(getLicenseArrayForKey(mappedLicenses, 0, 0));
+
+  Licenses* deserializedLicenses = deserializeFromFile(fileName, 1, 0);
+  CU_ASSERT_PTR_NOT_NULL(deserializedLicenses->mapped);
+  assert_Licenses(licenses, deserializedLicenses);
+
+  licenses_free(deserializedLicenses);
+  licenses_free(mappedLicenses);
+  licenses_free(licenses);
+  g_unlink(fileName);
+  g_free(fileName);
+}
+
+void test_knowledgebase_full_table() {
+  Licenses* licenses = getNLicensesWithText2(2, "a^b", "c^d");
+  char* fileName = g_build_filename(g_get_tmp_dir(), "monk_knowledgebaseXXXXXX", NULL);
+  close(g_mkstemp(fileName));
+
+  CU_ASSERT_TRUE(writeKnowledgebaseToFile(licenses, 0, "checksum", fileName));
+
+  /* fill every slot of the table, looking up a missing key would never end */
+  FILE* fp = fopen(fileName, "r+");
+  CU_ASSERT_PTR_NOT_NULL_FATAL(fp);
+  MappedHeader header;
+  CU_ASSERT_EQUAL(fread(&header, sizeof(header), 1, fp), 1);
+  MappedSlot slot = { .key = 0, .start = 0, .count = 1 };
+  CU_ASSERT_EQUAL(fseek(fp, header.slotsOffset, SEEK_SET), 0);
+  for (guint i = 0; i < (1u << header.indexBits); i++) {
+    CU_ASSERT_EQUAL(fwrite(&slot, sizeof(slot), 1, fp), 1);
+  }
+  fclose(fp);
+
+  CU_ASSERT_PTR_NULL(mapKnowledgebase(fileName, "checksum", 1, 0));
+
+  licenses_free(licenses);
+  g_unlink(fileName);
+  g_free(fileName);
+}
+
 CU_TestInfo serialize_testcases[] = {
   {"Test roundtrip with empty:", test_roundtrip_one},
   {"Test roundtrip with some licenses with tokens:", test_roundtrip},
+  {"Test mapped knowledgebase:", test_knowledgebase},
+  {"Test mapped knowledgebase with a full table:", test_knowledgebase_full_table},
   CU_TEST_INFO_NULL
 };
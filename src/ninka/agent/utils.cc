@@ -61,26 +61,26 @@ void bail(int exitval)
 
 bool processUploadId(const State& state, int uploadId, NinkaDatabaseHandler& databaseHandler)
 {
-  vector<unsigned long> fileIds = databaseHandler.queryFileIdsForUpload(uploadId);
+  vector<fo::PFileInfo> pFiles = databaseHandler.queryPFilesForUpload(uploadId);
 
   bool errors = false;
 #pragma omp parallel
   {
     NinkaDatabaseHandler threadLocalDatabaseHandler(databaseHandler.spawn());
 
-    size_t pFileCount = fileIds.size();
+    size_t pFileCount = pFiles.size();
 #pragma omp for
     for (size_t it = 0; it < pFileCount; ++it)
     {
       if (errors)
         continue;
 
-      unsigned long pFileId = fileIds[it];
+      const fo::PFileInfo& pFile = pFiles[it];
 
-      if (pFileId == 0)
+      if (pFile.id == 0)
         continue;
 
-      if (!matchPFileWithLicenses(state, pFileId, threadLocalDatabaseHandler))
+      if (!matchPFileWithLicenses(state, pFile, threadLocalDatabaseHandler))
       {
         errors = true;
       }
@@ -92,38 +92,17 @@ bool processUploadId(const State& state, int uploadId, NinkaDatabaseHandler& dat
   return !errors;
 }
 
-bool matchPFileWithLicenses(const State& state, unsigned long pFileId, NinkaDatabaseHandler& databaseHandler)
+bool matchPFileWithLicenses(const State& state, const fo::PFileInfo& pFile, NinkaDatabaseHandler& databaseHandler)
 {
-  char* pFile = databaseHandler.getPFileNameForFileId(pFileId);
-
-  if (!pFile)
-  {
-    cout << "File not found " << pFileId << endl;
-    bail(8);
-  }
-
-  char* fileName = NULL;
-  {
-#pragma omp critical (repo_mk_path)
-    fileName = fo_RepMkPath("files", pFile);
-  }
-  if (fileName)
+  if (pFile.path.empty())
   {
-    fo::File file(pFileId, fileName);
-
-    if (!matchFileWithLicenses(state, file, databaseHandler))
-      return false;
-
-    free(fileName);
-    free(pFile);
-  }
-  else
-  {
-    cout << "PFile not found in repo " << pFileId << endl;
+    cout << "PFile not found in repo " << pFile.id << endl;
     bail(7);
   }
 
-  return true;
+  fo::File file(pFile.id, pFile.path);
+
+  return matchFileWithLicenses(state, file, databaseHandler);
 }
 
 bool matchFileWithLicenses(const State& state, const fo::File& file, NinkaDatabaseHandler& databaseHandler)
@@ -39,7 +39,7 @@ int queryAgentId(fo::DbManager& dbManager);
 int writeARS(const State& state, int arsId, int uploadId, int success, fo::DbManager& dbManager);
 void bail(int exitval);
 bool processUploadId(const State& state, int uploadId, NinkaDatabaseHandler& databaseHandler);
-bool matchPFileWithLicenses(const State& state, unsigned long pFileId, NinkaDatabaseHandler& databaseHandler);
+bool matchPFileWithLicenses(const State& state, const fo::PFileInfo& pFile, NinkaDatabaseHandler& databaseHandler);
 bool matchFileWithLicenses(const State& state, const fo::File& file, NinkaDatabaseHandler& databaseHandler);
 bool saveLicenseMatchesToDatabase(const State& state, const vector<LicenseMatch>& matches, unsigned long pFileId, NinkaDatabaseHandler& databaseHandler);
 
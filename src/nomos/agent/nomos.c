@@ -76,14 +76,15 @@ void arsNomos(cacheroot_t* cacheroot){
   char *repFile;
 
   schedulerMode = 1;
-  /* get user_pk for user who queued the agent */
-  user_pk = fo_scheduler_userID();
   /* read upload_pk from scheduler */
   while (fo_scheduler_next())
   {
     upload_pk = atoi(fo_scheduler_current());
     if (upload_pk == 0)
       continue;
+    /* get user_pk for user who queued the job, it changes when the scheduler
+     * keeps the agent for its next job */
+    user_pk = fo_scheduler_userID();
     /* Check Permissions */
     if (GetUploadPerm(gl.pgConn, upload_pk, user_pk) < PERM_WRITE)
     {
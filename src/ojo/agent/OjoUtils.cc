@@ -112,16 +112,15 @@ void bail(int exitval)
 bool processUploadId(const OjoState &state, int uploadId,
     OjosDatabaseHandler &databaseHandler)
 {
-  vector<unsigned long> fileIds = databaseHandler.queryFileIdsForScan(
+  vector<fo::PFileInfo> pFiles = databaseHandler.queryPFilesForScan(
       uploadId, state.getAgentId());
-  char const *repoArea = "files";
 
   bool errors = false;
 #pragma omp parallel
   {
     OjosDatabaseHandler threadLocalDatabaseHandler(databaseHandler.spawn());
 
-    size_t pFileCount = fileIds.size();
+    size_t pFileCount = pFiles.size();
     OjoAgent agentObj = state.getOjoAgent();
 #pragma omp for
     for (size_t it = 0; it < pFileCount; ++it)
@@ -129,29 +128,25 @@ bool processUploadId(const OjoState &state, int uploadId,
       if (errors)
         continue;
 
-      unsigned long pFileId = fileIds[it];
+      const fo::PFileInfo &pFile = pFiles[it];
+      unsigned long pFileId = pFile.id;
 
       if (pFileId == 0)
         continue;
 
-      char *fileName = threadLocalDatabaseHandler.getPFileNameForFileId(
-        pFileId);
-      char *filePath = NULL;
-#pragma omp critical (repo_mk_path)
-      filePath = fo_RepMkPath(repoArea, fileName);
-
-      if (!filePath)
+      if (pFile.path.empty())
       {
         LOG_FATAL(
           AGENT_NAME" was unable to derive a file path for pfile %ld.  Check your HOSTS configuration.",
           pFileId);
         errors = true;
+        continue;
       }
 
       vector<ojomatch> identified;
       try
       {
-        identified = agentObj.processFile(filePath, threadLocalDatabaseHandler);
+        identified = agentObj.processFile(pFile.path, threadLocalDatabaseHandler);
       }
       catch (std::runtime_error &e)
       {
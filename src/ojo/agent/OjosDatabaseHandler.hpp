@@ -80,7 +80,7 @@ class OjosDatabaseHandler: public fo::AgentDatabaseHandler
     OjosDatabaseHandler spawn() const;
 
     std::vector<unsigned long> queryFileIdsForUpload(int uploadId);
-    std::vector<unsigned long> queryFileIdsForScan(int uploadId, int agentId);
+    std::vector<fo::PFileInfo> queryPFilesForScan(int uploadId, int agentId);
     unsigned long saveLicenseToDatabase(OjoDatabaseEntry &entry) const;
     bool insertNoResultInDatabase(OjoDatabaseEntry &entry) const;
     bool saveHighlightToDatabase(const ojomatch &match,
@@ -29,8 +29,10 @@
 #include <event.h>
 #include <host.h>
 #include <job.h>
+#include <launcher.h>
 #include <logging.h>
 #include <scheduler.h>
+#include <stats.h>
 
 /* library includes */
 #include <limits.h>
@@ -42,6 +44,9 @@
 /* unix library includes */
 #include <fcntl.h>
 #include <limits.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -122,10 +127,183 @@ const char* agent_status_strings[] =
 { AGENT_STATUS_TYPES(SELECT_STRING) };
 #undef SELECT_STRING
 
+/**
+ * Protects the metrics of every agent, they are written by the agent io
+ * thread and read by the main thread.
+ */
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+static GMutex metrics_lock;
+#define METRICS_LOCK()   g_mutex_lock(&metrics_lock)
+#define METRICS_UNLOCK() g_mutex_unlock(&metrics_lock)
+#else
+static GStaticMutex metrics_lock = G_STATIC_MUTEX_INIT;
+#define METRICS_LOCK()   g_static_mutex_lock(&metrics_lock)
+#define METRICS_UNLOCK() g_static_mutex_unlock(&metrics_lock)
+#endif
+
+#define AGENT_IO_EVENTS 64 ///< the number of ready pipes handled per epoll_wait()
+
+/**
+ * The agent io loop. A single thread reads the pipes of all agents, see
+ * agent_io_loop(). It never writes to them, all writes to agents are done by
+ * the main thread.
+ */
+static struct
+{
+    int      epoll_fd;  ///< the epoll instance every agent pipe is registered with
+    int      wake_fd;   ///< eventfd used to stop the agent io thread
+    GThread* thread;    ///< the agent io thread, NULL until the first agent is spawned
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+    GMutex   lock;      ///< protects the listening flag of every agent
+    GCond    cond;      ///< signaled when the io thread stops listening to an agent
+#else
+    GStaticMutex lock;  ///< protects the listening flag of every agent
+    GCond*   cond;      ///< signaled when the io thread stops listening to an agent
+#endif
+} agent_io;
+
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+#define AGENT_IO_LOCK()      g_mutex_lock(&agent_io.lock)
+#define AGENT_IO_UNLOCK()    g_mutex_unlock(&agent_io.lock)
+#define AGENT_IO_WAIT()      g_cond_wait(&agent_io.cond, &agent_io.lock)
+#define AGENT_IO_BROADCAST() g_cond_broadcast(&agent_io.cond)
+#else
+#define AGENT_IO_LOCK()      g_static_mutex_lock(&agent_io.lock)
+#define AGENT_IO_UNLOCK()    g_static_mutex_unlock(&agent_io.lock)
+#define AGENT_IO_WAIT()      g_cond_wait(agent_io.cond, g_static_mutex_get_mutex(&agent_io.lock))
+#define AGENT_IO_BROADCAST() g_cond_broadcast(agent_io.cond)
+#endif
+
+/**
+ * The job that the idle agents in the pool belong to, see agent_pool_add(). It
+ * is never added to the job list, it only keeps the owner of an idle agent
+ * valid.
+ */
+static job_t agent_pool_job = { .agent_type = "pool", .id = -1 };
+
 /* ************************************************************************** */
 /* **** Local Functions ***************************************************** */
 /* ************************************************************************** */
 
+/**
+ * @brief Updates a metric of an agent from a "METRIC: <name> <c|g> <value>"
+ *        message.
+ *
+ * Counters are sent as running totals, so the value simply replaces the old
+ * one and the difference is used to calculate the current rate. Agents can
+ * not create more than MAX_METRICS different metrics.
+ *
+ * @param agent  the agent that sent the message
+ * @param msg    the message without the leading "METRIC: "
+ * @return 0 if the message was valid, -1 otherwise
+ */
+static int agent_metric_update(agent_t* agent, char* msg)
+{
+  char name[64];
+  char kind;
+  gint64 value;
+  agent_metric* metric;
+  time_t now = time(NULL);
+
+  if (sscanf(msg, "%63s %c %" G_GINT64_FORMAT, name, &kind, &value) != 3 ||
+      (kind != 'c' && kind != 'g'))
+    return -1;
+
+  METRICS_LOCK();
+  if ((metric = g_tree_lookup(agent->metrics, name)) == NULL)
+  {
+    if (g_tree_nnodes(agent->metrics) >= MAX_METRICS)
+    {
+      METRICS_UNLOCK();
+      return -1;
+    }
+
+    metric = g_new0(agent_metric, 1);
+    metric->gauge = (kind == 'g');
+    metric->value = value;
+    metric->stamp = now;
+    g_tree_insert(agent->metrics, g_strdup(name), metric);
+  }
+  else
+  {
+    if (!metric->gauge && now > metric->stamp)
+      metric->rate = (double)(value - metric->value) / (now - metric->stamp);
+    metric->value = value;
+    metric->stamp = now;
+  }
+  METRICS_UNLOCK();
+
+  return 0;
+}
+
+/**
+ * @brief Adds one metric to a different set of metrics.
+ *
+ * This function will be called by g_tree_foreach() which is the reason for its
+ * formatting. The first element of into is the GTree that will be added to,
+ * the second element is TRUE if gauges and rates should be added as well.
+ *
+ * @param name    the name of the metric
+ * @param metric  the metric that is being added
+ * @param into    the metrics to add to and whether they are live
+ * @return always returns 0 to indicate that the traversal should continue
+ */
+static int agent_metric_fold(char* name, agent_metric* metric, arg_int* into)
+{
+  agent_metric* total;
+  double rate = metric->rate;
+
+  if (!into->second && metric->gauge)
+    return 0;
+
+  /* a counter that did not change for a while is not producing anything */
+  if (time(NULL) - metric->stamp > CONF_agent_update_interval)
+    rate = 0;
+
+  if ((total = g_tree_lookup(into->first, name)) == NULL)
+  {
+    total = g_new0(agent_metric, 1);
+    total->gauge = metric->gauge;
+    g_tree_insert(into->first, g_strdup(name), total);
+  }
+
+  if (total->gauge != metric->gauge)
+    return 0;
+
+  total->value += metric->value;
+  if (into->second)
+    total->rate += rate;
+  total->stamp = MAX(total->stamp, metric->stamp);
+
+  return 0;
+}
+
+/**
+ * @brief Appends a metric to a string as " <name>:<value>", counters are
+ *        followed by their rate as " <name>/s:<rate>".
+ *
+ * This function will be called by g_tree_foreach() which is the reason for its
+ * formatting.
+ *
+ * @param name    the name of the metric
+ * @param metric  the metric to print
+ * @param str     the string to append to
+ * @return always returns 0 to indicate that the traversal should continue
+ */
+static int agent_metric_print(char* name, agent_metric* metric, GString* str)
+{
+  double rate = metric->rate;
+
+  if (time(NULL) - metric->stamp > CONF_agent_update_interval)
+    rate = 0;
+
+  g_string_append_printf(str, " %s:%" G_GINT64_FORMAT, name, metric->value);
+  if (!metric->gauge)
+    g_string_append_printf(str, " %s/s:%.1f", name, rate);
+
+  return 0;
+}
+
 /**
  * @brief This will close all of the agent's pipes
  *
@@ -144,7 +322,6 @@ static int agent_close_fd(int* pid_ptr, agent_t* agent, agent_t* excepted)
   {
     close(agent->from_child);
     close(agent->to_child);
-    fclose(agent->read);
     fclose(agent->write);
   }
   return 0;
@@ -266,52 +443,33 @@ static int agent_test(const gchar* name, meta_agent_t* ma, scheduler_t* schedule
 }
 
 /**
- * Main function used for agent communication. This is where the communication
- * thread will spend the majority of its time.
+ * @brief Checks the version information that an agent sends as its first line.
+ *
+ * The agent should send "VERSION: <string>" where the string is the version
+ * information. there are five things that can happen here.
+ *   -# the agent sends correct version information   => continue
+ *   -# this is the first agent to send version info  => save version and continue
+ *   -# the agent sends incorrect version information => invalidate the agent
+ *   -# the agent doesn't send version information    => invalidate the agent
+ *   -# the agent crashed before sending information  => stop listening
+ *
+ * Only the agent io thread calls this, so the version of the meta agent needs
+ * no lock.
  *
  * @param scheduler Pointer to scheduler interface
- * @param agent a the agent that will be listened on
+ * @param agent     the agent that sent the line
+ * @param buffer    the line, without the trailing newline
+ * @return TRUE if the scheduler should keep listening to the agent
  */
-static void agent_listen(scheduler_t* scheduler, agent_t* agent)
+static gboolean agent_version(scheduler_t* scheduler, agent_t* agent, char* buffer)
 {
-  /* static locals */
-#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
-  static GMutex version_lock;
-#else
-  static GStaticMutex version_lock = G_STATIC_MUTEX_INIT;
-#endif
-
-  /* locals */
-  char buffer[1024]; // buffer to store c strings read from agent
-  GMatchInfo* match; // regex match information
-  char* arg;         // used during regex retrievals
-  int relevant;      // used during special retrievals
-
-  TEST_NULV(agent);
-
-  /**
-   * Start by getting the version information from the agent. The agent should
-   * send "VERSION: <string>" where the string is the version information. there
-   * are five things that can happen here.
-   *   -# the agent sends correct version information   => continue
-   *   -# this is the first agent to send version info  => save version and continue
-   *   -# the agent sends incorrect version information => invalidate the agent
-   *   -# the agent doesn't send version information    => invalidate the agent
-   *   -# the agent crashed before sending information  => close the thread
-   */
-  if (fgets(buffer, sizeof(buffer), agent->read) == NULL)
-  {
-    AGENT_CONCURRENT_PRINT("pipe from child closed: %s\n", strerror(errno));
-    g_thread_exit(NULL);
-  }
-
   /* check to make sure "VERSION" was sent */
-  buffer[strlen(buffer) - 1] = '\0';
   if (strncmp(buffer, "VERSION: ", 9) != 0)
   {
     if (strncmp(buffer, "@@@1", 4) == 0)
     {
-      THREAD_FATAL(job_log(agent->owner), "agent crashed before sending version information");
+      con_printf(job_log(agent->owner), "ERROR %s.%d: agent crashed before sending version information\n",
+          __FILE__, __LINE__);
     }
     else
     {
@@ -321,17 +479,12 @@ static void agent_listen(scheduler_t* scheduler, agent_t* agent)
       con_printf(main_log, "ERROR %s.%d: agent %s.%s has been invalidated, removing from agents\n", __FILE__, __LINE__,
           agent->host->name, agent->type->name);
       AGENT_CONCURRENT_PRINT("agent didn't send version information: \"%s\"\n", buffer);
-      return;
     }
+    return FALSE;
   }
 
   /* check that the VERSION information is correct */
-#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
-  g_mutex_lock(&version_lock);
-#else
-  g_static_mutex_lock(&version_lock);
-#endif
-  strcpy(buffer, &buffer[9]);
+  buffer += 9;
   if (agent->type->version == NULL && agent->type->valid)
   {
     agent->type->version_source = agent->host->name;
@@ -340,7 +493,7 @@ static void agent_listen(scheduler_t* scheduler, agent_t* agent)
       con_printf(main_log, "META_AGENT[%s.%s] version is: \"%s\"\n", agent->host->name, agent->type->name,
           agent->type->version);
   }
-  else if (strcmp(agent->type->version, buffer) != 0)
+  else if (agent->type->version == NULL || strcmp(agent->type->version, buffer) != 0)
   {
     con_printf(job_log(agent->owner), "ERROR %s.%d: META_DATA[%s] invalid agent spawn check\n", __FILE__, __LINE__,
         agent->type->name);
@@ -348,203 +501,464 @@ static void agent_listen(scheduler_t* scheduler, agent_t* agent)
         agent->type->version_source, agent->type->version, agent->host->name, buffer);
     agent->type->valid = 0;
     agent_kill(agent);
-#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
-    g_mutex_unlock(&version_lock);
-#else
-    g_static_mutex_unlock(&version_lock);
-#endif
-    return;
+    return FALSE;
   }
-#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
-  g_mutex_unlock(&version_lock);
-#else
-  g_static_mutex_unlock(&version_lock);
-#endif
 
-  /*!
-   * If we reach here the agent has correctly sent VERION information to the
-   * scheduler. The agent now enters a listening loop. The communication thread
-   * will wait for input from the agent, and act according to the agents current
-   * state and what was sent
+  agent->versioned = TRUE;
+  return TRUE;
+}
+
+/**
+ * @brief Answers the GETSPECIAL request of an agent.
+ *
+ * The io thread never writes to an agent, a full pipe would block it for all
+ * agents. The reply is written by the main thread, like the data and the
+ * commands the agents get.
+ *
+ * @param scheduler the scheduler
+ * @param params    the agent and the value of the special attribute
+ */
+static void agent_value_event(scheduler_t* scheduler, arg_int* params)
+{
+  aprintf(params->first, "VALUE: %d\n", params->second);
+  g_free(params);
+}
+
+/** The LOAD line of an agent, handed from the io thread to the main thread */
+typedef struct
+{
+  agent_t* agent;   ///< the agent that sent the line
+  int load;         ///< the cpu load of its host in percent
+  int memory;       ///< the available memory of its host in MB
+  int rss;          ///< the resident memory of the agent in MB, -1 if not sent
+} agent_load;
+
+/**
+ * @brief Records the load an agent reported.
+ *
+ * The host and the agent memory are read by the main thread when it places
+ * agents, so they are only written here and not by the io thread.
+ *
+ * @param scheduler the scheduler
+ * @param report    the reported load, freed here
+ */
+static void agent_load_event(scheduler_t* scheduler, agent_load* report)
+{
+  agent_t* agent = report->agent;
+
+  host_report_load(agent->host, report->load, report->memory);
+  if (report->rss > (int)agent->rss)
+  {
+    agent->rss = report->rss;
+    agent_memory_event(scheduler, agent);
+  }
+  g_free(report);
+}
+
+/**
+ * Handles one line that was read from an agent. This is where the agent io
+ * thread spends the majority of its time.
+ *
+ * Once the agent has correctly sent VERSION information to the scheduler, the
+ * io thread acts on every line according to the agents current state and what
+ * was sent.
+ *
+ * \note any command prepended by "@@@" is a message from the scheduler to the
+ *       io thread, not from the agent.
+ *
+ * @param scheduler Pointer to scheduler interface
+ * @param agent     the agent that sent the line
+ * @param buffer    the line, without the trailing newline
+ * @return TRUE if the scheduler should keep listening to the agent
+ */
+static gboolean agent_message(scheduler_t* scheduler, agent_t* agent, char* buffer)
+{
+  GMatchInfo* match; // regex match information
+  char* arg;         // used during regex retrievals
+  int relevant;      // used during special retrievals
+  arg_int* value;    // reply to GETSPECIAL
+  agent_load* load;  // LOAD report
+  char items[64];    // used to count the items of a heartbeat
+
+  if (!agent->versioned)
+    return agent_version(scheduler, agent, buffer);
+
+  if (strlen(buffer) == 0)
+    return TRUE;
+
+  if (TVERB_AGENT && (TVERB_SPECIAL || strncmp(buffer, "SPECIAL", 7) != 0))
+    AGENT_CONCURRENT_PRINT("received: \"%s\"\n", buffer);
+
+  /*! - \b command: "BYE"
    *
-   * \note any command prepended by "@@@" is a message from the scheduler to the
-   *       communication thread, not from the agent.
+   *    The agent has finished processing all of the data from the relevant job.
+   *    This command is follow by a return code. 0 indicates that it completed
+   *    correctly, anything else can be used as an error code. Regardless of
+   *    whether the agent completed, the scheduler stops listening to it.
    */
-  while (1)
+  if (strncmp(buffer, "BYE", 3) == 0)
   {
-    /* get message from agent */
-    if (fgets(buffer, sizeof(buffer), agent->read) == NULL)
-      g_thread_exit(NULL);
-
-    buffer[strlen(buffer) - 1] = '\0';
-
-    if (strlen(buffer) == 0)
-      continue;
-
-    if (TVERB_AGENT && (TVERB_SPECIAL || strncmp(buffer, "SPECIAL", 7) != 0))
-      AGENT_CONCURRENT_PRINT("received: \"%s\"\n", buffer);
-
-    /*! - \b command: "BYE"
-     *
-     *    The agent has finished processing all of the data from the relevant job.
-     *    This command is follow by a return code. 0 indicates that it completed
-     *    correctly, anything else can be used as an error code. Regardless of
-     *    whether the agent completed, the communication thread will shutdown.
-     */
-    if (strncmp(buffer, "BYE", 3) == 0)
+    if ((agent->return_code = atoi(&(buffer[4]))) != 0)
     {
-      if ((agent->return_code = atoi(&(buffer[4]))) != 0)
-      {
-        AGENT_CONCURRENT_PRINT("agent failed with error code %d\n", agent->return_code);
-        event_signal(agent_fail_event, agent);
-      }
-      break;
+      AGENT_CONCURRENT_PRINT("agent failed with error code %d\n", agent->return_code);
+      event_signal_priority(agent_fail_event, agent, EVENT_HIGH);
     }
+    return FALSE;
+  }
 
-    /*! - \b command "@@@1"
-     *
-     *    The scheduler needs the communication thread to shutdown. This will
-     *    normally only happen if the agent crashes and the scheduler receives a
-     *    SIGCHLD for it before it sends "BYE #".
-     */
-    if (strncmp(buffer, "@@@1", 4) == 0)
-      break;
+  /*! - \b command "@@@1"
+   *
+   *    The scheduler needs the io thread to stop listening to the agent. This
+   *    will normally only happen if the agent crashes and the scheduler receives
+   *    a SIGCHLD for it before it sends "BYE #".
+   */
+  if (strncmp(buffer, "@@@1", 4) == 0)
+    return FALSE;
+
+  /* agent just checked in */
+  agent->check_in = time(NULL);
+
+  /*! - \b command: "OK"
+   *
+   *    The agent is ready for data. This is sent it 2 situations:
+   *        -# the agent has completed startup and is ready for the first part of
+   *           the data that needs to be analyzed for the job
+   *        -# the agent has finished the last piece of the job it was working on
+   *           and is ready for the next piece or to be shutdown
+   */
+  if (strncmp(buffer, "OK", 2) == 0)
+  {
+    if (agent->status != AG_PAUSED || agent->chunk != NULL)
+      event_signal_priority(agent_ready_event, agent, EVENT_HIGH);
+  }
+
+  /*! - \b command: "HEART"
+   *
+   *    Given the size of jobs that can be processed by FOSSology, agents can
+   *    take an extremely long period of time to finish. To make sure that an
+   *    agent is still working it must periodically update the scheduler with
+   *    how much of the job it has processed.
+   */
+  else if (strncmp(buffer, "HEART", 5) == 0)
+  {
+    g_regex_match(scheduler->parse_agent_msg, buffer, 0, &match);
+
+    arg = g_match_info_fetch(match, 3);
+    agent->total_analyzed = atoi(arg);
+    g_free(arg);
 
-    /*! - \b command "@@@0"
-     *
-     *    The scheduler has updated the data that the agent should be processing.
-     *    This is sent after an agent sends the "OK" command, and the scheduler has
-     *    processed the resulting agent_ready_event().
-     */
-    if (strncmp(buffer, "@@@0", 4) == 0 && agent->updated)
+    /* the processed items are also a counter, so that their rate is known */
+    snprintf(items, sizeof(items), "items c %" G_GUINT64_FORMAT, agent->total_analyzed);
+    agent_metric_update(agent, items);
+
+    arg = g_match_info_fetch(match, 6);
+    agent->alive = (arg[0] == '1' || agent->alive);
+    g_free(arg);
+
+    g_match_info_free(match);
+    match = NULL;
+
+    if (agent->owner->id >= 0)
+      database_job_processed(agent->owner->id, agent->total_analyzed);
+  }
+
+  /*! - \b command: "LOAD"
+   *
+   *    Along with the heartbeat, agents report the load of the host they run
+   *    on as "LOAD: <cpu load in percent> <available memory in MB>", followed
+   *    by their own resident memory in MB. The scheduler uses this to decide
+   *    where the next agents are started, see get_host(), and to learn how
+   *    much memory agents of the type use, see agent_memory_event().
+   */
+  else if (strncmp(buffer, "LOAD", 4) == 0)
+  {
+    load = g_new0(agent_load, 1);
+    load->agent = agent;
+    load->rss = -1;
+    if (sscanf(buffer, "LOAD: %d %d %d", &load->load, &load->memory, &load->rss) >= 2)
     {
-      aprintf(agent, "%s\n", agent->data);
-      aprintf(agent, "END\n");
-      fflush(agent->write);
-      agent->updated = 0;
-      continue;
+      event_signal_priority(agent_load_event, load, EVENT_HIGH);
     }
-
-    /* agent just checked in */
-    agent->check_in = time(NULL);
-
-    /*! - \b command: "OK"
-     *
-     *    The agent is ready for data. This is sent it 2 situations:
-     *        -# the agent has completed startup and is ready for the first part of
-     *           the data that needs to be analyzed for the job
-     *        -# the agent has finished the last piece of the job it was working on
-     *           and is ready for the next piece or to be shutdown
-     */
-    if (strncmp(buffer, "OK", 2) == 0)
+    else
     {
-      if (agent->status != AG_PAUSED)
-        event_signal(agent_ready_event, agent);
+      AGENT_CONCURRENT_PRINT("invalid load: \"%s\"\n", buffer);
+      g_free(load);
     }
+  }
 
-    /*! - \b command: "HEART"
-     *
-     *    Given the size of jobs that can be processed by FOSSology, agents can
-     *    take an extremely long period of time to finish. To make sure that an
-     *    agent is still working it must periodically update the scheduler with
-     *    how much of the job it has processed.
-     */
-    else if (strncmp(buffer, "HEART", 5) == 0)
-    {
-      g_regex_match(scheduler->parse_agent_msg, buffer, 0, &match);
+  /*! - \b command: "METRIC"
+   *
+   *    Agents can report counters and gauges beyond the number of items
+   *    processed, e.g. the number of bytes scanned or the time spent in the
+   *    database. The message is "METRIC: <name> <c|g> <value>". Agents send
+   *    these by calling fo_scheduler_metric_add() and fo_scheduler_metric_set()
+   *    in the agent api.
+   */
+  else if (strncmp(buffer, "METRIC", 6) == 0)
+  {
+    if (strlen(buffer) < 8 || agent_metric_update(agent, buffer + 8) != 0)
+      AGENT_CONCURRENT_PRINT("invalid metric: \"%s\"\n", buffer);
+  }
 
-      arg = g_match_info_fetch(match, 3);
-      agent->total_analyzed = atoi(arg);
-      g_free(arg);
+  /*! - \b command: "EMAIL"
+   *
+   *    Agents have the ability to set the message that will be sent with the
+   *    notification email. This grabs the message and sets inside the job that
+   *    the agent is running under.
+   */
+  else if (strncmp(buffer, "EMAIL", 5) == 0)
+  {
+    agent->owner->message = g_strdup(buffer + 6);
+  }
 
-      arg = g_match_info_fetch(match, 6);
-      agent->alive = (arg[0] == '1' || agent->alive);
-      g_free(arg);
+  /*! - \b command: "SPECIAL"
+   *
+   *    Agents can set special attributes that change how it is treated during
+   *    execution. This grabs the command and whether it is being set to true
+   *    or false. Agents use this by calling fo_scheduler_set_special() in the
+   *    agent api.
+   */
+  else if (strncmp(buffer, "SPECIAL", 7) == 0)
+  {
+    relevant = INT_MAX;
 
-      g_match_info_free(match);
-      match = NULL;
+    g_regex_match(scheduler->parse_agent_msg, buffer, 0, &match);
 
-      database_job_processed(agent->owner->id, agent->total_analyzed);
-    }
+    arg = g_match_info_fetch(match, 3);
+    relevant &= atoi(arg);
+    g_free(arg);
 
-    /*! - \b command: "EMAIL"
-     *
-     *    Agents have the ability to set the message that will be sent with the
-     *    notification email. This grabs the message and sets inside the job that
-     *    the agent is running under.
-     */
-    else if (strncmp(buffer, "EMAIL", 5) == 0)
+    arg = g_match_info_fetch(match, 6);
+    if (atoi(arg))
     {
-      agent->owner->message = g_strdup(buffer + 6);
+      if (agent->special & relevant)
+        relevant = 0;
     }
+    else
+    {
+      if (!(agent->special & relevant))
+        relevant = 0;
+    }
+    g_free(arg);
+
+    g_match_info_free(match);
 
-    /*! - \b command: "SPECIAL"
-     *
-     *    Agents can set special attributes that change how it is treated during
-     *    execution. This grabs the command and whether it is being set to true
-     *    or false. Agents use this by calling fo_scheduler_set_special() in the
-     *    agent api.
-     */
-    else if (strncmp(buffer, "SPECIAL", 7) == 0)
+    agent->special ^= relevant;
+  }
+
+  /*! - \b command: GETSPECIAL
+   *
+   *    The agent has requested the value of a special attribute. The scheduler
+   *    will respond with the value of the special attribute.
+   */
+  else if (strncmp(buffer, "GETSPECIAL", 10) == 0)
+  {
+    g_regex_match(scheduler->parse_agent_msg, buffer, 0, &match);
+
+    arg = g_match_info_fetch(match, 3);
+    relevant = atoi(arg);
+    g_free(arg);
+
+    value = g_new0(arg_int, 1);
+    value->first = agent;
+    value->second = (agent->special & relevant) ? 1 : 0;
+    event_signal_priority(agent_value_event, value, EVENT_HIGH);
+
+    g_match_info_free(match);
+  }
+
+  /*! - \b command: unknown
+   *
+   *    The agent didn't use a legal command. This will simply put what the agent
+   *    printed into the log and move on.
+   */
+  else if (!(TVERB_AGENT))
+    AGENT_CONCURRENT_PRINT("\"%s\"\n", buffer);
+
+  return TRUE;
+}
+
+/**
+ * @brief Stops listening to an agent.
+ *
+ * Removes the pipe of the agent from the agent io loop and wakes up the main
+ * thread if it is waiting in agent_io_wait(). The agent may be freed as soon
+ * as this returns, so this must be the last use of the agent by the io thread.
+ *
+ * @param agent the agent to stop listening to
+ */
+static void agent_io_close(agent_t* agent)
+{
+  if (epoll_ctl(agent_io.epoll_fd, EPOLL_CTL_DEL, agent->from_child, NULL) != 0)
+    AGENT_ERROR("unable to remove agent from io loop: %s", strerror(errno));
+
+  if (TVERB_AGENT)
+    AGENT_CONCURRENT_PRINT("communication closing\n");
+
+  AGENT_IO_LOCK();
+  agent->listening = FALSE;
+  AGENT_IO_BROADCAST();
+  AGENT_IO_UNLOCK();
+}
+
+/**
+ * @brief Reads whatever an agent has written and handles every complete line.
+ *
+ * The pipe from the agent is non-blocking, an incomplete line is kept in the
+ * read buffer of the agent until the rest of it arrives. A line that does not
+ * fit in the buffer is handled in pieces, the same way fgets() used to split it.
+ *
+ * @param scheduler Pointer to scheduler interface
+ * @param agent     the agent whose pipe is readable
+ */
+static void agent_read(scheduler_t* scheduler, agent_t* agent)
+{
+  gboolean keep = TRUE;
+  ssize_t len;
+  char* line;
+  char* next;
+  char* end;
+
+  len = read(agent->from_child, agent->read_buf + agent->read_len, sizeof(agent->read_buf) - 1 - agent->read_len);
+  if (len < 0 && (errno == EAGAIN || errno == EINTR))
+    return;
+  if (len <= 0)
+  {
+    AGENT_CONCURRENT_PRINT("pipe from child closed: %s\n", len == 0 ? "end of file" : strerror(errno));
+    agent_io_close(agent);
+    return;
+  }
+
+  agent->read_len += len;
+  agent->read_buf[agent->read_len] = '\0';
+
+  for (line = agent->read_buf; keep; line = next)
+  {
+    if ((end = strchr(line, '\n')) != NULL)
+    {
+      *end = '\0';
+      next = end + 1;
+    }
+    else if (line == agent->read_buf && agent->read_len == sizeof(agent->read_buf) - 1)
+    {
+      next = agent->read_buf + agent->read_len;
+    }
+    else
     {
-      relevant = INT_MAX;
+      break;
+    }
 
-      g_regex_match(scheduler->parse_agent_msg, buffer, 0, &match);
+    keep = agent_message(scheduler, agent, line);
+  }
 
-      arg = g_match_info_fetch(match, 3);
-      relevant &= atoi(arg);
-      g_free(arg);
+  if (!keep)
+  {
+    agent_io_close(agent);
+    return;
+  }
 
-      arg = g_match_info_fetch(match, 6);
-      if (atoi(arg))
-      {
-        if (agent->special & relevant)
-          relevant = 0;
-      }
-      else
-      {
-        if (!(agent->special & relevant))
-          relevant = 0;
-      }
-      g_free(arg);
+  /* keep the incomplete line for the next read */
+  agent->read_len -= line - agent->read_buf;
+  memmove(agent->read_buf, line, agent->read_len + 1);
+}
 
-      g_match_info_free(match);
+/**
+ * Main function of the agent io thread. A single thread reads the output of
+ * every agent, instead of one blocking thread per agent. It waits on the epoll
+ * instance that the pipe of every running agent is registered with, reads the
+ * pipes that are ready and turns the lines into events for the main thread.
+ *
+ * @param scheduler Pointer to scheduler interface
+ * @return always NULL
+ */
+static void* agent_io_loop(scheduler_t* scheduler)
+{
+  struct epoll_event events[AGENT_IO_EVENTS];
+  int n, i;
 
-      agent->special ^= relevant;
+  while (1)
+  {
+    if ((n = epoll_wait(agent_io.epoll_fd, events, AGENT_IO_EVENTS, -1)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      ERROR("agent io loop failed: %s", strerror(errno));
+      break;
     }
 
-    /*! - \b command: GETSPECIAL
-     *
-     *    The agent has requested the value of a special attribute. The scheduler
-     *    will respond with the value of the special attribute.
-     */
-    else if (strncmp(buffer, "GETSPECIAL", 10) == 0)
+    for (i = 0; i < n; i++)
     {
-      g_regex_match(scheduler->parse_agent_msg, buffer, 0, &match);
+      /* only the wake up descriptor is registered without an agent */
+      if (events[i].data.ptr == NULL)
+        return NULL;
+      agent_read(scheduler, events[i].data.ptr);
+    }
+  }
 
-      arg = g_match_info_fetch(match, 3);
-      relevant = atoi(arg);
-      g_free(arg);
+  return NULL;
+}
 
-      if (agent->special & relevant)
-        aprintf(agent, "VALUE: 1\n");
-      else
-        aprintf(agent, "VALUE: 0\n");
+/**
+ * @brief Starts listening to a newly spawned agent.
+ *
+ * The agent io thread and its epoll instance are created the first time an
+ * agent is spawned.
+ *
+ * @param scheduler Pointer to scheduler interface
+ * @param agent     the agent to listen to
+ */
+static void agent_io_add(scheduler_t* scheduler, agent_t* agent)
+{
+  struct epoll_event event;
 
-      g_match_info_free(match);
-    }
+  if (agent_io.thread == NULL)
+  {
+    if ((agent_io.epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+        (agent_io.wake_fd = eventfd(0, EFD_CLOEXEC)) < 0)
+      FATAL("unable to create the agent io loop");
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    if (epoll_ctl(agent_io.epoll_fd, EPOLL_CTL_ADD, agent_io.wake_fd, &event) != 0)
+      FATAL("unable to create the agent io loop");
 
-    /*! - \b command: unknown
-     *
-     *    The agent didn't use a legal command. This will simply put what the agent
-     *    printed into the log and move on.
-     */
-    else if (!(TVERB_AGENT))
-      AGENT_CONCURRENT_PRINT("\"%s\"\n", buffer);
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+    agent_io.thread = g_thread_new("agent_io", (GThreadFunc) agent_io_loop, scheduler);
+#else
+    agent_io.cond = g_cond_new();
+    agent_io.thread = g_thread_create((GThreadFunc) agent_io_loop, scheduler, 1, NULL);
+#endif
   }
 
-  if (TVERB_AGENT)
-    AGENT_CONCURRENT_PRINT("communication thread closing\n");
+  fcntl(agent->from_child, F_SETFL, fcntl(agent->from_child, F_GETFL) | O_NONBLOCK);
+  agent->listening = TRUE;
+
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.ptr = agent;
+  if (epoll_ctl(agent_io.epoll_fd, EPOLL_CTL_ADD, agent->from_child, &event) != 0)
+  {
+    AGENT_ERROR("unable to add agent to io loop: %s", strerror(errno));
+    agent->listening = FALSE;
+    agent_kill(agent);
+  }
+}
+
+/**
+ * @brief Waits until the agent io thread has stopped listening to an agent.
+ *
+ * Called by the main thread before it frees an agent, after it has written
+ * "@@@1" to the pipe of the agent.
+ *
+ * @param agent the agent to wait for
+ */
+static void agent_io_wait(agent_t* agent)
+{
+  AGENT_IO_LOCK();
+  while (agent->listening)
+    AGENT_IO_WAIT();
+  AGENT_IO_UNLOCK();
 }
 
 /**
@@ -603,20 +1017,63 @@ static void shell_parse(char* confdir, int user_id, int group_id, char* input, c
   (*argv)[idx++] = g_strdup_printf("--config=%s", confdir);
   (*argv)[idx++] = g_strdup_printf("--userID=%d", user_id);
   (*argv)[idx++] = g_strdup_printf("--groupID=%d", group_id);
-  (*argv)[idx++] = "--scheduler_start";
+  (*argv)[idx++] = g_strdup("--scheduler_start");
   if (jq_cmd_args)
     (*argv)[idx++] = jq_cmd_args;
   (*argc) = idx;
 }
 
 /**
- * For the agent_spawn() function.
+ * @brief Starts a remote agent through the launcher of its host.
+ *
+ * The launcher of the host is started the first time it is needed. The agent
+ * gets the arguments that a local agent would get, with the paths of the host.
+ *
+ * @param scheduler  the scheduler the agent belongs to
+ * @param agent      the new agent
+ * @return TRUE if the launcher started the agent, FALSE if ssh has to be used
  */
-typedef struct
+static gboolean agent_launch(scheduler_t* scheduler, agent_t* agent)
 {
-  scheduler_t* scheduler; ///< Reference to current scheduler state
-  agent_t* agent;         ///< Reference to current agent state
-} agent_spawn_args;
+  host_t* host = agent->host;
+  gchar* cmd[4];
+  gchar* raw;
+  gchar* tmp;
+  gchar** args;
+  gboolean ready;
+  int argc, i;
+
+  if (host->launcher == NULL)
+    host->launcher = launcher_init(host->name);
+
+  cmd[0] = "/usr/bin/ssh";
+  cmd[1] = host->address;
+  cmd[2] = g_strdup_printf(AGENT_BINARY, host->agent_dir, AGENT_CONF, "scheduler", "fo_launcher");
+  cmd[3] = NULL;
+  ready = launcher_ready(host->launcher, cmd);
+  g_free(cmd[2]);
+  if (!ready)
+    return FALSE;
+
+  /* shell_parse() changes the string it parses */
+  raw = g_strdup(agent->type->raw_cmd);
+  shell_parse(host->agent_dir, agent->owner->user_id, agent->owner->group_id,
+              raw, agent->owner->jq_cmd_args, agent->owner->parent_id, &argc, &args);
+  tmp = args[0];
+  args[0] = g_strdup_printf(AGENT_BINARY, host->agent_dir, AGENT_CONF, agent->type->name, tmp);
+  g_free(tmp);
+
+  agent->pid = launcher_spawn(host->launcher, agent->from_parent, agent->to_parent,
+      agent->owner->priority, args);
+
+  for (i = 0; i < argc; i++)
+    if (args[i] != agent->owner->jq_cmd_args)
+      g_free(args[i]);
+  g_free(args);
+  g_free(raw);
+
+  return agent->pid != 0;
+}
 
 /**
  * @brief Spawns a new agent using the command passed in using the meta agent.
@@ -631,23 +1088,34 @@ typedef struct
  *   agent. It will then call exec to start the new agent process
  *
  * @b parent:
- *   This will enter the listen function, and wait for information from the
- *   child, either as a failure or as an update for the information being
- *   analyzed
+ *   This will register the pipe from the child with the agent io loop, which
+ *   waits for information from the child, either as a failure or as an update
+ *   for the information being analyzed
  *
- * @param pass  a pointer to scheduler_t and the new agent_t
+ * An agent on a remote host is started by the launcher of the host instead,
+ * see agent_launch(). Only if that fails is ssh started for the agent.
+ *
+ * @param scheduler  the scheduler the agent belongs to
+ * @param agent      the new agent
  */
-static void* agent_spawn(agent_spawn_args* pass)
+static void agent_spawn(scheduler_t* scheduler, agent_t* agent)
 {
   /* locals */
-  scheduler_t* scheduler = pass->scheduler;
-  agent_t* agent = pass->agent;
   gchar* tmp;                 // pointer to temporary string
   gchar** args;               // the arguments that will be passed to the child
   int argc;                   // the number of arguments parsed
   int len;
   char buffer[2048];          // character buffer
 
+  /* the agent is created before the main thread can see it die */
+  event_signal_priority(agent_create_event, agent, EVENT_HIGH);
+
+  if (CONF_launcher && strcmp(agent->host->address, LOCAL_HOST) != 0 && agent_launch(scheduler, agent))
+  {
+    agent_io_add(scheduler, agent);
+    return;
+  }
+
   /* spawn the new process */
   while ((agent->pid = fork()) < 0)
     sleep(rand() % CONF_fork_backoff_time);
@@ -721,15 +1189,169 @@ static void* agent_spawn(agent_spawn_args* pass)
     /* If we reach here, the exec call has failed */
     log_printf("ERROR %s.%d: JOB[%d.%s]: exec failed: pid = %d, errno = \"%s\"", __FILE__, __LINE__, agent->owner->id,
         agent->owner->agent_type, getpid(), strerror(errno));
+    exit(5);
   }
   /* we are in the parent */
   else
   {
-    event_signal(agent_create_event, agent);
-    agent_listen(scheduler, agent);
+    agent_io_add(scheduler, agent);
   }
+}
 
-  return NULL;
+/**
+ * @brief The resident memory of a local agent in bytes.
+ *
+ * @param agent the agent to check
+ * @return the resident memory, 0 if it is unknown
+ */
+static uint64_t agent_rss(agent_t* agent)
+{
+  gchar* path;
+  gchar* contents = NULL;
+  unsigned long size, resident = 0;
+
+  if (strcmp(agent->host->address, LOCAL_HOST) != 0 || agent->pid < 0)
+    return 0;
+
+  path = g_strdup_printf("/proc/%d/statm", agent->pid);
+  if (g_file_get_contents(path, &contents, NULL, NULL) &&
+      sscanf(contents, "%lu %lu", &size, &resident) != 2)
+    resident = 0;
+  g_free(contents);
+  g_free(path);
+
+  return (uint64_t) resident * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * @brief Reads how many processes the out of memory killer of the local
+ *        system has killed since boot.
+ *
+ * @return the count from /proc/vmstat, -1 if it cannot be read
+ */
+static int64_t agent_oom_kills()
+{
+  gchar* contents = NULL;
+  gchar* line;
+  int64_t kills = -1;
+
+  if (g_file_get_contents("/proc/vmstat", &contents, NULL, NULL) &&
+      (line = strstr(contents, "\noom_kill ")) != NULL)
+    kills = g_ascii_strtoll(line + 10, NULL, 10);
+  g_free(contents);
+
+  return kills;
+}
+
+/**
+ * @brief Decides if an agent that got a SIGKILL from someone other than the
+ *        scheduler was killed for lack of memory.
+ *
+ * A SIGKILL can also come from an administrator, so there has to be evidence
+ * of the out of memory killer. On the local host the kill counter of the
+ * kernel must have grown while the agent ran. Remote hosts cannot be asked,
+ * there the agent must have grown close to the memory budget of the host.
+ *
+ * @param agent  the agent that was killed
+ * @return TRUE if the agent likely ran out of memory
+ */
+static gboolean agent_oom_evidence(agent_t* agent)
+{
+  int64_t kills;
+
+  if (agent->oom_kills >= 0 && (kills = agent_oom_kills()) >= 0)
+    return kills > agent->oom_kills;
+
+  return agent->host->budget > 0 && (uint64_t) agent->rss * 10 >= (uint64_t) agent->host->budget * 9;
+}
+
+/**
+ * @brief Learns how much memory agents of a type use from one that is gone.
+ *
+ * The estimate follows a larger peak at once and goes down slowly after
+ * smaller ones, never below what the agent's configuration declares. An agent
+ * that ran out of memory doubles the estimate, but never beyond the largest
+ * memory budget of a host, so the agent type stays schedulable.
+ *
+ * @param type  the type of the agent
+ * @param peak  the largest resident memory in MB the agent reported, 0 if none
+ * @param oom   the agent was killed for lack of memory
+ * @param cap   the largest memory budget of a host in MB, 0 for no limit
+ */
+static void meta_agent_learn_memory(meta_agent_t* type, uint32_t peak, gboolean oom, uint32_t cap)
+{
+  if (oom)
+    type->memory = MIN((uint64_t) MAX(type->memory, peak) * 2, UINT32_MAX);
+  else if (peak > type->memory)
+    type->memory = peak;
+  else if (peak > 0)
+    type->memory = (3 * (uint64_t) type->memory + peak) / 4;
+
+  if (cap > 0)
+    type->memory = MIN(type->memory, cap);
+  type->memory = MAX(type->memory, type->memory_min);
+}
+
+/**
+ * @brief Gives a job to an idle agent from the pool of the host.
+ *
+ * The agent learns about its new job from a "JOB <job> <user> <group>" line
+ * and then asks for data like a newly started agent. Only jobs without extra
+ * command line arguments can use an idle agent, since its arguments are the
+ * ones it was started with.
+ *
+ * @param scheduler  the scheduler the agent belongs to
+ * @param host       the host the job should run on
+ * @param job        the job that needs an agent
+ * @return the agent, NULL if there is no idle agent for the job
+ */
+static agent_t* agent_pool_take(scheduler_t* scheduler, host_t* host, job_t* job)
+{
+  meta_agent_t* type = g_tree_lookup(scheduler->meta_agents, job->agent_type);
+  agent_t* agent = NULL;
+  gboolean listening = FALSE;
+  GList* iter;
+
+  if (job->id <= 0 || job->jq_cmd_args != NULL)
+    return NULL;
+
+  for (iter = host->pool; iter != NULL && !listening; iter = iter->next)
+  {
+    agent = iter->data;
+    AGENT_IO_LOCK();
+    listening = (agent->type == type && agent->listening);
+    AGENT_IO_UNLOCK();
+  }
+  if (!listening)
+    return NULL;
+
+  host->pool = g_list_remove(host->pool, agent);
+  agent->owner = job;
+  agent->n_jobs++;
+  agent->data = NULL;
+  agent->chunk = NULL;
+  agent->n_updates = 0;
+  agent->total_analyzed = 0;
+  agent->check_in = time(NULL);
+
+  METRICS_LOCK();
+  g_tree_destroy(agent->metrics);
+  agent->metrics = metrics_init();
+  METRICS_UNLOCK();
+
+  /* leaving the paused state puts the load back on the host */
+  agent_transition(agent, AG_RUNNING);
+  job_add_agent(job, agent);
+  job->n_agents++;
+
+  if (!agent_priority(agent, job->priority))
+    AGENT_SEQUENTIAL_PRINT("unable to set priority: %s\n", strerror(errno));
+  AGENT_SEQUENTIAL_PRINT("idle agent taken from the pool, job %d\n", agent->n_jobs);
+
+  aprintf(agent, "JOB %d %d %d\n", job->parent_id, job->user_id, job->group_id);
+  event_signal_priority(agent_ready_event, agent, EVENT_HIGH);
+
+  return agent;
 }
 
 /* ************************************************************************** */
@@ -779,6 +1401,9 @@ meta_agent_t* meta_agent_init(char* name, char* cmd, int max, int spc)
   strcat(ma->raw_cmd, " --scheduler_start");
   ma->max_run = max;
   ma->run_count = 0;
+  ma->weight = 1;
+  ma->memory = 0;
+  ma->memory_min = 0;
   ma->special = spc;
   ma->version = NULL;
   ma->valid = TRUE;
@@ -816,7 +1441,6 @@ agent_t* agent_init(scheduler_t* scheduler, host_t* host, job_t* job)
   agent_t* agent;
   int child_to_parent[2];
   int parent_to_child[2];
-  agent_spawn_args* pass;
 
   /* check job input */
   if (!job)
@@ -837,6 +1461,10 @@ agent_t* agent_init(scheduler_t* scheduler, host_t* host, job_t* job)
     return NULL;
   }
 
+  /* an idle agent of the same type needs no new process */
+  if ((agent = agent_pool_take(scheduler, host, job)) != NULL)
+    return agent;
+
   /* allocate memory and do trivial assignments */
   agent = g_new(agent_t, 1);
   agent->type = g_tree_lookup(scheduler->meta_agents, job->agent_type);
@@ -879,20 +1507,29 @@ agent_t* agent_init(scheduler_t* scheduler, host_t* host, job_t* job)
   /* initialize other info */
   agent->host = host;
   agent->owner = job;
-  agent->updated = 0;
   agent->n_updates = 0;
   agent->data = NULL;
+  agent->chunk = NULL;
   agent->return_code = -1;
   agent->total_analyzed = 0;
   agent->special = 0;
+  agent->n_jobs = 1;
+  agent->memory = agent->type->memory;
+  agent->rss = 0;
+  agent->killed = FALSE;
+  agent->oom_kills = strcmp(host->address, LOCAL_HOST) == 0 ? agent_oom_kills() : -1;
+
+  agent->read_len = 0;
+  agent->versioned = FALSE;
+  agent->listening = FALSE;
+
+  /* the agent only needs its own ends of the pipes, dup2() clears the flag */
+  fcntl(agent->from_parent, F_SETFD, FD_CLOEXEC);
+  fcntl(agent->to_child, F_SETFD, FD_CLOEXEC);
+  fcntl(agent->from_child, F_SETFD, FD_CLOEXEC);
+  fcntl(agent->to_parent, F_SETFD, FD_CLOEXEC);
 
   /* open the relevant file pointers */
-  if ((agent->read = fdopen(agent->from_child, "r")) == NULL)
-  {
-    ERROR("JOB[%d.%s] failed to initialize read file", job->id, job->agent_type);
-    g_free(agent);
-    return NULL;
-  }
   if ((agent->write = fdopen(agent->to_child, "w")) == NULL)
   {
     ERROR("JOB[%d.%s] failed to initialize write file", job->id, job->agent_type);
@@ -900,23 +1537,21 @@ agent_t* agent_init(scheduler_t* scheduler, host_t* host, job_t* job)
     return NULL;
   }
 
+  agent->metrics = metrics_init();
+
   /* increase the load on the host and count of running agents */
   if (agent->owner->id > 0)
   {
-    host_increase_load(agent->host);
+    host_increase_load(agent->host, agent->type->weight);
     meta_agent_increase_count(agent->type);
   }
 
-  /* spawn the listen thread */
-  pass = g_new0(agent_spawn_args, 1);
-  pass->scheduler = scheduler;
-  pass->agent = agent;
+  /* a stopped or idle agent keeps its memory, it is released once it is gone */
+  host_reserve(agent->host, agent->memory);
 
-#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
-  agent->thread = g_thread_new(agent->type->name, (GThreadFunc) agent_spawn, pass);
-#else
-  agent->thread = g_thread_create((GThreadFunc)agent_spawn, pass, 1, NULL);
-#endif
+  /* spawn the agent process */
+  agent_spawn(scheduler, agent);
+  job->n_agents++;
 
   return agent;
 }
@@ -942,9 +1577,9 @@ void agent_destroy(agent_t* agent)
   close(agent->from_parent);
   close(agent->to_parent);
   fclose(agent->write);
-  fclose(agent->read);
 
   /* release the child process */
+  g_tree_destroy(agent->metrics);
   g_free(agent);
 }
 
@@ -964,21 +1599,56 @@ void agent_death_event(scheduler_t* scheduler, pid_t* pid)
 {
   agent_t* agent;
   int status = pid[1];
+  gboolean oom;
 
   if ((agent = g_tree_lookup(scheduler->agents, &pid[0])) == NULL)
   {
-    ERROR("invalid agent death event: pid[%d]", pid[0]);
+    if (!host_launcher_exited(scheduler->host_list, pid[0], status) &&
+        !email_exited(pid[0], status))
+      ERROR("invalid agent death event: pid[%d]", pid[0]);
+    g_free(pid);
     return;
   }
 
-  if (agent->owner->id >= 0)
-    event_signal(database_update_event, NULL);
+  host_reserve(agent->host, -(int)agent->memory);
+
+  /* an idle agent only has to leave the pool */
+  if (agent->owner == &agent_pool_job)
+  {
+    agent->host->pool = g_list_remove(agent->host->pool, agent);
+    if (write(agent->to_parent, "@@@1\n", 5) != 5)
+      AGENT_SEQUENTIAL_PRINT("write to agent unsuccessful: %s\n", strerror(errno));
+    agent_io_wait(agent);
+
+    AGENT_SEQUENTIAL_PRINT("idle agent removed from the system\n");
+    g_tree_remove(scheduler->agents, &agent->pid);
+    g_free(pid);
+    return;
+  }
 
   if (write(agent->to_parent, "@@@1\n", 5) != 5)
     AGENT_SEQUENTIAL_PRINT("write to agent unsuccessful: %s\n", strerror(errno));
-  g_thread_join(agent->thread);
+  agent_io_wait(agent);
+
+  /* keep the totals of the agent once it is gone */
+  if (agent->owner->metrics)
+    agent_fold_metrics(agent, agent->owner->metrics, FALSE);
+  if (agent->owner->id >= 0)
+    stats_agent_items(agent->type->name, agent->total_analyzed);
 
-  if (agent->return_code != 0)
+  /* a SIGKILL that the scheduler did not send may come from the kernel's out
+   * of memory killer, the job is then run again once a host has room for it */
+  oom = agent->return_code != 0 && WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL && !agent->killed &&
+      agent_oom_evidence(agent);
+  meta_agent_learn_memory(agent->type, agent->rss, oom, host_max_budget(scheduler->host_list));
+
+  if (oom && job_requeue(scheduler, agent->owner, agent))
+  {
+    AGENT_WARNING("agent was killed, likely out of memory, its work is queued again");
+    stats_agent_failed(agent->type->name);
+    stats_agent_restarted(agent->type->name);
+  }
+  else if (agent->return_code != 0)
   {
     if (WIFEXITED(status))
     {
@@ -998,9 +1668,14 @@ void agent_death_event(scheduler_t* scheduler, pid_t* pid)
     agent_fail_event(scheduler, agent);
   }
 
+  /* an agent that quit cleanly without asking for more data is done with its chunk */
+  if (agent->return_code == 0)
+    job_chunk_done(agent->owner, agent);
+
   if (agent->status != AG_PAUSED && agent->status != AG_FAILED)
     agent_transition(agent, AG_PAUSED);
 
+  agent->owner->n_agents--;
   job_update(scheduler, agent->owner);
   if (agent->status == AG_FAILED && agent->owner->id < 0)
   {
@@ -1052,6 +1727,7 @@ void agent_create_event(scheduler_t* scheduler, agent_t* agent)
  */
 void agent_ready_event(scheduler_t* scheduler, agent_t* agent)
 {
+  job_t* job;
   int ret;
 
   TEST_NULV(agent);
@@ -1061,11 +1737,25 @@ void agent_ready_event(scheduler_t* scheduler, agent_t* agent)
     AGENT_SEQUENTIAL_PRINT("agent successfully created\n");
   }
 
+  /* the agent has finished its chunk, if the job is paused it asks again on restart */
+  job_chunk_done(agent->owner, agent);
+  if (agent->status == AG_PAUSED)
+    return;
+
+  /* a preempted runonpfile job stops its agents here, see job_preempt() */
+  if (agent->owner->status == JB_PAUSED && agent->owner->chunks != NULL)
+  {
+    agent_transition(agent, AG_PAUSED);
+    return;
+  }
+
   if ((ret = job_is_open(scheduler, agent->owner)) == 0)
   {
+    job = agent->owner;
     agent_transition(agent, AG_PAUSED);
-    job_finish_agent(agent->owner, agent);
-    job_update(scheduler, agent->owner);
+    job_finish_agent(job, agent);
+    job_update(scheduler, job);
+    job_remove_agent(job, scheduler->job_list, NULL);
     return;
   }
   else if (ret < 0)
@@ -1073,13 +1763,17 @@ void agent_ready_event(scheduler_t* scheduler, agent_t* agent)
     agent_transition(agent, AG_FAILED);
     return;
   }
+  else if (agent->owner->chunks != NULL)
+  {
+    agent->chunk = job_next_chunk(agent->owner);
+    agent->data = agent->chunk->data;
+  }
   else
   {
     agent->data = job_next(agent->owner);
-    agent->updated = 1;
   }
 
-  if (write(agent->to_parent, "@@@0\n", 5) != 5)
+  if (aprintf(agent, "%s\n", agent->data) < 0 || aprintf(agent, "END\n") < 0)
   {
     AGENT_ERROR("failed sending new data to agent");
     agent_kill(agent);
@@ -1105,18 +1799,68 @@ void agent_update_event(scheduler_t* scheduler, void* unused)
  *
  * This will move the agent status to AG_FAILED and send a
  * SIGKILL to the relevant agent. It will also update the agents status within
- * the job that owns it and close the associated communication thread.
+ * the job that owns it and stop listening to the agent.
  *
  * @param scheduler the scheduler to which agent is attached
  * @param agent  the agent that is failing.
  */
 void agent_fail_event(scheduler_t* scheduler, agent_t* agent)
 {
+  gboolean counted;
+
   TEST_NULV(agent);
+
+  counted = agent->status == AG_FAILED || agent->owner->id < 0;
   agent_transition(agent, AG_FAILED);
-  job_fail_agent(agent->owner, agent);
+  if (!counted)
+    stats_agent_failed(agent->type->name);
+
+  if (agent->owner == &agent_pool_job)
+  {
+    agent->host->pool = g_list_remove(agent->host->pool, agent);
+    if (write(agent->to_parent, "@@@1\n", 5) != 5)
+      AGENT_ERROR("Failed to stop listening to agent cleanly");
+    return;
+  }
+
+  /* the chunk of a runonpfile job is given to another agent and the job goes
+   * on, the agent stays with the finished agents until it is gone */
+  if (job_chunk_failed(agent->owner, agent))
+  {
+    job_finish_agent(agent->owner, agent);
+    if (!counted)
+      stats_agent_restarted(agent->type->name);
+  }
+  else if (agent->owner->chunks == NULL || !g_list_find(agent->owner->finished_agents, agent))
+    job_fail_agent(agent->owner, agent);
+
   if (write(agent->to_parent, "@@@1\n", 5) != 5)
-    AGENT_ERROR("Failed to kill agent thread cleanly");
+    AGENT_ERROR("Failed to stop listening to agent cleanly");
+}
+
+/**
+ * @brief Event created when an agent reported a larger resident memory.
+ *
+ * An agent that uses more memory than was reserved for it on its host gets
+ * the difference reserved as well, so that no other agent is started into
+ * the memory it uses. What an agent type uses is learned once its agents are
+ * gone, see agent_death_event().
+ *
+ * @param scheduler the scheduler to which agent is attached
+ * @param agent     the agent that reported its memory
+ */
+void agent_memory_event(scheduler_t* scheduler, agent_t* agent)
+{
+  uint32_t rss;
+
+  TEST_NULV(agent);
+
+  rss = agent->rss;
+  if (rss <= agent->memory)
+    return;
+
+  host_reserve(agent->host, rss - agent->memory);
+  agent->memory = rss;
 }
 
 /**
@@ -1153,12 +1897,12 @@ void agent_transition(agent_t* agent, agent_status new_status)
   {
     if (agent->status == AG_PAUSED)
     {
-      host_increase_load(agent->host);
+      host_increase_load(agent->host, agent->type->weight);
       meta_agent_increase_count(agent->type);
     }
     if (new_status == AG_PAUSED)
     {
-      host_decrease_load(agent->host);
+      host_decrease_load(agent->host, agent->type->weight);
       meta_agent_decrease_count(agent->type);
     }
   }
@@ -1174,7 +1918,7 @@ void agent_transition(agent_t* agent, agent_status new_status)
  */
 void agent_pause(agent_t* agent)
 {
-  kill(agent->pid, SIGSTOP);
+  agent_signal(agent, SIGSTOP);
   agent_transition(agent, AG_PAUSED);
 }
 
@@ -1187,7 +1931,7 @@ void agent_pause(agent_t* agent)
  */
 void agent_unpause(agent_t* agent)
 {
-  kill(agent->pid, SIGCONT);
+  agent_signal(agent, SIGCONT);
   agent_transition(agent, AG_RUNNING);
 }
 
@@ -1223,6 +1967,80 @@ void agent_print_status(agent_t* agent, GOutputStream* ostr)
   return;
 }
 
+/**
+ * @brief Prints the metrics sent by an agent to the output stream.
+ *
+ * The output will be in this format:
+ *   agent:<pid> job:<id> host:<host> type:<type> items:<# processed> [<name>:<value> [<name>/s:<rate>]]...
+ *
+ * @param agent the agent to print the metrics for
+ * @param ostr  the output stream to write to
+ */
+void agent_print_metrics(agent_t* agent, GOutputStream* ostr)
+{
+  GString* str;
+
+  TEST_NULV(agent);
+  TEST_NULV(ostr);
+
+  str = g_string_new(NULL);
+  g_string_printf(str, "agent:%d job:%d host:%s type:%s items:%" G_GUINT64_FORMAT, agent->pid,
+      agent->owner ? agent->owner->id : 0, agent->host->name, agent->type->name, agent->total_analyzed);
+  METRICS_LOCK();
+  metrics_print(agent->metrics, str);
+  METRICS_UNLOCK();
+  g_string_append(str, "\n");
+
+  g_output_stream_write(ostr, str->str, str->len, NULL, NULL);
+  g_string_free(str, TRUE);
+}
+
+/**
+ * @brief Adds the metrics of an agent to an other set of metrics.
+ *
+ * This is used to aggregate metrics per job and host. When live is FALSE only
+ * the counters totals are added, this is used to keep the work of an agent
+ * in its job after the agent is gone.
+ *
+ * @param agent the agent to take the metrics from
+ * @param into  the metrics to add to, created with metrics_init()
+ * @param live  if gauges and rates should be added as well
+ */
+void agent_fold_metrics(agent_t* agent, GTree* into, gboolean live)
+{
+  arg_int params;
+
+  TEST_NULV(agent);
+
+  params.first = into;
+  params.second = live;
+
+  METRICS_LOCK();
+  g_tree_foreach(agent->metrics, (GTraverseFunc) agent_metric_fold, &params);
+  METRICS_UNLOCK();
+}
+
+/**
+ * @brief Creates an empty set of metrics, keyed by name.
+ *
+ * @return the new GTree, free it with g_tree_destroy()
+ */
+GTree* metrics_init()
+{
+  return g_tree_new_full(string_compare, NULL, g_free, g_free);
+}
+
+/**
+ * @brief Appends a set of metrics to a string, see agent_print_metrics().
+ *
+ * @param metrics the metrics to print
+ * @param str     the string to append to
+ */
+void metrics_print(GTree* metrics, GString* str)
+{
+  g_tree_foreach(metrics, (GTraverseFunc) agent_metric_print, str);
+}
+
 /**
  * @brief Unclean kill of an agent.
  *
@@ -1234,8 +2052,39 @@ void agent_print_status(agent_t* agent, GOutputStream* ostr)
 void agent_kill(agent_t* agent)
 {
   AGENT_SEQUENTIAL_PRINT("KILL: sending SIGKILL to pid %d\n", agent->pid);
+  agent->killed = TRUE;
   meta_agent_decrease_count(agent->type);
-  kill(agent->pid, SIGKILL);
+  agent_signal(agent, SIGKILL);
+}
+
+/**
+ * Sends a signal to the process of an agent, through the launcher of its host
+ * if it was started by one.
+ *
+ * @param agent  the agent to signal
+ * @param signo  the signal to send
+ * @return TRUE if the signal was sent
+ */
+gboolean agent_signal(agent_t* agent, int signo)
+{
+  if (agent->pid < 0)
+    return agent->host->launcher != NULL && launcher_signal(agent->host->launcher, agent->pid, signo);
+  return kill(agent->pid, signo) == 0;
+}
+
+/**
+ * Changes the priority of the process of an agent, through the launcher of
+ * its host if it was started by one.
+ *
+ * @param agent     the agent to change
+ * @param priority  the new nice value
+ * @return TRUE if the priority was changed
+ */
+gboolean agent_priority(agent_t* agent, int priority)
+{
+  if (agent->pid < 0)
+    return agent->host->launcher != NULL && launcher_priority(agent->host->launcher, agent->pid, priority);
+  return setpriority(PRIO_PROCESS, agent->pid, priority) == 0;
 }
 
 /**
@@ -1272,10 +2121,10 @@ int aprintf(agent_t* agent, const char* fmt, ...)
 }
 
 /**
- * Write information to the communication thread for the agent. This is used
- * when the scheduler needs to wake up or kill the thread used to talk to the
- * agent. When using this function, one should always print "@@@..." where ...
- * is the message that is actually getting sent.
+ * Write information to the agent io thread as if the agent had sent it. This
+ * is used when the scheduler needs to wake up or stop listening to the agent.
+ * When using this function, one should always print "@@@..." where ... is the
+ * message that is actually getting sent.
  *
  * @param agent the agent to send the information to
  * @param buf the actual data
@@ -1314,6 +2163,124 @@ void kill_agents(scheduler_t* scheduler)
   g_tree_foreach(scheduler->agents, (GTraverseFunc) agent_kill_traverse, NULL);
 }
 
+/**
+ * @brief Keeps an agent whose job has completed for the next job of its type.
+ *
+ * Only agents whose meta agent has the POOL special are kept, and only up to
+ * agent_pool_size of every type on a host. An agent is not kept once it has
+ * run agent_pool_jobs jobs or its resident memory has grown beyond
+ * agent_pool_memory MB, so that leaks in long running agents do not add up.
+ * The agent is removed from its job and belongs to the pool until
+ * agent_pool_take() gives it a new job.
+ *
+ * @param scheduler  the scheduler the agent belongs to
+ * @param agent      a finished agent of a completed job
+ * @return TRUE if the agent was kept, FALSE if it should be closed
+ */
+gboolean agent_pool_add(scheduler_t* scheduler, agent_t* agent)
+{
+  job_t* job = agent->owner;
+  gboolean listening;
+  uint32_t idle = 0;
+  GList* iter;
+
+  if (CONF_agent_pool_size == 0 || !is_meta_special(agent->type, SAG_POOL) ||
+      is_meta_special(agent->type, SAG_EXCLUSIVE) || !agent->type->valid)
+    return FALSE;
+
+  if (agent->status != AG_PAUSED || job->id <= 0 || job->jq_cmd_args != NULL ||
+      job->status != JB_COMPLETE)
+    return FALSE;
+
+  if (agent->n_jobs >= CONF_agent_pool_jobs)
+  {
+    AGENT_SEQUENTIAL_PRINT("agent has run %d jobs, replacing it\n", agent->n_jobs);
+    return FALSE;
+  }
+
+  if (CONF_agent_pool_memory > 0 && agent_rss(agent) > (uint64_t) CONF_agent_pool_memory << 20)
+  {
+    AGENT_SEQUENTIAL_PRINT("agent uses more than %d MB, replacing it\n", CONF_agent_pool_memory);
+    return FALSE;
+  }
+
+  for (iter = agent->host->pool; iter != NULL; iter = iter->next)
+    if (((agent_t*) iter->data)->type == agent->type)
+      idle++;
+  if (idle >= CONF_agent_pool_size)
+    return FALSE;
+
+  AGENT_IO_LOCK();
+  listening = agent->listening;
+  AGENT_IO_UNLOCK();
+  if (!listening)
+    return FALSE;
+
+  /* keep the totals of the agent with the job it worked for */
+  agent_fold_metrics(agent, job->metrics, FALSE);
+  if (job->id >= 0)
+    stats_agent_items(agent->type->name, agent->total_analyzed);
+
+  job->finished_agents = g_list_remove(job->finished_agents, agent);
+  job->n_agents--;
+
+  AGENT_SEQUENTIAL_PRINT("agent kept in the pool\n");
+  agent->owner = &agent_pool_job;
+  agent->data = NULL;
+  agent->chunk = NULL;
+  agent->host->pool = g_list_append(agent->host->pool, agent);
+
+  return TRUE;
+}
+
+/**
+ * @brief Closes every idle agent in the pool.
+ *
+ * Used when the scheduler is closing, before an exclusive agent runs and
+ * before the configuration is reloaded. The agents stay in the system until
+ * their process is gone.
+ *
+ * @param scheduler the scheduler the pools belong to
+ */
+void agent_pool_drain(scheduler_t* scheduler)
+{
+  GList* host;
+  GList* iter;
+
+  for (host = scheduler->host_queue; host != NULL; host = host->next)
+  {
+    for (iter = ((host_t*) host->data)->pool; iter != NULL; iter = iter->next)
+      aprintf(iter->data, "CLOSE\n");
+    g_list_free(((host_t*) host->data)->pool);
+    ((host_t*) host->data)->pool = NULL;
+  }
+}
+
+/**
+ * @brief Stops the agent io thread and closes its epoll instance.
+ *
+ * Used when the scheduler is destroyed. The thread is created again when the
+ * next agent is spawned.
+ */
+void agent_io_destroy()
+{
+  uint64_t wake = 1;
+
+  if (agent_io.thread == NULL)
+    return;
+
+  if (write(agent_io.wake_fd, &wake, sizeof(wake)) != sizeof(wake))
+    ERROR("unable to stop the agent io thread: %s", strerror(errno));
+  g_thread_join(agent_io.thread);
+
+  close(agent_io.epoll_fd);
+  close(agent_io.wake_fd);
+#if !(GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32)
+  g_cond_free(agent_io.cond);
+#endif
+  agent_io.thread = NULL;
+}
+
 /**
  * Creates a new meta agent and adds it to the list of meta agents. This will
  * parse the shell command that will start the agent process.
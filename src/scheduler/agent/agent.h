@@ -38,6 +38,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define MAX_NAME    255  ///< the size of the agent's name buffer    (arbitrary)
 #define MAX_ARGS    32   ///< the size of the argument buffer        (arbitrary)
 #define DEFAULT_RET -1   ///< default return code                    (arbitrary)
+#define MAX_METRICS 32   ///< the number of metrics kept per agent   (arbitrary)
+#define MAX_LINE    1024 ///< the size of a line read from an agent  (arbitrary)
 
 #define LOCAL_HOST "localhost"
 
@@ -45,6 +47,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define SAG_EXCLUSIVE  (1 << 1) ///< This agent must not run at the same time as any other agent
 #define SAG_NOEMAIL    (1 << 2) ///< This agent should not send notification emails
 #define SAG_LOCAL      (1 << 3) ///< This agent should only run on localhost
+#define SAG_POOL       (1 << 4) ///< Idle agents of this type are kept for the next job
+#define SAG_INTERACTIVE (1 << 5) ///< Jobs of this agent are waited for in the UI, see scheduler_preempt()
 
 /**
  * \file
@@ -99,6 +103,9 @@ typedef struct
     char* version;              ///< the version of the agent that is running on all hosts
     int valid;                  ///< flag indicating if the meta_agent is valid
     int run_count;              ///< the count of agents in running state
+    uint32_t weight;            ///< how much of a host one agent uses, see get_host()
+    uint32_t memory;            ///< the memory in MB one agent is expected to use, see host_fits()
+    uint32_t memory_min;        ///< the memory in MB declared in the agent's configuration
 } meta_agent_t;
 
 /**
@@ -113,9 +120,8 @@ typedef struct
     meta_agent_t* type; ///< the type of agent this is i.e. bucket, copyright...
     host_t*       host; ///< the host that this agent will start on
 
-    /* thread management */
+    /* process management */
     agent_status status;    ///< the state of execution the agent is currently in
-    GThread*     thread;    ///< the thread that communicates with this agent
     time_t       check_in;  ///< the time that the agent last generated anything
     uint8_t      n_updates; ///< keeps track of the number of times the agent has updated
     pid_t        pid;       ///< the pid of the process this agent is running in
@@ -123,21 +129,43 @@ typedef struct
     /* pipes connecting to the child */
     int from_parent;  ///< file identifier to read from the parent (child stdin)
     int to_child;     ///< file identifier to print to the child
-    int from_child;   ///< file identifier to read from child
+    int from_child;   ///< file identifier to read from child, non-blocking
     int to_parent;    ///< file identifier to print to the parent  (child stdout)
-    FILE* read;       ///< FILE* that abstracts the use of the from_child socket
     FILE* write;      ///< FILE* that abstracts the use of the to_child socket
 
+    /* communication, see agent_io_loop() */
+    char     read_buf[MAX_LINE]; ///< the incomplete line last read from the child
+    size_t   read_len;           ///< the number of bytes in read_buf
+    gboolean versioned;          ///< the agent has sent valid version information
+    gboolean listening;          ///< the pipe from the child is still being read
+
     /* data management */
     job_t*   owner;           ///< the job that this agent is assigned to
     gchar*   data;            ///< the data that has been sent to the agent for analysis
-    gboolean updated;         ///< boolean flag to indicate if the scheduler has updated the data
+    job_chunk_t* chunk;       ///< the chunk of a runonpfile job the agent is working on
     uint64_t total_analyzed;  ///< the total number that this agent has analyzed
     gboolean alive;           ///< flag to tell the scheduler if the agent is still alive
     uint8_t  return_code;     ///< what was returned by the agent when it disconnected
     uint32_t special;         ///< any special flags that the agent has set
+    uint32_t n_jobs;          ///< the number of jobs the agent was given, see agent_pool_add()
+    uint32_t memory;          ///< the memory in MB reserved for the agent on its host
+    uint32_t rss;             ///< the largest resident memory in MB the agent reported
+    gboolean killed;          ///< the scheduler sent the agent a SIGKILL
+    int64_t  oom_kills;       ///< the oom kills of the local system when the agent started, -1 if unknown
+    GTree*   metrics;         ///< the METRIC values sent by the agent, keyed by name
 } agent_t;
 
+/**
+ * @brief A counter or gauge sent by an agent with "METRIC:".
+ */
+typedef struct
+{
+    gint64   value; ///< the total for a counter, the last value for a gauge
+    gboolean gauge; ///< TRUE for a gauge, FALSE for a counter
+    double   rate;  ///< change per second of a counter between the last two updates
+    time_t   stamp; ///< when the value was last updated
+} agent_metric;
+
 /* ************************************************************************** */
 /* **** Constructor Destructor ********************************************** */
 /* ************************************************************************** */
@@ -159,13 +187,20 @@ void agent_create_event(scheduler_t* scheduler, agent_t* agent);
 void agent_ready_event(scheduler_t* scheduler, agent_t* agent);
 void agent_update_event(scheduler_t* scheduler, void* unused);
 void agent_fail_event(scheduler_t* scheduler, agent_t* agent);
+void agent_memory_event(scheduler_t* scheduler, agent_t* agent);
 void list_agents_event(scheduler_t* scheduler, GOutputStream* ostr);
 
 void agent_transition(agent_t* agent, agent_status new_status);
 void agent_pause(agent_t* agent);
 void agent_unpause(agent_t* agent);
 void agent_print_status(agent_t* agent, GOutputStream* ostr);
+void agent_print_metrics(agent_t* agent, GOutputStream* ostr);
+void agent_fold_metrics(agent_t* agent, GTree* into, gboolean live);
+GTree* metrics_init();
+void metrics_print(GTree* metrics, GString* str);
 void agent_kill(agent_t* agent);
+gboolean agent_signal(agent_t* agent, int signo);
+gboolean agent_priority(agent_t* agent, int priority);
 int  aprintf(agent_t* agent, const char* fmt, ...);
 ssize_t agent_write(agent_t* agent, const void* buf, int count);
 
@@ -177,6 +212,9 @@ void test_agents(scheduler_t* scheduler);
 int  add_meta_agent(GTree* meta_agents, char* name, char* cmd, int max, int spc);
 
 void kill_agents(scheduler_t* scheduler);
+gboolean agent_pool_add(scheduler_t* scheduler, agent_t* agent);
+void agent_pool_drain(scheduler_t* scheduler);
+void agent_io_destroy();
 
 int  is_meta_special(meta_agent_t* ma, int special_type);
 int  is_agent_special(agent_t* agent, int special_type);
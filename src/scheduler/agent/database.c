@@ -30,6 +30,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 /* all of the sql statements used in the database */
 #include <sqlstatements.h>
@@ -56,18 +61,70 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define DEFAULT_SUBJECT "FOSSology scan complete\n" ///< Default email subject
 #define DEFAULT_COMMAND "/usr/bin/mailx"      ///< Default email command to use
 
+#define EMAIL_RETRY 60 ///< Seconds before a failed notification is tried again
+
 #define min(x, y) (x < y ? x : y)     ///< Return the minimum of x, y
 
 /**
- * We need to pass both a job_t* and the fossology url string to the
+ * A notification waiting for the email thread. It carries a copy of
+ * everything that is needed to send it, since the job is gone and the
+ * configuration may have been reloaded by the time it is sent.
+ */
+typedef struct {
+    int        id;         ///< The jq_pk of the job that finished
+    gchar*     agent_type; ///< The type of agent the job ran
+    job_status status;     ///< The status the job finished with
+    gchar*     text;       ///< The header, message and footer of the email
+    gchar*     foss_url;   ///< Fossology URL string
+    gchar*     command;    ///< The email client
+    gchar*     subject;    ///< The subject of the email
+    GRegex*    parse;      ///< Finds the variables in text, NULL if none
+    guint      tries;      ///< The failed attempts to send it
+    gint64     due;        ///< When to try again, in g_get_monotonic_time()
+} email_request;
+
+/**
+ * We need to pass both a email_request* and the fossology url string to the
  * email_replace() function. This structure allows both of these to be passed.
  */
 typedef struct {
-    scheduler_t* scheduler; ///< Current scheduler reference
     gchar* foss_url;        ///< Fossology URL string
-    job_t* job;             ///< Current job structure
+    email_request* job;     ///< The notification being sent
 } email_replace_args;
 
+/**
+ * The thread that sends the job notifications. Building an email takes
+ * several queries and the email client may take a long time to deliver it,
+ * neither should hold up the scheduler. The thread has its own connection to
+ * the database since a libpq connection cannot be shared between threads.
+ */
+static struct
+{
+    GThread*     thread; ///< The thread sending the notifications
+    GAsyncQueue* queue;  ///< The email_request waiting for the thread
+    gchar*       dbconf; ///< The Db.conf used for the connection
+    PGconn*      conn;   ///< The connection of the thread, NULL if lost
+    gint         pid;    ///< The email client that is running, 0 if none
+    gint         reaped; ///< The main thread collected the email client
+    gint         status; ///< The exit status of the email client if reaped
+    GMutex       lock;   ///< Protects pid and orphans, which the main thread reads
+    GSList*      orphans;///< Killed email clients the main thread has yet to collect
+} email_worker = { NULL, NULL, NULL, NULL, 0, 0, 0 };
+
+static email_request email_stop; ///< Queued to stop the email thread
+
+/**
+ * @brief Executes a sql statement on the connection of the email thread.
+ *
+ * @param sql  the sql to execute
+ * @return the results of the sql statement
+ */
+static PGresult* email_exec(const char* sql)
+{
+  V_SPECIAL("DATABASE: email exec \"%s\"\n", sql);
+  return PQexec(email_worker.conn, sql);
+}
+
 /**
  * @brief Replaces the variables that are in the header and footer files.
  *
@@ -98,7 +155,7 @@ static gboolean email_replace(const GMatchInfo* match, GString* ret,
   gchar* m_str = g_match_info_fetch(match, 1);
   gchar* sql   = NULL;
   gchar* fossy_url = args->foss_url;
-  job_t* job       = args->job;
+  email_request* job = args->job;
   GPtrArray* rows  = NULL;
   /* TODO belongs to $DB if statement => gchar* table, * column; */
   PGresult* db_result;
@@ -112,7 +169,7 @@ static gboolean email_replace(const GMatchInfo* match, GString* ret,
   if(strcmp(m_str, "UPLOADNAME") == 0)
   {
     sql = g_strdup_printf(upload_name, job->id);
-    db_result = database_exec(args->scheduler, sql);
+    db_result = email_exec(sql);
 
     if(PQresultStatus(db_result) != PGRES_TUPLES_OK)
     {
@@ -145,7 +202,7 @@ static gboolean email_replace(const GMatchInfo* match, GString* ret,
   else if(strcmp(m_str, "BROWSELINK") == 0)
   {
     sql = g_strdup_printf(upload_pk, job->id);
-    db_result = database_exec(args->scheduler, sql);
+    db_result = email_exec(sql);
 
     if(PQresultStatus(db_result) != PGRES_TUPLES_OK)
     {
@@ -179,7 +236,7 @@ static gboolean email_replace(const GMatchInfo* match, GString* ret,
   else if(strcmp(m_str, "JOBQUEUELINK") == 0)
   {
     sql = g_strdup_printf(upload_pk, job->id);
-    db_result = database_exec(args->scheduler, sql);
+    db_result = email_exec(sql);
 
     if(PQresultStatus(db_result) != PGRES_TUPLES_OK)
     {
@@ -213,7 +270,7 @@ static gboolean email_replace(const GMatchInfo* match, GString* ret,
   else if(strcmp(m_str, "UPLOADFOLDERNAME") == 0)
   {
     sql = g_strdup_printf(folder_name, job->id);
-    db_result = database_exec(args->scheduler, sql);
+    db_result = email_exec(sql);
 
     if(PQresultStatus(db_result) != PGRES_TUPLES_OK || PQntuples(db_result) == 0)
     {
@@ -229,7 +286,7 @@ static gboolean email_replace(const GMatchInfo* match, GString* ret,
       SafePQclear(db_result);
       g_free(sql);
       sql = g_strdup_printf(parent_folder_name, folder_pk);
-      db_result = database_exec(args->scheduler, sql);
+      db_result = email_exec(sql);
       /*
        * Get the current folder name and traverse back till the root folder.
        * Add the folder names found in an array.
@@ -245,7 +302,7 @@ static gboolean email_replace(const GMatchInfo* match, GString* ret,
         SafePQclear(db_result);
         g_free(sql);
         sql = g_strdup_printf(parent_folder_name, folder_pk);
-        db_result = database_exec(args->scheduler, sql);
+        db_result = email_exec(sql);
       }
       /*
        * Traverse the folder name array from behind and append the names with a
@@ -291,7 +348,7 @@ static gboolean email_replace(const GMatchInfo* match, GString* ret,
   else if(strcmp(m_str, "AGENTSTATUS") == 0)
   {
     sql = g_strdup_printf(jobsql_jobinfo, job->id);
-    db_result = database_exec(args->scheduler, sql);
+    db_result = email_exec(sql);
     if(PQresultStatus(db_result) != PGRES_TUPLES_OK)
     {
       g_string_append_printf(ret,
@@ -366,28 +423,121 @@ static gboolean email_replace(const GMatchInfo* match, GString* ret,
   return FALSE;
 }
 
+/**
+ * \brief Build command to run to send email
+ * \param smtp       The SMTP variables from sysconfig, see smtp_values
+ * \param command    The email client
+ * \param subject    The email subject
+ * \param user_email Email id to send mail to
+ * \return The command to run, NULL if SMTP is not configured
+ */
+static char* email_build_command(PGresult* smtp, gchar* command, gchar* subject,
+    char* user_email)
+{
+  int i;
+  GString* client_cmd;
+  GHashTable* smtpvariables;
+  char* temp_smtpvariable;
+  char* final_command;
+
+  client_cmd = g_string_new("");
+  smtpvariables = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  for(i = 0; i < PQntuples(smtp); i++)
+  {
+    if(PQget(smtp, i, "conf_value")[0])  //Not empty
+    {
+      g_hash_table_insert(smtpvariables, g_strdup(PQget(smtp, i, "variablename")),
+                          g_strdup(PQget(smtp, i, "conf_value")));
+    }
+  }
+  if(g_hash_table_contains(smtpvariables, "SMTPHostName") && g_hash_table_contains(smtpvariables, "SMTPPort"))
+  {
+    g_string_append_printf(client_cmd, " -S smtp=\"%s:%s\"", (char *)g_hash_table_lookup(smtpvariables, "SMTPHostName"),
+        (char *)g_hash_table_lookup(smtpvariables, "SMTPPort"));
+    if(g_hash_table_contains(smtpvariables, "SMTPStartTls"))
+    {
+      temp_smtpvariable = (char *)g_hash_table_lookup(smtpvariables, "SMTPStartTls");
+      if(g_strcmp0(temp_smtpvariable, "1") == 0)
+      {
+        g_string_append_printf(client_cmd, " -S smtp-use-starttls");
+      }
+    }
+    if(g_hash_table_contains(smtpvariables, "SMTPAuth"))
+    {
+      temp_smtpvariable = (char *)g_hash_table_lookup(smtpvariables, "SMTPAuth");
+      if(g_strcmp0(temp_smtpvariable, "L") == 0)
+      {
+        g_string_append_printf(client_cmd, " -S smtp-auth=login");
+      }
+      else if(g_strcmp0(temp_smtpvariable, "P") == 0)
+      {
+        g_string_append_printf(client_cmd, " -S smtp-auth=plain");
+      }
+    }
+    if(g_hash_table_contains(smtpvariables, "SMTPAuthUser"))
+    {
+      g_string_append_printf(client_cmd, " -S smtp-auth-user=\"%s\" -S from=\"%s\"",
+          (char *)g_hash_table_lookup(smtpvariables, "SMTPAuthUser"),
+          (char *)g_hash_table_lookup(smtpvariables, "SMTPAuthUser"));
+    }
+    if(g_hash_table_contains(smtpvariables, "SMTPAuthPasswd"))
+    {
+      g_string_append_printf(client_cmd, " -S smtp-auth-password=\"%s\"",
+         (char *)g_hash_table_lookup(smtpvariables, "SMTPAuthPasswd"));
+    }
+    if(g_hash_table_contains(smtpvariables, "SMTPSslVerify"))
+    {
+      temp_smtpvariable = (char *)g_hash_table_lookup(smtpvariables, "SMTPSslVerify");
+      g_string_append(client_cmd, " -S ssl-verify=");
+      if(g_strcmp0(temp_smtpvariable, "I") == 0)
+      {
+        g_string_append(client_cmd, "ignore");
+      }
+      else if(g_strcmp0(temp_smtpvariable, "S") == 0)
+      {
+        g_string_append(client_cmd, "strict");
+      }
+      else if(g_strcmp0(temp_smtpvariable, "W") == 0)
+      {
+        g_string_append(client_cmd, "warn");
+      }
+    }
+    temp_smtpvariable = NULL;
+    final_command = g_strdup_printf(EMAIL_BUILD_CMD, command,
+                  client_cmd->str, subject, user_email);
+  }
+  else
+  {
+    NOTIFY("Unable to send email. SMTP host or port not found in the configuration.\n"
+        "Please check Configuration Variables.");
+    final_command = NULL;
+  }
+  g_hash_table_destroy(smtpvariables);
+  g_string_free(client_cmd, TRUE);
+  return final_command;
+}
+
 /**
  * @brief Checks the database for the status of the job
  *
- * @param scheduler Current scheduler reference
- * @param job       The job to check for the job status on
- * @return 0: job is not finished, 1: job has finished, 2: job has failed
+ * @param email  The notification for the job
+ * @return 0: job is not finished, 1: job has finished, 2: job has failed,
+ *         -1: the database could not be queried
  */
-static gint email_checkjobstatus(scheduler_t* scheduler, job_t* job)
+static gint email_checkjobstatus(email_request* email)
 {
   gchar* sql;
   gint ret = 1;
   PGresult* db_result;
-  int id, i;
+  int i;
 
-  sql = g_strdup_printf(jobsql_anyrunnable, job->id);
-  db_result = database_exec(scheduler, sql);
+  sql = g_strdup_printf(jobsql_anyrunnable, email->id);
+  db_result = email_exec(sql);
+  g_free(sql);
   if(PQresultStatus(db_result) != PGRES_TUPLES_OK)
   {
-    PQ_ERROR(db_result, "unable to check job status for jq_pk %d", job->id);
-    g_free(sql);
-    SafePQclear(db_result);
-    return 0;
+    PQ_ERROR(db_result, "unable to check job status for jq_pk %d", email->id);
+    return -1;
   }
 
   /* check if all runnable jobs have been run */
@@ -395,93 +545,291 @@ static gint email_checkjobstatus(scheduler_t* scheduler, job_t* job)
   {
     ret = 0;
   }
+  SafePQclear(db_result);
 
+  /* check for any jobs that are still running or finished after this one, the
+   * last job to finish sends the notification */
+  sql = g_strdup_printf(jobsql_anylater, email->id, email->id, email->id);
+  db_result = email_exec(sql);
   g_free(sql);
+  if(PQresultStatus(db_result) != PGRES_TUPLES_OK)
+  {
+    PQ_ERROR(db_result, "unable to check job status for jq_pk %d", email->id);
+    return -1;
+  }
+  if(PQntuples(db_result) != 0)
+  {
+    ret = 0;
+  }
   SafePQclear(db_result);
 
-  sql = g_strdup_printf(jobsql_jobendbits, job->id);
-  db_result = database_exec(scheduler, sql);
+  sql = g_strdup_printf(jobsql_jobendbits, email->id);
+  db_result = email_exec(sql);
+  g_free(sql);
 
-  /* check for any jobs that are still running */
+  /* check for any failed jobs */
   for(i = 0; i < PQntuples(db_result) && ret; i++)
   {
-    id = atoi(PQget(db_result, i, "jq_pk"));
-    if(id != job->id && g_tree_lookup(scheduler->job_list, &id) != NULL)
+    if(atoi(PQget(db_result, i, "jq_end_bits")) == (1 << 1))
     {
-      ret = 0;
+      ret = 2;
       break;
     }
   }
 
-  /* check for any failed jobs */
-  for(i = 0; i < PQntuples(db_result) && ret; i++)
+  SafePQclear(db_result);
+  return ret;
+}
+
+/**
+ * @brief Decides if a notification is tried again after a failed query.
+ *
+ * Only a lost connection is worth another attempt. The connection is made
+ * again for the next attempt.
+ *
+ * @return TRUE if the connection was lost
+ */
+static gboolean email_connection_lost()
+{
+  if(PQstatus(email_worker.conn) == CONNECTION_OK)
+    return FALSE;
+
+  WARNING("email notification lost the database connection: %s",
+      PQerrorMessage(email_worker.conn));
+  PQfinish(email_worker.conn);
+  email_worker.conn = NULL;
+  return TRUE;
+}
+
+/**
+ * @brief Tells the email thread that the main thread collected its email
+ *        client.
+ *
+ * The scheduler collects every child process that exits, so the email client
+ * may be collected before the email thread gets to it.
+ *
+ * @param pid     the process that exited
+ * @param status  its exit status
+ * @return TRUE if the process was the email client
+ */
+gboolean email_exited(pid_t pid, int status)
+{
+  gboolean found = FALSE;
+
+  if(pid <= 0)
+    return FALSE;
+
+  g_mutex_lock(&email_worker.lock);
+  if(email_worker.pid == pid)
   {
-    if(atoi(PQget(db_result, i, "jq_end_bits")) == (1 << 1))
+    g_atomic_int_set(&email_worker.status, status);
+    g_atomic_int_set(&email_worker.reaped, 1);
+    found = TRUE;
+  }
+  else if(g_slist_find(email_worker.orphans, GINT_TO_POINTER(pid)) != NULL)
+  {
+    /* the email thread gave up on it after killing it, see email_run() */
+    email_worker.orphans = g_slist_remove(email_worker.orphans, GINT_TO_POINTER(pid));
+    found = TRUE;
+  }
+  g_mutex_unlock(&email_worker.lock);
+
+  return found;
+}
+
+/**
+ * @brief Waits for the email client to exit.
+ *
+ * @param pid       the email client
+ * @param deadline  the g_get_monotonic_time() to give up at
+ * @param status    set to the exit status of the email client
+ * @return TRUE if it exited before the deadline
+ */
+static gboolean email_wait(pid_t pid, gint64 deadline, int* status)
+{
+  pid_t ret;
+
+  while(1)
+  {
+    if((ret = waitpid(pid, status, WNOHANG)) == pid)
+      return TRUE;
+
+    /* the main thread collected it, see email_exited() */
+    if(ret < 0 && errno == ECHILD && g_atomic_int_get(&email_worker.reaped))
     {
-      ret = 2;
+      *status = g_atomic_int_get(&email_worker.status);
+      return TRUE;
+    }
+
+    if(g_get_monotonic_time() >= deadline)
+      return FALSE;
+    usleep(50000);
+  }
+}
+
+/**
+ * @brief Runs the email client and writes the email to its stdin.
+ *
+ * The email client is killed if it does not finish within email_timeout
+ * seconds, a mail server that does not answer would otherwise hold up every
+ * notification after it.
+ *
+ * @param email  the notification that is sent
+ * @param cmd    the command that runs the email client
+ * @param text   the email
+ * @return TRUE if the email client succeeded
+ */
+static gboolean email_run(email_request* email, char* cmd, char* text)
+{
+  gint64 deadline = g_get_monotonic_time() + (gint64)CONF_email_timeout * G_USEC_PER_SEC;
+  size_t len = strlen(text);
+  struct pollfd pfd;
+  gboolean collected;
+  ssize_t n;
+  int fds[2];
+  int status;
+  pid_t pid;
+
+  if(pipe(fds) != 0)
+  {
+    WARNING("Unable to spawn email notification process: '%s'.", email->command);
+    return FALSE;
+  }
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+  /* the main thread must not collect the email client before it knows the pid */
+  g_mutex_lock(&email_worker.lock);
+  g_atomic_int_set(&email_worker.reaped, 0);
+  if((pid = fork()) == 0)
+  {
+    setpgid(0, 0);
+    dup2(fds[0], fileno(stdin));
+    signal(SIGPIPE, SIG_DFL);
+    execl("/bin/sh", "sh", "-c", cmd, (char*)NULL);
+    _exit(127);
+  }
+
+  if(pid > 0)
+    email_worker.pid = pid;
+  g_mutex_unlock(&email_worker.lock);
+
+  close(fds[0]);
+  if(pid < 0)
+  {
+    close(fds[1]);
+    WARNING("Unable to spawn email notification process: '%s'.", email->command);
+    return FALSE;
+  }
+
+  fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+  pfd.fd = fds[1];
+  pfd.events = POLLOUT;
+  while(len > 0 && g_get_monotonic_time() < deadline)
+  {
+    if(poll(&pfd, 1, (deadline - g_get_monotonic_time()) / 1000 + 1) <= 0)
+      continue;
+    if((n = write(fds[1], text, len)) < 0 && errno != EAGAIN && errno != EINTR)
       break;
+    if(n > 0)
+    {
+      text += n;
+      len  -= n;
     }
   }
+  close(fds[1]);
 
-  g_free(sql);
-  SafePQclear(db_result);
-  return ret;
+  if(!email_wait(pid, deadline, &status))
+  {
+    ERROR("email notification for job %d did not finish in %d seconds, killing '%s'",
+        email->id, CONF_email_timeout, email->command);
+    kill(-pid, SIGKILL);
+    collected = email_wait(pid, g_get_monotonic_time() + G_USEC_PER_SEC, &status);
+
+    /* the main thread collects it later, that is expected */
+    g_mutex_lock(&email_worker.lock);
+    if(!collected && !g_atomic_int_get(&email_worker.reaped))
+      email_worker.orphans = g_slist_prepend(email_worker.orphans, GINT_TO_POINTER(pid));
+    email_worker.pid = 0;
+    g_mutex_unlock(&email_worker.lock);
+    return FALSE;
+  }
+  g_mutex_lock(&email_worker.lock);
+  email_worker.pid = 0;
+  g_mutex_unlock(&email_worker.lock);
+
+  if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+  {
+    ERROR("Received error code %d from '%s'", WEXITSTATUS(status), email->command);
+    return FALSE;
+  }
+
+  return TRUE;
 }
 
 /**
  * Sends an email notification that a particular job has completed correctly.
  * This compiles the email based upon the header file, footer file, and the job
- * that just completed.
+ * that just completed. Runs in the email thread.
  *
- * @param scheduler Current scheduler reference
- * @param job       The job that just finished
- * @return void, no return
+ * @param email  The notification for the job that finished
+ * @return FALSE if it should be tried again later
  */
-static void email_notification(scheduler_t* scheduler, job_t* job)
+static gboolean email_send(email_request* email)
 {
   PGresult* db_result;
-  int j_id = job->id;
+  PGresult* smtp;
+  int j_id = email->id;
   int upload_id;
   int status;
-  int retcode;
+  gboolean ret;
   char* val;
+  char* error = NULL;
   char* final_cmd = NULL;
   char sql[1024];
-  FILE* mail_io;
-  GString* email_txt;
-  job_status curr_status = job->status;
   email_replace_args args;
 
-  if(is_meta_special(g_tree_lookup(scheduler->meta_agents, job->agent_type), SAG_NOEMAIL) ||
-      !(status = email_checkjobstatus(scheduler, job)))
-    return;
+  if(email_worker.conn == NULL)
+  {
+    email_worker.conn = fo_dbconnect(email_worker.dbconf, &error);
+    if(error || PQstatus(email_worker.conn) != CONNECTION_OK)
+    {
+      WARNING("unable to connect the email notification to the database: \"%s\"", error);
+      PQfinish(email_worker.conn);
+      email_worker.conn = NULL;
+      return FALSE;
+    }
+  }
+
+  if((status = email_checkjobstatus(email)) <= 0)
+    return status == 0 || !email_connection_lost();
 
   sprintf(sql, select_upload_fk, j_id);
-  db_result = database_exec(scheduler, sql);
+  db_result = email_exec(sql);
   if(PQresultStatus(db_result) != PGRES_TUPLES_OK || PQntuples(db_result) == 0)
   {
     PQ_ERROR(db_result, "unable to select the upload id for job %d", j_id);
-    return;
+    return !email_connection_lost();
   }
 
   upload_id = atoi(PQgetvalue(db_result, 0, 0));
   SafePQclear(db_result);
 
   sprintf(sql, upload_common, upload_id);
-  db_result = database_exec(scheduler, sql);
+  db_result = email_exec(sql);
   if(PQresultStatus(db_result) != PGRES_TUPLES_OK)
   {
     PQ_ERROR(db_result, "unable to check common uploads to job %d", j_id);
-    return;
+    return !email_connection_lost();
   }
   SafePQclear(db_result);
 
   sprintf(sql, jobsql_email, upload_id);
-  db_result = database_exec(scheduler, sql);
+  db_result = email_exec(sql);
   if(PQresultStatus(db_result) != PGRES_TUPLES_OK)
   {
     PQ_ERROR(db_result, "unable to access email info for job %d", j_id);
-    return;
+    return !email_connection_lost();
   }
 
   /* special for delagent, upload records have been deleted.
@@ -491,68 +839,246 @@ static void email_notification(scheduler_t* scheduler, job_t* job)
   {
     SafePQclear(db_result);
     sprintf(sql, jobsql_email_job, j_id);
-    db_result = database_exec(scheduler, sql);
+    db_result = email_exec(sql);
     if(PQresultStatus(db_result) != PGRES_TUPLES_OK || PQntuples(db_result) == 0)
     {
       PQ_ERROR(db_result, "unable to access email info for job %d", j_id);
-      return;
+      return !email_connection_lost();
     }
   }
 
-  if(PQget(db_result, 0, "email_notify")[0] == 'y')
+  if(PQget(db_result, 0, "email_notify")[0] != 'y')
   {
-    if(status == 2)
-      job->status = JB_FAILED;
+    SafePQclear(db_result);
+    return TRUE;
+  }
 
-    email_txt = g_string_new("");
-    g_string_append(email_txt, scheduler->email_header);
-    g_string_append(email_txt, job->message == NULL ? "" : job->message);
-    g_string_append(email_txt, scheduler->email_footer);
+  smtp = email_exec(smtp_values);
+  if(PQresultStatus(smtp) != PGRES_TUPLES_OK || PQntuples(smtp) == 0)
+  {
+    PQ_ERROR(smtp, "unable to get conf variables for SMTP from sysconfig");
+    SafePQclear(db_result);
+    return !email_connection_lost();
+  }
+  final_cmd = email_build_command(smtp, email->command, email->subject,
+      PQget(db_result, 0, "user_email"));
+  SafePQclear(smtp);
+  SafePQclear(db_result);
+  if(final_cmd == NULL)
+    return TRUE;
 
+  if(status == 2)
+    email->status = JB_FAILED;
 
-    if(scheduler->parse_db_email != NULL)
+  if(email->parse != NULL)
+  {
+    args.foss_url = email->foss_url;
+    args.job      = email;
+    val = g_regex_replace_eval(email->parse, email->text, -1, 0, 0,
+        (GRegexEvalCallback)email_replace, &args, NULL);
+  }
+  else
+  {
+    val = g_strdup(email->text);
+  }
+
+  ret = email_run(email, final_cmd, val);
+  g_free(val);
+  g_free(final_cmd);
+  return ret;
+}
+
+/**
+ * @brief Frees the memory of a notification.
+ */
+static void email_request_destroy(email_request* email)
+{
+  if(email->parse != NULL)
+    g_regex_unref(email->parse);
+  g_free(email->agent_type);
+  g_free(email->text);
+  g_free(email->foss_url);
+  g_free(email->command);
+  g_free(email->subject);
+  g_free(email);
+}
+
+/**
+ * @brief Orders the notifications waiting for another attempt by due time.
+ */
+static gint email_due_compare(email_request* a, email_request* b)
+{
+  return (a->due > b->due) - (a->due < b->due);
+}
+
+/**
+ * @brief The body of the email thread.
+ *
+ * Sends the notifications in the order they were queued. One that could not
+ * be sent is tried again after EMAIL_RETRY seconds times the attempts so
+ * far, up to email_retries times. The notifications that are queued when the
+ * thread is stopped are still sent, those waiting for another attempt are
+ * dropped.
+ *
+ * @param unused
+ * @return always NULL
+ */
+static void* email_worker_loop(void* unused)
+{
+  GList* retry = NULL;
+  email_request* email;
+  gint64 wait;
+#if !(GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32)
+  GTimeVal timeout;
+#endif
+
+  while(1)
+  {
+    if(retry == NULL)
     {
-      args.foss_url   = scheduler->host_url;
-      args.job        = job;
-      args.scheduler  = scheduler;
-      val = g_regex_replace_eval(scheduler->parse_db_email, email_txt->str,
-            email_txt->len, 0, 0, (GRegexEvalCallback)email_replace, &args, NULL);
+      email = g_async_queue_pop(email_worker.queue);
     }
     else
     {
-      val = email_txt->str;
+      wait = MAX(((email_request*)retry->data)->due - g_get_monotonic_time(), 0);
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+      email = g_async_queue_timeout_pop(email_worker.queue, wait);
+#else
+      g_get_current_time(&timeout);
+      g_time_val_add(&timeout, wait);
+      email = g_async_queue_timed_pop(email_worker.queue, &timeout);
+#endif
     }
 
-    final_cmd = get_email_command(scheduler, PQget(db_result, 0, "user_email"));
-    if(final_cmd == NULL)
+    if(email == &email_stop)
+      break;
+
+    if(email == NULL)
     {
-      if(scheduler->parse_db_email != NULL)
-        g_free(val);
-      g_string_free(email_txt, TRUE);
-      return;
+      email = retry->data;
+      retry = g_list_delete_link(retry, retry);
     }
-    if((mail_io = popen(final_cmd, "w")) != NULL)
+
+    if(!email_send(email))
     {
-      fprintf(mail_io, "%s", val);
-      fflush(mail_io);
-      retcode = WEXITSTATUS(pclose(mail_io));
-      if(retcode != 0)
+      if(email->tries++ < CONF_email_retries)
       {
-        ERROR("Received error code %d from '%s'", retcode, scheduler->email_command);
+        email->due = g_get_monotonic_time() + (gint64)EMAIL_RETRY * email->tries * G_USEC_PER_SEC;
+        retry = g_list_insert_sorted(retry, email, (GCompareFunc)email_due_compare);
+        continue;
       }
+      ERROR("unable to send the email notification for job %d", email->id);
     }
-    else
-    {
-      WARNING("Unable to spawn email notification process: '%s'.\n",
-              scheduler->email_command);
-    }
-    job->status = curr_status;
-    if(scheduler->parse_db_email != NULL)
-      g_free(val);
-    g_free(final_cmd);
-    g_string_free(email_txt, TRUE);
+
+    email_request_destroy(email);
   }
-  SafePQclear(db_result);
+
+  for(; retry != NULL; retry = g_list_delete_link(retry, retry))
+  {
+    email = retry->data;
+    WARNING("dropped the email notification for job %d", email->id);
+    email_request_destroy(email);
+  }
+
+  PQfinish(email_worker.conn);
+  email_worker.conn = NULL;
+  return NULL;
+}
+
+/**
+ * @brief Finds another job of the same upload that did not finish yet.
+ *
+ * Used with g_tree_foreach() on the job list, finished is set to NULL when a
+ * job is found.
+ */
+static gboolean email_job_running(int* id, job_t* job, job_t** finished)
+{
+  if(*id >= 0 && *id != (*finished)->id && job->parent_id == (*finished)->parent_id)
+    *finished = NULL;
+  return *finished == NULL;
+}
+
+/**
+ * Queues an email notification that a particular job has completed. The email
+ * is built and sent by the email thread, only the parts of the job and of the
+ * configuration that it needs are copied here.
+ *
+ * @param scheduler Current scheduler reference
+ * @param job       The job that just finished
+ * @param status    The status the job finished with
+ * @return void, no return
+ */
+static void email_notification(scheduler_t* scheduler, job_t* job, job_status status)
+{
+  email_request* email;
+  job_t* finished = job;
+
+  if(is_meta_special(g_tree_lookup(scheduler->meta_agents, job->agent_type), SAG_NOEMAIL))
+    return;
+
+  /* the last job of the upload sends the notification */
+  g_tree_foreach(scheduler->job_list, (GTraverseFunc)email_job_running, &finished);
+  if(finished == NULL)
+    return;
+
+  if(email_worker.thread == NULL)
+  {
+    WARNING("no email notification for job %d, the email thread is not running", job->id);
+    return;
+  }
+
+  email = g_new0(email_request, 1);
+  email->id         = job->id;
+  email->agent_type = g_strdup(job->agent_type);
+  email->status     = status;
+  email->text       = g_strconcat(scheduler->email_header,
+      job->message == NULL ? "" : job->message, scheduler->email_footer, NULL);
+  email->foss_url   = g_strdup(scheduler->host_url);
+  email->command    = g_strdup(scheduler->email_command);
+  email->subject    = g_strdup(scheduler->email_subject);
+  email->parse      = scheduler->parse_db_email ? g_regex_ref(scheduler->parse_db_email) : NULL;
+
+  g_async_queue_push(email_worker.queue, email);
+}
+
+/**
+ * @brief Starts the email thread if it is not running yet.
+ *
+ * @param scheduler the scheduler_t* whose Db.conf should be used
+ */
+static void email_worker_init(scheduler_t* scheduler)
+{
+  if(email_worker.thread != NULL)
+    return;
+
+  email_worker.queue  = g_async_queue_new();
+  email_worker.dbconf = g_strdup_printf("%s/Db.conf", scheduler->sysconfigdir);
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+  email_worker.thread = g_thread_new("email", (GThreadFunc) email_worker_loop, NULL);
+#else
+  email_worker.thread = g_thread_create((GThreadFunc) email_worker_loop, NULL, 1, NULL);
+#endif
+}
+
+/**
+ * @brief Stops the email thread once the notifications queued so far are sent.
+ *
+ * Called when the scheduler shuts down, a reload of the configuration keeps
+ * the thread running.
+ */
+void email_worker_destroy()
+{
+  if(email_worker.thread == NULL)
+    return;
+
+  g_async_queue_push(email_worker.queue, &email_stop);
+  g_thread_join(email_worker.thread);
+
+  g_async_queue_unref(email_worker.queue);
+  g_free(email_worker.dbconf);
+  email_worker.thread = NULL;
+  email_worker.queue  = NULL;
+  email_worker.dbconf = NULL;
 }
 
 /**
@@ -638,6 +1164,191 @@ void email_init(scheduler_t* scheduler)
 	error = NULL;
 }
 
+/* ************************************************************************** */
+/* **** job notifications *************************************************** */
+/* ************************************************************************** */
+
+#define LISTEN_RETRY 60 ///< Seconds between attempts to reconnect the listener
+
+/**
+ * The thread that waits for the "fossology_jobs" notifications sent by
+ * JobQueueAdd(). It has its own connection to the database since a libpq
+ * connection cannot be shared between threads.
+ */
+static struct
+{
+    GThread* thread;  ///< The thread waiting for notifications
+    gchar*   dbconf;  ///< The Db.conf used for the connection
+    int      wake_fd; ///< Written to stop the thread
+    gint     pending; ///< A database_update_event() is queued but did not run yet
+} db_listen = { NULL, NULL, -1, 0 };
+
+/**
+ * @brief Queues a database_update_event() unless one is already waiting.
+ *
+ * A burst of new jobs causes a burst of notifications, but a single check of
+ * the job queue finds all of them.
+ */
+static void database_listen_signal()
+{
+  if (g_atomic_int_compare_and_exchange(&db_listen.pending, 0, 1))
+    event_signal(database_update_event, NULL);
+}
+
+/**
+ * @brief Creates the connection of the listener and subscribes it to the job
+ *        notifications.
+ *
+ * @return the connection, NULL if the database could not be reached
+ */
+static PGconn* database_listen_connect()
+{
+  PGconn* conn;
+  PGresult* db_result;
+  char* error = NULL;
+
+  conn = fo_dbconnect(db_listen.dbconf, &error);
+  if (error || PQstatus(conn) != CONNECTION_OK)
+  {
+    WARNING("unable to connect the job listener to the database: \"%s\"", error);
+    PQfinish(conn);
+    return NULL;
+  }
+
+  db_result = PQexec(conn, jobsql_listen);
+  if (PQresultStatus(db_result) != PGRES_COMMAND_OK)
+  {
+    WARNING("unable to listen for new jobs: %s", PQerrorMessage(conn));
+    SafePQclear(db_result);
+    PQfinish(conn);
+    return NULL;
+  }
+  SafePQclear(db_result);
+
+  return conn;
+}
+
+/**
+ * @brief The body of the listener thread.
+ *
+ * Sleeps in poll() until either the database sends a notification or
+ * database_listen_destroy() wakes it up. All notifications that arrived
+ * together are turned into a single database_update_event(). When the
+ * connection is lost it is retried every LISTEN_RETRY seconds, until then the
+ * scheduler only finds new jobs through its regular poll of the job queue.
+ *
+ * @param unused
+ * @return always NULL
+ */
+static void* database_listen_loop(void* unused)
+{
+  PGconn* conn = NULL;
+  PGnotify* notify;
+  struct pollfd fds[2];
+  int received;
+
+  fds[0].fd = db_listen.wake_fd;
+  fds[0].events = POLLIN;
+
+  while (1)
+  {
+    if (conn == NULL && (conn = database_listen_connect()) != NULL)
+    {
+      /* jobs may have been added while there was no connection */
+      database_listen_signal();
+    }
+
+    fds[0].revents = 0;
+    fds[1].fd = conn ? PQsocket(conn) : -1;
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+
+    if (poll(fds, 2, conn ? -1 : LISTEN_RETRY * 1000) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      ERROR("job listener stopped: %s", strerror(errno));
+      break;
+    }
+
+    if (fds[0].revents)
+      break;
+    if (!fds[1].revents)
+      continue;
+
+    if (!PQconsumeInput(conn))
+    {
+      WARNING("job listener lost the database connection: %s", PQerrorMessage(conn));
+      PQfinish(conn);
+      conn = NULL;
+      continue;
+    }
+
+    received = 0;
+    while ((notify = PQnotifies(conn)) != NULL)
+    {
+      received++;
+      PQfreemem(notify);
+    }
+
+    if (received)
+    {
+      V_DATABASE("DB: received %d job notifications\n", received);
+      database_listen_signal();
+    }
+  }
+
+  PQfinish(conn);
+  return NULL;
+}
+
+/**
+ * @brief Starts the listener thread if it is not running yet.
+ *
+ * @param scheduler the scheduler_t* whose Db.conf should be used
+ */
+static void database_listen_init(scheduler_t* scheduler)
+{
+  if (db_listen.thread != NULL)
+    return;
+
+  if ((db_listen.wake_fd = eventfd(0, EFD_CLOEXEC)) < 0)
+  {
+    ERROR("unable to create the job listener: %s", strerror(errno));
+    return;
+  }
+
+  db_listen.dbconf = g_strdup_printf("%s/Db.conf", scheduler->sysconfigdir);
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+  db_listen.thread = g_thread_new("db_listen", (GThreadFunc) database_listen_loop, NULL);
+#else
+  db_listen.thread = g_thread_create((GThreadFunc) database_listen_loop, NULL, 1, NULL);
+#endif
+}
+
+/**
+ * @brief Stops the listener thread and closes its connection.
+ *
+ * Called when the configuration is reloaded and when the scheduler shuts down.
+ */
+void database_listen_destroy()
+{
+  uint64_t wake = 1;
+
+  if (db_listen.thread == NULL)
+    return;
+
+  if (write(db_listen.wake_fd, &wake, sizeof(wake)) != sizeof(wake))
+    ERROR("unable to stop the job listener: %s", strerror(errno));
+  g_thread_join(db_listen.thread);
+
+  close(db_listen.wake_fd);
+  g_free(db_listen.dbconf);
+  db_listen.thread  = NULL;
+  db_listen.dbconf  = NULL;
+  db_listen.wake_fd = -1;
+}
+
 /* ************************************************************************** */
 /* **** local functions ***************************************************** */
 /* ************************************************************************** */
@@ -775,8 +1486,8 @@ static PGconn* database_connect(gchar* configdir)
 
 /**
  * Initializes any one-time attributes relating to the database. Currently this
- * includes creating the db connection and checking the URL of the FOSSology
- * instance out of the db.
+ * includes creating the db connection, checking the URL of the FOSSology
+ * instance out of the db and starting to listen for new jobs.
  */
 void database_init(scheduler_t* scheduler)
 {
@@ -793,6 +1504,9 @@ void database_init(scheduler_t* scheduler)
 
   /* check that relevant database fields exist */
   check_tables(scheduler);
+
+  database_listen_init(scheduler);
+  email_worker_init(scheduler);
 }
 
 /* ************************************************************************** */
@@ -843,9 +1557,68 @@ void database_exec_event(scheduler_t* scheduler, char* sql)
   g_free(sql);
 }
 
+/**
+ * @brief Makes a new job wait for the jobs it depends on.
+ *
+ * The jobs are given as the jq_depends array of basic_checkout, e.g.
+ * "{12,13}". Every one of them must be known to the scheduler, either from an
+ * earlier check of the job queue or from this one, so that it can tell the job
+ * when it is complete. Otherwise the job is dropped and picked up by a later
+ * check of the job queue.
+ *
+ * @param scheduler The scheduler_t* the job belongs to
+ * @param job       the new job
+ * @param depends   the ids of the jobs it waits for
+ * @return FALSE if the job was dropped
+ */
+static gboolean database_job_depends(scheduler_t* scheduler, job_t* job, char* depends)
+{
+  GArray* ids = g_array_new(FALSE, FALSE, sizeof(job_t*));
+  job_t* dependency;
+  char* curr;
+  int id;
+  guint i;
+
+  for(curr = depends; *curr != '\0'; )
+  {
+    if(!g_ascii_isdigit(*curr))
+    {
+      curr++;
+      continue;
+    }
+
+    id = strtol(curr, &curr, 10);
+    if((dependency = g_tree_lookup(scheduler->job_list, &id)) == NULL ||
+        dependency->status == JB_FAILED)
+    {
+      V_DATABASE("DB: jq_pk[%d] waits for unknown jq_pk[%d]\n", job->id, id);
+      g_array_free(ids, TRUE);
+      job_drop(scheduler, job);
+      return FALSE;
+    }
+    g_array_append_val(ids, dependency);
+  }
+
+  for(i = 0; i < ids->len; i++)
+    job_depend(job, g_array_index(ids, job_t*, i));
+
+  g_array_free(ids, TRUE);
+  return TRUE;
+}
+
 /**
  * @brief Checks the job queue for any new entries.
  *
+ * A single query returns every jobqueue entry that was not started yet
+ * together with the user, group and priority of its job and the entries it
+ * still waits for. The entries that do not wait are queued at once. The
+ * others are kept by the scheduler and queued as soon as the jobs they wait
+ * for are complete, see job_depend(), without asking the database again.
+ *
+ * This is signaled when the listener receives a notification about a new job,
+ * by the "database" command of the interface and by the slow poll in
+ * scheduler_signal().
+ *
  * @param scheduler The scheduler_t* that holds the connection
  * @param unused
  */
@@ -853,11 +1626,13 @@ void database_update_event(scheduler_t* scheduler, void* unused)
 {
   /* locals */
   PGresult* db_result;
-  PGresult* pri_result;
   int i, j_id;
-  char sql[512];
   char* value, * type, * host, * pfile, * parent, *jq_cmd_args;
   job_t* job;
+  GArray* added;
+
+  /* notifications from now on need another check */
+  g_atomic_int_set(&db_listen.pending, 0);
 
   if(closing)
   {
@@ -875,6 +1650,7 @@ void database_update_event(scheduler_t* scheduler, void* unused)
 
   V_SPECIAL("DB: retrieved %d entries from the job queue\n",
       PQntuples(db_result));
+  added = g_array_new(FALSE, FALSE, sizeof(int));
   for(i = 0; i < PQntuples(db_result); i++)
   {
     /* start by checking that the job hasn't already been grabbed */
@@ -907,29 +1683,38 @@ void database_update_event(scheduler_t* scheduler, void* unused)
       continue;
     }
 
-    sprintf(sql, jobsql_information, parent);
-    pri_result = database_exec(scheduler, sql);
-    if(PQresultStatus(pri_result) != PGRES_TUPLES_OK)
-    {
-      PQ_ERROR(pri_result, "database update failed on call to PQexec");
-      continue;
-    }
-    if(PQntuples(pri_result)==0)
+    if(PQgetisnull(db_result, i, PQfnumber(db_result, "user_pk")))
     {
       WARNING("can not find the user information of job_pk %s\n", parent);
-      SafePQclear(pri_result);
       continue;
     }
-    job = job_init(scheduler->job_list, scheduler->job_queue, type, host, j_id,
+
+    job = job_init(scheduler->job_list, NULL, type, host, j_id,
         atoi(parent),
-        atoi(PQget(pri_result, 0, "user_pk")),
-        atoi(PQget(pri_result, 0, "group_pk")),
-        atoi(PQget(pri_result, 0, "job_priority")), jq_cmd_args);
+        atoi(PQget(db_result, i, "user_pk")),
+        atoi(PQget(db_result, i, "group_pk")),
+        atoi(PQget(db_result, i, "job_priority")), jq_cmd_args);
     job_set_data(scheduler, job,  value, (pfile && pfile[0] != '\0'));
+    g_array_append_val(added, i);
+  }
+
+  /* the new jobs can depend on each other, so all of them must exist first */
+  for(i = 0; i < added->len; i++)
+  {
+    j_id = atoi(PQget(db_result, g_array_index(added, int, i), "jq_pk"));
+    if((job = g_tree_lookup(scheduler->job_list, &j_id)) != NULL)
+      database_job_depends(scheduler, job, PQget(db_result, g_array_index(added, int, i), "jq_depends"));
+  }
 
-    SafePQclear(pri_result);
+  /* a job that was dropped above is no longer in the job list */
+  for(i = 0; i < added->len; i++)
+  {
+    j_id = atoi(PQget(db_result, g_array_index(added, int, i), "jq_pk"));
+    if((job = g_tree_lookup(scheduler->job_list, &j_id)) != NULL && job->depends == NULL)
+      job_ready(scheduler, job);
   }
 
+  g_array_free(added, TRUE);
   SafePQclear(db_result);
 }
 
@@ -989,23 +1774,96 @@ void database_update_job(scheduler_t* scheduler, job_t* job, job_status status)
     PQ_ERROR(db_result, "failed to update job status in job queue");
 
   if(status == JB_COMPLETE || status == JB_FAILED)
-    email_notification(scheduler, job);
+    email_notification(scheduler, job, status);
 
   g_free(sql);
 }
 
+/**
+ * The number of items processed of the job queue entries that still has to be
+ * written to the database, by jq_pk. It is filled from the heartbeats of the
+ * agents on the agent io thread and emptied by database_processed_event(), so
+ * only the newest number of every entry is written.
+ */
+static GHashTable* processed = NULL;
+
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+static GMutex processed_lock;
+#define PROCESSED_LOCK()   g_mutex_lock(&processed_lock)
+#define PROCESSED_UNLOCK() g_mutex_unlock(&processed_lock)
+#else
+static GStaticMutex processed_lock = G_STATIC_MUTEX_INIT;
+#define PROCESSED_LOCK()   g_static_mutex_lock(&processed_lock)
+#define PROCESSED_UNLOCK() g_static_mutex_unlock(&processed_lock)
+#endif
+
+/**
+ * @brief Writes the number of items processed of every job queue entry that
+ *        changed since the last time, with a single statement.
+ *
+ * @param scheduler the scheduler with the database connection
+ * @param unused
+ */
+void database_processed_event(scheduler_t* scheduler, void* unused)
+{
+  GHashTable* pending;
+  GHashTableIter iter;
+  gpointer j_id, num;
+  GString* values;
+  gchar* sql;
+  PGresult* db_result;
+
+  PROCESSED_LOCK();
+  pending = processed;
+  processed = NULL;
+  PROCESSED_UNLOCK();
+
+  if(pending == NULL)
+    return;
+
+  if(scheduler->db_conn != NULL)
+  {
+    values = g_string_new(NULL);
+    g_hash_table_iter_init(&iter, pending);
+    while(g_hash_table_iter_next(&iter, &j_id, &num))
+      g_string_append_printf(values, "%s(%d, %d)", values->len ? ", " : "",
+          GPOINTER_TO_INT(j_id), GPOINTER_TO_INT(num));
+
+    sql = g_strdup_printf(jobsql_processed, values->str);
+    db_result = database_exec(scheduler, sql);
+    if(PQresultStatus(db_result) != PGRES_COMMAND_OK)
+      PQ_ERROR(db_result, "failed to update the items processed: %s", sql);
+
+    g_string_free(values, TRUE);
+    g_free(sql);
+  }
+
+  g_hash_table_destroy(pending);
+}
+
 /**
  * @brief Updates the number of items that a job queue entry has processed.
  *
+ * The heartbeats of the agents come in far more often than the number is
+ * worth writing, so only the newest number of every entry is kept until the
+ * low priority database_processed_event() writes them. There is at most one
+ * such event waiting at any time.
+ *
  * @param j_id the id number of the job queue entry
  * @param num the number of items processed in total
  */
 void database_job_processed(int j_id, int num)
 {
-  gchar* sql = NULL;
+  gboolean first;
 
-  sql = g_strdup_printf(jobsql_processed, num, j_id);
-  event_signal(database_exec_event, sql);
+  PROCESSED_LOCK();
+  if((first = (processed == NULL)))
+    processed = g_hash_table_new(g_direct_hash, g_direct_equal);
+  g_hash_table_insert(processed, GINT_TO_POINTER(j_id), GINT_TO_POINTER(num));
+  PROCESSED_UNLOCK();
+
+  if(first)
+    event_signal_priority(database_processed_event, NULL, EVENT_LOW);
 }
 
 /**
@@ -1042,6 +1900,65 @@ void database_job_priority(scheduler_t* scheduler, job_t* job, int priority)
   g_free(sql);
 }
 
+/**
+ * @brief Frees a job_chunk_t, used as the free function of job->chunks.
+ */
+static void database_chunk_free(job_chunk_t* chunk)
+{
+  g_free(chunk->data);
+  g_free(chunk);
+}
+
+/**
+ * @brief Splits the pfiles of the upload of a runonpfile job into chunks.
+ *
+ * The data of a runonpfile job is the upload id. Every chunk covers up to
+ * runonpfile_chunk_size distinct pfiles of the upload, the data sent to the
+ * agent is "<upload> PFILES <first pfile>-<last pfile>", see
+ * fo_scheduler_chunk() in the agent api.
+ *
+ * @param scheduler The scheduler_t* that holds the connection
+ * @param job       the runonpfile job
+ * @return the chunks of the job, NULL if the upload can not be split
+ */
+GPtrArray* database_job_chunks(scheduler_t* scheduler, job_t* job)
+{
+  gchar* sql = NULL;
+  PGresult* db_result;
+  GPtrArray* chunks;
+  job_chunk_t* chunk;
+  int i;
+
+  if(job->data == NULL || !string_is_num(job->data))
+  {
+    WARNING("JOB[%d]: runonpfile data \"%s\" is not an upload, job is not split",
+        job->id, job->data);
+    return NULL;
+  }
+
+  sql = g_strdup_printf(jobsql_chunks, MAX(CONF_runonpfile_chunk_size, 1), atoi(job->data));
+  db_result = database_exec(scheduler, sql);
+  g_free(sql);
+
+  if(PQresultStatus(db_result) != PGRES_TUPLES_OK)
+  {
+    PQ_ERROR(db_result, "unable to split job %d into chunks", job->id);
+    return NULL;
+  }
+
+  chunks = g_ptr_array_new_with_free_func((GDestroyNotify) database_chunk_free);
+  for(i = 0; i < PQntuples(db_result); i++)
+  {
+    chunk = g_new0(job_chunk_t, 1);
+    chunk->data = g_strdup_printf("%s PFILES %s-%s", job->data,
+        PQget(db_result, i, "first"), PQget(db_result, i, "last"));
+    g_ptr_array_add(chunks, chunk);
+  }
+
+  SafePQclear(db_result);
+  return chunks;
+}
+
 /**
  * \brief Build command to run to send email
  * \param scheduler  Current scheduler object
@@ -1051,10 +1968,6 @@ void database_job_priority(scheduler_t* scheduler, job_t* job, int priority)
 char* get_email_command(scheduler_t* scheduler, char* user_email)
 {
   PGresult* db_result_smtp;
-  int i;
-  GString* client_cmd;
-  GHashTable* smtpvariables;
-  char* temp_smtpvariable;
   char* final_command;
 
   db_result_smtp = database_exec(scheduler, smtp_values);
@@ -1063,80 +1976,8 @@ char* get_email_command(scheduler_t* scheduler, char* user_email)
     PQ_ERROR(db_result_smtp, "unable to get conf variables for SMTP from sysconfig");
     return NULL;
   }
-  client_cmd = g_string_new("");
-  smtpvariables = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
-  for(i = 0; i < PQntuples(db_result_smtp); i++)
-  {
-    if(PQget(db_result_smtp, i, "conf_value")[0])  //Not empty
-    {
-      g_hash_table_insert(smtpvariables, g_strdup(PQget(db_result_smtp, i, "variablename")),
-                          g_strdup(PQget(db_result_smtp, i, "conf_value")));
-    }
-  }
+  final_command = email_build_command(db_result_smtp, scheduler->email_command,
+      scheduler->email_subject, user_email);
   SafePQclear(db_result_smtp);
-  if(g_hash_table_contains(smtpvariables, "SMTPHostName") && g_hash_table_contains(smtpvariables, "SMTPPort"))
-  {
-    g_string_append_printf(client_cmd, " -S smtp=\"%s:%s\"", (char *)g_hash_table_lookup(smtpvariables, "SMTPHostName"),
-        (char *)g_hash_table_lookup(smtpvariables, "SMTPPort"));
-    if(g_hash_table_contains(smtpvariables, "SMTPStartTls"))
-    {
-      temp_smtpvariable = (char *)g_hash_table_lookup(smtpvariables, "SMTPStartTls");
-      if(g_strcmp0(temp_smtpvariable, "1") == 0)
-      {
-        g_string_append_printf(client_cmd, " -S smtp-use-starttls");
-      }
-    }
-    if(g_hash_table_contains(smtpvariables, "SMTPAuth"))
-    {
-      temp_smtpvariable = (char *)g_hash_table_lookup(smtpvariables, "SMTPAuth");
-      if(g_strcmp0(temp_smtpvariable, "L") == 0)
-      {
-        g_string_append_printf(client_cmd, " -S smtp-auth=login");
-      }
-      else if(g_strcmp0(temp_smtpvariable, "P") == 0)
-      {
-        g_string_append_printf(client_cmd, " -S smtp-auth=plain");
-      }
-    }
-    if(g_hash_table_contains(smtpvariables, "SMTPAuthUser"))
-    {
-      g_string_append_printf(client_cmd, " -S smtp-auth-user=\"%s\" -S from=\"%s\"",
-          (char *)g_hash_table_lookup(smtpvariables, "SMTPAuthUser"),
-          (char *)g_hash_table_lookup(smtpvariables, "SMTPAuthUser"));
-    }
-    if(g_hash_table_contains(smtpvariables, "SMTPAuthPasswd"))
-    {
-      g_string_append_printf(client_cmd, " -S smtp-auth-password=\"%s\"",
-         (char *)g_hash_table_lookup(smtpvariables, "SMTPAuthPasswd"));
-    }
-    if(g_hash_table_contains(smtpvariables, "SMTPSslVerify"))
-    {
-      temp_smtpvariable = (char *)g_hash_table_lookup(smtpvariables, "SMTPSslVerify");
-      g_string_append(client_cmd, " -S ssl-verify=");
-      if(g_strcmp0(temp_smtpvariable, "I") == 0)
-      {
-        g_string_append(client_cmd, "ignore");
-      }
-      else if(g_strcmp0(temp_smtpvariable, "S") == 0)
-      {
-        g_string_append(client_cmd, "strict");
-      }
-      else if(g_strcmp0(temp_smtpvariable, "W") == 0)
-      {
-        g_string_append(client_cmd, "warn");
-      }
-    }
-    temp_smtpvariable = NULL;
-    final_command = g_strdup_printf(EMAIL_BUILD_CMD, scheduler->email_command,
-                  client_cmd->str, scheduler->email_subject, user_email);
-  }
-  else
-  {
-    NOTIFY("Unable to send email. SMTP host or port not found in the configuration.\n"
-        "Please check Configuration Variables.");
-    final_command = NULL;
-  }
-  g_hash_table_destroy(smtpvariables);
-  g_string_free(client_cmd, TRUE);
   return final_command;
 }
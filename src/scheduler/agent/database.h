@@ -36,7 +36,9 @@ extern const char* jobsql_failed;
 /* ************************************************************************** */
 
 void database_init(scheduler_t* scheduler);
+void database_listen_destroy();
 void email_init(scheduler_t* scheduler);
+void email_worker_destroy();
 
 /* ************************************************************************** */
 /* **** event and functions ************************************************* */
@@ -45,12 +47,15 @@ void email_init(scheduler_t* scheduler);
 PGresult* database_exec(scheduler_t* scheduler, const char* sql);
 void database_exec_event(scheduler_t* scheduler, char* sql);
 void database_update_event(scheduler_t* scheduler, void* unused);
+void database_processed_event(scheduler_t* scheduler, void* unused);
 
 void database_reset_queue(scheduler_t* scheduler);
 void database_update_job(scheduler_t* db_conn, job_t* j, job_status status);
 void database_job_processed(int j_id, int number);
 void database_job_log(int j_id, char* log_name);
 void database_job_priority(scheduler_t* scheduler, job_t* job, int priority);
+GPtrArray* database_job_chunks(scheduler_t* scheduler, job_t* job);
 char* get_email_command(scheduler_t* scheduler, char* user_email);
+gboolean email_exited(pid_t pid, int status);
 
 #endif /* DATABASE_H_INCLUDE */
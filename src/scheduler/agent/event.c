@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <event.h>
 #include <logging.h>
 #include <scheduler.h>
+#include <stats.h>
 
 /* std libaray includes */
 #include <stdlib.h>
@@ -45,6 +46,9 @@ event_loop_t vl_singleton;
  */
 int el_created = 0;
 
+/** The names of the event priorities, used as label of the statistics */
+const char* event_priority_strings[] = { "high", "normal", "low" };
+
 /**
  * There is only one instance of an event loop in any program. This function
  * will control access to that event loop. If the event loop hasn't been created
@@ -58,6 +62,7 @@ int el_created = 0;
  */
 event_loop_t* event_loop_get()
 {
+  int i;
 
   /* if the event loop has already been created, return it */
   if(el_created)
@@ -65,7 +70,10 @@ event_loop_t* event_loop_get()
     return &vl_singleton;
   }
 
-  vl_singleton.queue = g_async_queue_new_full((GDestroyNotify)event_destroy);
+  vl_singleton.queue = g_async_queue_new();
+  for(i = 0; i < EVENT_PRIORITIES; i++)
+    vl_singleton.events[i] = g_queue_new();
+  vl_singleton.awake      = 0;
   vl_singleton.occupied   = 0;
   vl_singleton.terminated = 0;
   el_created = 1;
@@ -73,11 +81,26 @@ event_loop_t* event_loop_get()
   return &vl_singleton;
 }
 
+/**
+ * @brief The number of events waiting in the event loop, the caller must hold
+ *        the lock of the queue.
+ */
+static guint event_loop_length_unlocked(event_loop_t* event_loop)
+{
+  guint ret = 0;
+  int i;
+
+  for(i = 0; i < EVENT_PRIORITIES; i++)
+    ret += g_queue_get_length(event_loop->events[i]);
+
+  return ret;
+}
+
 /**
  * puts a new item into the event queue. The event queue acts as a circular,
  * concurrent queue, and as a result this function must correct synchronize on
- * the queue to prevent race conditions. This will lock the queue, and wait if
- * the queue is full.
+ * the queue to prevent race conditions. The event is added to the end of the
+ * queue of its priority and the event loop is woken up if it is waiting.
  *
  * @param event_loop the event loop to add the event to
  * @param e the event to put into the event loop
@@ -85,49 +108,149 @@ event_loop_t* event_loop_get()
  */
 int event_loop_put(event_loop_t* event_loop, event_t* e)
 {
-  g_async_queue_push(event_loop->queue, e);
+  g_async_queue_lock(event_loop->queue);
+  g_queue_push_tail(event_loop->events[e->priority], e);
+  if(!event_loop->awake)
+  {
+    event_loop->awake = 1;
+    g_async_queue_push_unlocked(event_loop->queue, event_loop);
+  }
+  g_async_queue_unlock(event_loop->queue);
   return 1;
 }
 
 /**
- * Takes the next item out of the queue. The event queue acts as a circular,
- * concurrent queue, and as a result this function must correctly synchronize on
- * the queue to prevent race conditions. This will lock the queue, and wait if
- * the queue is full.
+ * @brief Puts events that were taken but not run back at the front of their
+ *        queues, so that they are the next ones taken.
  *
- * @param event_loop the event loop to get the event out of
- * @return the next event in the event loop, NULL if the event loop has ended
+ * @param event_loop the event loop the events were taken from
+ * @param batch      the events, in the order they were taken
+ * @param n          the number of events
  */
-event_t* event_loop_take(event_loop_t* event_loop)
+static void event_loop_return(event_loop_t* event_loop, event_t** batch, guint n)
 {
-  GTimeVal timeout;
-  event_t* ret;
+  g_async_queue_lock(event_loop->queue);
+  while(n > 0)
+  {
+    n--;
+    g_queue_push_head(event_loop->events[batch[n]->priority], batch[n]);
+  }
+  g_async_queue_unlock(event_loop->queue);
+}
+
+/**
+ * @brief Takes the next events out of the queue, at most max of them.
+ *
+ * If there are no events this waits for one, for at most a second. The events
+ * are taken in the order of their priority, but every priority that has
+ * events waiting gets at least one of them, so a steady stream of important
+ * events cannot starve the others. The events that signal the end of the
+ * event loop are dropped.
+ *
+ * @param event_loop the event loop to get the events out of
+ * @param batch      filled with the events in the order they should be run
+ * @param max        the size of batch
+ * @return the number of events in batch, 0 if there were none or the event
+ *         loop has ended
+ */
+guint event_loop_take_batch(event_loop_t* event_loop, event_t** batch, guint max)
+{
+  guint quota[EVENT_PRIORITIES];
+  guint n, length, ret = 0;
+  event_t* e;
+  int i;
 
   if(event_loop->terminated)
   {
-    return NULL;
+    return 0;
   }
 
-  /* wait for 1 second */
-  timeout.tv_sec  = 1;
-  timeout.tv_usec = 0;
+  g_async_queue_lock(event_loop->queue);
 
+  /* the token is taken with the events, later puts have to wake us again */
+  if(event_loop->awake)
+  {
+    g_async_queue_try_pop_unlocked(event_loop->queue);
+    event_loop->awake = 0;
+  }
+
+  /* wait for 1 second */
+  if(event_loop_length_unlocked(event_loop) == 0)
+  {
 #if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
-  if((ret = g_async_queue_timeout_pop(event_loop->queue,
-      timeout.tv_sec * 1000000 + timeout.tv_usec)) == NULL)
-    return ret;
+    if(g_async_queue_timeout_pop_unlocked(event_loop->queue, 1000000) != NULL)
+      event_loop->awake = 0;
 #else
-  g_get_current_time(&timeout);
-  g_time_val_add(&timeout, 1000000);
-  if((ret = g_async_queue_timed_pop(event_loop->queue, &timeout)) == NULL)
-    return ret;
+    GTimeVal timeout;
+    g_get_current_time(&timeout);
+    g_time_val_add(&timeout, 1000000);
+    if(g_async_queue_timed_pop_unlocked(event_loop->queue, &timeout) != NULL)
+      event_loop->awake = 0;
 #endif
+  }
 
-  if(ret->func == NULL)
+  /* one event of every priority that has some, then the rest by priority */
+  n = max;
+  for(i = 0; i < EVENT_PRIORITIES; i++)
   {
-    event_destroy(ret);
-    ret = NULL;
+    quota[i] = (n > 0 && !g_queue_is_empty(event_loop->events[i])) ? 1 : 0;
+    n -= quota[i];
   }
+  for(i = 0; i < EVENT_PRIORITIES; i++)
+  {
+    length = g_queue_get_length(event_loop->events[i]) - quota[i];
+    quota[i] += MIN(length, n);
+    n -= MIN(length, n);
+  }
+
+  for(i = 0; i < EVENT_PRIORITIES; i++)
+  {
+    while(quota[i]-- > 0)
+    {
+      e = g_queue_pop_head(event_loop->events[i]);
+      if(e->func == NULL)
+        event_destroy(e);
+      else
+        batch[ret++] = e;
+    }
+  }
+
+  g_async_queue_unlock(event_loop->queue);
+  return ret;
+}
+
+/**
+ * Takes the next item out of the queue. The event queue acts as a circular,
+ * concurrent queue, and as a result this function must correctly synchronize on
+ * the queue to prevent race conditions. This will wait for at most a second
+ * if the queue is empty.
+ *
+ * @param event_loop the event loop to get the event out of
+ * @return the next event in the event loop, NULL if the event loop has ended
+ */
+event_t* event_loop_take(event_loop_t* event_loop)
+{
+  event_t* ret;
+
+  if(event_loop_take_batch(event_loop, &ret, 1) == 0)
+    return NULL;
+
+  return ret;
+}
+
+/**
+ * @brief The number of events waiting in the event loop.
+ *
+ * @param event_loop the event loop to count the events of
+ * @return the number of events of all priorities
+ */
+guint event_loop_length(event_loop_t* event_loop)
+{
+  guint ret;
+
+  g_async_queue_lock(event_loop->queue);
+  ret = event_loop_length_unlocked(event_loop);
+  g_async_queue_unlock(event_loop->queue);
 
   return ret;
 }
@@ -159,6 +282,8 @@ event_t* event_init(void(*func)(scheduler_t*, void*), void* arg, char* name, cha
   e->name = name;
   e->source_name = source_name;
   e->source_line = source_line;
+  e->created = g_get_monotonic_time();
+  e->priority = EVENT_NORMAL;
 
   return e;
 }
@@ -184,7 +309,15 @@ void event_destroy(event_t* e)
  */
 void event_loop_destroy()
 {
-  g_async_queue_unref(event_loop_get()->queue);
+  event_loop_t* event_loop = event_loop_get();
+  int i;
+
+  for(i = 0; i < EVENT_PRIORITIES; i++)
+  {
+    g_queue_foreach(event_loop->events[i], (GFunc)event_destroy, NULL);
+    g_queue_free(event_loop->events[i]);
+  }
+  g_async_queue_unref(event_loop->queue);
   el_created = 0;
 }
 
@@ -205,8 +338,29 @@ void event_loop_destroy()
  */
 void event_signal_ext(void* func, void* args, char* name, char* s_name, uint16_t s_line)
 {
+  event_signal_priority_ext(func, args, EVENT_NORMAL, name, s_name, s_line);
+}
+
+/**
+ * Same as event_signal_ext() for an event of the given priority. Events of a
+ * higher priority are run before the ones that are already waiting.
+ *
+ * @param func
+ * @param args
+ * @param priority the priority of the event
+ * @param name name of the event
+ * @param s_name source file name creating the event
+ * @param s_line line number of the source file creating the event
+ */
+void event_signal_priority_ext(void* func, void* args, event_priority priority,
+    char* name, char* s_name, uint16_t s_line)
+{
+  event_t* e;
+
   V_EVENT("EVENT: creating event: [%p, %p, %s, %s, %d]", func, args, name, s_name, s_line);
-  event_loop_put(event_loop_get(), event_init((event_function)func, args, name, s_name, s_line));
+  e = event_init((event_function)func, args, name, s_name, s_line);
+  e->priority = priority;
+  event_loop_put(event_loop_get(), e);
 }
 
 /**
@@ -217,9 +371,14 @@ void event_signal_ext(void* func, void* args, char* name, char* s_name, uint16_t
  * return until the program is ready to exit. There should also only be one
  * thread working on this part of the event loop.
  *
+ * The events are taken in batches of up to EVENT_BATCH, see
+ * event_loop_take_batch(), so that a full queue only takes the lock once for
+ * every batch.
+ *
  * @param scheduler   scheduler reference to to be notified
- * @param update_call a function that is called every time an event is processed
- * @param signal_call a function that is called once a second
+ * @param update_call a function that is called after every batch of events
+ * @param signal_call a function that is called before every batch of events,
+ *                    and at least once a second
  * @return this function will return an error code:
  *          0x0:   successful execution
  *          0x1:   attempt to enter a loop that is occupied
@@ -228,7 +387,9 @@ int event_loop_enter(scheduler_t* scheduler,
     void(*update_call)(scheduler_t*),
     void(*signal_call)(scheduler_t*))
 {
+  event_t* batch[EVENT_BATCH];
   event_t* e;
+  guint i, n;
   event_loop_t* event_loop = event_loop_get();
 
   /* start by checking to make sure this is the only thread in this loop */
@@ -248,21 +409,33 @@ int event_loop_enter(scheduler_t* scheduler,
   /* the loop to execute events is very simple, grab event, run event */
   while(!event_loop->terminated)
   {
-    e = event_loop_take(event_loop);
+    n = event_loop_take_batch(event_loop, batch, EVENT_BATCH);
 
     if(signal_call)
       signal_call(scheduler);
-    if(e == NULL)
+    if(n == 0)
       continue;
 
-    if(TVERB_EVENT && strcmp(e->name, "log_event") != 0)
-      log_printf("EVENT: calling %s, source[%s.%d] \n", e->name, e->source_name, e->source_line);
-    e->func(scheduler, e->argument);
+    for(i = 0; i < n; i++)
+    {
+      /* the events after the one that ended the loop are left for later */
+      if(event_loop->terminated)
+      {
+        event_loop_return(event_loop, batch + i, n - i);
+        break;
+      }
+
+      e = batch[i];
+      if(TVERB_EVENT && strcmp(e->name, "log_event") != 0)
+        log_printf("EVENT: calling %s, source[%s.%d] \n", e->name, e->source_name, e->source_line);
+      stats_event_lag(e->priority, (g_get_monotonic_time() - e->created) / 1e6);
+      e->func(scheduler, e->argument);
 
-    if(TVERB_EVENT && strcmp(e->name, "log_event") != 0)
-      log_printf("EVENT: finished %s, source[%s.%d] \n", e->name, e->source_name, e->source_line);
+      if(TVERB_EVENT && strcmp(e->name, "log_event") != 0)
+        log_printf("EVENT: finished %s, source[%s.%d] \n", e->name, e->source_name, e->source_line);
 
-    event_destroy(e);
+      event_destroy(e);
+    }
 
     if(update_call)
       update_call(scheduler);
@@ -284,5 +457,5 @@ void event_loop_terminate()
 
   event_loop->terminated = 1;
   event_loop->occupied = 0;
-  event_signal(NULL, NULL);
+  event_signal_priority(NULL, NULL, EVENT_HIGH);
 }
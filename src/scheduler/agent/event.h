@@ -30,6 +30,22 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 /* ************************************************************************** */
 
 #define EVENT_LOOP_SIZE 1024
+#define EVENT_BATCH     64   ///< The most events run for one wakeup of the event loop
+
+/**
+ * The priority of an event. Events of a higher priority are run first, events
+ * of the same priority in the order they were created.
+ */
+typedef enum {
+  EVENT_HIGH,       ///< The events of agents and jobs, the log lines of the other
+                    ///< threads and the scheduler closing. None of them may pass
+                    ///< the death of an agent, which frees the agent and its job
+  EVENT_NORMAL,     ///< Everything else
+  EVENT_LOW,        ///< Bookkeeping that can wait, like the progress of the jobs
+  EVENT_PRIORITIES  ///< The number of priorities
+} event_priority;
+
+extern const char* event_priority_strings[];
 
 /** interanl structure for an event */
 typedef struct {
@@ -38,11 +54,19 @@ typedef struct {
   char* name;                       ///< Name of the event, used for debugging
   char*    source_name;             ///< Name of the source file creating the event
   uint16_t source_line;             ///< Line in the source file creating the event
+  gint64   created;                 ///< When the event was created, in monotonic microseconds
+  event_priority priority;          ///< The queue of the event loop the event is in
 } event_t;
 
-/** internal structure for the event loop */
+/**
+ * internal structure for the event loop. The events wait in one queue per
+ * priority, which are protected by the lock of the GAsyncQueue. The
+ * GAsyncQueue itself only holds a token to wake up the event loop.
+ */
 typedef struct event_loop {
-  GAsyncQueue* queue; ///< The queue that is the core of the event loop
+  GAsyncQueue* queue; ///< Wakes up the event loop, its lock protects the events
+  GQueue* events[EVENT_PRIORITIES]; ///< The waiting events of every priority
+  int awake;          ///< The wake up token is in the queue
   int terminated;     ///< Flag that signals the end of the event loop
   int occupied;       ///< Does this loop already have a worker thread
 } event_loop_t;
@@ -65,8 +89,11 @@ typedef struct
 
 event_t* event_init(void(*func)(scheduler_t*, void*), void* arg, char* name, char* source_name, uint16_t source_line);
 void     event_destroy(event_t* e);
+event_loop_t* event_loop_get();
 int event_loop_put(event_loop_t* event_loop, event_t* event);
 event_t* event_loop_take(event_loop_t* event_loop);
+guint    event_loop_take_batch(event_loop_t* event_loop, event_t** batch, guint max);
+guint    event_loop_length(event_loop_t* event_loop);
 
 void     event_loop_destroy();
 
@@ -75,8 +102,12 @@ void     event_loop_destroy();
 /* ************************************************************************** */
 
 #define event_signal(func, args) event_signal_ext(func, args, #func, __FILE__, __LINE__)
+#define event_signal_priority(func, args, priority) \
+  event_signal_priority_ext(func, args, priority, #func, __FILE__, __LINE__)
 
 void event_signal_ext(void* func, void* args, char* name, char* s_name, uint16_t s_line);
+void event_signal_priority_ext(void* func, void* args, event_priority priority,
+    char* name, char* s_name, uint16_t s_line);
 int  event_loop_enter(scheduler_t* scheduler, void(*)(scheduler_t*), void(*)(scheduler_t*));
 void event_loop_terminate();
 
@@ -186,6 +186,7 @@ void interface_usage()
   printf("|%*s:   reload the configuration information          |\n", P_WIDTH, "reload");
   printf("|%*s:   prints a list of valid agents                 |\n", P_WIDTH, "agents");
   printf("|%*s:   scheduler responds with status information    |\n", P_WIDTH, "status [jq_pk]");
+  printf("|%*s:   scheduler responds with agent metrics         |\n", P_WIDTH, "metrics [jq_pk]");
   printf("|%*s:   restart a paused job                          |\n", P_WIDTH, "restart <jq_pk>");
   printf("|%*s:   query/change the scheduler/job verbosity      |\n", P_WIDTH, "verbose [jq_pk] [level]");
   printf("|%*s:   change priority for job that this jq_pk is in |\n", P_WIDTH, "priority <jq_pk> <level>");
@@ -389,6 +390,7 @@ int main(int argc, char** argv)
 
       response = (strncmp(buffer, "agents",  6) == 0 ||
                   strncmp(buffer, "status",  6) == 0 ||
+                  strncmp(buffer, "metrics", 7) == 0 ||
                   strcmp (buffer, "verbose\n" ) == 0 ||
                   strcmp (buffer, "load\n"    ) == 0) ?
                       FALSE : TRUE;
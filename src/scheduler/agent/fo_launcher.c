@@ -0,0 +1,374 @@
+/* **************************************************************
+Copyright (C) 2026 Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+************************************************************** */
+/**
+ * \file
+ * \brief Starts the agents of a scheduler on the host it runs on
+ *
+ * The scheduler starts fo_launcher once per remote host, using ssh, and sends
+ * it frames on stdin, see launch_frame. For every LAUNCH_SPAWN frame the
+ * launcher starts an agent, copies LAUNCH_DATA frames to the stdin of the
+ * agent and sends whatever the agent writes back as LAUNCH_DATA frames on
+ * stdout. Once an agent is gone a LAUNCH_EXIT frame carries its exit status.
+ *
+ * The launcher kills every agent and exits when its stdin is closed, which
+ * happens when the scheduler or the ssh connection goes away.
+ */
+
+/* scheduler includes */
+#include <launcher.h>
+
+/* std library includes */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* unix includes */
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* other library includes */
+#include <glib.h>
+
+/** An agent started by the launcher */
+typedef struct
+{
+    int32_t id;       ///< the id the scheduler gave the agent
+    pid_t   pid;      ///< the process of the agent
+    int     to_child; ///< the stdin of the agent
+    int     from_child; ///< the stdout and stderr of the agent, -1 once closed
+} child_t;
+
+static GHashTable* children; ///< the running agents, keyed by id
+
+/**
+ * @brief Writes a whole buffer, a full pipe blocks the launcher.
+ */
+static gboolean write_full(int fd, const char* buf, size_t len)
+{
+  ssize_t n;
+
+  while (len > 0)
+  {
+    if ((n = write(fd, buf, len)) < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return FALSE;
+    buf += n;
+    len -= n;
+  }
+
+  return TRUE;
+}
+
+/**
+ * @brief Sends the output of an agent to the scheduler.
+ *
+ * @param child  the agent
+ * @param drain  read until nothing is left, used once the agent is gone
+ */
+static void child_read(child_t* child, gboolean drain)
+{
+  char buf[LAUNCHER_BUF];
+  ssize_t len;
+
+  do
+  {
+    len = read(child->from_child, buf, sizeof(buf));
+    if (len < 0 && errno == EINTR)
+      continue;
+    if (len < 0 && errno == EAGAIN)
+      return;
+    if (len <= 0)
+    {
+      close(child->from_child);
+      child->from_child = -1;
+      return;
+    }
+    if (!launcher_write_frame(fileno(stdout), child->id, LAUNCH_DATA, buf, len))
+      exit(1);
+  } while (drain);
+}
+
+/**
+ * @brief Starts an agent for a LAUNCH_SPAWN frame.
+ *
+ * @param id    the id of the agent
+ * @param data  its priority and arguments, each terminated by a '\0'
+ * @param len   the length of data
+ */
+static void child_spawn(int32_t id, char* data, uint32_t len)
+{
+  child_t* child;
+  GPtrArray* args = g_ptr_array_new();
+  int to[2], from[2];
+  int priority;
+  uint32_t pos;
+  sigset_t mask;
+  gchar* dir;
+  int32_t status;
+
+  priority = atoi(data);
+  for (pos = strlen(data) + 1; pos < len; pos += strlen(data + pos) + 1)
+    g_ptr_array_add(args, data + pos);
+  g_ptr_array_add(args, NULL);
+
+  if (args->len < 2 || pipe2(to, O_CLOEXEC) != 0 || pipe2(from, O_CLOEXEC) != 0)
+  {
+    fprintf(stderr, "ERROR: unable to start agent %d: %s\n", id, strerror(errno));
+    status = htonl(W_EXITCODE(5, 0));
+    launcher_write_frame(fileno(stdout), id, LAUNCH_EXIT, &status, sizeof(status));
+    g_ptr_array_free(args, TRUE);
+    return;
+  }
+
+  child = g_new0(child_t, 1);
+  child->id = id;
+  child->to_child = to[1];
+  child->from_child = from[0];
+
+  if ((child->pid = fork()) == 0)
+  {
+    dup2(to[0], fileno(stdin));
+    dup2(from[1], fileno(stdout));
+    dup2(from[1], fileno(stderr));
+
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+    signal(SIGPIPE, SIG_DFL);
+
+    if (nice(priority) == -1)
+      fprintf(stderr, "ERROR: unable to set priority of agent: %s\n", strerror(errno));
+
+    dir = g_path_get_dirname(g_ptr_array_index(args, 0));
+    if (chdir(dir) != 0)
+      fprintf(stderr, "ERROR: unable to change working directory: %s\n", strerror(errno));
+
+    execv(g_ptr_array_index(args, 0), (char**) args->pdata);
+
+    fprintf(stderr, "ERROR: exec of %s failed: %s\n", (char*) g_ptr_array_index(args, 0), strerror(errno));
+    _exit(5);
+  }
+
+  close(to[0]);
+  close(from[1]);
+  g_ptr_array_free(args, TRUE);
+
+  if (child->pid < 0)
+  {
+    close(child->to_child);
+    close(child->from_child);
+    g_free(child);
+    status = htonl(W_EXITCODE(5, 0));
+    launcher_write_frame(fileno(stdout), id, LAUNCH_EXIT, &status, sizeof(status));
+    return;
+  }
+
+  fcntl(child->from_child, F_SETFL, fcntl(child->from_child, F_GETFL) | O_NONBLOCK);
+  g_hash_table_insert(children, &child->id, child);
+}
+
+/**
+ * @brief Collects the agents that are gone and tells the scheduler.
+ */
+static void child_reap()
+{
+  GHashTableIter iter;
+  child_t* child;
+  int32_t status;
+  pid_t pid;
+  int ret;
+
+  while ((pid = waitpid(-1, &ret, WNOHANG)) > 0)
+  {
+    g_hash_table_iter_init(&iter, children);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer*) &child))
+    {
+      if (child->pid != pid)
+        continue;
+
+      if (child->from_child >= 0)
+        child_read(child, TRUE);
+
+      status = htonl(ret);
+      if (!launcher_write_frame(fileno(stdout), child->id, LAUNCH_EXIT, &status, sizeof(status)))
+        exit(1);
+
+      close(child->to_child);
+      g_hash_table_iter_remove(&iter);
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Handles one frame from the scheduler.
+ *
+ * @return FALSE once the scheduler is gone
+ */
+static gboolean launcher_command()
+{
+  child_t* child;
+  uint32_t type, len, value = 0;
+  int32_t id;
+  char* data;
+
+  if (!launcher_read_frame(fileno(stdin), &id, &type, &data, &len))
+    return FALSE;
+
+  child = g_hash_table_lookup(children, &id);
+  if (len == sizeof(value))
+  {
+    memcpy(&value, data, sizeof(value));
+    value = ntohl(value);
+  }
+
+  switch (type)
+  {
+    case LAUNCH_SPAWN:
+      if (child == NULL)
+        child_spawn(id, data, len);
+      break;
+    case LAUNCH_DATA:
+      if (child != NULL && !write_full(child->to_child, data, len))
+        fprintf(stderr, "ERROR: unable to write to agent %d: %s\n", id, strerror(errno));
+      break;
+    case LAUNCH_SIGNAL:
+      if (child != NULL)
+        kill(child->pid, (int) value);
+      break;
+    case LAUNCH_PRIORITY:
+      if (child != NULL)
+        setpriority(PRIO_PROCESS, child->pid, (int) value);
+      break;
+  }
+
+  g_free(data);
+  return TRUE;
+}
+
+/**
+ * @brief Frees an agent, used as the value destroy function of children.
+ */
+static void child_destroy(child_t* child)
+{
+  if (child->from_child >= 0)
+    close(child->from_child);
+  g_free(child);
+}
+
+int main(int argc, char** argv)
+{
+  struct signalfd_siginfo info;
+  GHashTableIter iter;
+  child_t* child;
+  GArray* fds;
+  GPtrArray* polled;
+  struct pollfd pfd;
+  sigset_t mask;
+  int sig_fd;
+  guint i;
+  gboolean running = TRUE;
+
+  if (argc != 1)
+  {
+    fprintf(stderr, "Usage: %s\n", argv[0]);
+    fprintf(stderr, "  Started by the scheduler, starts its agents on this host.\n");
+    return 255;
+  }
+
+  children = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, (GDestroyNotify) child_destroy);
+
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  sigaddset(&mask, SIGTERM);
+  sigaddset(&mask, SIGHUP);
+  sigaddset(&mask, SIGINT);
+  sigprocmask(SIG_BLOCK, &mask, NULL);
+  signal(SIGPIPE, SIG_IGN);
+  if ((sig_fd = signalfd(-1, &mask, SFD_CLOEXEC)) < 0)
+  {
+    fprintf(stderr, "ERROR: unable to create signalfd: %s\n", strerror(errno));
+    return 1;
+  }
+
+  fds = g_array_new(FALSE, FALSE, sizeof(struct pollfd));
+  polled = g_ptr_array_new();
+
+  while (running)
+  {
+    g_array_set_size(fds, 0);
+    g_ptr_array_set_size(polled, 0);
+
+    pfd.events = POLLIN;
+    pfd.fd = fileno(stdin);
+    g_array_append_val(fds, pfd);
+    pfd.fd = sig_fd;
+    g_array_append_val(fds, pfd);
+
+    g_hash_table_iter_init(&iter, children);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer*) &child))
+    {
+      if (child->from_child < 0)
+        continue;
+      pfd.fd = child->from_child;
+      g_array_append_val(fds, pfd);
+      g_ptr_array_add(polled, child);
+    }
+
+    if (poll((struct pollfd*) fds->data, fds->len, -1) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      fprintf(stderr, "ERROR: poll failed: %s\n", strerror(errno));
+      break;
+    }
+
+    /* the output of the agents first, their exit is reported after it */
+    for (i = 0; i < polled->len; i++)
+      if (g_array_index(fds, struct pollfd, i + 2).revents)
+        child_read(g_ptr_array_index(polled, i), FALSE);
+
+    if (g_array_index(fds, struct pollfd, 1).revents)
+    {
+      if (read(sig_fd, &info, sizeof(info)) == sizeof(info) && info.ssi_signo != SIGCHLD)
+        running = FALSE;
+      child_reap();
+    }
+
+    if (g_array_index(fds, struct pollfd, 0).revents && !launcher_command())
+      running = FALSE;
+  }
+
+  /* without the scheduler the agents have nobody to talk to */
+  g_hash_table_iter_init(&iter, children);
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer*) &child))
+    kill(child->pid, SIGKILL);
+
+  g_hash_table_destroy(children);
+  g_array_free(fds, TRUE);
+  g_ptr_array_free(polled, TRUE);
+  close(sig_fd);
+  return 0;
+}
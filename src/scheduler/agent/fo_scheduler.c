@@ -125,6 +125,7 @@ int main(int argc, char** argv)
 
   scheduler_foss_config(scheduler);
   if(s_daemon && scheduler_daemonize(scheduler) == -1) { return -1; }
+  log_writer_init();
   scheduler_agent_config(scheduler);
 
   database_init(scheduler);
@@ -145,6 +146,9 @@ int main(int argc, char** argv)
   signal(SIGQUIT, scheduler_sig_handle);
   signal(SIGHUP,  scheduler_sig_handle);
 
+  /* a lost launcher must not take the scheduler with it */
+  signal(SIGPIPE, SIG_IGN);
+
   /* ***************************************************** */
   /* *** we have finished initialization without error *** */
   /* ***************************************************** */
@@ -44,6 +44,158 @@ static int print_host_all(gchar* host_name, host_t* host, GOutputStream* ostr)
   return 0;
 }
 
+/**
+ * @brief GTraverseFunc that finds the largest memory budget of the hosts.
+ *
+ * @param host_name  the string name of the host
+ * @param host       the host struct paired with the name
+ * @param budget     the largest budget so far
+ * @return always 0 so that the traversal continues
+ */
+static int host_find_budget(gchar* host_name, host_t* host, uint32_t* budget)
+{
+  *budget = MAX(*budget, host->budget);
+  return 0;
+}
+
+/**
+ * @brief GTraverseFunc that finds the host whose launcher runs as a process.
+ *
+ * @param host_name  the string name of the host
+ * @param host       the host struct paired with the name
+ * @param found      in: the pid of the process, out: the host if found
+ * @return TRUE to stop the traversal once the host is found
+ */
+static int host_find_launcher(gchar* host_name, host_t* host, gpointer* found)
+{
+  if (host->launcher != NULL && host->launcher->pid == *(pid_t*)found[0])
+  {
+    found[1] = host;
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Checks if the load reported for a host is recent enough to be used.
+ *
+ * @param host the host to check
+ * @return TRUE if an agent reported the load within agent_update_interval
+ */
+static gboolean host_load_known(host_t* host)
+{
+  return host->reported != 0 && time(NULL) - host->reported <= CONF_agent_update_interval;
+}
+
+/**
+ * @brief The expected load of a host in percent once an agent of a given
+ *        weight runs on it.
+ *
+ * This is the larger of the weights of the agents on the host compared to the
+ * number of agents it may run, and the cpu load last reported from the host.
+ * The weights react at once when an agent starts, the reported load also
+ * sees whatever else is running on the host.
+ *
+ * @param host    the host to check
+ * @param weight  the weight of the new agent
+ * @return the expected load in percent
+ */
+static int host_score(host_t* host, uint32_t weight)
+{
+  int score = 100 * (host->weight + weight) / host->max;
+
+  if (host_load_known(host) && host->load > score)
+    score = host->load;
+  return score;
+}
+
+/**
+ * @brief Placement policy that takes the hosts in turn.
+ *
+ * @param queue    the hosts, the last used host is at the end
+ * @param num      the number of free slots needed
+ * @param weight   the weight of the new agent, not used
+ * @param memory   the memory in MB the new agent is expected to use
+ * @param reserve  the percentage of every host that must stay free
+ * @return the first host with enough free slots, NULL if there is none
+ */
+static host_t* host_round_robin(GList* queue, uint8_t num, uint32_t weight, uint32_t memory,
+    uint32_t reserve)
+{
+  GList*  curr;
+  host_t* host;
+
+  for(curr = queue; curr != NULL; curr = curr->next)
+  {
+    host = curr->data;
+    if(host_free(host, reserve) >= num && host_fits(host, memory))
+      return host;
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Placement policy that picks the host with the lowest expected load.
+ *
+ * Hosts that reported less than host_min_memory MB of available memory are
+ * only used if no other host has a free slot. Between hosts with the same
+ * expected load, hosts that store part of the repository are preferred, then
+ * the host that was used least recently.
+ *
+ * @param queue    the hosts, the last used host is at the end
+ * @param num      the number of free slots needed
+ * @param weight   the weight of the new agent
+ * @param memory   the memory in MB the new agent is expected to use
+ * @param reserve  the percentage of every host that must stay free
+ * @return the least loaded host with enough free slots, NULL if there is none
+ */
+static host_t* host_least_loaded(GList* queue, uint8_t num, uint32_t weight, uint32_t memory,
+    uint32_t reserve)
+{
+  GList*   curr;
+  host_t*  host;
+  host_t*  ret = NULL;
+  gboolean low, ret_low = FALSE;
+  int      score, ret_score = 0;
+
+  for(curr = queue; curr != NULL; curr = curr->next)
+  {
+    host = curr->data;
+    if(host_free(host, reserve) < num || !host_fits(host, memory))
+      continue;
+
+    low = host_load_known(host) && host->memory >= 0 &&
+        (uint32_t)host->memory < CONF_host_min_memory;
+    score = host_score(host, weight);
+
+    if(ret == NULL || low < ret_low || (low == ret_low &&
+        (score < ret_score || (score == ret_score && host->repo && !ret->repo))))
+    {
+      ret = host;
+      ret_low = low;
+      ret_score = score;
+    }
+  }
+
+  return ret;
+}
+
+/**
+ * The placement policies, indexed by host_policy. A new policy is added here
+ * and to the host_policy enum, and is selected with host_policy in the
+ * SCHEDULER section of fossology.conf.
+ */
+static const struct
+{
+  const char* name;
+  host_t* (*select)(GList* queue, uint8_t num, uint32_t weight, uint32_t memory, uint32_t reserve);
+} host_policies[] =
+{
+  { "roundrobin",  host_round_robin  },
+  { "leastloaded", host_least_loaded }
+};
+
 /* ************************************************************************** */
 /* **** Contructor Destructor *********************************************** */
 /* ************************************************************************** */
@@ -66,6 +218,15 @@ host_t* host_init(char* name, char* address, char* agent_dir, int max)
   host->agent_dir = g_strdup(agent_dir);
   host->max = max;
   host->running = 0;
+  host->weight = 0;
+  host->load = -1;
+  host->memory = -1;
+  host->reported = 0;
+  host->repo = FALSE;
+  host->budget = 0;
+  host->reserved = 0;
+  host->pool = NULL;
+  host->launcher = NULL;
 
   return host;
 }
@@ -80,12 +241,16 @@ void host_destroy(host_t* host)
   g_free(host->name);
   g_free(host->address);
   g_free(host->agent_dir);
+  g_list_free(host->pool);
+  launcher_destroy(host->launcher);
 
   host->name = NULL;
   host->address = NULL;
   host->agent_dir = NULL;
   host->max = 0;
   host->running = 0;
+  host->pool = NULL;
+  host->launcher = NULL;
 
   g_free(host);
 }
@@ -109,23 +274,56 @@ void host_insert(host_t* host, scheduler_t* scheduler)
 /**
  * @brief Increase the number of running agents on a host by 1
  *
- * @param host The relevant host
+ * @param host    The relevant host
+ * @param weight  The weight of the agent type, see get_host()
  */
-void host_increase_load(host_t* host)
+void host_increase_load(host_t* host, uint32_t weight)
 {
   host->running++;
-  V_HOST("HOST[%s] load increased to %d\n", host->name, host->running);
+  host->weight += weight;
+  V_HOST("HOST[%s] load increased to %d, weight %u\n", host->name, host->running, host->weight);
 }
 
 /**
  * @brief Decrease the number of running agents on a host by 1
  *
- * @param host the relevant host
+ * @param host    the relevant host
+ * @param weight  The weight of the agent type, see get_host()
  */
-void host_decrease_load(host_t* host)
+void host_decrease_load(host_t* host, uint32_t weight)
 {
   host->running--;
-  V_HOST("HOST[%s] load decreased to %d\n", host->name, host->running);
+  host->weight -= MIN(weight, host->weight);
+  V_HOST("HOST[%s] load decreased to %d, weight %u\n", host->name, host->running, host->weight);
+}
+
+/**
+ * @brief Changes the memory that is expected to be used on a host.
+ *
+ * @param host    the relevant host
+ * @param memory  the memory in MB, negative when an agent stops running
+ */
+void host_reserve(host_t* host, int memory)
+{
+  host->reserved = MAX(host->reserved + memory, 0);
+  V_HOST("HOST[%s] memory reserved %d of %u MB\n", host->name, host->reserved, host->budget);
+}
+
+/**
+ * @brief Records the load that an agent reported for the host it runs on.
+ *
+ * \note only called from the main thread, which reads the load when it places
+ *       agents, see agent_load_event()
+ *
+ * @param host    the host the agent runs on
+ * @param load    the cpu load in percent of all cpus of the host
+ * @param memory  the available memory of the host in MB
+ */
+void host_report_load(host_t* host, int load, int memory)
+{
+  host->load = load;
+  host->memory = memory;
+  host->reported = time(NULL);
 }
 
 /**
@@ -145,34 +343,126 @@ void host_print(host_t* host, GOutputStream* ostr)
   g_free(buf);
 }
 
+/**
+ * @brief Checks if a process that died was the launcher of a host.
+ *
+ * The launcher thread notices that the connection is lost on its own, this
+ * only keeps launcher_ready() from waiting for a process that is gone.
+ *
+ * @param host_list  the hosts of the scheduler
+ * @param pid        the process that died
+ * @param status     its status from waitpid()
+ * @return TRUE if it was the launcher of a host
+ */
+gboolean host_launcher_exited(GTree* host_list, pid_t pid, int status)
+{
+  gpointer found[2] = { &pid, NULL };
+  host_t* host;
+
+  g_tree_foreach(host_list, (GTraverseFunc)host_find_launcher, found);
+  if ((host = found[1]) == NULL)
+    return FALSE;
+
+  WARNING("launcher of host %s exited, status %d", host->name, status);
+  host->launcher->pid = 0;
+  return TRUE;
+}
+
+/**
+ * @brief Gets the placement policy with the given name.
+ *
+ * Used to load host_policy from the SCHEDULER section of fossology.conf.
+ *
+ * @param name  the name of the policy, "roundrobin" or "leastloaded"
+ * @return the policy, HOST_LEAST_LOADED if the name is unknown
+ */
+host_policy host_policy_parse(const char* name)
+{
+  int i;
+
+  for(i = 0; i < G_N_ELEMENTS(host_policies); i++)
+    if(strcmp(name, host_policies[i].name) == 0)
+      return i;
+
+  WARNING("unknown host_policy \"%s\", using %s", name, host_policies[HOST_LEAST_LOADED].name);
+  return HOST_LEAST_LOADED;
+}
+
+/**
+ * @brief The number of agents that can still be started on a host.
+ *
+ * A part of every host can be kept free for interactive jobs, see
+ * interactive_reserve in scheduler.h. Jobs that may not use it pass the
+ * percentage that is reserved, interactive jobs pass 0.
+ *
+ * @param host     the host to check
+ * @param reserve  the percentage of the host's max that must stay free
+ * @return the number of free slots, may be negative
+ */
+int host_free(host_t* host, uint32_t reserve)
+{
+  return host->max - host->running - host->max * (int)MIN(reserve, 100) / 100;
+}
+
+/**
+ * @brief Finds the largest memory budget of the hosts.
+ *
+ * No agent is expected to need more than this, see meta_agent_learn_memory().
+ *
+ * @param host_list  the hosts of the scheduler
+ * @return the budget in MB, 0 if no host has one
+ */
+uint32_t host_max_budget(GTree* host_list)
+{
+  uint32_t budget = 0;
+
+  g_tree_foreach(host_list, (GTraverseFunc)host_find_budget, &budget);
+  return budget;
+}
+
+/**
+ * @brief Checks if an agent fits into the memory budget of a host.
+ *
+ * The budget is the optional fourth value of the host's entry in the HOSTS
+ * section of fossology.conf. An agent is always admitted on a host where no
+ * memory is reserved, so that an agent whose estimate is larger than the
+ * budget still runs, alone.
+ *
+ * @param host    the host to check
+ * @param memory  the memory in MB the agent is expected to use
+ * @return TRUE if the agent can be started on the host
+ */
+gboolean host_fits(host_t* host, uint32_t memory)
+{
+  return host->budget == 0 || host->reserved <= 0 ||
+      (uint32_t)host->reserved + memory <= host->budget;
+}
+
 /**
  * Gets a host for which there are at least num agents available to start
- * new agents on.
+ * new agents on. Which of these hosts is used depends on the host_policy that
+ * is configured, by default the host with the lowest expected load is used.
+ * Agent types declare how heavy they are with the weight key of their
+ * configuration file, the weight of an agent that does not is 1.
  *
- * @param queue GList of available hosts
- * @param num the number of agents to start on the host
+ * @param queue    GList of available hosts
+ * @param num      the number of agents to start on the host
+ * @param weight   the weight of the agent type that will be started
+ * @param memory   the memory in MB the agent is expected to use, see host_fits()
+ * @param reserve  the percentage of every host that must stay free, see host_free()
  * @return the host with that number of available slots, NULL if none exist
  */
-host_t* get_host(GList** queue, uint8_t num)
+host_t* get_host(GList** queue, uint8_t num, uint32_t weight, uint32_t memory, uint32_t reserve)
 {
-  GList*  host_queue = *queue;
-  GList*  curr       = NULL;
-  host_t* ret        = NULL;
+  host_t* ret;
 
-  for(curr = host_queue; curr != NULL; curr = curr->next)
-  {
-    ret = curr->data;
-    if(ret->max - ret->running >= num)
-      break;
-  }
-
-  if(curr == NULL)
+  ret = host_policies[MIN(CONF_host_policy, HOST_LEAST_LOADED)].select(
+      *queue, num, weight, memory, reserve);
+  if(ret == NULL)
     return NULL;
 
-  host_queue = g_list_remove(host_queue, ret);
-  host_queue = g_list_append(host_queue, ret);
-
-  *queue = host_queue;
+  *queue = g_list_remove(*queue, ret);
+  *queue = g_list_append(*queue, ret);
   return ret;
 }
 
@@ -20,10 +20,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define HOST_H_INCLUDE
 
 /* scheduler includes */
+#include <launcher.h>
 #include <scheduler.h>
 
 /* std includes */
 #include <stdio.h>
+#include <time.h>
 
 /* other library includes */
 #include <gio/gio.h>
@@ -41,8 +43,24 @@ typedef struct {
   char* agent_dir;  ///< The location on the host machine where the executables are
   int max;          ///< The max number of agents that can run on this host
   int running;      ///< The number of agents currently running on this host
+  uint32_t weight;  ///< The sum of the weights of the agents running on this host
+  int load;         ///< The last reported cpu load in percent of all cpus, -1 if unknown
+  int memory;       ///< The last reported available memory in MB, -1 if unknown
+  time_t reported;  ///< When load and memory were last reported by an agent
+  gboolean repo;    ///< The host stores part of the repository
+  uint32_t budget;  ///< The memory in MB the agents on this host may use, 0 for no limit
+  int reserved;     ///< The memory in MB the running agents are expected to use
+  GList* pool;      ///< The idle agents kept on this host, see agent_pool_add()
+  launcher_t* launcher; ///< Starts the agents on a remote host, NULL until first used
 } host_t;
 
+/** The policies get_host() can use to place a new agent, see host_policy_parse() */
+typedef enum
+{
+  HOST_ROUND_ROBIN,  ///< The next host with a free slot, in turn
+  HOST_LEAST_LOADED  ///< The host with the lowest expected load
+} host_policy;
+
 /* ************************************************************************** */
 /* **** Contructor Destructor *********************************************** */
 /* ************************************************************************** */
@@ -55,11 +73,18 @@ void host_destroy(host_t* h);
 /* ************************************************************************** */
 
 void host_insert(host_t* host, scheduler_t* scheduler);
-void host_increase_load(host_t* host);
-void host_decrease_load(host_t* host);
+void host_increase_load(host_t* host, uint32_t weight);
+void host_decrease_load(host_t* host, uint32_t weight);
+void host_report_load(host_t* host, int load, int memory);
+void host_reserve(host_t* host, int memory);
 void host_print(host_t* host, GOutputStream* ostr);
+gboolean host_launcher_exited(GTree* host_list, pid_t pid, int status);
 
-host_t* get_host(GList** queue, uint8_t num);
+host_policy host_policy_parse(const char* name);
+int      host_free(host_t* host, uint32_t reserve);
+gboolean host_fits(host_t* host, uint32_t memory);
+uint32_t host_max_budget(GTree* host_list);
+host_t*  get_host(GList** queue, uint8_t num, uint32_t weight, uint32_t memory, uint32_t reserve);
 void    print_host_load(GTree* host_list, GOutputStream* ostr);
 
 #endif /* HOST_H_INCLUDE */
@@ -27,6 +27,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <job.h>
 #include <logging.h>
 #include <scheduler.h>
+#include <stats.h>
 
 /* std library includes */
 #include <stdio.h>
@@ -47,6 +48,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define FIELD_WIDTH 10
 #define BUFFER_SIZE 1024
+#define HTTP_TIMEOUT 5  ///< seconds an http request waits for the main thread
 
 #define netw g_output_stream_write
 
@@ -106,6 +108,67 @@ static void interface_conn_destroy(interface_connection* inter)
   g_free(inter);
 }
 
+/**
+ * @brief Answers an http request that was sent to the interface port.
+ *
+ * This lets a monitoring system like Prometheus scrape the statistics of the
+ * scheduler from "GET /metrics" without a separate listening socket. The rest
+ * of the request header is read and ignored, then the connection is closed.
+ * The statistics are printed by the main thread, see stats_prometheus_event().
+ *
+ * @param conn       the connection the request came from
+ * @param scheduler  the scheduler the statistics are printed for
+ * @param request    the first part of the request that was already read
+ */
+static void interface_http(interface_connection* conn, scheduler_t* scheduler, char* request)
+{
+  GString* header = g_string_new(request);
+  GAsyncQueue* reply;
+  char buffer[BUFFER_SIZE];
+  char* body = NULL;
+  char* response;
+  gssize len;
+#if !(GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32)
+  GTimeVal timeout;
+#endif
+
+  /* a request that is not read completely is reset instead of closed */
+  while(strstr(header->str, "\r\n\r\n") == NULL && header->len < BUFFER_SIZE * 8 &&
+      (len = g_input_stream_read(conn->istr, buffer, sizeof(buffer) - 1, scheduler->cancel, NULL)) > 0)
+    g_string_append_len(header, buffer, len);
+
+  if(strncmp(header->str, "GET /metrics ", 13) == 0 || strncmp(header->str, "GET /metrics\r", 13) == 0)
+  {
+    reply = g_async_queue_new_full(g_free);
+    event_signal(stats_prometheus_event, g_async_queue_ref(reply));
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+    body = g_async_queue_timeout_pop(reply, HTTP_TIMEOUT * 1000000);
+#else
+    g_get_current_time(&timeout);
+    g_time_val_add(&timeout, HTTP_TIMEOUT * 1000000);
+    body = g_async_queue_timed_pop(reply, &timeout);
+#endif
+    g_async_queue_unref(reply);
+  }
+
+  if(body != NULL)
+    response = g_strdup_printf("HTTP/1.0 200 OK\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: close\r\n\r\n%s", strlen(body), body);
+  else if(strncmp(header->str, "GET /metrics", 12) == 0)
+    response = g_strdup("HTTP/1.0 503 Service Unavailable\r\nConnection: close\r\n\r\n");
+  else
+    response = g_strdup("HTTP/1.0 404 Not Found\r\nConnection: close\r\n\r\n");
+
+  V_INTERFACE("INTERFACE: http request answered with \"%.12s\"\n", response + 9);
+  g_output_stream_write_all(conn->ostr, response, strlen(response), NULL, NULL, NULL);
+
+  g_string_free(header, TRUE);
+  g_free(response);
+  g_free(body);
+}
+
 /**
  * @brief Function that will run the thread associated with a particular interface
  * instance.
@@ -129,6 +192,7 @@ static void interface_conn_destroy(interface_connection* inter)
  * |  verbose | Change verbose level for scheduler or job |
  * | priority | Change the priority of job |
  * | database | Check the database job queue |
+ * | GET /metrics | Statistics in the Prometheus format, answered over http |
  *
  * @param  conn      Pointer to the interface_connection structure
  * @param  scheduler Pointer to the relevant scheduler structure
@@ -152,6 +216,19 @@ void interface_thread(interface_connection* conn, scheduler_t* scheduler)
     V_INTERFACE("INTERFACE: received \"%s\"\n", buffer);
     /* convert all characters before first ' ' to lower case */
     memcpy(org, buffer, sizeof(buffer));
+
+    /* command: "GET /metrics HTTP/1.x"
+     *
+     * An http request, most likely from a monitoring system. It is answered
+     * with the statistics of the scheduler and the connection is closed.
+     */
+    if(strncmp(org, "GET ", 4) == 0)
+    {
+      org[sizeof(org) - 1] = '\0';
+      interface_http(conn, scheduler, org);
+      break;
+    }
+
     for(cmd = buffer; *cmd; cmd++)
       *cmd = g_ascii_tolower(*cmd);
     g_regex_match(scheduler->parse_interface_cmd, buffer, 0, &regex_match);
@@ -196,7 +273,7 @@ void interface_thread(interface_connection* conn, scheduler_t* scheduler)
     {
       g_output_stream_write(conn->ostr, "CLOSE\n", 6, NULL, NULL);
       V_INTERFACE("INTERFACE: shutting down scheduler gracefully\n");
-      event_signal(scheduler_close_event, (void*)0);
+      event_signal_priority(scheduler_close_event, (void*)0, EVENT_HIGH);
 
       g_match_info_free(regex_match);
       g_free(cmd);
@@ -213,7 +290,7 @@ void interface_thread(interface_connection* conn, scheduler_t* scheduler)
     {
       g_output_stream_write(conn->ostr, "CLOSE\n", 6, NULL, NULL);
       V_INTERFACE("INTERFACE: killing the scheduler\n");
-      event_signal(scheduler_close_event, (void*)1);
+      event_signal_priority(scheduler_close_event, (void*)1, EVENT_HIGH);
 
       g_match_info_free(regex_match);
       g_free(cmd);
@@ -263,7 +340,7 @@ void interface_thread(interface_connection* conn, scheduler_t* scheduler)
         if(job->message)
           g_free(job->message);
         job->message = strdup(((arg2 == NULL) ? "no message" : arg2));
-        event_signal(job_fail_event, job);
+        event_signal_priority(job_fail_event, job, EVENT_HIGH);
       }
 
       g_free(arg1);
@@ -292,7 +369,7 @@ void interface_thread(interface_connection* conn, scheduler_t* scheduler)
         params = g_new0(arg_int, 1);
         params->second = atoi(arg1);
         params->first = g_tree_lookup(scheduler->job_list, &params->second);
-        event_signal(job_pause_event, params);
+        event_signal_priority(job_pause_event, params, EVENT_HIGH);
         g_free(arg1);
       }
     }
@@ -335,7 +412,29 @@ void interface_thread(interface_connection* conn, scheduler_t* scheduler)
       params = g_new0(arg_int, 1);
       params->first = conn->ostr;
       params->second = (arg1 == NULL) ? 0 : atoi(arg1);
-      event_signal(job_status_event, params);
+      event_signal_priority(job_status_event, params, EVENT_HIGH);
+
+      g_free(arg1);
+    }
+
+    /* command: "metrics [job_id]"
+     *
+     * fetches the metrics that the agents have sent with "METRIC:". The
+     * argument is not required for this command.
+     *
+     * with job_id:
+     *   print the job totals followed by the metrics of its running agents
+     * without job_id:
+     *   print the totals of every job followed by the totals of every host
+     */
+    else if(strcmp(cmd, "metrics") == 0)
+    {
+      arg1 = g_match_info_fetch(regex_match, 3);
+
+      params = g_new0(arg_int, 1);
+      params->first = conn->ostr;
+      params->second = (arg1 == NULL) ? 0 : atoi(arg1);
+      event_signal_priority(job_metrics_event, params, EVENT_HIGH);
 
       g_free(arg1);
     }
@@ -364,7 +463,7 @@ void interface_thread(interface_connection* conn, scheduler_t* scheduler)
         params = g_new0(arg_int, 1);
         params->second = atoi(arg1);
         params->first = g_tree_lookup(scheduler->job_list, &params->second);
-        event_signal(job_restart_event, params);
+        event_signal_priority(job_restart_event, params, EVENT_HIGH);
         g_free(arg1);
       }
     }
@@ -417,7 +516,7 @@ void interface_thread(interface_connection* conn, scheduler_t* scheduler)
         else
         {
           job->verbose = atoi(arg2);
-          event_signal(job_verbose_event, job);
+          event_signal_priority(job_verbose_event, job, EVENT_HIGH);
         }
 
         g_free(arg1);
@@ -443,7 +542,7 @@ void interface_thread(interface_connection* conn, scheduler_t* scheduler)
         params = g_new0(arg_int, 1);
         params->first = g_tree_lookup(scheduler->job_list, &i);
         params->second = atoi(arg2);
-        event_signal(job_priority_event, params);
+        event_signal_priority(job_priority_event, params, EVENT_HIGH);
         g_free(arg1);
         g_free(arg2);
       }
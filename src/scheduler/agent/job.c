@@ -26,6 +26,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <database.h>
 #include <job.h>
 #include <scheduler.h>
+#include <stats.h>
 
 /* std library includes */
 #include <stdlib.h>
@@ -110,6 +111,124 @@ static int job_sstatus(int* job_id, job_t* job, GOutputStream* ostr)
   return 0;
 }
 
+/**
+ * @brief Adds the total of a counter kept by a job to a set of metrics.
+ *
+ * @param name    the name of the counter
+ * @param metric  the counter
+ * @param into    the metrics to add to
+ * @return always returns 0
+ */
+static int job_add_metric(char* name, agent_metric* metric, GTree* into)
+{
+  agent_metric* total;
+
+  if((total = g_tree_lookup(into, name)) == NULL)
+  {
+    total = g_new0(agent_metric, 1);
+    g_tree_insert(into, g_strdup(name), total);
+  }
+
+  if(!total->gauge)
+    total->value += metric->value;
+  return 0;
+}
+
+/**
+ * @brief Prints the metrics of a job to the output stream.
+ *
+ * The metrics of the job are the totals of its finished agents plus the
+ * current metrics of its running agents. The output will be in this format:
+ *   job:<id> type:<agent type> running:<# running> [<name>:<value> [<name>/s:<rate>]]...
+ *
+ * @param job_id the id number that the job was created with
+ *   @note if the int pointed to by the job_id is value 0, that means
+ *         print the metrics of the running agents as well
+ * @param job  the job itself
+ * @param ostr the output stream to write everything to
+ * @return always returns 0
+ */
+static int job_smetrics(int* job_id, job_t* job, GOutputStream* ostr)
+{
+  GTree* totals = metrics_init();
+  GString* str = g_string_new(NULL);
+  GList* iter;
+
+  for(iter = job->running_agents; iter != NULL; iter = iter->next)
+    agent_fold_metrics(iter->data, totals, TRUE);
+
+  /* the finished agents only left counters behind */
+  g_tree_foreach(job->metrics, (GTraverseFunc)job_add_metric, totals);
+
+  g_string_printf(str, "job:%d type:%s running:%d",
+      job->id, job->agent_type, g_list_length(job->running_agents));
+  metrics_print(totals, str);
+  g_string_append(str, "\n");
+  g_output_stream_write(ostr, str->str, str->len, NULL, NULL);
+
+  if(*job_id == 0)
+    g_list_foreach(job->running_agents, (GFunc)agent_print_metrics, ostr);
+
+  g_string_free(str, TRUE);
+  g_tree_destroy(totals);
+  return 0;
+}
+
+/**
+ * @brief Finds a job in the job queue.
+ *
+ * A runonpfile job stays in the queue while it is running, see
+ * scheduler_update().
+ *
+ * @param job_queue  The queue to search
+ * @param job        The job to find
+ * @return the position of the job in the queue, NULL if it is not queued
+ */
+static GSequenceIter* job_queued(GSequence* job_queue, job_t* job)
+{
+  GSequenceIter* iter;
+
+  for(iter = g_sequence_get_begin_iter(job_queue);
+      !g_sequence_iter_is_end(iter); iter = g_sequence_iter_next(iter))
+    if(g_sequence_get(iter) == job)
+      return iter;
+
+  return NULL;
+}
+
+/**
+ * @brief Lets the jobs that wait for a job know that it is finished.
+ *
+ * A job that no longer waits for any other job is queued. If the job failed,
+ * the jobs that wait for it can never run and are dropped, see job_drop().
+ *
+ * @param scheduler  The scheduler that this job belongs to
+ * @param job        The job that completed or failed
+ */
+static void job_release(scheduler_t* scheduler, job_t* job)
+{
+  GList* dependents = job->dependents;
+  GList* iter;
+  job_t* dependent;
+
+  job->dependents = NULL;
+  for(iter = dependents; iter != NULL; iter = iter->next)
+  {
+    dependent = iter->data;
+    dependent->depends = g_list_remove(dependent->depends, job);
+
+    if(job->status == JB_FAILED)
+      job_drop(scheduler, dependent);
+    else if(dependent->depends == NULL)
+    {
+      V_JOB("JOB[%d]: job %d completed, queued\n", dependent->id, job->id);
+      job_ready(scheduler, dependent);
+    }
+  }
+
+  g_list_free(dependents);
+}
+
 /**
  * Changes the status of the job and updates the database with the new job status
  *
@@ -119,14 +238,37 @@ static int job_sstatus(int* job_id, job_t* job, GOutputStream* ostr)
  */
 static void job_transition(scheduler_t* scheduler, job_t* job, job_status new_status)
 {
+  GSequenceIter* iter;
+
   /* book keeping */
   TEST_NULV(job);
   V_JOB("JOB[%d]: job status changed: %s => %s\n",
       job->id, job_status_strings[job->status], job_status_strings[new_status]);
 
+  /* the throughput statistics only count real jobs */
+  if(job->id >= 0 && new_status == JB_STARTED && job->started == 0)
+  {
+    job->started = g_get_monotonic_time();
+    stats_job_started(job->agent_type, (job->started - job->queued) / 1e6);
+  }
+  if(job->id >= 0 && (new_status == JB_COMPLETE || new_status == JB_FAILED) &&
+      job->status != JB_COMPLETE && job->status != JB_FAILED)
+    stats_job_finished(job->agent_type, job->started == 0 ? -1 :
+        (g_get_monotonic_time() - job->started) / 1e6, new_status == JB_FAILED);
+
   /* change the job status */
   job->status = new_status;
 
+  /* the jobs that wait for this one can run now, or never */
+  if(new_status == JB_COMPLETE || new_status == JB_FAILED)
+    job_release(scheduler, job);
+
+  /* a finished or paused job must not get new agents */
+  if(job->chunks != NULL &&
+      (new_status == JB_COMPLETE || new_status == JB_FAILED || new_status == JB_PAUSED) &&
+      (iter = job_queued(scheduler->job_queue, job)) != NULL)
+    g_sequence_remove(iter);
+
   /* only update database for real jobs */
   if(job->id >= 0)
     database_update_job(scheduler, job, new_status);
@@ -161,7 +303,8 @@ static gint job_compare(gconstpointer a, gconstpointer b, gpointer user_data)
  * new agent to deal with the data.
  *
  * @param job_list   The list of all jobs, the job will be added to this list
- * @param job_queue  The job queue, the job must be added to this for scheduling
+ * @param job_queue  The job queue, the job must be added to this for scheduling,
+ *                   NULL if job_ready() queues it later
  * @param type       The type of agent that will be created for this job
  * @param host       The name of the host that this job will execute on
  * @param id         The id number for the job in the database
@@ -185,9 +328,17 @@ job_t* job_init(GTree* job_list, GSequence* job_queue,
   job->log             = NULL;
   job->status          = JB_CHECKEDOUT;
   job->data            = NULL;
-  job->db_result       = NULL;
-  job->lock            = NULL;
   job->idx             = 0;
+  job->chunks          = NULL;
+  job->retry           = NULL;
+  job->done            = 0;
+  job->chunk_failed    = FALSE;
+  job->n_agents        = 0;
+  job->preempted       = FALSE;
+  job->oom_retries     = 0;
+  job->runonpfile      = FALSE;
+  job->depends         = NULL;
+  job->dependents      = NULL;
   job->message         = NULL;
   job->priority        = priority;
   job->verbose         = 0;
@@ -196,9 +347,12 @@ job_t* job_init(GTree* job_list, GSequence* job_queue,
   job->user_id         = user_id;
   job->group_id        = group_id;
   job->jq_cmd_args     = g_strdup(jq_cmd_args);
+  job->metrics         = metrics_init();
+  job->queued          = g_get_monotonic_time();
+  job->started         = 0;
 
   g_tree_insert(job_list, &job->id, job);
-  if(id >= 0) g_sequence_insert_sorted(job_queue, job, job_compare, NULL);
+  if(id >= 0 && job_queue != NULL) g_sequence_insert_sorted(job_queue, job, job_compare, NULL);
   return job;
 }
 
@@ -213,18 +367,10 @@ void job_destroy(job_t* job)
 {
   TEST_NULV(job);
 
-  if(job->db_result != NULL)
+  if(job->chunks != NULL)
   {
-    SafePQclear(job->db_result);
-
-    // Lock the mutex to prevent clearing locked mutex
-    g_mutex_lock(job->lock);
-    g_mutex_unlock(job->lock);
-#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
-    g_mutex_clear(job->lock);
-#else
-    g_mutex_free(job->lock);
-#endif
+    g_ptr_array_free(job->chunks, TRUE);
+    g_queue_free(job->retry);
   }
 
   if(job->log)
@@ -233,11 +379,14 @@ void job_destroy(job_t* job)
   g_list_free(job->running_agents);
   g_list_free(job->finished_agents);
   g_list_free(job->failed_agents);
+  g_list_free(job->depends);
+  g_list_free(job->dependents);
   g_free(job->message);
   g_free(job->agent_type);
   g_free(job->required_host);
   g_free(job->data);
   if (job->jq_cmd_args) g_free(job->jq_cmd_args);
+  g_tree_destroy(job->metrics);
   g_free(job);
 }
 
@@ -311,6 +460,116 @@ void job_status_event(scheduler_t* scheduler, arg_int* params)
   g_free(params);
 }
 
+/**
+ * @brief Frees the metrics collected for one host by job_host_fold().
+ *
+ * @param host the metrics and the number of running agents
+ */
+static void job_host_free(arg_int* host)
+{
+  g_tree_destroy(host->first);
+  g_free(host);
+}
+
+/**
+ * @brief Prints the metrics of a running agent and adds them to the totals of
+ *        the host the agent is running on.
+ *
+ * @param pid_ptr  the key that was used to store this agent
+ * @param agent    the agent
+ * @param hosts    the totals of every host, keyed by host name
+ * @return always returns 0
+ */
+static int job_host_fold(int* pid_ptr, agent_t* agent, GTree* hosts)
+{
+  arg_int* host;
+
+  if(agent->status != AG_RUNNING && agent->status != AG_PAUSED)
+    return 0;
+
+  if((host = g_tree_lookup(hosts, agent->host->name)) == NULL)
+  {
+    host = g_new0(arg_int, 1);
+    host->first = metrics_init();
+    g_tree_insert(hosts, agent->host->name, host);
+  }
+
+  host->second++;
+  agent_fold_metrics(agent, host->first, TRUE);
+  return 0;
+}
+
+/**
+ * @brief Prints the totals of one host collected by job_host_fold().
+ *
+ * @param name  the name of the host
+ * @param host  the metrics and the number of running agents
+ * @param ostr  the output stream to write to
+ * @return always returns 0
+ */
+static int job_host_print(char* name, arg_int* host, GOutputStream* ostr)
+{
+  GString* str = g_string_new(NULL);
+
+  g_string_printf(str, "host:%s running:%d", name, host->second);
+  metrics_print(host->first, str);
+  g_string_append(str, "\n");
+  g_output_stream_write(ostr, str->str, str->len, NULL, NULL);
+
+  g_string_free(str, TRUE);
+  return 0;
+}
+
+/**
+ * @brief Event to get the metrics sent by the agents.
+ *
+ * This is only generated by the interface receiving a metrics command. Like
+ * job_status_event() the parameter is a pair, the first is the
+ * g_output_stream to write to, the second is either 0 (every agent, job and
+ * host) or the jq_pk of the job that the metrics were requested for.
+ *
+ * Without a jq_pk, every job is printed followed by one line per host in this
+ * format:
+ *   host:<name> running:<# running> [<name>:<value> [<name>/s:<rate>]]...
+ *
+ * @param scheduler  the scheduler this event is called on
+ * @param params     the g_output_stream and possibly the jq_pk of the job
+ */
+void job_metrics_event(scheduler_t* scheduler, arg_int* params)
+{
+  const char end[] = "end\n";
+  char buf[1024];
+  int tmp;
+
+  if(!params->second)
+  {
+    GTree* hosts = g_tree_new_full(string_compare, NULL, NULL, (GDestroyNotify)job_host_free);
+
+    g_tree_foreach(scheduler->job_list, (GTraverseFunc)job_smetrics, params->first);
+    g_tree_foreach(scheduler->agents, (GTraverseFunc)job_host_fold, hosts);
+    g_tree_foreach(hosts, (GTraverseFunc)job_host_print, params->first);
+
+    g_tree_destroy(hosts);
+  }
+  else
+  {
+    job_t* job = g_tree_lookup(scheduler->job_list, &params->second);
+    if(job)
+    {
+      tmp = 0;
+      job_smetrics(&tmp, job, params->first);
+    }
+    else
+    {
+      sprintf(buf, "ERROR: invalid job id = %d\n", params->second);
+      g_output_stream_write(params->first, buf, strlen(buf), NULL, NULL);
+    }
+  }
+
+  g_output_stream_write(params->first, end, sizeof(end), NULL, NULL);
+  g_free(params);
+}
+
 /**
  * @brief Event to pause a job.
  *
@@ -333,10 +592,13 @@ void job_pause_event(scheduler_t* scheduler, arg_int* params)
     tmp_job.status         = JB_NOT_AVAILABLE;
     tmp_job.running_agents = NULL;
     tmp_job.message        = NULL;
+    tmp_job.chunks         = NULL;
 
     job = &tmp_job;
   }
 
+  /* a job paused by a user is not resumed by the scheduler */
+  job->preempted = FALSE;
   job_transition(scheduler, job, JB_PAUSED);
   for(iter = job->running_agents; iter != NULL; iter = iter->next)
     agent_pause(iter->data);
@@ -344,6 +606,29 @@ void job_pause_event(scheduler_t* scheduler, arg_int* params)
   g_free(params);
 }
 
+/**
+ * @brief Pauses a job so that an interactive job can use the slots of its
+ *        agents.
+ *
+ * Only runonpfile jobs are preempted. Their agents are not stopped, they are
+ * paused in agent_ready_event() once they finish their chunk, the next time
+ * they call fo_scheduler_next(). The remaining chunks wait until the job is
+ * restarted. Agents of other jobs cannot stop in the middle of their upload,
+ * so scheduler_preempt() never picks them. The job is restarted with
+ * job_restart_event() when scheduler_update() finds room for it again.
+ *
+ * @param scheduler  the scheduler the job belongs to
+ * @param job        the job to pause
+ */
+void job_preempt(scheduler_t* scheduler, job_t* job)
+{
+  TEST_NULV(job);
+  V_JOB("JOB[%d]: preempted by an interactive job\n", job->id);
+
+  job_transition(scheduler, job, JB_PAUSED);
+  job->preempted = TRUE;
+}
+
 /**
  * Event to restart a paused job. This is called by the interface.
  *
@@ -363,6 +648,8 @@ void job_restart_event(scheduler_t* scheduler, arg_int* params)
     tmp_job.status         = JB_PAUSED;
     tmp_job.running_agents = NULL;
     tmp_job.message        = NULL;
+    tmp_job.chunks         = NULL;
+    tmp_job.preempted      = FALSE;
 
     event_signal(database_update_event, NULL);
     job = &tmp_job;
@@ -378,11 +665,20 @@ void job_restart_event(scheduler_t* scheduler, arg_int* params)
 
   for(iter = job->running_agents; iter != NULL; iter = iter->next)
   {
-    if(job->db_result != NULL) agent_write(iter->data, "OK\n", 3);
     agent_unpause(iter->data);
+    /* agents of a runonpfile job that finished their chunk ask for the next one */
+    if(job->chunks != NULL && ((agent_t*)iter->data)->chunk == NULL)
+      agent_write(iter->data, "OK\n", 3);
   }
 
+  job->preempted = FALSE;
   job_transition(scheduler, job, JB_RESTART);
+
+  /* the chunks that had no agent when the job was paused need new ones */
+  if(job->chunks != NULL && job_agents_wanted(job) > 0 &&
+      job_queued(scheduler->job_queue, job) == NULL)
+    g_sequence_insert_sorted(scheduler->job_queue, job, job_compare, NULL);
+
   g_free(params);
 }
 
@@ -400,7 +696,7 @@ void job_priority_event(scheduler_t* scheduler, arg_int* params)
   database_job_priority(scheduler, params->first, params->second);
   ((job_t*)params->first)->priority = params->second;
   for(iter = ((job_t*)params->first)->running_agents; iter; iter = iter->next)
-    setpriority(PRIO_PROCESS, ((agent_t*)iter->data)->pid, params->second);
+    agent_priority(iter->data, params->second);
   g_free(params);
 }
 
@@ -510,38 +806,145 @@ void job_fail_agent(job_t* job, void* agent)
 }
 
 /**
- * Sets the data that a job should be working on. Currently runonpfile is not
- * implemented, so sql will always be true.
+ * Sets the data that a job should be working on. The pfiles of a runonpfile
+ * job are split into chunks once the job is ready, see job_ready().
  *
- * @param scheduler Scheduler containing database connection, used for runonpfile
+ * @param scheduler Scheduler containing database connection
  * @param job      the job to set the data for
  * @param data     the data that the job should be processing
- * @param sql      currently, always false
- * @todo runonpfile is not implemented
+ * @param sql      true if the job is a runonpfile job
  */
 void job_set_data(scheduler_t* scheduler, job_t* job, char* data, int sql)
 {
   job->data = g_strdup(data);
   job->idx = 0;
+  job->runonpfile = sql;
+}
+
+/**
+ * Makes a job wait for another one to complete. The job is queued by
+ * job_ready() once every job it depends on is complete, so that the scheduler
+ * does not have to ask the database whether the job is ready. A job that
+ * depends on a failed job can never run.
+ *
+ * @param job         the job that waits
+ * @param dependency  the job it waits for
+ * @return FALSE if the dependency failed
+ */
+gboolean job_depend(job_t* job, job_t* dependency)
+{
+  TEST_NULL(job, FALSE);
+  TEST_NULL(dependency, FALSE);
+
+  if(dependency->status == JB_FAILED)
+    return FALSE;
+  if(dependency->status == JB_COMPLETE)
+    return TRUE;
+
+  job->depends = g_list_prepend(job->depends, dependency);
+  dependency->dependents = g_list_prepend(dependency->dependents, job);
+  return TRUE;
+}
+
+/**
+ * Removes a job that waits for other jobs from the system, together with the
+ * jobs that wait for it. This is done when a job it depends on failed. The
+ * job stays in the job queue of the database, where it is not picked up again
+ * since one of its dependencies failed.
+ *
+ * @param scheduler  the scheduler the job belongs to
+ * @param job        the job to remove
+ */
+void job_drop(scheduler_t* scheduler, job_t* job)
+{
+  GList* iter;
+
+  TEST_NULV(job);
+  V_JOB("JOB[%d]: can not run, removed from system\n", job->id);
+
+  for(iter = job->depends; iter != NULL; iter = iter->next)
+    ((job_t*)iter->data)->dependents = g_list_remove(((job_t*)iter->data)->dependents, job);
+
+  /* the jobs waiting for this one are dropped as well */
+  job->status = JB_FAILED;
+  job_release(scheduler, job);
+  g_tree_remove(scheduler->job_list, &job->id);
+}
+
+/**
+ * Queues a job that does not wait for other jobs. A runonpfile job is split
+ * into chunks first, so that several agents can work on the job at the same
+ * time. This is only done now since the pfiles of the upload are known once
+ * the jobs it depends on, like the unpack, are complete. If the upload can not
+ * be split, the job is run by a single agent like any other job.
+ *
+ * @param scheduler  the scheduler the job belongs to
+ * @param job        the job that is ready
+ */
+void job_ready(scheduler_t* scheduler, job_t* job)
+{
+  TEST_NULV(job);
 
-  if(sql)
+  if(job->runonpfile && job->chunks == NULL &&
+      (job->chunks = database_job_chunks(scheduler, job)) != NULL)
   {
-    // TODO
-    //j->db_result = PQexec(db_conn, j->data);
-    //j->lock = g_mutex_new();
+    job->retry = g_queue_new();
+    V_JOB("JOB[%d]: split into %u chunks\n", job->id, job->chunks->len);
   }
+
+  job->queued = g_get_monotonic_time();
+  g_sequence_insert_sorted(scheduler->job_queue, job, job_compare, NULL);
+}
+
+/**
+ * Hands the remaining chunks of a runonpfile job to an agent. An idle agent of
+ * the job is woken up if there is one, otherwise the job goes back into the
+ * job queue so that scheduler_update() starts new agents for it.
+ *
+ * @param scheduler  the scheduler the job belongs to
+ * @param job        the job with chunks that have no agent
+ */
+static void job_wake(scheduler_t* scheduler, job_t* job)
+{
+  GList* curr;
+  agent_t* agent;
+
+  for(curr = job->finished_agents; curr != NULL; curr = curr->next)
+  {
+    agent = curr->data;
+    if(agent->status == AG_PAUSED)
+    {
+      V_JOB("JOB[%d]: waking agent %d for the remaining chunks\n", job->id, agent->pid);
+      job->finished_agents = g_list_remove(job->finished_agents, agent);
+      job->running_agents  = g_list_append(job->running_agents,  agent);
+      agent_transition(agent, AG_RUNNING);
+      agent_ready_event(scheduler, agent);
+      return;
+    }
+  }
+
+  if(job_queued(scheduler->job_queue, job) != NULL)
+    return;
+
+  V_JOB("JOB[%d]: queued again for the remaining chunks\n", job->id);
+  g_sequence_insert_sorted(scheduler->job_queue, job, job_compare, NULL);
 }
 
 /**
  * Updates the status of the job. This will check the status of all agents that belong
  * to this job and if the job has finished or all of the agents have fail
  *
+ * When the job completes, its finished agents are closed or go to the agent
+ * pool. If all of them went to the pool, nothing is left to remove the job from
+ * the system, the caller does that with job_remove_agent().
+ *
  * @param scheduler
  * @param job
  */
 void job_update(scheduler_t* scheduler, job_t* job)
 {
   GList* iter;
+  GList* next;
   int finished = 1;
 
   TEST_NULV(job)
@@ -550,14 +953,27 @@ void job_update(scheduler_t* scheduler, job_t* job)
     if(((agent_t*)iter->data)->status != AG_PAUSED)
       finished = 0;
 
+  /* a job queued again by job_requeue() waits for its next agent */
+  if(job->chunks == NULL && job->idx == 0 && job_queued(scheduler->job_queue, job) != NULL)
+    return;
+
   if(job->status != JB_PAUSED && job->status != JB_COMPLETE && finished)
   {
-    if(job->failed_agents == NULL)
+    /* a runonpfile job is only finished once every chunk is */
+    if(job->chunks != NULL && job->status != JB_FAILED && job->failed_agents == NULL &&
+        job->done < job->chunks->len)
+    {
+      job_wake(scheduler, job);
+    }
+    else if(job->failed_agents == NULL)
     {
       job_transition(scheduler, job, JB_COMPLETE);
-      for(iter = job->finished_agents; iter != NULL; iter = iter->next)
+      for(iter = job->finished_agents; iter != NULL; iter = next)
       {
-        aprintf(iter->data, "CLOSE\n");
+        /* agents that go to the pool are removed from the job */
+        next = iter->next;
+        if(!agent_pool_add(scheduler, iter->data))
+          aprintf(iter->data, "CLOSE\n");
       }
     }
     /* this indicates a failed agent */
@@ -580,62 +996,170 @@ void job_update(scheduler_t* scheduler, job_t* job)
  */
 int job_is_open(scheduler_t* scheduler, job_t* job)
 {
-  /* local */
-  int retval = 0;
-
   TEST_NULL(job, -1);
 
   /* check to make sure that the job status is correct */
   if(job->status == JB_CHECKEDOUT)
     job_transition(scheduler, job, JB_STARTED);
 
-  /* check to see if we even need to worry about sql stuff */
-  if(job->db_result == NULL)
+  /* check to see if we even need to worry about chunks */
+  if(job->chunks == NULL)
     return (job->idx == 0 && job->data != NULL);
 
-  g_mutex_lock(job->lock);
-  if(job->idx < PQntuples(job->db_result))
-  {
-    retval = 1;
-  }
-  else
-  {
-    SafePQclear(job->db_result);
-    job->db_result = database_exec(scheduler, job->data);
-    job->idx = 0;
-
-    retval = PQntuples(job->db_result) != 0;
-  }
-
-  g_mutex_unlock(job->lock);
-  return retval;
+  return !job->chunk_failed &&
+      (!g_queue_is_empty(job->retry) || job->idx < job->chunks->len);
 }
 
 /**
  * Gets the next piece of data that should be analyzed, if there is no more data
- * to analyze, this will return NULL;
+ * to analyze, this will return NULL. Use job_next_chunk() for runonpfile jobs.
  *
  * @param job the job to get the data for
  * @return a pointer to the next block of data or NULL
  */
 char* job_next(job_t* job)
 {
-  char* retval = NULL;
+  TEST_NULL(job, NULL);
 
+  job->idx = 1;
+  return job->data;
+}
+
+/**
+ * Gets the next chunk of a runonpfile job that has no agent. Chunks given back
+ * by failed agents come first.
+ *
+ * @param job the job to get the chunk for
+ * @return the chunk or NULL if every chunk has an agent
+ */
+job_chunk_t* job_next_chunk(job_t* job)
+{
   TEST_NULL(job, NULL);
-  if(job->db_result == NULL)
+  if(job->chunks == NULL)
+    return NULL;
+
+  if(!g_queue_is_empty(job->retry))
+    return g_queue_pop_head(job->retry);
+  if(job->idx < job->chunks->len)
+    return g_ptr_array_index(job->chunks, job->idx++);
+  return NULL;
+}
+
+/**
+ * Records that an agent has finished its chunk of a runonpfile job.
+ *
+ * @param job    the job the agent belongs to
+ * @param agent  the agent that sent "OK" for its chunk
+ */
+void job_chunk_done(job_t* job, void* agent)
+{
+  agent_t* a = agent;
+
+  TEST_NULV(job);
+
+  if(a == NULL || a->chunk == NULL)
+    return;
+
+  job->done++;
+  a->chunk = NULL;
+  V_JOB("JOB[%d]: %u of %u chunks finished\n", job->id, job->done, job->chunks->len);
+}
+
+/**
+ * Gives the chunk of a failed agent back to its runonpfile job, so that
+ * another agent can process it. After JOB_CHUNK_RETRIES attempts the chunk is
+ * considered broken and the job will fail.
+ *
+ * @param job    the job the agent belongs to
+ * @param agent  the agent that failed
+ * @return TRUE if the chunk will be given to another agent
+ */
+gboolean job_chunk_failed(job_t* job, void* agent)
+{
+  agent_t* a = agent;
+  job_chunk_t* chunk;
+
+  TEST_NULL(job, FALSE);
+
+  if(a == NULL || (chunk = a->chunk) == NULL)
+    return FALSE;
+  a->chunk = NULL;
+
+  if(++chunk->failures > JOB_CHUNK_RETRIES)
   {
-    job->idx = 1;
-    return job->data;
+    V_JOB("JOB[%d]: chunk \"%s\" failed %u times\n", job->id, chunk->data, chunk->failures);
+    job->chunk_failed = TRUE;
+    return FALSE;
   }
 
-  g_mutex_lock(job->lock);
+  V_JOB("JOB[%d]: chunk \"%s\" given back after agent failure\n", job->id, chunk->data);
+  g_queue_push_tail(job->retry, chunk);
+  return TRUE;
+}
 
-  if(job->idx < PQntuples(job->db_result))
-    retval = PQgetvalue(job->db_result, job->idx++, 0);
+/**
+ * Gives the work of an agent that ran out of memory back to its job, so that
+ * the job is run again once a host has room for it instead of failing. The
+ * chunk of a runonpfile job goes to the next agent, without counting as a
+ * failure of the chunk. Any other job goes back into the job queue. The agent
+ * is removed from the job. After JOB_OOM_RETRIES times the agent fails like
+ * any other.
+ *
+ * @param scheduler  the scheduler the job belongs to
+ * @param job        the job the agent belongs to
+ * @param agent      the agent that ran out of memory
+ * @return TRUE if the work of the agent will be done again
+ */
+gboolean job_requeue(scheduler_t* scheduler, job_t* job, void* agent)
+{
+  agent_t* a = agent;
 
-  g_mutex_unlock(job->lock);
-  return retval;
+  TEST_NULL(job, FALSE);
+
+  if(a == NULL || job->id <= 0 || job->oom_retries >= JOB_OOM_RETRIES ||
+      !g_list_find(job->running_agents, a))
+    return FALSE;
+
+  job->oom_retries++;
+  job->running_agents = g_list_remove(job->running_agents, a);
+
+  if(job->chunks != NULL)
+  {
+    if(a->chunk != NULL)
+      g_queue_push_head(job->retry, a->chunk);
+    a->chunk = NULL;
+  }
+  else
+  {
+    job->idx = 0;
+    if(job_queued(scheduler->job_queue, job) == NULL)
+      g_sequence_insert_sorted(scheduler->job_queue, job, job_compare, NULL);
+  }
+
+  V_JOB("JOB[%d]: queued again after its agent ran out of memory, %u of %u\n",
+      job->id, job->oom_retries, JOB_OOM_RETRIES);
+  return TRUE;
+}
+
+/**
+ * Gets the number of agents that should still be started for a job. A job that
+ * is not split needs one agent, a runonpfile job can use one agent per chunk
+ * that is not finished, up to runonpfile_max_agents.
+ *
+ * @param job the job to check
+ * @return the number of agents that should be started
+ */
+int job_agents_wanted(job_t* job)
+{
+  int wanted;
+
+  TEST_NULL(job, 0);
+
+  if(job->chunks == NULL)
+    return 1;
+
+  wanted = MIN(job->chunks->len - job->done, CONF_runonpfile_max_agents);
+  return wanted - (int)job->n_agents;
 }
 
 /**
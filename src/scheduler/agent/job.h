@@ -55,6 +55,23 @@ typedef enum { JOB_STATUS_TYPES(SELECT_ENUM) } job_status;
 
 extern const char* job_status_strings[];
 
+/** The number of times a chunk is given to a new agent after its agent failed */
+#define JOB_CHUNK_RETRIES 2
+/** The number of times a job is queued again after its agent ran out of memory */
+#define JOB_OOM_RETRIES 3
+
+/**
+ * @brief A range of the pfiles of a runonpfile job.
+ *
+ * A runonpfile job is split into chunks that are handed to different agents,
+ * possibly on different hosts. Each chunk is processed by one agent at a time.
+ */
+typedef struct
+{
+    gchar*   data;     ///< The data sent to the agent, the jq_args followed by the pfile range
+    uint32_t failures; ///< The number of agents that failed while processing this chunk
+} job_chunk_t;
+
 /**
  * @brief The job structure
  */
@@ -72,9 +89,19 @@ typedef struct
     job_status status;    ///< The current status for the job
     gchar*     data;      ///< The data associated with this job (jq_args)
     gchar     *jq_cmd_args; ///< Command line arguments for this job
-    PGresult*  db_result; ///< Results from the sql query (if any)
-    GMutex*    lock;      ///< Lock to maintain data integrity
-    uint32_t   idx;       ///< The current index into the sql results
+    uint32_t   idx;       ///< The next chunk to hand out, 1 once the data was sent if not split
+    GPtrArray* chunks;    ///< The job_chunk_t* of a runonpfile job, NULL if the job is not split
+    GQueue*    retry;     ///< Chunks whose agent failed, handed out before the remaining ones
+    uint32_t   done;      ///< The number of chunks that have been finished
+    gboolean   chunk_failed; ///< A chunk failed more than JOB_CHUNK_RETRIES times
+    uint32_t   n_agents;  ///< The number of agents started for this job that are still alive
+    gboolean   preempted; ///< Paused by the scheduler for an interactive job, see job_preempt()
+    uint32_t   oom_retries; ///< The number of times the job was queued again, see job_requeue()
+    gboolean   runonpfile;  ///< The job is split into chunks once it is ready, see job_ready()
+
+    /* dependencies between jobs, see job_depend() */
+    GList*   depends;    ///< The jobs that must complete before this job is queued
+    GList*   dependents; ///< The jobs that wait for this job to complete
 
     /* information about job status */
     gchar*   message;   ///< Message that will be sent with job notification email
@@ -84,6 +111,9 @@ typedef struct
     int32_t  id;        ///< The identifier for this job
     int32_t  user_id;   ///< The id of the user that created the job
     int32_t  group_id;  ///< The id of the group that created the job
+    GTree*   metrics;   ///< Metric totals of the agents that are gone
+    gint64   queued;    ///< When the job was put in the job queue, in monotonic microseconds
+    gint64   started;   ///< When the job got its first agent, 0 before that
 } job_t;
 
 /* ************************************************************************** */
@@ -100,7 +130,9 @@ void   job_destroy(job_t* job);
 
 void job_verbose_event (scheduler_t* scheduler, job_t* j);
 void job_status_event  (scheduler_t* scheduler, arg_int* params);
+void job_metrics_event (scheduler_t* scheduler, arg_int* params);
 void job_pause_event   (scheduler_t* scheduler, arg_int* params);
+void job_preempt       (scheduler_t* scheduler, job_t* job);
 void job_restart_event (scheduler_t* scheduler, arg_int* params);
 void job_priority_event(scheduler_t* scheduler, arg_int* params);
 void job_fail_event    (scheduler_t* scheduler, job_t* job);
@@ -110,10 +142,18 @@ void job_remove_agent(job_t* job, GTree* job_list, void* a);
 void job_finish_agent(job_t* job, void* a);
 void job_fail_agent(job_t* job, void* a);
 void job_set_data(scheduler_t* scheduler, job_t* job, char* data, int sql);
+gboolean job_depend(job_t* job, job_t* dependency);
+void job_drop(scheduler_t* scheduler, job_t* job);
+void job_ready(scheduler_t* scheduler, job_t* job);
 void job_update(scheduler_t* scheduler, job_t* job);
 
 gboolean  job_is_open(scheduler_t* scheduler, job_t* job);
 gchar*    job_next(job_t* job);
+job_chunk_t* job_next_chunk(job_t* job);
+void      job_chunk_done(job_t* job, void* a);
+gboolean  job_chunk_failed(job_t* job, void* a);
+gboolean  job_requeue(scheduler_t* scheduler, job_t* job, void* a);
+int       job_agents_wanted(job_t* job);
 log_t*    job_log(job_t* job);
 
 /* ************************************************************************** */
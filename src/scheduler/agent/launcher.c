@@ -0,0 +1,646 @@
+/* **************************************************************
+Copyright (C) 2026 Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+************************************************************** */
+/**
+ * \file
+ * \brief Starts agents on a host through its fo_launcher
+ *
+ * Instead of one ssh process per agent, the scheduler starts a single
+ * fo_launcher on a remote host and asks it to start every agent. The agent
+ * still gets the pipes that agent_init() created: the launcher thread copies
+ * whatever the scheduler writes to an agent into LAUNCH_DATA frames, and writes
+ * the LAUNCH_DATA frames that the launcher sends back into the pipe that the
+ * agent io thread reads. The death of a remote agent arrives as a LAUNCH_EXIT
+ * frame and is turned into the same agent_death_event() that a SIGCHLD causes.
+ *
+ * Agents started through a launcher get negative ids instead of pids, so they
+ * never collide with the local processes in scheduler->agents.
+ */
+
+/* local includes */
+#include <agent.h>
+#include <event.h>
+#include <launcher.h>
+#include <logging.h>
+#include <scheduler.h>
+
+/* std library includes */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* unix library includes */
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* ************************************************************************** */
+/* **** Locals ************************************************************** */
+/* ************************************************************************** */
+
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+#define LAUNCHER_LOCK(l)   g_mutex_lock(&(l)->lock)
+#define LAUNCHER_UNLOCK(l) g_mutex_unlock(&(l)->lock)
+#else
+#define LAUNCHER_LOCK(l)   g_static_mutex_lock(&(l)->lock)
+#define LAUNCHER_UNLOCK(l) g_static_mutex_unlock(&(l)->lock)
+#endif
+
+#define LAUNCHER_EVENTS 64 ///< the number of epoll events handled at once
+
+/**
+ * The scheduler's ends of the pipes of an agent started through a launcher.
+ */
+typedef struct
+{
+    int32_t  id;          ///< the id of the agent, also its key in launcher->agents
+    int      from_parent; ///< what the scheduler writes to the agent
+    int      to_parent;   ///< where the output of the agent goes
+    gboolean gone;        ///< the pipe of the agent is no longer listened to
+} launcher_agent_t;
+
+/** the id of the next agent, counts down from -1 */
+static int32_t launcher_next_id = -1;
+
+/**
+ * @brief Reads or writes a whole buffer, retrying after short transfers.
+ *
+ * @param fd     the descriptor to use
+ * @param buf    the buffer
+ * @param len    the number of bytes to transfer
+ * @param input  read if TRUE, write otherwise
+ * @return TRUE if every byte was transferred
+ */
+static gboolean launcher_full(int fd, char* buf, size_t len, gboolean input)
+{
+  ssize_t n;
+
+  while (len > 0)
+  {
+    n = input ? read(fd, buf, len) : write(fd, buf, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return FALSE;
+    buf += n;
+    len -= n;
+  }
+
+  return TRUE;
+}
+
+/**
+ * @brief Sends a frame with a single integer as payload, the caller holds the lock.
+ *
+ * @param launcher  the launcher to send the frame to
+ * @param id        the id of the agent
+ * @param type      the type of the frame
+ * @param value     the payload
+ * @return TRUE if the frame was sent
+ */
+static gboolean launcher_send_int(launcher_t* launcher, int32_t id, uint32_t type, int32_t value)
+{
+  uint32_t payload = htonl((uint32_t) value);
+
+  return launcher_write_frame(launcher->to_launcher, id, type, &payload, sizeof(payload));
+}
+
+/**
+ * @brief Makes every agent of a launcher that is lost die.
+ *
+ * The fo_launcher kills its agents once its stdin is closed, so an agent
+ * death event is created for each one that is still known. New agents for the
+ * host are started using ssh until launcher_ready() starts the launcher again.
+ *
+ * @param launcher  the launcher that is lost
+ */
+static void launcher_lost(launcher_t* launcher)
+{
+  GHashTableIter iter;
+  launcher_agent_t* entry;
+  pid_t* pass;
+
+  LAUNCHER_LOCK(launcher);
+  if (launcher->connected)
+    WARNING("lost the launcher of host %s, its agents are started using ssh", launcher->host);
+  launcher->connected = FALSE;
+  launcher->lost = time(NULL);
+
+  g_hash_table_iter_init(&iter, launcher->agents);
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer*) &entry))
+  {
+    if (!entry->gone)
+      epoll_ctl(launcher->epoll_fd, EPOLL_CTL_DEL, entry->from_parent, NULL);
+
+    pass = g_new0(pid_t, 2);
+    pass[0] = entry->id;
+    pass[1] = W_EXITCODE(255, 0);
+    event_signal_priority(agent_death_event, pass, EVENT_HIGH);
+  }
+  g_hash_table_remove_all(launcher->agents);
+  LAUNCHER_UNLOCK(launcher);
+}
+
+/**
+ * @brief Handles one frame sent by the launcher.
+ *
+ * @param launcher  the launcher that sent the frame
+ * @param gone      the entries of agents that exited, freed by the caller
+ * @return FALSE if the connection to the launcher is lost
+ */
+static gboolean launcher_receive(launcher_t* launcher, GList** gone)
+{
+  launcher_agent_t* entry;
+  uint32_t type, len, status;
+  int32_t id;
+  char* data;
+  pid_t* pass;
+
+  if (!launcher_read_frame(launcher->from_launcher, &id, &type, &data, &len))
+    return FALSE;
+
+  LAUNCHER_LOCK(launcher);
+  entry = g_hash_table_lookup(launcher->agents, &id);
+
+  if (entry != NULL && type == LAUNCH_DATA)
+  {
+    if (!launcher_full(entry->to_parent, data, len, FALSE))
+      V_HOST("LAUNCHER[%s] unable to pass output of agent %d: %s\n", launcher->host, id, strerror(errno));
+  }
+  else if (entry != NULL && type == LAUNCH_EXIT && len == sizeof(status))
+  {
+    memcpy(&status, data, sizeof(status));
+    g_hash_table_steal(launcher->agents, &id);
+    if (!entry->gone)
+      epoll_ctl(launcher->epoll_fd, EPOLL_CTL_DEL, entry->from_parent, NULL);
+    entry->gone = TRUE;
+    *gone = g_list_prepend(*gone, entry);
+
+    pass = g_new0(pid_t, 2);
+    pass[0] = id;
+    pass[1] = ntohl(status);
+    event_signal_priority(agent_death_event, pass, EVENT_HIGH);
+  }
+  LAUNCHER_UNLOCK(launcher);
+
+  g_free(data);
+  return TRUE;
+}
+
+/**
+ * @brief Main function of the launcher thread.
+ *
+ * Waits on the connection to the launcher and on the pipe of every agent that
+ * was started through it. Frames from the launcher are handled by
+ * launcher_receive(), anything the scheduler writes to an agent is sent on as
+ * a LAUNCH_DATA frame.
+ *
+ * @param launcher  the launcher to serve
+ * @return always NULL
+ */
+static void* launcher_loop(launcher_t* launcher)
+{
+  struct epoll_event events[LAUNCHER_EVENTS];
+  launcher_agent_t* entry;
+  GList* gone = NULL;
+  char buf[LAUNCHER_BUF];
+  ssize_t len;
+  int n, i;
+
+  while (1)
+  {
+    if ((n = epoll_wait(launcher->epoll_fd, events, LAUNCHER_EVENTS, -1)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      ERROR("launcher loop of host %s failed: %s", launcher->host, strerror(errno));
+      break;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+      /* only the wake up descriptor is registered without data */
+      if (events[i].data.ptr == NULL)
+        break;
+
+      if (events[i].data.ptr == launcher)
+      {
+        if (!launcher_receive(launcher, &gone))
+          break;
+        continue;
+      }
+
+      entry = events[i].data.ptr;
+      if (entry->gone)
+        continue;
+
+      len = read(entry->from_parent, buf, sizeof(buf));
+      if (len < 0 && (errno == EAGAIN || errno == EINTR))
+        continue;
+
+      LAUNCHER_LOCK(launcher);
+      if (len > 0 && launcher->connected)
+      {
+        if (!launcher_write_frame(launcher->to_launcher, entry->id, LAUNCH_DATA, buf, len))
+          V_HOST("LAUNCHER[%s] unable to pass input of agent %d\n", launcher->host, entry->id);
+      }
+      else if (len <= 0)
+      {
+        /* the agent is destroyed, stop listening until its LAUNCH_EXIT arrives */
+        epoll_ctl(launcher->epoll_fd, EPOLL_CTL_DEL, entry->from_parent, NULL);
+        entry->gone = TRUE;
+      }
+      LAUNCHER_UNLOCK(launcher);
+    }
+
+    g_list_free_full(gone, g_free);
+    gone = NULL;
+
+    if (i < n)
+      break;
+  }
+
+  launcher_lost(launcher);
+  return NULL;
+}
+
+/**
+ * @brief Stops the launcher thread and the launcher process.
+ *
+ * @param launcher  the launcher to stop
+ */
+static void launcher_stop(launcher_t* launcher)
+{
+  uint64_t wake = 1;
+
+  if (launcher->thread != NULL)
+  {
+    if (write(launcher->wake_fd, &wake, sizeof(wake)) != sizeof(wake))
+      ERROR("unable to wake the launcher thread of host %s", launcher->host);
+    g_thread_join(launcher->thread);
+    launcher->thread = NULL;
+  }
+
+  if (launcher->to_launcher >= 0)   close(launcher->to_launcher);
+  if (launcher->from_launcher >= 0) close(launcher->from_launcher);
+  if (launcher->epoll_fd >= 0)      close(launcher->epoll_fd);
+  if (launcher->wake_fd >= 0)       close(launcher->wake_fd);
+  launcher->to_launcher = launcher->from_launcher = -1;
+  launcher->epoll_fd = launcher->wake_fd = -1;
+
+  /* the launcher exits once its stdin is closed */
+  if (launcher->pid > 0)
+  {
+    kill(launcher->pid, SIGTERM);
+    waitpid(launcher->pid, NULL, 0);
+    launcher->pid = 0;
+  }
+}
+
+/* ************************************************************************** */
+/* **** Constructor Destructor ********************************************** */
+/* ************************************************************************** */
+
+/**
+ * @brief Creates the connection to the launcher of a host, it is not started.
+ *
+ * @param host  the name of the host
+ * @return the new launcher
+ */
+launcher_t* launcher_init(char* host)
+{
+  launcher_t* launcher = g_new0(launcher_t, 1);
+
+  launcher->host = g_strdup(host);
+  launcher->pid = 0;
+  launcher->to_launcher = -1;
+  launcher->from_launcher = -1;
+  launcher->epoll_fd = -1;
+  launcher->wake_fd = -1;
+  launcher->connected = FALSE;
+  launcher->lost = 0;
+  launcher->thread = NULL;
+  launcher->agents = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, g_free);
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+  g_mutex_init(&launcher->lock);
+#else
+  g_static_mutex_init(&launcher->lock);
+#endif
+
+  return launcher;
+}
+
+/**
+ * @brief Stops the launcher and frees it.
+ *
+ * Agents that are still running through the launcher die with it, an agent
+ * death event is created for each of them.
+ *
+ * @param launcher  the launcher to free
+ */
+void launcher_destroy(launcher_t* launcher)
+{
+  if (launcher == NULL)
+    return;
+
+  LAUNCHER_LOCK(launcher);
+  launcher->connected = FALSE;
+  LAUNCHER_UNLOCK(launcher);
+  launcher_stop(launcher);
+
+  g_hash_table_destroy(launcher->agents);
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+  g_mutex_clear(&launcher->lock);
+#else
+  g_static_mutex_free(&launcher->lock);
+#endif
+  g_free(launcher->host);
+  g_free(launcher);
+}
+
+/* ************************************************************************** */
+/* **** Functions *********************************************************** */
+/* ************************************************************************** */
+
+/**
+ * @brief Starts the launcher process and the launcher thread.
+ *
+ * @param launcher  the launcher to start
+ * @param argv      the command that runs fo_launcher, ssh for a remote host
+ * @return TRUE if the launcher was started
+ */
+gboolean launcher_start(launcher_t* launcher, char** argv)
+{
+  struct epoll_event event;
+  int to[2], from[2];
+
+  if (pipe2(to, O_CLOEXEC) != 0)
+    return FALSE;
+  if (pipe2(from, O_CLOEXEC) != 0)
+  {
+    close(to[0]);
+    close(to[1]);
+    return FALSE;
+  }
+
+  if ((launcher->pid = fork()) == 0)
+  {
+    dup2(to[0], fileno(stdin));
+    dup2(from[1], fileno(stdout));
+    execv(argv[0], argv);
+
+    log_printf("ERROR %s.%d: unable to start launcher of host %s: %s\n", __FILE__, __LINE__,
+        launcher->host, strerror(errno));
+    exit(5);
+  }
+
+  close(to[0]);
+  close(from[1]);
+  launcher->to_launcher = to[1];
+  launcher->from_launcher = from[0];
+
+  if (launcher->pid < 0 ||
+      (launcher->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+      (launcher->wake_fd = eventfd(0, EFD_CLOEXEC)) < 0)
+  {
+    ERROR("unable to start launcher of host %s: %s", launcher->host, strerror(errno));
+    launcher_stop(launcher);
+    return FALSE;
+  }
+
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.ptr = NULL;
+  epoll_ctl(launcher->epoll_fd, EPOLL_CTL_ADD, launcher->wake_fd, &event);
+  event.data.ptr = launcher;
+  epoll_ctl(launcher->epoll_fd, EPOLL_CTL_ADD, launcher->from_launcher, &event);
+
+  launcher->connected = TRUE;
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+  launcher->thread = g_thread_new("launcher", (GThreadFunc) launcher_loop, launcher);
+#else
+  launcher->thread = g_thread_create((GThreadFunc) launcher_loop, launcher, 1, NULL);
+#endif
+
+  V_HOST("LAUNCHER[%s] started, pid %d\n", launcher->host, launcher->pid);
+  return TRUE;
+}
+
+/**
+ * @brief Makes sure that the launcher can start agents.
+ *
+ * A launcher that was lost is started again once LAUNCHER_RETRY seconds have
+ * passed, until then the agents of the host are started using ssh.
+ *
+ * @param launcher  the launcher to check
+ * @param argv      the command that runs fo_launcher, see launcher_start()
+ * @return TRUE if the launcher is running
+ */
+gboolean launcher_ready(launcher_t* launcher, char** argv)
+{
+  gboolean connected;
+
+  LAUNCHER_LOCK(launcher);
+  connected = launcher->connected;
+  LAUNCHER_UNLOCK(launcher);
+
+  if (connected)
+    return TRUE;
+  if (launcher->lost != 0 && time(NULL) - launcher->lost < LAUNCHER_RETRY)
+    return FALSE;
+
+  launcher_stop(launcher);
+  if (!launcher_start(launcher, argv))
+  {
+    launcher->lost = time(NULL);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+ * @brief Starts an agent through the launcher.
+ *
+ * The payload of the LAUNCH_SPAWN frame is the priority of the agent followed
+ * by its arguments, each one terminated by a '\0'.
+ *
+ * @param launcher     the launcher of the host
+ * @param from_parent  the pipe the agent reads from
+ * @param to_parent    the pipe the agent writes to
+ * @param priority     the nice value of the agent
+ * @param argv         the arguments of the agent, argv[0] is its path on the host
+ * @return the id of the agent, 0 if it could not be started
+ */
+int32_t launcher_spawn(launcher_t* launcher, int from_parent, int to_parent, int priority, char** argv)
+{
+  launcher_agent_t* entry;
+  struct epoll_event event;
+  GString* payload;
+  int32_t id = 0;
+  int i;
+
+  payload = g_string_new(NULL);
+  g_string_append_printf(payload, "%d", priority);
+  g_string_append_c(payload, '\0');
+  for (i = 0; argv[i] != NULL; i++)
+  {
+    g_string_append(payload, argv[i]);
+    g_string_append_c(payload, '\0');
+  }
+
+  LAUNCHER_LOCK(launcher);
+  if (launcher->connected && payload->len <= LAUNCHER_FRAME)
+  {
+    id = launcher_next_id;
+    launcher_next_id = (launcher_next_id == G_MININT32) ? -1 : launcher_next_id - 1;
+
+    if (launcher_write_frame(launcher->to_launcher, id, LAUNCH_SPAWN, payload->str, payload->len))
+    {
+      entry = g_new0(launcher_agent_t, 1);
+      entry->id = id;
+      entry->from_parent = from_parent;
+      entry->to_parent = to_parent;
+      entry->gone = FALSE;
+      fcntl(from_parent, F_SETFL, fcntl(from_parent, F_GETFL) | O_NONBLOCK);
+      g_hash_table_insert(launcher->agents, &entry->id, entry);
+
+      memset(&event, 0, sizeof(event));
+      event.events = EPOLLIN;
+      event.data.ptr = entry;
+      if (epoll_ctl(launcher->epoll_fd, EPOLL_CTL_ADD, from_parent, &event) != 0)
+      {
+        /* the agent dies and its LAUNCH_EXIT frame removes the entry */
+        ERROR("unable to listen to agent %d on host %s: %s", id, launcher->host, strerror(errno));
+        entry->gone = TRUE;
+        launcher_send_int(launcher, id, LAUNCH_SIGNAL, SIGKILL);
+      }
+    }
+    else
+    {
+      id = 0;
+    }
+  }
+  LAUNCHER_UNLOCK(launcher);
+
+  g_string_free(payload, TRUE);
+  return id;
+}
+
+/**
+ * @brief Sends a signal to an agent that was started through the launcher.
+ *
+ * @param launcher  the launcher of the host
+ * @param id        the id of the agent
+ * @param signo     the signal to send
+ * @return TRUE if the signal was passed on to the launcher
+ */
+gboolean launcher_signal(launcher_t* launcher, int32_t id, int signo)
+{
+  gboolean ret = FALSE;
+
+  LAUNCHER_LOCK(launcher);
+  if (launcher->connected && g_hash_table_lookup(launcher->agents, &id) != NULL)
+    ret = launcher_send_int(launcher, id, LAUNCH_SIGNAL, signo);
+  LAUNCHER_UNLOCK(launcher);
+
+  return ret;
+}
+
+/**
+ * @brief Changes the priority of an agent that was started through the launcher.
+ *
+ * @param launcher  the launcher of the host
+ * @param id        the id of the agent
+ * @param priority  the new nice value of the agent
+ * @return TRUE if the priority was passed on to the launcher
+ */
+gboolean launcher_priority(launcher_t* launcher, int32_t id, int priority)
+{
+  gboolean ret = FALSE;
+
+  LAUNCHER_LOCK(launcher);
+  if (launcher->connected && g_hash_table_lookup(launcher->agents, &id) != NULL)
+    ret = launcher_send_int(launcher, id, LAUNCH_PRIORITY, priority);
+  LAUNCHER_UNLOCK(launcher);
+
+  return ret;
+}
+
+/**
+ * @brief Writes one frame, used by both the scheduler and fo_launcher.
+ *
+ * @param fd    the descriptor to write to
+ * @param id    the id of the agent
+ * @param type  the type of the frame, see launch_frame
+ * @param data  the payload
+ * @param len   the length of the payload
+ * @return TRUE if the whole frame was written
+ */
+gboolean launcher_write_frame(int fd, int32_t id, uint32_t type, const void* data, uint32_t len)
+{
+  uint32_t header[3];
+
+  header[0] = htonl((uint32_t) id);
+  header[1] = htonl(type);
+  header[2] = htonl(len);
+
+  return launcher_full(fd, (char*) header, sizeof(header), FALSE) &&
+      launcher_full(fd, (char*) data, len, FALSE);
+}
+
+/**
+ * @brief Reads one frame, used by both the scheduler and fo_launcher.
+ *
+ * The payload is always followed by a '\0' that is not part of its length.
+ *
+ * @param fd         the descriptor to read from
+ * @param[out] id    the id of the agent
+ * @param[out] type  the type of the frame, see launch_frame
+ * @param[out] data  the payload, freed by the caller with g_free()
+ * @param[out] len   the length of the payload
+ * @return FALSE at the end of the stream or if the frame is invalid
+ */
+gboolean launcher_read_frame(int fd, int32_t* id, uint32_t* type, char** data, uint32_t* len)
+{
+  uint32_t header[3];
+
+  *data = NULL;
+  if (!launcher_full(fd, (char*) header, sizeof(header), TRUE))
+    return FALSE;
+
+  *id = (int32_t) ntohl(header[0]);
+  *type = ntohl(header[1]);
+  *len = ntohl(header[2]);
+  if (*len > LAUNCHER_FRAME)
+    return FALSE;
+
+  *data = g_malloc(*len + 1);
+  (*data)[*len] = '\0';
+  if (!launcher_full(fd, *data, *len, TRUE))
+  {
+    g_free(*data);
+    *data = NULL;
+    return FALSE;
+  }
+
+  return TRUE;
+}
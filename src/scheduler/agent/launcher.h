@@ -0,0 +1,97 @@
+/* **************************************************************
+Copyright (C) 2026 Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+************************************************************** */
+
+#ifndef LAUNCHER_H_INCLUDE
+#define LAUNCHER_H_INCLUDE
+
+/* std includes */
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+/* other library includes */
+#include <glib.h>
+
+/* ************************************************************************** */
+/* **** Data Types ********************************************************** */
+/* ************************************************************************** */
+
+/**
+ * The frames sent between the scheduler and fo_launcher. Every frame starts
+ * with the id of the agent, the type and the length of the payload, each as a
+ * 32 bit integer in network byte order.
+ */
+typedef enum
+{
+  LAUNCH_SPAWN = 1, ///< start an agent, the payload is its priority and argv, see launcher_spawn()
+  LAUNCH_DATA,      ///< bytes for the stdin of an agent, or from its stdout
+  LAUNCH_SIGNAL,    ///< send the signal in the payload to an agent
+  LAUNCH_PRIORITY,  ///< change the priority of an agent to the one in the payload
+  LAUNCH_EXIT       ///< the agent is gone, the payload is its waitpid() status
+} launch_frame;
+
+#define LAUNCHER_BUF   4096  ///< the largest LAUNCH_DATA payload that is sent
+#define LAUNCHER_FRAME 65536 ///< the largest payload that is accepted
+#define LAUNCHER_RETRY 60    ///< seconds before a lost launcher is started again
+
+/**
+ * The connection to the fo_launcher of a host. The launcher is started once,
+ * through ssh for a remote host, and starts every agent of the scheduler on
+ * that host. The pipes of those agents are multiplexed over the stdin and
+ * stdout of the launcher by the launcher thread, see launcher_loop().
+ */
+typedef struct
+{
+    gchar*   host;          ///< the name of the host, used in log messages
+    pid_t    pid;           ///< the process running the launcher, ssh for a remote host
+    int      to_launcher;   ///< the stdin of the launcher
+    int      from_launcher; ///< the stdout of the launcher
+    int      epoll_fd;      ///< the connection and the pipes of every agent are registered with it
+    int      wake_fd;       ///< eventfd used to stop the launcher thread
+    gboolean connected;     ///< the launcher is running and starts new agents
+    time_t   lost;          ///< when the launcher was last lost, see launcher_ready()
+    GThread* thread;        ///< the launcher thread
+    GHashTable* agents;     ///< the pipes of the running agents, keyed by agent id
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+    GMutex   lock;          ///< protects the agents and writes to the launcher
+#else
+    GStaticMutex lock;      ///< protects the agents and writes to the launcher
+#endif
+} launcher_t;
+
+/* ************************************************************************** */
+/* **** Constructor Destructor ********************************************** */
+/* ************************************************************************** */
+
+launcher_t* launcher_init(char* host);
+void launcher_destroy(launcher_t* launcher);
+
+/* ************************************************************************** */
+/* **** Functions *********************************************************** */
+/* ************************************************************************** */
+
+gboolean launcher_start(launcher_t* launcher, char** argv);
+gboolean launcher_ready(launcher_t* launcher, char** argv);
+int32_t  launcher_spawn(launcher_t* launcher, int from_parent, int to_parent, int priority, char** argv);
+gboolean launcher_signal(launcher_t* launcher, int32_t id, int signo);
+gboolean launcher_priority(launcher_t* launcher, int32_t id, int priority);
+
+gboolean launcher_write_frame(int fd, int32_t id, uint32_t type, const void* data, uint32_t len);
+gboolean launcher_read_frame(int fd, int32_t* id, uint32_t* type, char** data, uint32_t* len);
+
+#endif /* LAUNCHER_H_INCLUDE */
@@ -30,6 +30,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <time.h>
 
 /* unix includes */
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -43,6 +44,43 @@ with this program; if not, write to the Free Software Foundation, Inc.,
  */
 log_t* main_log = NULL;
 
+#define LOG_BATCH 256 ///< the number of records written before the logs are flushed
+
+/** What the log writer does with a log_record */
+typedef enum
+{
+  LOG_WRITE, ///< write the text to the log
+  LOG_CLOSE, ///< close and free the log
+  LOG_FLUSH, ///< flush every log, then answer on the reply queue
+  LOG_STOP   ///< end the log writer
+} log_op;
+
+/**
+ * A request for the log writer. The text is formatted by the thread that
+ * logs, the log writer only writes it.
+ */
+typedef struct
+{
+    log_op       op;    ///< what to do
+    log_t*       log;   ///< the log to write to or close
+    gchar*       text;  ///< the text to write
+    gsize        len;   ///< the length of text
+    GAsyncQueue* reply; ///< gets a record back once a LOG_FLUSH is done
+} log_record;
+
+/**
+ * The log writer. Once it is started, the log files are only written by its
+ * thread, so that a slow disk or a lot of verbose output does not block the
+ * thread that logs. Every message is handed over in a log_record.
+ */
+static struct
+{
+    GAsyncQueue* queue;   ///< the records that still have to be written
+    GThread*     thread;  ///< the log writer thread, NULL if the logs are written directly
+    gint         dropped; ///< the number of lines dropped since the start
+    gboolean     forked;  ///< this is a child forked from the scheduler, see log_writer_child()
+} log_writer;
+
 /* ************************************************************************** */
 /* **** local functions ***************************************************** */
 /* ************************************************************************** */
@@ -72,6 +110,206 @@ static void log_event(scheduler_t* scheduler, log_event_args* pass)
   g_free(pass);
 }
 
+/**
+ * @brief Closes the file of a log and frees the log.
+ *
+ * @param log  the log, its names are already freed by log_destroy()
+ */
+static void log_close(log_t* log)
+{
+  if(log->log_file && log->log_file != stdout && log->log_file != stderr)
+  {
+    if(CONF_log_fsync)
+    {
+      fflush(log->log_file);
+      fsync(fileno(log->log_file));
+    }
+    fclose(log->log_file);
+  }
+  else if(log->log_file)
+  {
+    fflush(log->log_file);
+  }
+
+  g_free(log);
+}
+
+/**
+ * @brief Flushes the logs that were written to, they are synced to the disk
+ *        every log_fsync seconds.
+ *
+ * @param unsynced  the logs written to since the last fsync
+ * @param synced    when the logs were last synced
+ * @return the logs that still have to be synced
+ */
+static GList* log_writer_flush(GList* unsynced, time_t* synced)
+{
+  GList* iter;
+
+  for(iter = unsynced; iter != NULL; iter = iter->next)
+    fflush(((log_t*)iter->data)->log_file);
+
+  if(CONF_log_fsync == 0)
+  {
+    g_list_free(unsynced);
+    return NULL;
+  }
+
+  if(time(NULL) - *synced < CONF_log_fsync)
+    return unsynced;
+
+  /* fsync of stdout fails with EINVAL, which does not matter */
+  for(iter = unsynced; iter != NULL; iter = iter->next)
+    fsync(fileno(((log_t*)iter->data)->log_file));
+  *synced = time(NULL);
+  g_list_free(unsynced);
+  return NULL;
+}
+
+/**
+ * @brief The loop of the log writer thread.
+ *
+ * Everything that is waiting in the queue is written before the logs are
+ * flushed, so a burst of messages costs a few large writes instead of one
+ * write per message.
+ *
+ * @param unused
+ * @return always NULL
+ */
+static gpointer log_writer_loop(gpointer unused)
+{
+  GList* unsynced = NULL;
+  log_record* record;
+  time_t synced = time(NULL);
+  gboolean running = TRUE;
+  int n;
+#if !(GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32)
+  GTimeVal timeout;
+#endif
+
+  while(running)
+  {
+    /* wake up once a second so that a pending fsync is not delayed forever */
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+    record = g_async_queue_timeout_pop(log_writer.queue, 1000000);
+#else
+    g_get_current_time(&timeout);
+    g_time_val_add(&timeout, 1000000);
+    record = g_async_queue_timed_pop(log_writer.queue, &timeout);
+#endif
+
+    for(n = 0; record != NULL; n++)
+    {
+      switch(record->op)
+      {
+        case LOG_WRITE:
+          if(fwrite(record->text, 1, record->len, record->log->log_file) == record->len &&
+              g_list_find(unsynced, record->log) == NULL)
+            unsynced = g_list_prepend(unsynced, record->log);
+          break;
+        case LOG_CLOSE:
+          unsynced = g_list_remove(unsynced, record->log);
+          log_close(record->log);
+          break;
+        case LOG_FLUSH:
+          unsynced = log_writer_flush(unsynced, &synced);
+          g_async_queue_push(record->reply, GINT_TO_POINTER(1));
+          g_async_queue_unref(record->reply);
+          break;
+        case LOG_STOP:
+          running = FALSE;
+          break;
+      }
+
+      g_free(record->text);
+      g_free(record);
+      record = (running && n < LOG_BATCH) ? g_async_queue_try_pop(log_writer.queue) : NULL;
+    }
+
+    unsynced = log_writer_flush(unsynced, &synced);
+  }
+
+  /* the last messages are synced, whatever the interval is */
+  synced = 0;
+  log_writer_flush(unsynced, &synced);
+  return NULL;
+}
+
+/**
+ * @brief Called at the start of every line, decides if the line is dropped.
+ *
+ * Lines are dropped while more than log_buffer records wait for the log
+ * writer. The first line written after that says how many were dropped.
+ *
+ * @param log       the log the line is for
+ * @param text      the text to append the line start to
+ * @param time_buf  the time stamp of the line
+ */
+static void log_line_start(log_t* log, GString* text, char* time_buf)
+{
+  if(log_writer.thread != NULL && g_async_queue_length(log_writer.queue) >= (gint)CONF_log_buffer)
+  {
+    log->dropping = TRUE;
+    log->dropped++;
+    g_atomic_int_inc(&log_writer.dropped);
+    return;
+  }
+
+  if(log->dropped)
+  {
+    g_string_append_printf(text, "%s %s [%d] :: WARNING: %u log lines dropped, the log writer was behind\n",
+        time_buf, log->pro_name, log->pro_pid, log->dropped);
+    log->dropped = 0;
+  }
+
+  log->dropping = FALSE;
+  g_string_append_printf(text, "%s %s [%d] :: ", time_buf, log->pro_name, log->pro_pid);
+}
+
+/**
+ * @brief Writes formatted text to a log, or hands it to the log writer.
+ *
+ * @param log   the log to write to
+ * @param text  the text, freed by this function
+ * @return 1 on success, 0 otherwise
+ */
+static int log_write(log_t* log, GString* text)
+{
+  log_record* record;
+  int ret = 1;
+
+  if(text->len == 0)
+  {
+    g_string_free(text, TRUE);
+    return 1;
+  }
+
+  /* the stdio lock of the log may have been held by the log writer when the
+   * child was forked, so the child writes around it */
+  if(log_writer.forked)
+  {
+    ret = (write(fileno(log->log_file), text->str, text->len) == (ssize_t)text->len);
+    g_string_free(text, TRUE);
+    return ret;
+  }
+
+  if(log_writer.thread == NULL)
+  {
+    ret = (fwrite(text->str, 1, text->len, log->log_file) == text->len);
+    fflush(log->log_file);
+    g_string_free(text, TRUE);
+    return ret;
+  }
+
+  record = g_new0(log_record, 1);
+  record->op   = LOG_WRITE;
+  record->log  = log;
+  record->len  = text->len;
+  record->text = g_string_free(text, FALSE);
+  g_async_queue_push(log_writer.queue, record);
+  return ret;
+}
+
 /* ************************************************************************** */
 /* **** logging functions *************************************************** */
 /* ************************************************************************** */
@@ -107,6 +345,7 @@ log_t* log_new(gchar* log_name, gchar* pro_name, pid_t pro_pid)
     ret->log_name = g_strdup_printf("%s/fossology.log", log_name);
   else
     ret->log_name = g_strdup(log_name);
+  ret->n_line = 1;
 
   /* open the log file */
   if     (strcmp(ret->log_name, "stderr") == 0) { ret->log_file = stderr; }
@@ -146,6 +385,7 @@ log_t* log_new_FILE(FILE* log_file, gchar* log_name, gchar* pro_name, pid_t pro_
 
   ret->log_name = g_strdup(log_name);
   ret->log_file = log_file;
+  ret->n_line   = 1;
 
   V_JOB("NEW_LOG: log_name: \"%s\", pro_name: \"%s\", pro_pid: %d, log_file: %p\n",
       ret->log_name, ret->pro_name, ret->pro_pid, ret->log_file);
@@ -156,23 +396,136 @@ log_t* log_new_FILE(FILE* log_file, gchar* log_name, gchar* pro_name, pid_t pro_
 /**
  * @brief Free memory associated with the log file.
  *
+ * If the log writer is running, the file is closed once everything that was
+ * logged before is written.
+ *
  * @param log  the log file to close
  */
 void log_destroy(log_t* log)
 {
+  log_record* record;
+
   if(log->pro_name) g_free(log->pro_name);
   if(log->log_name) g_free(log->log_name);
 
-  if(log->log_file && log->log_file != stdout && log->log_file != stderr)
-    fclose(log->log_file);
-
   log->pro_name = NULL;
   log->log_name = NULL;
 
-  if(log->log_file != stdout && log->log_file != stderr)
-    log->log_file = NULL;
+  if(log_writer.thread != NULL)
+  {
+    record = g_new0(log_record, 1);
+    record->op  = LOG_CLOSE;
+    record->log = log;
+    g_async_queue_push(log_writer.queue, record);
+    return;
+  }
+
+  log_close(log);
+}
 
-  g_free(log);
+/**
+ * @brief Called in the child of every fork() once the log writer runs.
+ *
+ * The log writer thread does not exist in the child, so records queued for it
+ * would never be written. The child, an agent that is about to exec, writes its
+ * logs directly instead.
+ */
+static void log_writer_child()
+{
+  log_writer.thread = NULL;
+  log_writer.queue  = NULL;
+  log_writer.forked = TRUE;
+}
+
+/**
+ * @brief Starts the log writer thread.
+ *
+ * From now on the logs are written by the log writer, the threads that log
+ * only format the messages. This must be called after the scheduler became a
+ * daemon, since the thread does not survive a fork(). Children forked later
+ * write their logs directly, see log_writer_child().
+ */
+void log_writer_init()
+{
+  static gboolean atfork = FALSE;
+
+  if(log_writer.thread != NULL)
+    return;
+
+  if(!atfork)
+  {
+    pthread_atfork(NULL, NULL, log_writer_child);
+    atfork = TRUE;
+  }
+
+  log_writer.queue = g_async_queue_new();
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+  log_writer.thread = g_thread_new("log_writer", log_writer_loop, NULL);
+#else
+  log_writer.thread = g_thread_create(log_writer_loop, NULL, TRUE, NULL);
+#endif
+}
+
+/**
+ * @brief Writes everything that is left and stops the log writer thread.
+ *
+ * The logs are written directly again afterwards.
+ */
+void log_writer_destroy()
+{
+  GThread* thread = log_writer.thread;
+  log_record* record;
+
+  if(thread == NULL)
+    return;
+
+  record = g_new0(log_record, 1);
+  record->op = LOG_STOP;
+  g_async_queue_push(log_writer.queue, record);
+  g_thread_join(thread);
+
+  log_writer.thread = NULL;
+  g_async_queue_unref(log_writer.queue);
+  log_writer.queue = NULL;
+}
+
+/**
+ * @brief Waits until everything logged so far is written, used before the
+ *        scheduler exits because of a fatal error.
+ */
+void log_flush()
+{
+  GAsyncQueue* reply;
+  log_record* record;
+#if !(GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32)
+  GTimeVal timeout;
+#endif
+
+  if(log_writer.thread == NULL || g_thread_self() == log_writer.thread)
+    return;
+
+  reply = g_async_queue_new();
+  record = g_new0(log_record, 1);
+  record->op    = LOG_FLUSH;
+  record->reply = g_async_queue_ref(reply);
+  g_async_queue_push(log_writer.queue, record);
+
+#if GLIB_MAJOR_VERSION >= 2 && GLIB_MINOR_VERSION >= 32
+  g_async_queue_timeout_pop(reply, 5000000);
+#else
+  g_get_current_time(&timeout);
+  g_time_val_add(&timeout, 5000000);
+  g_async_queue_timed_pop(reply, &timeout);
+#endif
+  g_async_queue_unref(reply);
+}
+
+/**
+ * @brief The number of log lines dropped because the log writer was behind.
+ */
+uint32_t log_dropped()
+{
+  return g_atomic_int_get(&log_writer.dropped);
 }
 
 /**
@@ -223,12 +576,9 @@ int lprintf(log_t* log, const char* fmt, ...)
  */
 int vlprintf(log_t* log, const char* fmt, va_list args)
 {
-  /* static used to determine if a '\n' needs to be printed */
-  static int n_line = 1;
-
-  /* locals */
   time_t t = time(NULL);
-  char* tmp, * curr;
+  GString* text;
+  char* tmp, * curr, * save;
   char time_buf[64];
   int e_line;
 
@@ -238,32 +588,31 @@ int vlprintf(log_t* log, const char* fmt, va_list args)
   strftime(time_buf, sizeof(time_buf),"%F %T",localtime(&t));
 
   tmp = g_strdup_vprintf(fmt, args);
-  e_line = tmp[strlen(tmp) - 1] == '\n';
-  curr = strtok(tmp, "\n");
+  text = g_string_sized_new(strlen(tmp) + 64);
+  e_line = tmp[0] != '\0' && tmp[strlen(tmp) - 1] == '\n';
+  curr = strtok_r(tmp, "\n", &save);
   while(curr != NULL)
   {
-    if(n_line && fprintf(log->log_file, "%s %s [%d] :: ", time_buf,
-        log->pro_name, log->pro_pid) == 0)
-      return 0;
+    if(log->n_line)
+      log_line_start(log, text, time_buf);
 
-    if(fprintf(log->log_file, "%s", curr) == 0)
-      return 0;
+    if(!log->dropping)
+      g_string_append(text, curr);
 
-    n_line = ((curr = strtok(NULL, "\n")) != NULL);
-    if(n_line && fprintf(log->log_file, "\n") == 0)
-        return 0;
+    log->n_line = ((curr = strtok_r(NULL, "\n", &save)) != NULL);
+    if(log->n_line && !log->dropping)
+      g_string_append_c(text, '\n');
   }
 
   if(e_line)
   {
-    n_line = 1;
-    if(fprintf(log->log_file, "\n") == 0)
-      return 0;
+    log->n_line = 1;
+    if(!log->dropping)
+      g_string_append_c(text, '\n');
   }
 
-  fflush(log->log_file);
   g_free(tmp);
-  return 1;
+  return log_write(log, text);
 }
 
 /**
@@ -288,12 +637,12 @@ int clprintf(log_t* log, char* s_name, uint16_t s_line, const char* fmt, ...)
   if(!log) return 0;
 
   va_start(args, fmt);
-  if(g_thread_self() != main_thread)
+  if(g_thread_self() != main_thread && !log_writer.forked)
   {
     pass = g_new0(log_event_args, 1);
     pass->log = log;
     pass->msg = g_strdup_vprintf(fmt, args);
-    event_signal_ext(log_event, pass, "log_event", s_name, s_line);
+    event_signal_priority_ext(log_event, pass, EVENT_HIGH, "log_event", s_name, s_line);
   }
   else
   {
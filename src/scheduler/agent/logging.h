@@ -48,6 +48,9 @@ typedef struct
     gchar* pro_name;  ///< What should be printed as the process name
     pid_t  pro_pid;   ///< The pid of the process
     FILE*  log_file;  ///< The log file itself
+    int    n_line;    ///< The next message starts a new line
+    gboolean dropping; ///< The current line is dropped, the log writer is behind
+    uint32_t dropped; ///< The lines dropped since the last line that was written
 } log_t;
 
 // global log file
@@ -76,6 +79,7 @@ extern log_t* main_log;
             lprintf(main_log, __VA_ARGS__); \
             lprintf(main_log, "\n"); \
             lprintf(main_log, "FATAL errno is: %s\n", strerror(errno)); \
+            log_flush(); \
             exit(-2); } while(0)
 
 /** Macro that is called when a thread generated a fatal error */
@@ -143,6 +147,11 @@ log_t* log_new(gchar* log_name, gchar* pro_name, pid_t pro_pid);
 log_t* log_new_FILE(FILE* log_file, gchar* log_name, gchar* pro_name, pid_t pro_pid);
 void log_destroy(log_t* log);
 
+void log_writer_init();
+void log_writer_destroy();
+void log_flush();
+uint32_t log_dropped();
+
 int  lprintf (log_t* log, const char* fmt, ...);
 int  clprintf(log_t* log, char* s_name, uint16_t s_line, const char* fmt, ...);
 int  vlprintf(log_t* log, const char* fmt, va_list args);
@@ -27,6 +27,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <host.h>
 #include <interface.h>
 #include <scheduler.h>
+#include <stats.h>
 #include <fossconfig.h>
 
 /* std library includes */
@@ -154,6 +155,8 @@ void scheduler_signal(scheduler_t* scheduler)
 {
   // the last time an update was run
   static time_t last_update = 0;
+  // the last time the job queue was polled
+  static time_t last_poll = 0;
 
   // copy of the mask
   guint mask;
@@ -168,7 +171,7 @@ void scheduler_signal(scheduler_t* scheduler)
 
   /* initialize last_update */
   if(last_update == 0)
-    last_update = time(NULL);
+    last_update = last_poll = time(NULL);
 
   /* signal: SIGCHLD
    *
@@ -189,7 +192,7 @@ void scheduler_signal(scheduler_t* scheduler)
       pass = g_new0(pid_t, 2);
       pass[0] = n;
       pass[1] = status;
-      event_signal(agent_death_event, pass);
+      event_signal_priority(agent_death_event, pass, EVENT_HIGH);
     }
   }
 
@@ -201,7 +204,7 @@ void scheduler_signal(scheduler_t* scheduler)
   if(mask & MASK_SIGTERM)
   {
     V_SCHED("SIGNALS: Scheduler received terminate signal, shutting down gracefully\n");
-    event_signal(scheduler_close_event, (void*)0);
+    event_signal_priority(scheduler_close_event, (void*)0, EVENT_HIGH);
   }
 
   /* signal: SIGQUIT
@@ -213,7 +216,7 @@ void scheduler_signal(scheduler_t* scheduler)
   if(mask & MASK_SIGQUIT)
   {
     V_SCHED("SIGNALS: Scheduler received quit signal, shutting down scheduler\n");
-    event_signal(scheduler_close_event, (void*)1);
+    event_signal_priority(scheduler_close_event, (void*)1, EVENT_HIGH);
   }
 
   /* signal: SIGHUP
@@ -229,18 +232,27 @@ void scheduler_signal(scheduler_t* scheduler)
 
   /* Finish by checking if an agent update needs to be performed.
    *
-   * Every CONF_agent_update_interval, the agents and database should be
-   * updated. The agents need to be updated to check for dead and unresponsive
-   * agents. The database is updated to make sure that a new job hasn't been
-   * scheduled without the scheduler being informed.
+   * Every CONF_agent_update_interval, the agents should be updated to check
+   * for dead and unresponsive agents.
    */
   if((time(NULL) - last_update) > CONF_agent_update_interval )
   {
-    V_SPECIAL("SIGNALS: Performing agent and database update\n");
+    V_SPECIAL("SIGNALS: Performing agent update\n");
     event_signal(agent_update_event, NULL);
-    event_signal(database_update_event, NULL);
     last_update = time(NULL);
   }
+
+  /* New jobs are normally announced by a notification from the database.
+   * Every CONF_database_poll_interval, the job queue is checked anyway to make
+   * sure that a new job hasn't been scheduled without the scheduler being
+   * informed.
+   */
+  if((time(NULL) - last_poll) > CONF_database_poll_interval )
+  {
+    V_SPECIAL("SIGNALS: Performing database update\n");
+    event_signal(database_update_event, NULL);
+    last_poll = time(NULL);
+  }
 }
 
 /* ************************************************************************** */
@@ -372,9 +384,16 @@ scheduler_t* scheduler_init(gchar* sysconfigdir, log_t* log)
  */
 void scheduler_destroy(scheduler_t* scheduler)
 {
+  /* the launcher threads use the pipes of the agents */
+  g_tree_unref(scheduler->host_list);
 
   event_loop_destroy();
+  agent_io_destroy();
+
+  /* the progress of the jobs that the event loop did not write anymore */
+  database_processed_event(scheduler, NULL);
 
+  log_writer_destroy();
   if(scheduler->main_log)
   {
     log_destroy(scheduler->main_log);
@@ -398,11 +417,13 @@ void scheduler_destroy(scheduler_t* scheduler)
 
   g_tree_unref(scheduler->meta_agents);
   g_tree_unref(scheduler->agents);
-  g_tree_unref(scheduler->host_list);
   g_tree_unref(scheduler->job_list);
 
+  email_worker_destroy();
+  database_listen_destroy();
   if (scheduler->db_conn) PQfinish(scheduler->db_conn);
 
+  stats_destroy();
   g_free(scheduler);
 }
 
@@ -426,6 +447,176 @@ static gboolean isMaxLimitReached(meta_agent_t* agent)
   }
 }
 
+/**
+ * @brief Checks if a user is waiting for a job in the UI.
+ *
+ * These are the jobs with a priority below 0, which an admin can set with the
+ * priority command, and the jobs of agents with the INTERACTIVE special.
+ *
+ * @param scheduler  the scheduler the job belongs to
+ * @param job        the job to check
+ * @return TRUE if the job is interactive
+ */
+static gboolean is_interactive(scheduler_t* scheduler, job_t* job)
+{
+  return job->priority < 0 || is_meta_special(
+      g_tree_lookup(scheduler->meta_agents, job->agent_type), SAG_INTERACTIVE);
+}
+
+/**
+ * State of the search through the job list of scheduler_preempt() and
+ * scheduler_resume().
+ */
+typedef struct
+{
+  scheduler_t* scheduler; ///< the scheduler that is searched
+  host_t*  host;          ///< the host the agents must be on, NULL for any
+  job_t*   job;           ///< the best job found so far
+  gboolean draining;      ///< agents of a preempted job are finishing their chunk
+} job_search_t;
+
+/**
+ * @brief Traversal function of scheduler_preempt().
+ *
+ * Finds the least important runonpfile job that is running and not
+ * interactive, with an agent on the host that is needed. Other agents cannot
+ * stop between two items, so their jobs are never preempted.
+ */
+static gboolean preempt_candidate(int* id, job_t* job, job_search_t* search)
+{
+  GList* iter;
+  agent_t* agent;
+
+  if(job->preempted)
+  {
+    for(iter = job->running_agents; iter != NULL; iter = iter->next)
+      if(((agent_t*)iter->data)->status != AG_PAUSED)
+        search->draining = TRUE;
+    return FALSE;
+  }
+
+  if(job->id <= 0 || job->chunks == NULL ||
+      (job->status != JB_STARTED && job->status != JB_RESTART) ||
+      is_interactive(search->scheduler, job) || is_meta_special(
+      g_tree_lookup(search->scheduler->meta_agents, job->agent_type), SAG_EXCLUSIVE))
+    return FALSE;
+
+  for(iter = job->running_agents; iter != NULL; iter = iter->next)
+  {
+    agent = iter->data;
+    if(agent->status == AG_RUNNING && (search->host == NULL || agent->host == search->host))
+      break;
+  }
+
+  if(iter != NULL && (search->job == NULL || job->priority > search->job->priority ||
+      (job->priority == search->job->priority && job->id > search->job->id)))
+    search->job = job;
+  return FALSE;
+}
+
+/**
+ * @brief Pauses a job so that a waiting interactive job can start.
+ *
+ * This is called when the interactive job at the top of the job queue finds
+ * no free slot. With preempt set, the least important running runonpfile job
+ * that is not interactive and has an agent on a host the interactive job can
+ * use is paused with job_preempt(). Its slots are free once its agents finish
+ * their chunk, so the waiting job starts at a later update. Nothing is paused
+ * while the agents of a job that was preempted before are still finishing
+ * their chunk, or when the job waits for memory rather than a slot, since a
+ * paused agent keeps its memory.
+ *
+ * @param scheduler  the scheduler
+ * @param job        the job that is waiting
+ * @param host       the host the job must run on, NULL if it can run anywhere
+ */
+static void scheduler_preempt(scheduler_t* scheduler, job_t* job, host_t* host)
+{
+  job_search_t search = { scheduler, host, NULL, FALSE };
+  GList* iter;
+
+  if(!CONF_preempt || !is_interactive(scheduler, job) || is_meta_special(
+      g_tree_lookup(scheduler->meta_agents, job->agent_type), SAG_EXCLUSIVE))
+    return;
+
+  if(host != NULL && host_free(host, 0) > 0)
+    return;
+  for(iter = scheduler->host_queue; host == NULL && iter != NULL; iter = iter->next)
+    if(host_free(iter->data, 0) > 0)
+      return;
+
+  g_tree_foreach(scheduler->job_list, (GTraverseFunc)preempt_candidate, &search);
+  if(search.draining || search.job == NULL)
+    return;
+
+  V_SCHED("JOB_INIT: pausing JOB[%d] for interactive JOB[%d]\n", search.job->id, job->id);
+  job_preempt(scheduler, search.job);
+}
+
+/**
+ * @brief Traversal function of scheduler_resume().
+ *
+ * Finds the most important preempted job whose stopped agents all fit on
+ * their hosts again.
+ */
+static gboolean resume_candidate(int* id, job_t* job, job_search_t* search)
+{
+  GList* iter;
+  GList* other;
+  agent_t* agent;
+  int n;
+
+  if(!job->preempted || (search->job != NULL && (job->priority > search->job->priority ||
+      (job->priority == search->job->priority && job->id > search->job->id))))
+    return FALSE;
+
+  for(iter = job->running_agents; iter != NULL && !closing; iter = iter->next)
+  {
+    agent = iter->data;
+    if(agent->status != AG_PAUSED)
+      continue;
+
+    for(n = 0, other = job->running_agents; other != NULL; other = other->next)
+      if(((agent_t*)other->data)->status == AG_PAUSED && ((agent_t*)other->data)->host == agent->host)
+        n++;
+    if(host_free(agent->host, CONF_interactive_reserve) < n)
+      return FALSE;
+  }
+
+  search->job = job;
+  return FALSE;
+}
+
+/**
+ * @brief Restarts a job that scheduler_preempt() paused, once there is room.
+ *
+ * Nothing is restarted while an interactive job waits at the top of the job
+ * queue. Otherwise the most important preempted job whose agents fit on their
+ * hosts again is restarted with job_restart_event(). When the scheduler is
+ * closing, preempted jobs are restarted at once so that their agents can end.
+ *
+ * @param scheduler  the scheduler
+ */
+static void scheduler_resume(scheduler_t* scheduler)
+{
+  job_search_t search = { scheduler, NULL, NULL, FALSE };
+  job_t* head = peek_job(scheduler->job_queue);
+  arg_int* params;
+
+  if(!closing && head != NULL && is_interactive(scheduler, head))
+    return;
+
+  g_tree_foreach(scheduler->job_list, (GTraverseFunc)resume_candidate, &search);
+  if(search.job == NULL)
+    return;
+
+  V_SCHED("JOB_INIT: resuming preempted JOB[%d]\n", search.job->id);
+  params = g_new0(arg_int, 1);
+  params->first = search.job;
+  params->second = search.job->id;
+  job_restart_event(scheduler, params);
+}
+
 /**
  * @brief Update function called after every event
  *
@@ -434,11 +625,14 @@ static gboolean isMaxLimitReached(meta_agent_t* agent)
  * is executed. Therefore the code should be light weight since it will be run
  * very frequently.
  *
- * @todo Currently this will only grab a job and create a single agent to execute
- *   the job.
+ * Every job gets a single agent, except runonpfile jobs, which get an agent
+ * per chunk of their upload up to runonpfile_max_agents, spread over the hosts.
+ *
+ * Interactive jobs may use the capacity that interactive_reserve keeps free on
+ * every host, and pause other jobs when that is not enough, see
+ * scheduler_preempt(). Jobs paused like this are restarted before any new job
+ * is started, see scheduler_resume().
  *
- * @todo Allow for runonpfile jobs to have multiple agents based on size
- * @todo Allow for job preemption. The scheduler can pause jobs, allow it
  * @todo Allow for specific hosts to be chosen.
  */
 void scheduler_update(scheduler_t* scheduler)
@@ -451,6 +645,9 @@ void scheduler_update(scheduler_t* scheduler)
   /* locals */
   int n_agents = g_tree_nnodes(scheduler->agents);
   int n_jobs   = active_jobs(scheduler->job_list);
+  int wanted;
+  uint32_t reserve;
+  meta_agent_t* type;
 
   /* check to see if we are in and can exit the startup state */
   if(scheduler->s_startup && n_agents == 0)
@@ -459,6 +656,10 @@ void scheduler_update(scheduler_t* scheduler)
     scheduler->s_startup = 0;
   }
 
+  /* idle agents are not needed anymore once the scheduler is closing */
+  if(closing)
+    agent_pool_drain(scheduler);
+
   /* check if we are able to close the scheduler */
   if(closing && n_agents == 0 && n_jobs == 0)
   {
@@ -469,13 +670,18 @@ void scheduler_update(scheduler_t* scheduler)
   if(lockout && n_agents == 0 && n_jobs == 0)
     lockout = 0;
 
+  /* jobs paused for an interactive job go first once it is done */
+  scheduler_resume(scheduler);
+
   if(job == NULL && !lockout)
   {
     while((job = peek_job(scheduler->job_queue)) != NULL)
     {
+      reserve = is_interactive(scheduler, job) ? 0 : CONF_interactive_reserve;
+      type = g_tree_lookup(scheduler->meta_agents, job->agent_type);
+
       // Check the max limit of running agents
-      if (isMaxLimitReached(
-          g_tree_lookup(scheduler->meta_agents, job->agent_type)))
+      if (isMaxLimitReached(type))
       {
         V_SCHED("JOB_INIT: Unable to run agent %s due to max_run limit.\n",
             job->agent_type);
@@ -487,8 +693,9 @@ void scheduler_update(scheduler_t* scheduler)
           g_tree_lookup(scheduler->meta_agents, job->agent_type), SAG_LOCAL))
       {
         host = g_tree_lookup(scheduler->host_list, LOCAL_HOST);
-        if(!(host->running < host->max))
+        if(host_free(host, reserve) < 1 || !host_fits(host, type->memory))
         {
+          scheduler_preempt(scheduler, job, host);
           job = NULL;
           break;
         }
@@ -499,8 +706,9 @@ void scheduler_update(scheduler_t* scheduler)
         host = g_tree_lookup(scheduler->host_list, job->required_host);
         if(host != NULL)
         {
-          if(!(host->running < host->max))
+          if(host_free(host, reserve) < 1 || !host_fits(host, type->memory))
           {
+          scheduler_preempt(scheduler, job, host);
           job = NULL;
           break;
         }
@@ -514,13 +722,26 @@ void scheduler_update(scheduler_t* scheduler)
        }
       }
       // the generic case, this can run anywhere, find a place
-      else if((host = get_host(&(scheduler->host_queue), 1)) == NULL)
+      else if((host = get_host(&(scheduler->host_queue), 1, type->weight, type->memory,
+          reserve)) == NULL)
       {
+        scheduler_preempt(scheduler, job, NULL);
         job = NULL;
         break;
       }
 
-      next_job(scheduler->job_queue);
+      /* a runonpfile job stays at the top of the queue until it has an agent
+       * for every chunk, or as many as it may use */
+      wanted = job_agents_wanted(job);
+      if(wanted <= 1 || is_meta_special(
+          g_tree_lookup(scheduler->meta_agents, job->agent_type), SAG_EXCLUSIVE))
+        next_job(scheduler->job_queue);
+      if(wanted <= 0)
+      {
+        job = NULL;
+        continue;
+      }
+
       if(is_meta_special(
           g_tree_lookup(scheduler->meta_agents, job->agent_type), SAG_EXCLUSIVE))
       {
@@ -529,11 +750,16 @@ void scheduler_update(scheduler_t* scheduler)
       }
 
       V_SCHED("Starting JOB[%d].%s\n", job->id, job->agent_type);
-      agent_init(scheduler, host, job);
+      if(agent_init(scheduler, host, job) == NULL && wanted > 1)
+        next_job(scheduler->job_queue);
       job = NULL;
     }
   }
 
+  /* an exclusive job waits for every other agent to be gone, idle ones too */
+  if(job != NULL)
+    agent_pool_drain(scheduler);
+
   if(job != NULL && n_agents == 0 && n_jobs == 0)
   {
     agent_init(scheduler, host, job);
@@ -681,6 +907,7 @@ int kill_scheduler(int force)
  */
 void scheduler_clear_config(scheduler_t* scheduler)
 {
+  agent_pool_drain(scheduler);
   g_tree_clear(scheduler->meta_agents);
   g_tree_clear(scheduler->host_list);
 
@@ -690,6 +917,7 @@ void scheduler_clear_config(scheduler_t* scheduler)
   g_free(scheduler->host_url);
   g_free(scheduler->email_subject);
   g_free(scheduler->email_command);
+  database_listen_destroy();
   PQfinish(scheduler->db_conn);
   scheduler->db_conn       = NULL;
   scheduler->host_url      = NULL;
@@ -750,6 +978,10 @@ void g_tree_clear(GTree* tree)
  * -# command: The command that will be used to start the agent
  * -# max:     The maximum number of this agent that can run at once
  * -# special: Anything that is special about the agent
+ * -# weight:  Optional, how much of a host one agent uses compared to an agent
+ *             of weight 1, see get_host()
+ * -# memory:  Optional, the memory in MB one agent is expected to use at least,
+ *             see host_fits()
  */
 void scheduler_agent_config(scheduler_t* scheduler)
 {
@@ -817,6 +1049,10 @@ void scheduler_agent_config(scheduler_t* scheduler)
             special |= SAG_NOKILL;
           else if(strncmp(cmd, "LOCAL", 6) == 0)
             special |= SAG_LOCAL;
+          else if(strncmp(cmd, "POOL", 4) == 0)
+            special |= SAG_POOL;
+          else if(strncmp(cmd, "INTERACTIVE", 11) == 0)
+            special |= SAG_INTERACTIVE;
           else if(strlen(cmd) != 0)
             WARNING("%s: Invalid special type for agent %s: %s",
                 dirname, name, cmd);
@@ -832,13 +1068,27 @@ void scheduler_agent_config(scheduler_t* scheduler)
       {
         V_SCHED("CONFIG: could not create meta agent using %s\n", ep->d_name);
       }
-      else if(TVERB_SCHED)
+      else
       {
-        log_printf("CONFIG: added new agent\n");
-        log_printf("    name = %s\n", name);
-        log_printf(" command = %s\n", cmd);
-        log_printf("     max = %d\n", max);
-        log_printf(" special = %d\n", special);
+        meta_agent_t* ma = g_tree_lookup(scheduler->meta_agents, name);
+
+        if(fo_config_has_key(config, "default", "weight") &&
+            (i = atoi(fo_config_get(config, "default", "weight", &error))) > 0)
+          ma->weight = i;
+        if(fo_config_has_key(config, "default", "memory") &&
+            (i = atoi(fo_config_get(config, "default", "memory", &error))) > 0)
+          ma->memory = ma->memory_min = i;
+
+        if(TVERB_SCHED)
+        {
+          log_printf("CONFIG: added new agent\n");
+          log_printf("    name = %s\n", name);
+          log_printf(" command = %s\n", cmd);
+          log_printf("     max = %d\n", max);
+          log_printf(" special = %d\n", special);
+          log_printf("  weight = %u\n", ma->weight);
+          log_printf("  memory = %u\n", ma->memory);
+        }
       }
 
       g_free(dirname);
@@ -866,6 +1116,7 @@ void scheduler_foss_config(scheduler_t* scheduler)
   gchar*   tmp;                   // pointer into a string
   gchar**  keys;                  // list of host names grabbed from the config file
   int32_t  max = -1;              // the number of agents to a host or number of one type running
+  int32_t  budget = 0;            // the memory in MB the agents on a host may use
   int32_t  special = 0;           // anything that is special about the agent (EXCLUSIVE)
   gchar    addbuf[512];           // standard string buffer
   gchar    dirbuf[FILENAME_MAX];  // standard string buffer
@@ -917,8 +1168,11 @@ void scheduler_foss_config(scheduler_t* scheduler)
       continue;
     }
 
-    sscanf(tmp, "%s %s %d", addbuf, dirbuf, &max);
+    budget = 0;
+    sscanf(tmp, "%s %s %d %d", addbuf, dirbuf, &max, &budget);
     host = host_init(keys[i], addbuf, dirbuf, max);
+    host->repo = fo_config_has_key(scheduler->sysconfig, "REPOSITORY", keys[i]);
+    host->budget = MAX(budget, 0);
     host_insert(host, scheduler);
     if(TVERB_SCHED)
     {
@@ -927,6 +1181,7 @@ void scheduler_foss_config(scheduler_t* scheduler)
       log_printf("   address = %s\n", addbuf);
       log_printf(" directory = %s\n", dirbuf);
       log_printf("       max = %d\n", max);
+      log_printf("    memory = %u\n", host->budget);
     }
   }
 
@@ -42,11 +42,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
  *     agent. A job is a scheduler construct used to run an agent process.
  * \section schedulerarchitecture Scheduler Architecture
  * Scheduler use a classic client server communication style for both the agent
- * communication and the UI communication. Every time a new communication
- * channel is needed, the scheduler will create a new thread to manage the
- * communications with that channel. This makes the communication logic much simpler.
+ * communication and the UI communication. UI connections are handled by a pool
+ * of interface threads. The output of every agent is read by a single agent io
+ * thread, which waits on the pipes of all agents with epoll and handles every
+ * line an agent writes as soon as it is complete.
  *
- * If the communication thread receives anything that would involve changing a
+ * If a communication thread receives anything that would involve changing a
  * data structure internal to the scheduler, it passes the information off to
  * the main thread instead of changing it personally. The communication threads send
  * information to the main thread using events. The communication thread will package
@@ -58,27 +59,60 @@ with this program; if not, write to the Free Software Foundation, Inc.,
  * created the jobs will have agents allocated to them. Allocated agents belong
  * to the job and will remain in the scheduler's data structures until the job
  * is removed from the system. Jobs are responsible for cleaning up any agents
- * allocated to them.
+ * allocated to them. A job whose jobqueue entry sets jq_runonpfile is split into
+ * ranges of the pfiles of its upload, these chunks are handed to several agents
+ * on different hosts and the job is complete once every chunk is.
+ *
+ * Agents whose configuration sets the POOL special are not closed when their
+ * job completes. Up to agent_pool_size of them are kept idle on every host and
+ * the next job of the same type is given to one of them with a "JOB" line
+ * instead of starting a new process. An agent is replaced once it has run
+ * agent_pool_jobs jobs or uses more than agent_pool_memory MB.
+ *
+ * New agents are placed on the host chosen by the host_policy. By default this
+ * is the host with the lowest expected load, computed from the weight that
+ * each agent type declares in its configuration file and from the cpu load and
+ * free memory that running agents report for their host with "LOAD" lines.
+ *
+ * Interactive jobs, the ones a user waits for in the UI, are the jobs with a
+ * priority below 0 and the jobs of agents with the INTERACTIVE special. Only
+ * they may use the interactive_reserve percent of every host. When one of them
+ * finds no free slot and preempt is set, the least important other runonpfile
+ * job is paused at the end of its chunks until there is room for it again, see
+ * scheduler_preempt().
+ *
+ * Agents on a remote host are started by an fo_launcher on that host, which
+ * the scheduler starts once using ssh when launcher is set. The pipes of all
+ * agents of the host are multiplexed over that one connection, so an agent
+ * sees the same stdin and stdout as a local one. If the launcher is lost, the
+ * agents are started with one ssh process each until it is started again.
  *
  * Within a job, when an agent is ready for data, it will inform the main thread
  * that it is waiting. The main thread will then take a chunk of data from the
- * job that the agent belongs to and allocate it to the agent. The communication
+ * job that the agent belongs to and allocate it to the agent. The agent io
  * thread will then be responsible for sending the data to the corresponding
- * process. It is important to note that the communication threads are using
- * blocking IO on the pipe from the corresponding process. As a result, any
- * string that starts with "@" is reserved as a communication from the scheduler
- * instead of the corresponding process. Writing anything that starts with "@"
- * to stdout within an agent will result in undefined behavior.
+ * process. The main thread talks to the agent io thread by writing to the pipe
+ * from the corresponding process. As a result, any string that starts with "@"
+ * is reserved as a communication from the scheduler instead of the
+ * corresponding process. Writing anything that starts with "@" to stdout
+ * within an agent will result in undefined behavior.
  *
  * Here are some other properties of the scheduler:
  * - Scheduler can take advantage of multiple processors on whatever machine it is running on.
- * - Simplified code for communicating with agents since all IO would be blocking instead of non-blocking.
+ * - The number of scheduler threads does not grow with the number of running agents.
  * - Master thread can not get swamped with communications between the agents and can concentrate on managing new jobs.
  * - Uses GLib
  * - Job queue is implemented in db tables:
  *     - **job** - the job stream
  *     - **jobqueue** - individual jobs
  *     - **jobdepends** - job dependencies (for example, you can't run buckets until the license scan is done)
+ * - New jobqueue entries are announced with a "NOTIFY fossology_jobs". A listener
+ *   thread with its own database connection waits for these and makes the main
+ *   thread check the job queue. The job queue is also polled every
+ *   database_poll_interval seconds in case a notification was lost.
+ * - Jobqueue entries that wait for others are read once and kept in memory
+ *   with their dependencies. They are queued as soon as the entries they wait
+ *   for complete, without another check of the job queue.
  *
  * [More info on scheduler](https://github.com/fossology/fossology/wiki/Job-Scheduler)
  * \section scheduleractions Communicating with scheduler
@@ -101,6 +135,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
  * | priority | Changes the priority of a particular job within the scheduler. |
  * | database | Check the database job queue for new jobs. |
  *
+ * The same port answers "GET /metrics" over http with statistics in the
+ * Prometheus text format, so a monitoring system can scrape the scheduler
+ * directly: the depth of the job queue per agent type, the running agents
+ * per host, histograms of job wait and run times, items per second from the
+ * agent heartbeats, agent failures and restarts and the lag of the event
+ * loop. See stats.c.
+ *
  * \section schedulersource Agent source
  *   - \link src/scheduler/agent \endlink
  *   - Test agents \link src/scheduler/agent_tests/agents \endlink
@@ -239,7 +280,23 @@ extern GThread* main_thread;
  *   agent_death_timer     => The amount of time to wait before killing an agent
  *   agent_update_interval => The time between each SIGALRM for the scheduler
  *   agent_update_number   => The number of updates before killing an agent
+ *   database_poll_interval => The time between checks of the job queue when no
+ *                            notification about a new job was received
  *   interface_nthreads    => The number of threads available to the interface
+ *   runonpfile_chunk_size => The number of pfiles in a chunk of a runonpfile job
+ *   runonpfile_max_agents => The number of agents that work on a runonpfile job at once
+ *   agent_pool_size       => The number of idle agents of a type kept per host, 0 disables the pool
+ *   agent_pool_jobs       => The number of jobs an agent runs before it is replaced
+ *   agent_pool_memory     => The resident memory in MB above which an agent is replaced
+ *   host_policy           => How new agents are placed, "leastloaded" or "roundrobin"
+ *   host_min_memory       => The free memory in MB below which a host is only used as a last resort
+ *   preempt               => Pause other runonpfile jobs when an interactive job finds no free slot
+ *   interactive_reserve   => The percentage of every host only used by interactive jobs
+ *   launcher              => Start remote agents through one fo_launcher per host instead of ssh
+ *   log_buffer            => The log messages waiting for the log writer before lines are dropped
+ *   log_fsync             => The seconds between fsyncs of the log files, 0 never syncs
+ *   email_timeout         => The seconds the email client may take before it is killed
+ *   email_retries         => How often a notification that could not be sent is tried again
  *
  * For the operation that will be taken when a variable is loaded from the
  * configuration file. You should provide a function or macro that takes a
@@ -258,7 +315,22 @@ extern GThread* main_thread;
   apply(uint32_t, agent_death_timer,     atoi, %d, 180)           \
   apply(uint32_t, agent_update_interval, atoi, %d, 120)           \
   apply(uint32_t, agent_update_number,   atoi, %d, 5)             \
-  apply(gint,     interface_nthreads,    atoi, %d, 10)
+  apply(uint32_t, database_poll_interval, atoi, %d, 600)          \
+  apply(gint,     interface_nthreads,    atoi, %d, 10)             \
+  apply(uint32_t, runonpfile_chunk_size, atoi, %d, 10000)         \
+  apply(uint32_t, runonpfile_max_agents, atoi, %d, 8)             \
+  apply(uint32_t, agent_pool_size,       atoi, %d, 2)             \
+  apply(uint32_t, agent_pool_jobs,       atoi, %d, 100)           \
+  apply(uint32_t, agent_pool_memory,     atoi, %d, 1024)          \
+  apply(uint32_t, host_policy,           host_policy_parse, %d, HOST_LEAST_LOADED) \
+  apply(uint32_t, host_min_memory,       atoi, %d, 256)           \
+  apply(uint32_t, preempt,               atoi, %d, 1)             \
+  apply(uint32_t, interactive_reserve,   atoi, %d, 0)             \
+  apply(uint32_t, launcher,              atoi, %d, 1)             \
+  apply(uint32_t, log_buffer,            atoi, %d, 10000)         \
+  apply(uint32_t, log_fsync,             atoi, %d, 0)             \
+  apply(uint32_t, email_timeout,         atoi, %d, 60)            \
+  apply(uint32_t, email_retries,         atoi, %d, 3)
 
 /** The extern declaractions of configuration varaibles */
 #define SELECT_DECLS(type, name, l_op, w_op, val) extern type CONF_##name;
@@ -115,25 +115,40 @@ const char* jobsql_email_job =
 
 /* job queue related sql */
 /**
- * Get the jobs which are not yet queued by the scheduler
+ * Get the jobs which are not yet started, together with the user, group and
+ * priority of the job they belong to and the jobs they still wait for. Jobs
+ * that depend on a failed job are left out, they can never run
  */
 const char* basic_checkout =
-    " SELECT jobqueue.* FROM jobqueue INNER JOIN job ON job_pk = jq_job_fk "
+    " SELECT jobqueue.*, job_priority, job_group_fk AS group_pk, user_pk, "
+    "     ARRAY(SELECT jdep_jq_depends_fk FROM jobdepends, jobqueue jdep "
+    "       WHERE jdep_jq_fk=jobqueue.jq_pk "
+    "         AND jdep_jq_depends_fk=jdep.jq_pk "
+    "         AND jdep.jq_endtime IS NULL) AS jq_depends "
+    "   FROM jobqueue INNER JOIN job ON job_pk = jq_job_fk "
+    "   LEFT JOIN users ON user_pk = job_user_fk "
     " WHERE jq_starttime IS NULL AND jq_end_bits < 2 "
     "   AND NOT EXISTS(SELECT * FROM jobdepends, jobqueue jdep "
     "     WHERE jdep_jq_fk=jobqueue.jq_pk "
     "       AND jdep_jq_depends_fk=jdep.jq_pk"
-    "       AND NOT(jdep.jq_endtime IS NOT NULL AND jdep.jq_end_bits < 2)) "
-    " ORDER BY job_priority DESC "
-    "   LIMIT 10;";
+    "       AND jdep.jq_end_bits >= 2) "
+    " ORDER BY job_priority DESC;";
 
 /**
- * For a given job id, get the job information
+ * Subscribe to the notifications sent when a jobqueue entry is added
  */
-const char* jobsql_information =
-    " SELECT user_pk, job_priority, job_group_fk as group_pk FROM users "
-    "   LEFT JOIN job ON job_user_fk = user_pk "
-    "   WHERE job_pk = '%s';";
+const char* jobsql_listen =
+    " LISTEN fossology_jobs;";
+
+/**
+ * Split the distinct pfiles of an upload into ranges of at most %d pfiles
+ */
+const char* jobsql_chunks =
+    " SELECT min(pfile_fk) AS first, max(pfile_fk) AS last FROM "
+    "   (SELECT pfile_fk, (row_number() OVER (ORDER BY pfile_fk) - 1) / %d AS chunk "
+    "     FROM (SELECT DISTINCT pfile_fk FROM uploadtree "
+    "       WHERE upload_fk = %d AND pfile_fk IS NOT NULL AND pfile_fk != 0) pfiles) ranges "
+    "   GROUP BY chunk ORDER BY chunk;";
 
 /**
  * Mark the given job id as started
@@ -181,12 +196,14 @@ const char* jobsql_failed =
     "   WHERE jq_pk = '%d';";
 
 /**
- * Update the items processed for the given job id
+ * Update the items processed for the given job ids, from a list of
+ * (jq_pk, items processed) values
  */
 const char* jobsql_processed =
-    " Update jobqueue "
-    "   SET jq_itemsprocessed = %d "
-    "   WHERE jq_pk = '%d';";
+    " UPDATE jobqueue "
+    "   SET jq_itemsprocessed = processed.num "
+    "   FROM (VALUES %s) AS processed(id, num) "
+    "   WHERE jq_pk = processed.id;";
 
 /**
  * Mark the given job id as paused
@@ -231,6 +248,17 @@ const char* jobsql_anyrunnable =
     "       AND NOT(jdep.jq_endtime IS NOT NULL AND jdep.jq_end_bits < 2))"
     "   AND jq_job_fk = (SELECT jq_job_fk FROM jobqueue queue WHERE queue.jq_pk = %d)";
 
+/**
+ * Get the started jobs of the same job as the given job id that are still
+ * running or that finished after it
+ */
+const char* jobsql_anylater =
+    " SELECT jq_pk FROM jobqueue "
+    "   WHERE jq_starttime IS NOT NULL AND jq_pk <> %d "
+    "     AND (jq_endtime IS NULL OR jq_endtime > "
+    "       (SELECT jq_endtime FROM jobqueue queue WHERE queue.jq_pk = %d)) "
+    "     AND jq_job_fk = (SELECT jq_job_fk FROM jobqueue queue WHERE queue.jq_pk = %d)";
+
 /**
  * Get the job id and job end bits for the given job id
  */
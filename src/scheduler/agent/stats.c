@@ -0,0 +1,537 @@
+/* **************************************************************
+Copyright (C) 2026 Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+************************************************************** */
+/**
+ * \file
+ * \brief Throughput statistics of the scheduler in the Prometheus format
+ *
+ * The scheduler keeps counters and histograms about its jobs, agents and
+ * event loop, and prints them together with the current state of the job
+ * queue and the hosts in the Prometheus text format. The interface serves
+ * them to "GET /metrics" requests, see interface_thread().
+ *
+ * Everything in here is only used by the main thread.
+ */
+
+/* local includes */
+#include <agent.h>
+#include <event.h>
+#include <host.h>
+#include <job.h>
+#include <logging.h>
+#include <scheduler.h>
+#include <stats.h>
+
+/* std library includes */
+#include <string.h>
+
+/* ************************************************************************** */
+/* **** Locals ************************************************************** */
+/* ************************************************************************** */
+
+/** The buckets of the job wait and run times in seconds */
+static const double stats_job_bounds[] = { 1, 5, 15, 60, 300, 900, 3600, 14400, 86400 };
+/** The buckets of the event loop lag in seconds */
+static const double stats_lag_bounds[] = { 0.0001, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 30 };
+
+/**
+ * The statistics of one agent type.
+ */
+typedef struct
+{
+    stats_histogram wait;     ///< seconds from queued to started of its jobs
+    stats_histogram run;      ///< seconds from started to finished of its jobs
+    uint64_t completed;       ///< the number of jobs that completed
+    uint64_t failed;          ///< the number of jobs that failed
+    uint64_t agent_failures;  ///< the number of agents that failed
+    uint64_t agent_restarts;  ///< the number of times work was given to a new agent after a failure
+    uint64_t items;           ///< the items processed by agents that are gone
+    uint32_t queued;          ///< used while printing, the jobs in the job queue
+    uint32_t waiting;         ///< used while printing, the jobs that wait for other jobs
+    uint32_t running;         ///< used while printing, the running agents
+    uint64_t live_items;      ///< used while printing, the items of the running agents
+    double   rate;            ///< used while printing, the items per second of the running agents
+} stats_type;
+
+static GTree* stats_types = NULL;  ///< the stats_type of every agent type, by name
+static stats_histogram stats_lag[EVENT_PRIORITIES]; ///< the time events wait in the event loop
+
+/**
+ * @brief Prepares an empty histogram.
+ */
+static void stats_histogram_init(stats_histogram* h, const double* bounds, guint n)
+{
+  h->bounds = bounds;
+  h->n = n;
+  h->buckets = g_new0(uint64_t, n + 1);
+  h->count = 0;
+  h->sum = 0;
+}
+
+/**
+ * @brief Adds an observation to a histogram.
+ */
+static void stats_histogram_observe(stats_histogram* h, double value)
+{
+  guint i;
+
+  for (i = 0; i < h->n && value > h->bounds[i]; i++);
+  h->buckets[i]++;
+  h->count++;
+  h->sum += value;
+}
+
+/**
+ * @brief Frees the statistics of an agent type.
+ */
+static void stats_type_destroy(stats_type* st)
+{
+  g_free(st->wait.buckets);
+  g_free(st->run.buckets);
+  g_free(st);
+}
+
+/**
+ * @brief Creates the statistics the first time they are used.
+ */
+static void stats_init()
+{
+  int i;
+
+  if (stats_types != NULL)
+    return;
+
+  stats_types = g_tree_new_full(string_compare, NULL, g_free, (GDestroyNotify)stats_type_destroy);
+  for (i = 0; i < EVENT_PRIORITIES; i++)
+    stats_histogram_init(&stats_lag[i], stats_lag_bounds, G_N_ELEMENTS(stats_lag_bounds));
+}
+
+/**
+ * @brief Gets the statistics of an agent type, they are created when needed.
+ *
+ * @param type  the name of the agent type
+ */
+static stats_type* stats_type_get(const char* type)
+{
+  stats_type* st;
+
+  stats_init();
+  if ((st = g_tree_lookup(stats_types, type)) == NULL)
+  {
+    st = g_new0(stats_type, 1);
+    stats_histogram_init(&st->wait, stats_job_bounds, G_N_ELEMENTS(stats_job_bounds));
+    stats_histogram_init(&st->run, stats_job_bounds, G_N_ELEMENTS(stats_job_bounds));
+    g_tree_insert(stats_types, g_strdup(type), st);
+  }
+
+  return st;
+}
+
+/**
+ * @brief Appends a label value, escaped the way the Prometheus format needs.
+ */
+static void stats_label(GString* str, const char* value)
+{
+  for (; *value; value++)
+  {
+    if (*value == '\\' || *value == '"')
+      g_string_append_c(str, '\\');
+    if (*value == '\n')
+      g_string_append(str, "\\n");
+    else
+      g_string_append_c(str, *value);
+  }
+}
+
+/**
+ * @brief Prints a histogram, with the label "label" set to value unless label
+ *        is NULL.
+ */
+static void stats_histogram_print(GString* str, const char* name, const char* label, const char* value,
+    stats_histogram* h)
+{
+  uint64_t total = 0;
+  guint i;
+
+  for (i = 0; i <= h->n; i++)
+  {
+    total += h->buckets[i];
+    g_string_append_printf(str, "%s_bucket{", name);
+    if (label)
+    {
+      g_string_append_printf(str, "%s=\"", label);
+      stats_label(str, value);
+      g_string_append(str, "\",");
+    }
+    if (i < h->n)
+      g_string_append_printf(str, "le=\"%g\"} %" G_GUINT64_FORMAT "\n", h->bounds[i], total);
+    else
+      g_string_append_printf(str, "le=\"+Inf\"} %" G_GUINT64_FORMAT "\n", total);
+  }
+
+  g_string_append_printf(str, "%s_sum", name);
+  if (label)
+  {
+    g_string_append_printf(str, "{%s=\"", label);
+    stats_label(str, value);
+    g_string_append(str, "\"}");
+  }
+  g_string_append_printf(str, " %g\n%s_count", h->sum, name);
+  if (label)
+  {
+    g_string_append_printf(str, "{%s=\"", label);
+    stats_label(str, value);
+    g_string_append(str, "\"}");
+  }
+  g_string_append_printf(str, " %" G_GUINT64_FORMAT "\n", h->count);
+}
+
+/**
+ * @brief GTraverseFunc that counts a job for the queue and waiting gauges.
+ */
+static int stats_count_job(int* job_id, job_t* job, gpointer unused)
+{
+  if (job->id >= 0 && job->depends != NULL)
+    stats_type_get(job->agent_type)->waiting++;
+  return 0;
+}
+
+/**
+ * @brief GFunc that counts a job in the job queue.
+ */
+static void stats_count_queued(job_t* job, gpointer unused)
+{
+  if (job->id >= 0)
+    stats_type_get(job->agent_type)->queued++;
+}
+
+/**
+ * @brief GTraverseFunc that counts a running agent for its type and its host.
+ *
+ * @param pid    the key of the agent
+ * @param agent  the agent
+ * @param hosts  the number of agents per host name
+ */
+static int stats_count_agent(int* pid, agent_t* agent, GHashTable* hosts)
+{
+  stats_type* st;
+  agent_metric* items;
+  GTree* metrics;
+
+  if (agent->owner->id < 0)
+    return 0;
+
+  st = stats_type_get(agent->type->name);
+  st->running++;
+  st->live_items += agent->total_analyzed;
+
+  metrics = metrics_init();
+  agent_fold_metrics(agent, metrics, TRUE);
+  if ((items = g_tree_lookup(metrics, "items")) != NULL)
+    st->rate += items->rate;
+  g_tree_destroy(metrics);
+
+  g_hash_table_insert(hosts, agent->host->name,
+      GINT_TO_POINTER(GPOINTER_TO_INT(g_hash_table_lookup(hosts, agent->host->name)) + 1));
+  return 0;
+}
+
+/**
+ * @brief GTraverseFunc that prints the gauges of one host.
+ */
+static int stats_print_host(char* name, host_t* host, gpointer* args)
+{
+  GString* str = args[0];
+  int agents = GPOINTER_TO_INT(g_hash_table_lookup(args[1], name));
+
+  g_string_append(str, "fossology_host_agents{host=\"");
+  stats_label(str, name);
+  g_string_append_printf(str, "\"} %d\n", agents);
+  g_string_append(str, "fossology_host_slots{host=\"");
+  stats_label(str, name);
+  g_string_append_printf(str, "\"} %d\n", host->max);
+  return 0;
+}
+
+/**
+ * @brief GTraverseFunc that prints one metric for every agent type.
+ *
+ * @param name  the name of the agent type
+ * @param st    its statistics
+ * @param args  the string to append to and the index of the metric
+ */
+static int stats_print_type(char* name, stats_type* st, gpointer* args)
+{
+  GString* str = args[0];
+
+  switch (GPOINTER_TO_INT(args[1]))
+  {
+    case 0:
+      g_string_append(str, "fossology_jobs_queued{agent=\"");
+      stats_label(str, name);
+      g_string_append_printf(str, "\"} %u\n", st->queued);
+      break;
+    case 1:
+      g_string_append(str, "fossology_jobs_waiting{agent=\"");
+      stats_label(str, name);
+      g_string_append_printf(str, "\"} %u\n", st->waiting);
+      break;
+    case 2:
+      g_string_append(str, "fossology_jobs_finished_total{agent=\"");
+      stats_label(str, name);
+      g_string_append_printf(str, "\",status=\"complete\"} %" G_GUINT64_FORMAT "\n", st->completed);
+      g_string_append(str, "fossology_jobs_finished_total{agent=\"");
+      stats_label(str, name);
+      g_string_append_printf(str, "\",status=\"failed\"} %" G_GUINT64_FORMAT "\n", st->failed);
+      break;
+    case 3:
+      stats_histogram_print(str, "fossology_job_wait_seconds", "agent", name, &st->wait);
+      break;
+    case 4:
+      stats_histogram_print(str, "fossology_job_run_seconds", "agent", name, &st->run);
+      break;
+    case 5:
+      g_string_append(str, "fossology_agents_running{agent=\"");
+      stats_label(str, name);
+      g_string_append_printf(str, "\"} %u\n", st->running);
+      break;
+    case 6:
+      g_string_append(str, "fossology_agent_items_total{agent=\"");
+      stats_label(str, name);
+      g_string_append_printf(str, "\"} %" G_GUINT64_FORMAT "\n", st->items);
+      break;
+    case 7:
+      g_string_append(str, "fossology_agent_items_running{agent=\"");
+      stats_label(str, name);
+      g_string_append_printf(str, "\"} %" G_GUINT64_FORMAT "\n", st->live_items);
+      break;
+    case 8:
+      g_string_append(str, "fossology_agent_items_per_second{agent=\"");
+      stats_label(str, name);
+      g_string_append_printf(str, "\"} %.1f\n", st->rate);
+      break;
+    case 9:
+      g_string_append(str, "fossology_agent_failures_total{agent=\"");
+      stats_label(str, name);
+      g_string_append_printf(str, "\"} %" G_GUINT64_FORMAT "\n", st->agent_failures);
+      break;
+    case 10:
+      g_string_append(str, "fossology_agent_restarts_total{agent=\"");
+      stats_label(str, name);
+      g_string_append_printf(str, "\"} %" G_GUINT64_FORMAT "\n", st->agent_restarts);
+      break;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief GTraverseFunc that clears the gauges of an agent type after printing.
+ */
+static int stats_clear_type(char* name, stats_type* st, gpointer unused)
+{
+  st->queued = 0;
+  st->waiting = 0;
+  st->running = 0;
+  st->live_items = 0;
+  st->rate = 0;
+  return 0;
+}
+
+/* ************************************************************************** */
+/* **** Constructor Destructor ********************************************** */
+/* ************************************************************************** */
+
+/**
+ * @brief Frees the statistics, they start from zero when used again.
+ */
+void stats_destroy()
+{
+  int i;
+
+  if (stats_types == NULL)
+    return;
+
+  g_tree_destroy(stats_types);
+  for (i = 0; i < EVENT_PRIORITIES; i++)
+    g_free(stats_lag[i].buckets);
+  stats_types = NULL;
+}
+
+/* ************************************************************************** */
+/* **** Functions and events ************************************************ */
+/* ************************************************************************** */
+
+/**
+ * @brief Records that a job got its first agent.
+ *
+ * @param type  the agent type of the job
+ * @param wait  the seconds the job was in the job queue
+ */
+void stats_job_started(const char* type, double wait)
+{
+  stats_histogram_observe(&stats_type_get(type)->wait, wait);
+}
+
+/**
+ * @brief Records that a job is complete or failed.
+ *
+ * @param type    the agent type of the job
+ * @param run     the seconds since the job started, negative if it never did
+ * @param failed  the job failed
+ */
+void stats_job_finished(const char* type, double run, gboolean failed)
+{
+  stats_type* st = stats_type_get(type);
+
+  if (failed)
+    st->failed++;
+  else
+    st->completed++;
+  if (run >= 0)
+    stats_histogram_observe(&st->run, run);
+}
+
+/**
+ * @brief Records that an agent failed.
+ *
+ * @param type  the agent type
+ */
+void stats_agent_failed(const char* type)
+{
+  stats_type_get(type)->agent_failures++;
+}
+
+/**
+ * @brief Records that the work of a failed agent is given to a new agent.
+ *
+ * @param type  the agent type
+ */
+void stats_agent_restarted(const char* type)
+{
+  stats_type_get(type)->agent_restarts++;
+}
+
+/**
+ * @brief Records the items that an agent processed for a job it is done with.
+ *
+ * @param type   the agent type
+ * @param items  the number of items from the last heartbeat of the agent
+ */
+void stats_agent_items(const char* type, uint64_t items)
+{
+  stats_type_get(type)->items += items;
+}
+
+/**
+ * @brief Records how long an event waited in the event loop.
+ *
+ * @param priority  the priority of the event
+ * @param lag       the seconds between event_signal() and the start of the event
+ */
+void stats_event_lag(event_priority priority, double lag)
+{
+  stats_init();
+  stats_histogram_observe(&stats_lag[priority], lag);
+}
+
+/**
+ * @brief Prints the statistics in the Prometheus text format.
+ *
+ * Besides the counters and histograms, this prints the current depth of the
+ * job queue per agent type and the running agents per agent type and host.
+ * The statistics only count real jobs, not the startup tests of the agents.
+ *
+ * @param scheduler  the scheduler to print the statistics of
+ * @return the text, freed by the caller
+ */
+GString* stats_prometheus(scheduler_t* scheduler)
+{
+  static const char* help[] =
+  {
+    "fossology_jobs_queued gauge Jobs in the job queue",
+    "fossology_jobs_waiting gauge Jobs that wait for other jobs to complete",
+    "fossology_jobs_finished_total counter Jobs that completed or failed",
+    "fossology_job_wait_seconds histogram Time from queueing to the first agent of a job",
+    "fossology_job_run_seconds histogram Time from the first agent to the end of a job",
+    "fossology_agents_running gauge Agents working on a job",
+    "fossology_agent_items_total counter Items processed by agents that are done with their job",
+    "fossology_agent_items_running gauge Items processed so far by the running agents",
+    "fossology_agent_items_per_second gauge Items processed per second by the running agents",
+    "fossology_agent_failures_total counter Agents that failed",
+    "fossology_agent_restarts_total counter Work given to a new agent after its agent failed",
+  };
+  GString* str = g_string_new(NULL);
+  GHashTable* hosts = g_hash_table_new(g_str_hash, g_str_equal);
+  gpointer args[2];
+  char** parts;
+  guint i;
+
+  stats_init();
+  g_sequence_foreach(scheduler->job_queue, (GFunc)stats_count_queued, NULL);
+  g_tree_foreach(scheduler->job_list, (GTraverseFunc)stats_count_job, NULL);
+  g_tree_foreach(scheduler->agents, (GTraverseFunc)stats_count_agent, hosts);
+
+  args[0] = str;
+  for (i = 0; i < G_N_ELEMENTS(help); i++)
+  {
+    parts = g_strsplit(help[i], " ", 3);
+    g_string_append_printf(str, "# HELP %s %s\n# TYPE %s %s\n", parts[0], parts[2], parts[0], parts[1]);
+    g_strfreev(parts);
+
+    args[1] = GINT_TO_POINTER(i);
+    g_tree_foreach(stats_types, (GTraverseFunc)stats_print_type, args);
+  }
+  g_tree_foreach(stats_types, (GTraverseFunc)stats_clear_type, NULL);
+
+  g_string_append(str, "# HELP fossology_host_agents Agents running on a host\n"
+      "# TYPE fossology_host_agents gauge\n"
+      "# HELP fossology_host_slots The maximum number of agents on a host\n"
+      "# TYPE fossology_host_slots gauge\n");
+  args[1] = hosts;
+  g_tree_foreach(scheduler->host_list, (GTraverseFunc)stats_print_host, args);
+
+  g_string_append(str, "# HELP fossology_event_loop_lag_seconds Time events wait for the main thread\n"
+      "# TYPE fossology_event_loop_lag_seconds histogram\n");
+  for (i = 0; i < EVENT_PRIORITIES; i++)
+    stats_histogram_print(str, "fossology_event_loop_lag_seconds", "priority", event_priority_strings[i],
+        &stats_lag[i]);
+  g_string_append_printf(str, "# HELP fossology_event_queue_length Events waiting for the main thread\n"
+      "# TYPE fossology_event_queue_length gauge\n"
+      "fossology_event_queue_length %u\n", event_loop_length(event_loop_get()));
+  g_string_append_printf(str, "# HELP fossology_log_dropped_total Log lines dropped because the log writer was behind\n"
+      "# TYPE fossology_log_dropped_total counter\n"
+      "fossology_log_dropped_total %u\n", log_dropped());
+
+  g_hash_table_destroy(hosts);
+  return str;
+}
+
+/**
+ * @brief Event to print the statistics for an interface thread.
+ *
+ * The interface thread waits for the text on the reply queue, so that it can
+ * answer the request itself without the main thread writing to the socket.
+ *
+ * @param scheduler  the scheduler to print the statistics of
+ * @param reply      the queue of the waiting interface thread
+ */
+void stats_prometheus_event(scheduler_t* scheduler, GAsyncQueue* reply)
+{
+  g_async_queue_push(reply, g_string_free(stats_prometheus(scheduler), FALSE));
+  g_async_queue_unref(reply);
+}
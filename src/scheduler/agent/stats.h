@@ -0,0 +1,69 @@
+/* **************************************************************
+Copyright (C) 2026 Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+************************************************************** */
+
+#ifndef STATS_H_INCLUDE
+#define STATS_H_INCLUDE
+
+/* scheduler includes */
+#include <event.h>
+#include <scheduler.h>
+
+/* std includes */
+#include <stdint.h>
+
+/* other library includes */
+#include <glib.h>
+
+/* ************************************************************************** */
+/* **** Data Types ********************************************************** */
+/* ************************************************************************** */
+
+/**
+ * A histogram in the form Prometheus expects it. The buckets are stored
+ * individually and only summed up when the histogram is printed.
+ */
+typedef struct
+{
+    const double* bounds;  ///< the upper bounds of the buckets, ascending
+    guint         n;       ///< the number of bounds
+    uint64_t*     buckets; ///< the observations per bucket, the last one is +Inf
+    uint64_t      count;   ///< the number of observations
+    double        sum;     ///< the sum of the observations
+} stats_histogram;
+
+/* ************************************************************************** */
+/* **** Constructor Destructor ********************************************** */
+/* ************************************************************************** */
+
+void stats_destroy();
+
+/* ************************************************************************** */
+/* **** Functions and events ************************************************ */
+/* ************************************************************************** */
+
+void stats_job_started(const char* type, double wait);
+void stats_job_finished(const char* type, double run, gboolean failed);
+void stats_agent_failed(const char* type);
+void stats_agent_restarted(const char* type);
+void stats_agent_items(const char* type, uint64_t items);
+void stats_event_lag(event_priority priority, double lag);
+
+GString* stats_prometheus(scheduler_t* scheduler);
+void stats_prometheus_event(scheduler_t* scheduler, GAsyncQueue* reply);
+
+#endif /* STATS_H_INCLUDE */
@@ -0,0 +1,229 @@
+/*********************************************************************
+Copyright (C) 2026 Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*********************************************************************/
+/**
+ * \file
+ * \brief Stress test of the agent communication of the scheduler
+ *
+ * Starts a large number of "chatty" test agents at once, each one in its own
+ * job, and runs the event loop of the scheduler until all of them have
+ * finished. Every agent sends CHATTY_LINES metric updates at CHATTY_RATE per
+ * second, so the scheduler has to handle about agents * rate lines per second.
+ *
+ * At the end it prints the wall time, the cpu time used by the scheduler
+ * process (not by the agents) and the highest number of scheduler threads
+ * seen. It fails if any agent did not exit cleanly or the agents did not
+ * finish in time.
+ *
+ * Build and run it with "make stress", it is not part of the unit tests.
+ */
+
+/* scheduler includes */
+#include <agent.h>
+#include <event.h>
+#include <host.h>
+#include <job.h>
+#include <logging.h>
+#include <scheduler.h>
+
+/* std library includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* unix library includes */
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* glib includes */
+#include <glib.h>
+
+static volatile sig_atomic_t sigchld = 0; ///< set when a SIGCHLD is received
+static int remaining = 0;    ///< the number of agents still running
+static int failed = 0;       ///< the number of agents that did not exit cleanly
+static int timed_out = 0;    ///< the agents were killed after the deadline
+static int peak_threads = 0; ///< the highest number of threads seen
+static time_t deadline;      ///< when the remaining agents are killed
+
+/**
+ * @brief Records that a child has died, the event loop collects it.
+ */
+static void stress_sig_handle(int signo)
+{
+  sigchld = 1;
+}
+
+/**
+ * @brief The number of threads of this process.
+ */
+static int stress_threads()
+{
+  GDir* dir;
+  int count = 0;
+
+  if ((dir = g_dir_open("/proc/self/task", 0, NULL)) == NULL)
+    return 0;
+  while (g_dir_read_name(dir) != NULL)
+    count++;
+  g_dir_close(dir);
+
+  return count;
+}
+
+/**
+ * @brief Called by the event loop every time it takes an event.
+ *
+ * Turns the death of the agents into agent_death_event()s, the same way
+ * scheduler_signal() does, and ends the event loop once every agent is gone.
+ *
+ * @param scheduler the scheduler running the agents
+ */
+static void stress_signal(scheduler_t* scheduler)
+{
+  static time_t last = 0;
+  pid_t* pass;
+  pid_t pid;
+  int status;
+
+  if (sigchld)
+  {
+    sigchld = 0;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        failed++;
+      remaining--;
+
+      pass = g_new0(pid_t, 2);
+      pass[0] = pid;
+      pass[1] = status;
+      event_signal(agent_death_event, pass);
+    }
+  }
+
+  if (time(NULL) != last)
+  {
+    last = time(NULL);
+    peak_threads = MAX(peak_threads, stress_threads());
+  }
+
+  if (remaining == 0 && g_tree_nnodes(scheduler->agents) == 0)
+  {
+    event_loop_terminate();
+  }
+  else if (!timed_out && time(NULL) > deadline)
+  {
+    fprintf(stderr, "ERROR: %d agents did not finish in time, killing them\n", remaining);
+    timed_out = 1;
+    kill_agents(scheduler);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  scheduler_t* scheduler;
+  host_t* host;
+  job_t* job;
+  struct rlimit limit;
+  struct rusage usage;
+  gint64 start;
+  double wall, cpu;
+  int n_agents = 1000;
+  int lines = 300;
+  int rate = 10;
+  char buf[32];
+  int c, i;
+
+  while ((c = getopt(argc, argv, "n:l:r:")) != -1)
+  {
+    switch (c)
+    {
+      case 'n': n_agents = atoi(optarg); break;
+      case 'l': lines = atoi(optarg); break;
+      case 'r': rate = atoi(optarg); break;
+      default: argc = 0; break;
+    }
+  }
+  if (argc - optind != 1 || n_agents < 1 || lines < 0 || rate < 1)
+  {
+    fprintf(stderr, "Usage: %s [-n agents] [-l lines] [-r rate] config_dir\n", argv[0]);
+    fprintf(stderr, "  Runs the chatty test agent from config_dir/mods-enabled and\n");
+    fprintf(stderr, "  reports the cpu time the scheduler needs to talk to them.\n");
+    fprintf(stderr, "  -n :: number of concurrent agents (default 1000).\n");
+    fprintf(stderr, "  -l :: number of lines every agent sends (default 300).\n");
+    fprintf(stderr, "  -r :: number of lines every agent sends per second (default 10).\n");
+    return 255;
+  }
+
+#if !GLIB_CHECK_VERSION(2,35,0)
+  g_type_init();
+  g_thread_init(NULL);
+#endif
+
+  /* the scheduler keeps four pipe ends open for every agent */
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+  {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < 4 * n_agents + 64)
+      fprintf(stderr, "WARNING: %d agents need more than %lu file descriptors\n", n_agents,
+          (unsigned long) limit.rlim_cur);
+  }
+
+  snprintf(buf, sizeof(buf), "%d", lines);
+  setenv("CHATTY_LINES", buf, 1);
+  snprintf(buf, sizeof(buf), "%d", rate);
+  setenv("CHATTY_RATE", buf, 1);
+
+  main_log = log_new("./agent_stress.log", "AGENT_STRESS", getpid());
+  scheduler = scheduler_init(argv[optind], main_log);
+  add_meta_agent(scheduler->meta_agents, "chatty", "chatty", -1, 0);
+  host = host_init(LOCAL_HOST, LOCAL_HOST, argv[optind], n_agents);
+  g_tree_insert(scheduler->host_list, host->name, host);
+
+  signal(SIGCHLD, stress_sig_handle);
+
+  printf("agents: %d, lines: %d per agent, rate: %d lines/s per agent\n", n_agents, lines, rate);
+
+  start = g_get_monotonic_time();
+  for (i = 0; i < n_agents; i++)
+  {
+    job = job_init(scheduler->job_list, scheduler->job_queue, "chatty", LOCAL_HOST, -(i + 1), 0, 0, 0, 0, NULL);
+    if (agent_init(scheduler, host, job) == NULL)
+    {
+      fprintf(stderr, "ERROR: unable to start agent %d\n", i);
+      return 1;
+    }
+    remaining++;
+  }
+
+  deadline = time(NULL) + lines / rate + 60;
+  event_loop_enter(scheduler, NULL, stress_signal);
+
+  wall = (g_get_monotonic_time() - start) / 1e6;
+  getrusage(RUSAGE_SELF, &usage);
+  cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+        usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+
+  printf("wall: %.1f s, scheduler cpu: %.2f s (%.1f%%), peak threads: %d, failed agents: %d\n",
+      wall, cpu, 100.0 * cpu / wall, peak_threads, failed);
+
+  scheduler_destroy(scheduler);
+  return (failed || timed_out) ? 1 : 0;
+}
@@ -0,0 +1,349 @@
+/*********************************************************************
+Copyright (C) 2026 Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*********************************************************************/
+/**
+ * \file
+ * \brief Throughput benchmark of the scheduler with fake agents
+ *
+ * Fills the job queue of the test database with a synthetic workload: every
+ * upload gets its own job with a chain of jobqueue entries, each one depending
+ * on the one before it. Then it runs the real event loop of the scheduler,
+ * which finds the jobs with database_update_event() and runs them on the
+ * "bench" test agent, until every job has finished. The agent speaks the
+ * normal agent protocol and takes a configurable time per job, a configurable
+ * share of the jobs fails.
+ *
+ * At the end it prints the makespan, the finished jobs per second, the mean
+ * dispatch latency (from a job being ready until its agent started on it) and
+ * the percentiles of the lag of the event loop for every event priority, the
+ * latter two from the statistics the scheduler keeps for its metrics. The
+ * percentiles come from the buckets of a histogram, so they are the upper
+ * bound of the bucket they fall in. It fails if the jobs did not finish in
+ * time. The synthetic jobs are removed from the database again.
+ *
+ * Build and run it with "make bench", it is not part of the unit tests.
+ */
+
+/* scheduler includes */
+#include <agent.h>
+#include <database.h>
+#include <event.h>
+#include <host.h>
+#include <job.h>
+#include <logging.h>
+#include <scheduler.h>
+#include <stats.h>
+
+/* std library includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* unix library includes */
+#include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+/* glib includes */
+#include <glib.h>
+
+#define BENCH_JOB "scheduler bench" ///< the job_name of the synthetic jobs
+
+static gint64 finished = 0; ///< when the last job finished, 0 until then
+static gint64 loaded = 0;   ///< when the first job was seen, 0 until then
+static int timed_out = 0;   ///< the jobs were killed after the deadline
+static time_t deadline;     ///< when the remaining jobs are killed
+
+/**
+ * @brief Counts the jobs from the job queue, the startup tests of the agents
+ *        have a negative id.
+ */
+static gboolean bench_count_jobs(int* id, job_t* job, int* count)
+{
+  if (*id >= 0)
+    (*count)++;
+  return FALSE;
+}
+
+/**
+ * @brief Called by the event loop every time it takes a batch of events.
+ *
+ * Handles the signals like the scheduler does and starts closing the scheduler
+ * once every synthetic job is gone, so that the idle agents are stopped too.
+ *
+ * @param scheduler the scheduler running the jobs
+ */
+static void bench_signal(scheduler_t* scheduler)
+{
+  int jobs = 0;
+
+  scheduler_signal(scheduler);
+
+  /* the jobs that were still waiting keep the scheduler from closing */
+  if (timed_out && g_tree_nnodes(scheduler->agents) == 0)
+    event_loop_terminate();
+  if (finished)
+    return;
+
+  g_tree_foreach(scheduler->job_list, (GTraverseFunc) bench_count_jobs, &jobs);
+  if (jobs > 0 && loaded == 0)
+    loaded = g_get_monotonic_time();
+
+  if (loaded && jobs == 0)
+  {
+    finished = g_get_monotonic_time();
+    closing = 1;
+  }
+  else if (!timed_out && time(NULL) > deadline)
+  {
+    fprintf(stderr, "ERROR: %d jobs did not finish in time, killing them\n", jobs);
+    timed_out = 1;
+    finished = g_get_monotonic_time();
+    event_signal(scheduler_close_event, (void*) 1);
+  }
+}
+
+/**
+ * @brief Executes a statement of the benchmark and checks the result.
+ *
+ * @return the first column of the first row, 0 if there is none
+ */
+static int bench_exec(scheduler_t* scheduler, char* sql)
+{
+  PGresult* db_result;
+  int ret = 0;
+
+  db_result = database_exec(scheduler, sql);
+  if (PQresultStatus(db_result) != PGRES_TUPLES_OK && PQresultStatus(db_result) != PGRES_COMMAND_OK)
+  {
+    fprintf(stderr, "ERROR: \"%s\" failed: %s", sql, PQresultErrorMessage(db_result));
+    exit(1);
+  }
+  if (PQresultStatus(db_result) == PGRES_TUPLES_OK && PQntuples(db_result) > 0)
+    ret = atoi(PQgetvalue(db_result, 0, 0));
+
+  SafePQclear(db_result);
+  g_free(sql);
+  return ret;
+}
+
+/**
+ * @brief Removes the synthetic jobs from the database.
+ */
+static void bench_clean(scheduler_t* scheduler)
+{
+  bench_exec(scheduler, g_strdup(
+      "DELETE FROM jobdepends WHERE jdep_jq_fk IN "
+      "  (SELECT jq_pk FROM jobqueue WHERE jq_type = 'bench')"));
+  bench_exec(scheduler, g_strdup("DELETE FROM jobqueue WHERE jq_type = 'bench'"));
+  bench_exec(scheduler, g_strdup("DELETE FROM job WHERE job_name = '" BENCH_JOB "'"));
+}
+
+/**
+ * @brief Adds the synthetic jobs to the database.
+ *
+ * @param uploads  the number of uploads, each one is a job
+ * @param chain    the number of jobqueue entries of every job
+ */
+static void bench_fill(scheduler_t* scheduler, int uploads, int chain)
+{
+  int user, job_pk, jq_pk, prev;
+  int u, c;
+
+  user = bench_exec(scheduler, g_strdup("SELECT MIN(user_pk) FROM users"));
+
+  bench_exec(scheduler, g_strdup("BEGIN"));
+  for (u = 0; u < uploads; u++)
+  {
+    job_pk = bench_exec(scheduler, g_strdup_printf(
+        "INSERT INTO job (job_queued, job_priority, job_name, job_user_fk) "
+        "VALUES (now(), 0, '" BENCH_JOB "', %d) RETURNING job_pk", user));
+
+    for (c = 0, prev = 0; c < chain; c++, prev = jq_pk)
+    {
+      jq_pk = bench_exec(scheduler, g_strdup_printf(
+          "INSERT INTO jobqueue (jq_job_fk, jq_type, jq_args, jq_end_bits) "
+          "VALUES (%d, 'bench', '%d', 0) RETURNING jq_pk", job_pk, u));
+      if (prev)
+        bench_exec(scheduler, g_strdup_printf(
+            "INSERT INTO jobdepends (jdep_jq_fk, jdep_jq_depends_fk) VALUES (%d, %d)", jq_pk, prev));
+    }
+  }
+  bench_exec(scheduler, g_strdup("COMMIT"));
+}
+
+/**
+ * @brief Reads the value of a sample from the output of stats_prometheus().
+ */
+static double bench_metric(GString* metrics, const char* sample)
+{
+  char* pos = strstr(metrics->str, sample);
+  return pos ? g_ascii_strtod(pos + strlen(sample), NULL) : 0;
+}
+
+/**
+ * @brief Estimates a quantile of the event loop lag of a priority from the
+ *        buckets of its histogram in the output of stats_prometheus().
+ *
+ * @param q  the quantile, between 0 and 1
+ * @return the upper bound of the bucket the quantile falls in, in seconds,
+ *         infinite for the last bucket and 0 if there were no events
+ */
+static double bench_lag_quantile(GString* metrics, event_priority priority, double q)
+{
+  gchar* prefix;
+  char* pos;
+  double bound, total, count;
+
+  prefix = g_strdup_printf("fossology_event_loop_lag_seconds_bucket{priority=\"%s\",le=\"",
+      event_priority_strings[priority]);
+
+  total = 0;
+  for (pos = strstr(metrics->str, prefix); pos; pos = strstr(pos, prefix))
+  {
+    pos += strlen(prefix);
+    total = g_ascii_strtod(strchr(pos, ' '), NULL);
+  }
+
+  for (pos = strstr(metrics->str, prefix); total > 0 && pos; pos = strstr(pos, prefix))
+  {
+    pos += strlen(prefix);
+    bound = g_ascii_strtod(pos, NULL);
+    count = g_ascii_strtod(strchr(pos, ' '), NULL);
+    if (count >= q * total)
+    {
+      g_free(prefix);
+      return bound;
+    }
+  }
+
+  g_free(prefix);
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  scheduler_t* scheduler;
+  host_t* host;
+  GString* metrics;
+  struct rlimit limit;
+  gint64 start;
+  double makespan, wait;
+  int uploads = 1000;
+  int chain = 3;
+  int runtime = 100;
+  int fail = 0;
+  int slots = 10;
+  int timeout = 600;
+  int complete, failed;
+  char buf[32];
+  int c, i;
+
+  while ((c = getopt(argc, argv, "u:c:r:f:s:t:")) != -1)
+  {
+    switch (c)
+    {
+      case 'u': uploads = atoi(optarg); break;
+      case 'c': chain = atoi(optarg); break;
+      case 'r': runtime = atoi(optarg); break;
+      case 'f': fail = atoi(optarg); break;
+      case 's': slots = atoi(optarg); break;
+      case 't': timeout = atoi(optarg); break;
+      default: argc = 0; break;
+    }
+  }
+  if (argc - optind != 1 || uploads < 1 || chain < 1 || runtime < 0 || fail < 0 || fail > 100 ||
+      slots < 1 || timeout < 1)
+  {
+    fprintf(stderr, "Usage: %s [-u uploads] [-c chain] [-r runtime] [-f fail] [-s slots] [-t timeout] config_dir\n", argv[0]);
+    fprintf(stderr, "  Runs a synthetic job queue on the bench test agent from\n");
+    fprintf(stderr, "  config_dir/mods-enabled, using the database of config_dir/Db.conf.\n");
+    fprintf(stderr, "  -u :: number of uploads, each one is a job (default 1000).\n");
+    fprintf(stderr, "  -c :: number of dependent jobqueue entries per upload (default 3).\n");
+    fprintf(stderr, "  -r :: milliseconds the agent takes per job on average (default 100).\n");
+    fprintf(stderr, "  -f :: percentage of jobs that fail (default 0).\n");
+    fprintf(stderr, "  -s :: number of agents that can run at the same time (default 10).\n");
+    fprintf(stderr, "  -t :: seconds before the remaining jobs are killed (default 600).\n");
+    return 255;
+  }
+
+#if !GLIB_CHECK_VERSION(2,35,0)
+  g_type_init();
+  g_thread_init(NULL);
+#endif
+
+  /* the scheduler keeps four pipe ends open for every agent */
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+  {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  snprintf(buf, sizeof(buf), "%d", runtime);
+  setenv("BENCH_RUNTIME", buf, 1);
+  snprintf(buf, sizeof(buf), "%d", fail);
+  setenv("BENCH_FAIL", buf, 1);
+
+  main_log = log_new("./scheduler_bench.log", "SCHEDULER_BENCH", getpid());
+  scheduler = scheduler_init(argv[optind], main_log);
+  add_meta_agent(scheduler->meta_agents, "bench", "bench", -1, SAG_NOEMAIL);
+  host = host_init(LOCAL_HOST, LOCAL_HOST, argv[optind], slots);
+  host_insert(host, scheduler);
+
+  database_init(scheduler);
+  if (scheduler->db_conn == NULL)
+  {
+    fprintf(stderr, "ERROR: unable to connect to the database of %s\n", argv[optind]);
+    return 1;
+  }
+
+  bench_clean(scheduler);
+  bench_fill(scheduler, uploads, chain);
+
+  signal(SIGCHLD, scheduler_sig_handle);
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("uploads: %d, chain: %d, jobs: %d, slots: %d, runtime: %d ms, failures: %d%%\n",
+      uploads, chain, uploads * chain, slots, runtime, fail);
+
+  deadline = time(NULL) + timeout;
+  start = g_get_monotonic_time();
+  event_signal(database_update_event, NULL);
+  event_loop_enter(scheduler, scheduler_update, bench_signal);
+
+  makespan = (finished - start) / 1e6;
+  complete = bench_exec(scheduler, g_strdup(
+      "SELECT count(*) FROM jobqueue WHERE jq_type = 'bench' AND jq_end_bits = 1"));
+  failed = bench_exec(scheduler, g_strdup(
+      "SELECT count(*) FROM jobqueue WHERE jq_type = 'bench' AND jq_end_bits = 2"));
+
+  metrics = stats_prometheus(scheduler);
+  wait = bench_metric(metrics, "fossology_job_wait_seconds_sum{agent=\"bench\"} ") /
+      MAX(bench_metric(metrics, "fossology_job_wait_seconds_count{agent=\"bench\"} "), 1);
+
+  printf("makespan: %.1f s, jobs/s: %.1f, complete: %d, failed: %d, never run: %d\n",
+      makespan, (complete + failed) / makespan, complete, failed, uploads * chain - complete - failed);
+  printf("dispatch latency: %.1f ms (mean)\n", wait * 1e3);
+  for (i = 0; i < EVENT_PRIORITIES; i++)
+    printf("event loop lag, %s priority: p50 <= %g ms, p90 <= %g ms, p99 <= %g ms\n",
+        event_priority_strings[i], bench_lag_quantile(metrics, i, 0.5) * 1e3,
+        bench_lag_quantile(metrics, i, 0.9) * 1e3, bench_lag_quantile(metrics, i, 0.99) * 1e3);
+
+  g_string_free(metrics, TRUE);
+  bench_clean(scheduler);
+  scheduler_destroy(scheduler);
+  return timed_out ? 1 : 0;
+}
@@ -24,10 +24,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 /* scheduler includes */
 #include <database.h>
+#include <event.h>
 #include <scheduler.h>
 
 /* library includes */
 #include <utils.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /* testing sql statements */
 char sqltmp[1024] = {0};
@@ -96,7 +99,7 @@ void test_database_exec_event()
   database_init(scheduler);
   FO_ASSERT_PTR_NOT_NULL(scheduler->db_conn);
 
-  sql = g_strdup_printf(jobsql_processed, 0, 123);
+  sql = g_strdup_printf(jobsql_processed, "(123, 0)");
 
   database_exec_event(scheduler, sql);
   scheduler_destroy(scheduler);
@@ -107,6 +110,7 @@ void test_database_exec_event()
  * \test
  * -# Initialize test database
  * -# Call database_update_event()
+ * -# Check if the job is created with the user and priority of its job
  * -# Check if new jobs are added to the queue with proper names
  * -# Reset the queue
  */
@@ -115,6 +119,8 @@ void test_database_update_event()
   scheduler_t* scheduler;
   char sql[512];
   PGresult* db_result;
+  job_t* job;
+  int jq_pk;
 
   scheduler = scheduler_init(testdb, NULL);
 
@@ -122,9 +128,13 @@ void test_database_update_event()
   database_init(scheduler);
   FO_ASSERT_PTR_NOT_NULL(scheduler->db_conn);
 
-  Prepare_Testing_Data(scheduler);
+  jq_pk = Prepare_Testing_Data(scheduler);
 
   database_update_event(scheduler, NULL);
+  job = g_tree_lookup(scheduler->job_list, &jq_pk);
+  FO_ASSERT_PTR_NOT_NULL_FATAL(job);
+  FO_ASSERT_EQUAL(job->user_id, 1);
+  FO_ASSERT_EQUAL(job->priority, 0);
   sprintf(sql, "SELECT * FROM job;");
   db_result = database_exec(scheduler, sql);
   //printf("result: %s", PQget(db_result, 0, "job_name"));
@@ -193,7 +203,9 @@ void test_database_update_job()
  * \test
  * -# Initialize test database
  * -# Create a mock job
- * -# Call database_job_processed() to update items processed
+ * -# Call database_job_processed() twice to update items processed
+ * -# Check that only one event was created and that it writes the newest
+ *    number of items processed
  * -# Call database_job_log() to create a test log
  * -# Call database_job_priority() to update job priority
  * \todo Add checks for function calls
@@ -205,6 +217,9 @@ void test_database_job()
   arg_int* params;
   int jq_pk;
   job_t tmp_job;
+  char sql[128];
+  PGresult* db_result;
+  guint length;
 
   scheduler = scheduler_init(testdb, NULL);
 
@@ -230,7 +245,19 @@ void test_database_job()
 
   FO_ASSERT_STRING_EQUAL(job_status_strings[job->status], "JOB_NOT_AVAILABLE");
 
+  length = event_loop_length(event_loop_get());
   database_job_processed(jq_pk, 2);
+  database_job_processed(jq_pk, 3);
+  FO_ASSERT_EQUAL(event_loop_length(event_loop_get()), length + 1);
+
+  database_processed_event(scheduler, NULL);
+  sprintf(sql, "SELECT jq_itemsprocessed FROM jobqueue WHERE jq_pk = %d", jq_pk);
+  db_result = database_exec(scheduler, sql);
+  FO_ASSERT_EQUAL(PQresultStatus(db_result), PGRES_TUPLES_OK);
+  if (PQresultStatus(db_result) == PGRES_TUPLES_OK && PQntuples(db_result) == 1)
+    FO_ASSERT_EQUAL(atoi(PQgetvalue(db_result, 0, 0)), 3);
+  PQclear(db_result);
+
   database_job_log(jq_pk, "test log");
   database_job_priority(scheduler, job, 1);
 
@@ -267,6 +294,108 @@ void test_email_notify()
 
   scheduler_destroy(scheduler);
 }
+
+static gchar* email_output;  ///< the file the email client of test_email_worker() writes
+static int    email_ticks;   ///< events run while that email client was still busy
+
+/**
+ * \brief Event that stands in for the work of the scheduler while an email is
+ *        sent, it runs again until the email client wrote the email.
+ */
+static void email_tick_event(scheduler_t* scheduler, gpointer unused)
+{
+  if(g_file_test(email_output, G_FILE_TEST_EXISTS) || email_ticks >= 100)
+  {
+    event_loop_terminate();
+    return;
+  }
+
+  email_ticks++;
+  usleep(50000);
+  event_signal(email_tick_event, NULL);
+}
+
+/**
+ * \brief Test for sending the email notification from the email thread
+ * \test
+ * -# Configure SMTP and a user that wants to be notified
+ * -# Use a script as email client that sleeps before it reads the email
+ * -# Check that database_update_job() returns while the script still sleeps
+ * -# Check that the event loop keeps running events while the script sleeps
+ * -# Check that the script receives the email
+ */
+void test_email_worker()
+{
+  scheduler_t* scheduler;
+  job_t* job;
+  gchar* script;
+  gchar* output;
+  gchar* contents = NULL;
+  gchar* sql;
+  gint64 start;
+  int jq_pk, fd, i;
+
+  scheduler = scheduler_init(testdb, NULL);
+  database_init(scheduler);
+  email_init(scheduler);
+
+  jq_pk = Prepare_Testing_Data(scheduler);
+  sql = g_strdup_printf("UPDATE jobqueue SET jq_starttime = now() WHERE jq_pk = %d", jq_pk);
+  PQclear(database_exec(scheduler, sql));
+  g_free(sql);
+  PQclear(database_exec(scheduler,
+      "UPDATE users SET email_notify = 'y', user_email = 'fossy@localhost' WHERE user_pk = 1"));
+  PQclear(database_exec(scheduler,
+      "DELETE FROM sysconfig WHERE variablename IN ('SMTPHostName', 'SMTPPort')"));
+  PQclear(database_exec(scheduler,
+      "INSERT INTO sysconfig (variablename, conf_value, ui_label, vartype, group_name, description) "
+      "VALUES ('SMTPHostName', 'localhost', 'SMTP Host Name', 2, 'SMTP', ''), "
+      "       ('SMTPPort', '25', 'SMTP Port', 1, 'SMTP', '')"));
+
+  /* the email client takes its time before it reads the email */
+  fd = g_file_open_tmp("fo_mailer_XXXXXX", &script, NULL);
+  FO_ASSERT_TRUE_FATAL(fd >= 0);
+  output = g_strconcat(script, ".out", NULL);
+  sql = g_strdup_printf("#!/bin/sh\nsleep 2\ncat > %s.tmp && mv %s.tmp %s\n", output, output, output);
+  FO_ASSERT_EQUAL(write(fd, sql, strlen(sql)), strlen(sql));
+  close(fd);
+  chmod(script, 0755);
+  g_free(sql);
+
+  g_free(scheduler->email_command);
+  scheduler->email_command = g_strdup(script);
+
+  job = job_init(scheduler->job_list, scheduler->job_queue, "ununpack", "localhost", -1, 0, 0, 0, 0, NULL);
+  job->id = jq_pk;
+
+  start = g_get_monotonic_time();
+  database_update_job(scheduler, job, JB_COMPLETE);
+  FO_ASSERT_TRUE(g_get_monotonic_time() - start < G_USEC_PER_SEC);
+  FO_ASSERT_FALSE(g_file_test(output, G_FILE_TEST_EXISTS));
+
+  /* the email client sleeps for 2 seconds, the events keep coming meanwhile */
+  email_output = output;
+  email_ticks = 0;
+  event_signal(email_tick_event, NULL);
+  FO_ASSERT_EQUAL(event_loop_enter(scheduler, NULL, NULL), 0x0);
+  FO_ASSERT_TRUE(email_ticks >= 20);
+  FO_ASSERT_TRUE(email_ticks < 100);
+
+  for(i = 0; i < 100 && !g_file_get_contents(output, &contents, NULL, NULL); i++)
+    usleep(100000);
+  FO_ASSERT_PTR_NOT_NULL(contents);
+  FO_ASSERT_NOT_EQUAL(strlen(contents ? contents : ""), 0);
+
+  PQclear(database_exec(scheduler, "UPDATE users SET email_notify = 'n' WHERE user_pk = 1"));
+  scheduler_destroy(scheduler);
+
+  unlink(script);
+  unlink(output);
+  g_free(contents);
+  g_free(script);
+  g_free(output);
+}
+
 /* ************************************************************************** */
 /* **** suite declaration *************************************************** */
 /* ************************************************************************** */
@@ -284,6 +413,7 @@ CU_TestInfo tests_database[] =
 CU_TestInfo tests_email[] =
 {
     {"Test email_notify",  test_email_notify  },
+    {"Test email_worker",  test_email_worker  },
     CU_TEST_INFO_NULL
 };
 
@@ -152,7 +152,7 @@ void test_event_signal_ext()
   sample_args = &call_num;
   event_signal_ext(sample_event, sample_args, "sample", s_name, s_line);
 
-  e = g_async_queue_pop(event_loop_get()->queue);
+  e = event_loop_take(event_loop_get());
 
   FO_ASSERT_PTR_EQUAL(   e->func,     sample_event);
   FO_ASSERT_PTR_EQUAL(   e->argument, sample_args);
@@ -180,7 +180,7 @@ void test_event_signal()
   sample_args = &call_num;
   event_signal(sample_event, sample_args);
 
-  e = g_async_queue_pop(event_loop_get()->queue);
+  e = event_loop_take(event_loop_get());
 
   FO_ASSERT_PTR_EQUAL(   e->func,     sample_event);
   FO_ASSERT_PTR_EQUAL(   e->argument, sample_args);
@@ -346,7 +346,7 @@ void test_event_loop_put()
   sample_args = &call_num;
   event_signal(sample_event, sample_args);
 
-  e = g_async_queue_pop(event_loop_get()->queue);
+  e = event_loop_take(event_loop_get());
 
   FO_ASSERT_PTR_EQUAL(   e->func,     sample_event);
   FO_ASSERT_PTR_EQUAL(   e->argument, sample_args);
@@ -356,6 +356,65 @@ void test_event_loop_put()
   scheduler_destroy(scheduler);
 }
 
+/**
+ * \brief Test for the priorities of event_loop_take() and
+ *        event_loop_take_batch()
+ * \test
+ * -# Create a low, two normal and a high priority event
+ * -# Check that event_loop_take() returns them by priority and the events of
+ *    the same priority in order
+ * -# Create a batch full of normal events and another low one
+ * -# Check that event_loop_take_batch() takes the low event last, in place of
+ *    a normal one
+ */
+void test_event_priority()
+{
+  scheduler_t* scheduler;
+  scheduler = scheduler_init(testdb, NULL);
+  scheduler_foss_config(scheduler);
+  event_loop_t* vl = event_loop_get();
+  event_t* batch[EVENT_BATCH];
+  event_t* e;
+  int args[3];
+  guint i;
+
+  event_signal_priority(sample_event, &args[0], EVENT_LOW);
+  event_signal_priority(sample_event, &args[1], EVENT_NORMAL);
+  event_signal_priority(sample_event, &args[2], EVENT_NORMAL);
+  event_signal_priority(other_event, NULL, EVENT_HIGH);
+  FO_ASSERT_EQUAL(event_loop_length(vl), 4);
+
+  e = event_loop_take(vl);
+  FO_ASSERT_PTR_EQUAL(e->func, other_event);
+  FO_ASSERT_EQUAL(e->priority, EVENT_HIGH);
+  g_free(e);
+  e = event_loop_take(vl);
+  FO_ASSERT_PTR_EQUAL(e->argument, &args[1]);
+  g_free(e);
+  e = event_loop_take(vl);
+  FO_ASSERT_PTR_EQUAL(e->argument, &args[2]);
+  g_free(e);
+  e = event_loop_take(vl);
+  FO_ASSERT_PTR_EQUAL(e->argument, &args[0]);
+  FO_ASSERT_EQUAL(e->priority, EVENT_LOW);
+  g_free(e);
+  FO_ASSERT_EQUAL(event_loop_length(vl), 0);
+
+  for(i = 0; i < EVENT_BATCH; i++)
+    event_signal(sample_event, &args[1]);
+  event_signal_priority(sample_event, &args[0], EVENT_LOW);
+
+  FO_ASSERT_EQUAL(event_loop_take_batch(vl, batch, EVENT_BATCH), EVENT_BATCH);
+  for(i = 0; i < EVENT_BATCH - 1; i++)
+    FO_ASSERT_EQUAL(batch[i]->priority, EVENT_NORMAL);
+  FO_ASSERT_PTR_EQUAL(batch[EVENT_BATCH - 1]->argument, &args[0]);
+  FO_ASSERT_EQUAL(event_loop_length(vl), 1);
+
+  for(i = 0; i < EVENT_BATCH; i++)
+    g_free(batch[i]);
+  scheduler_destroy(scheduler);
+}
+
 /* ************************************************************************** */
 /* *** suite decl *********************************************************** */
 /* ************************************************************************** */
@@ -370,5 +429,6 @@ CU_TestInfo tests_event[] =
     {"Test event_loop_terminate", test_event_loop_terminate },
     {"Test event_loop_take", test_event_loop_take },
     {"Test event_loop_put", test_event_loop_put },
+    {"Test event_priority", test_event_priority },
     CU_TEST_INFO_NULL
 };
@@ -27,6 +27,74 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 /* **** host function tests ************************************************* */
 /* ************************************************************************** */
 
+#define SIM_JOBS     12 ///< the number of jobs in the placement simulation
+#define SIM_CAPACITY 4  ///< the weight a simulated host runs at full speed
+
+/**
+ * \brief Simulates running a batch of jobs on two hosts with a policy.
+ *
+ * All jobs are submitted at once and placed with get_host(). Every other job
+ * is heavy: weight 4 and 4 ticks of work, the others have weight 1 and 1
+ * tick of work. A host runs SIM_CAPACITY weight at full speed, above that all
+ * of its agents slow down by the same factor.
+ *
+ * \param policy the placement policy to use
+ * \return the number of ticks until all jobs finished
+ */
+static int host_simulate(host_policy policy)
+{
+  struct
+  {
+    host_t*  host;
+    uint32_t weight;
+    double   left;
+    double   share;
+  } agents[SIM_JOBS];
+  GList* queue = NULL;
+  GList* iter;
+  int remaining = SIM_JOBS;
+  int tick, i;
+
+  CONF_host_policy = policy;
+  queue = g_list_append(queue, host_init("a_local", "localhost", "directory", 10));
+  queue = g_list_append(queue, host_init("b_local", "localhost", "directory", 10));
+
+  for(i = 0; i < SIM_JOBS; i++)
+  {
+    agents[i].weight = (i % 2 == 0) ? 4 : 1;
+    agents[i].left = agents[i].weight * agents[i].weight;
+    agents[i].host = get_host(&queue, 1, agents[i].weight, 0, 0);
+    FO_ASSERT_PTR_NOT_NULL_FATAL(agents[i].host);
+    host_increase_load(agents[i].host, agents[i].weight);
+  }
+
+  for(tick = 0; remaining > 0; tick++)
+  {
+    for(i = 0; i < SIM_JOBS; i++)
+      agents[i].share = MIN(1.0, (double)SIM_CAPACITY / agents[i].host->weight);
+
+    for(i = 0; i < SIM_JOBS; i++)
+    {
+      if(agents[i].left <= 0)
+        continue;
+
+      agents[i].left -= agents[i].weight * agents[i].share;
+      if(agents[i].left <= 1e-9)
+      {
+        agents[i].left = 0;
+        host_decrease_load(agents[i].host, agents[i].weight);
+        remaining--;
+      }
+    }
+  }
+
+  for(iter = queue; iter != NULL; iter = iter->next)
+    host_destroy(iter->data);
+  g_list_free(queue);
+
+  return tick;
+}
+
 /**
  * \brief Test for host_init()
  * \test
@@ -103,17 +171,20 @@ void test_host_insert()
  * -# Initialize host using host_init()
  * -# Check the running agents on host are 0
  * -# Call host_increase_load() on the host
- * -# Check if the running agents on host are increasing
+ * -# Check if the running agents and their weight on host are increasing
  */
 void test_host_increase_load()
 {
   host_t* host = host_init("local", "localhost", "directory", 10);
 
   FO_ASSERT_EQUAL(host->running, 0);
-  host_increase_load(host);
+  FO_ASSERT_EQUAL(host->weight, 0);
+  host_increase_load(host, 1);
   FO_ASSERT_EQUAL(host->running, 1);
-  host_increase_load(host);
+  FO_ASSERT_EQUAL(host->weight, 1);
+  host_increase_load(host, 4);
   FO_ASSERT_EQUAL(host->running, 2);
+  FO_ASSERT_EQUAL(host->weight, 5);
 
   host_destroy(host);
 }
@@ -122,20 +193,23 @@ void test_host_increase_load()
  * \brief Test for host_decrease_load()
  * \test
  * -# Initialize host using host_init()
- * -# Set the host load to 2
+ * -# Set the host load to 2 and its weight to 5
  * -# Call host_decrease_load() on the host
- * -# Check if the running agents on host are decreasing
+ * -# Check if the running agents and their weight on host are decreasing
  */
 void test_host_decrease_load()
 {
   host_t* host = host_init("local", "localhost", "directory", 10);
   host->running = 2;
+  host->weight = 5;
 
   FO_ASSERT_EQUAL(host->running, 2);
-  host_decrease_load(host);
+  host_decrease_load(host, 4);
   FO_ASSERT_EQUAL(host->running, 1);
-  host_decrease_load(host);
+  FO_ASSERT_EQUAL(host->weight, 1);
+  host_decrease_load(host, 1);
   FO_ASSERT_EQUAL(host->running, 0);
+  FO_ASSERT_EQUAL(host->weight, 0);
 
   host_destroy(host);
 }
@@ -145,7 +219,7 @@ void test_host_decrease_load()
  * \test
  * -# Initialize the scheduler using scheduler_init()
  * -# Add hosts to the scheduler with different capacity using host_insert()
- * -# Get the hosts from scheduler using get_host.
+ * -# Get the hosts from scheduler using get_host with the round robin policy.
  * -# Check the name of the host for a given capacity
  */
 void test_get_host()
@@ -156,6 +230,7 @@ void test_get_host()
   char* name = g_strdup(" _local");
 
   scheduler = scheduler_init(testdb, NULL);
+  CONF_host_policy = HOST_ROUND_ROBIN;
 
   for(i = 0; i < 9; i++)
   {
@@ -165,30 +240,192 @@ void test_get_host()
 
   for(i = 0; i < 9; i++)
   {
-    host = get_host(&scheduler->host_queue, i + 1);
+    host = get_host(&scheduler->host_queue, i + 1, 1, 0, 0);
     name[0] = (char)('1' + i);
 
     FO_ASSERT_PTR_EQUAL(host, g_tree_lookup(scheduler->host_list, name));
     FO_ASSERT_EQUAL(host->max, i + 1);
   }
 
-  host = get_host(&scheduler->host_queue, 3);
+  host = get_host(&scheduler->host_queue, 3, 1, 0, 0);
   FO_ASSERT_STRING_EQUAL(host->name, "3_local");
   FO_ASSERT_EQUAL(host->max, 3);
-  host = get_host(&scheduler->host_queue, 1);
+  host = get_host(&scheduler->host_queue, 1, 1, 0, 0);
   FO_ASSERT_STRING_EQUAL(host->name, "1_local");
   FO_ASSERT_EQUAL(host->max, 1);
-  host = get_host(&scheduler->host_queue, 9);
+  host = get_host(&scheduler->host_queue, 9, 1, 0, 0);
   FO_ASSERT_STRING_EQUAL(host->name, "9_local");
   FO_ASSERT_EQUAL(host->max, 9);
-  host = get_host(&scheduler->host_queue, 3);
+  host = get_host(&scheduler->host_queue, 3, 1, 0, 0);
   FO_ASSERT_STRING_EQUAL(host->name, "4_local");
   FO_ASSERT_EQUAL(host->max, 4);
 
+  CONF_host_policy = HOST_LEAST_LOADED;
   scheduler_destroy(scheduler);
   g_free(name);
 }
 
+/**
+ * \brief Test for host_free()
+ * \test
+ * -# Initialize a host with 10 slots and 3 running agents
+ * -# Check the free slots without a reserve and with a part of the host
+ *    reserved for interactive jobs
+ * -# Check that get_host() skips a host whose free slots are all reserved
+ */
+void test_host_free()
+{
+  GList* queue = NULL;
+  host_t* host = host_init("local", "localhost", "directory", 10);
+  host->running = 3;
+
+  FO_ASSERT_EQUAL(host_free(host, 0), 7);
+  FO_ASSERT_EQUAL(host_free(host, 20), 5);
+  FO_ASSERT_EQUAL(host_free(host, 200), -3);
+
+  host->running = 8;
+  queue = g_list_append(queue, host);
+  FO_ASSERT_PTR_NULL(get_host(&queue, 1, 1, 0, 20));
+  FO_ASSERT_PTR_EQUAL(get_host(&queue, 1, 1, 0, 0), host);
+
+  g_list_free(queue);
+  host_destroy(host);
+}
+
+/**
+ * \brief Test for host_max_budget()
+ * \test
+ * -# Insert hosts without a memory budget and check that there is no limit
+ * -# Give two hosts a budget and check that the largest one is found
+ */
+void test_host_max_budget()
+{
+  scheduler_t* scheduler;
+  host_t* first;
+  host_t* second;
+
+  scheduler = scheduler_init(testdb, NULL);
+  first = host_init("first", "localhost", "directory", 10);
+  second = host_init("second", "localhost", "directory", 10);
+  host_insert(first, scheduler);
+  host_insert(second, scheduler);
+  FO_ASSERT_EQUAL(host_max_budget(scheduler->host_list), 0);
+
+  first->budget = 4000;
+  second->budget = 16000;
+  FO_ASSERT_EQUAL(host_max_budget(scheduler->host_list), 16000);
+
+  scheduler_destroy(scheduler);
+}
+
+/**
+ * \brief Test for host_reserve() and host_fits()
+ * \test
+ * -# Initialize a host with a memory budget of 1000 MB
+ * -# Reserve memory and check which agents still fit
+ * -# Check that the first agent always fits, even above the budget
+ * -# Check that get_host() skips a host without enough memory
+ */
+void test_host_fits()
+{
+  GList* queue = NULL;
+  host_t* host = host_init("local", "localhost", "directory", 10);
+  host->budget = 1000;
+
+  FO_ASSERT_TRUE(host_fits(host, 2000));
+  host_reserve(host, 600);
+  FO_ASSERT_EQUAL(host->reserved, 600);
+  FO_ASSERT_TRUE(host_fits(host, 400));
+  FO_ASSERT_FALSE(host_fits(host, 401));
+
+  queue = g_list_append(queue, host);
+  FO_ASSERT_PTR_NULL(get_host(&queue, 1, 1, 500, 0));
+  FO_ASSERT_PTR_EQUAL(get_host(&queue, 1, 1, 100, 0), host);
+
+  host_reserve(host, -1000);
+  FO_ASSERT_EQUAL(host->reserved, 0);
+  host->budget = 0;
+  host_reserve(host, 5000);
+  FO_ASSERT_TRUE(host_fits(host, 5000));
+
+  g_list_free(queue);
+  host_destroy(host);
+}
+
+/**
+ * \brief Test for get_host() with the least loaded policy
+ * \test
+ * -# Add two hosts to the scheduler
+ * -# Check that agents go to the host with the lower total weight
+ * -# Report a high cpu load for that host and check the other host is used
+ * -# Report low memory for the other host and check it is only used when the
+ *    first host is full
+ * -# Check that a host storing the repository wins a tie
+ */
+void test_get_host_least_loaded()
+{
+  host_t* first;
+  host_t* second;
+  scheduler_t* scheduler;
+
+  scheduler = scheduler_init(testdb, NULL);
+  CONF_host_policy = HOST_LEAST_LOADED;
+  first = host_init("first", "localhost", "directory", 4);
+  second = host_init("second", "localhost", "directory", 4);
+  host_insert(first, scheduler);
+  host_insert(second, scheduler);
+
+  host_increase_load(first, 4);
+  FO_ASSERT_PTR_EQUAL(get_host(&scheduler->host_queue, 1, 1, 0, 0), second);
+  host_increase_load(second, 1);
+  FO_ASSERT_PTR_EQUAL(get_host(&scheduler->host_queue, 1, 1, 0, 0), second);
+  host_decrease_load(first, 4);
+  FO_ASSERT_PTR_EQUAL(get_host(&scheduler->host_queue, 1, 1, 0, 0), first);
+
+  host_report_load(first, 90, 4096);
+  FO_ASSERT_PTR_EQUAL(get_host(&scheduler->host_queue, 1, 1, 0, 0), second);
+
+  host_report_load(second, 0, 100);
+  FO_ASSERT_PTR_EQUAL(get_host(&scheduler->host_queue, 1, 1, 0, 0), first);
+  first->running = first->max;
+  FO_ASSERT_PTR_EQUAL(get_host(&scheduler->host_queue, 1, 1, 0, 0), second);
+  first->running = 0;
+
+  host_decrease_load(second, 1);
+  first->reported = second->reported = 0;
+  second->repo = TRUE;
+  FO_ASSERT_PTR_EQUAL(get_host(&scheduler->host_queue, 1, 1, 0, 0), second);
+  FO_ASSERT_PTR_EQUAL(get_host(&scheduler->host_queue, 1, 1, 0, 0), second);
+
+  scheduler_destroy(scheduler);
+}
+
+/**
+ * \brief Test for the makespan of the placement policies
+ * \test
+ * -# Simulate a batch of heavy and light jobs on two hosts with the round
+ *    robin policy and with the least loaded policy
+ * -# Check that the least loaded policy finishes the batch sooner
+ */
+void test_get_host_makespan()
+{
+  int round_robin = host_simulate(HOST_ROUND_ROBIN);
+  int least_loaded = host_simulate(HOST_LEAST_LOADED);
+
+  FO_ASSERT_TRUE(least_loaded < round_robin);
+  CONF_host_policy = HOST_LEAST_LOADED;
+}
+
+/**
+ * \brief Test for host_policy_parse()
+ */
+void test_host_policy_parse()
+{
+  FO_ASSERT_EQUAL(host_policy_parse("roundrobin"), HOST_ROUND_ROBIN);
+  FO_ASSERT_EQUAL(host_policy_parse("leastloaded"), HOST_LEAST_LOADED);
+  FO_ASSERT_EQUAL(host_policy_parse("random"), HOST_LEAST_LOADED);
+}
+
 /* ************************************************************************** */
 /* *** suite declaration **************************************************** */
 /* ************************************************************************** */
@@ -200,6 +437,12 @@ CU_TestInfo tests_host[] =
     {"Test host_increase_load", test_host_increase_load },
     {"Test host_decrease_load", test_host_decrease_load },
     {"Test host_get_host",      test_get_host           },
+    {"Test host_get_host_least_loaded", test_get_host_least_loaded },
+    {"Test host_get_host_makespan",     test_get_host_makespan     },
+    {"Test host_policy_parse",          test_host_policy_parse     },
+    {"Test host_free",                  test_host_free             },
+    {"Test host_fits",                  test_host_fits             },
+    {"Test host_max_budget",            test_host_max_budget       },
     CU_TEST_INFO_NULL
 };
 
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 /* scheduler includes */
 #include <scheduler.h>
+#include <agent.h>
 #include <job.h>
 
 #include <utils.h>
@@ -48,6 +49,9 @@ int Prepare_Testing_Data_Job(scheduler_t* scheduler) {
  *     -# job_verbose_event() and check if job is updated
  *     -# job_pause_event() and check if job is paused
  *     -# job_restart_event() and check if job is restarted
+ *     -# job_preempt() and check if job is paused by the scheduler
+ *     -# job_pause_event() and check if the job is no longer resumed by the
+ *        scheduler, then restart it
  *     -# job_priority_event() and check if job is restarted
  *     -# job_fail_event() and check if job is failed
  */
@@ -85,6 +89,23 @@ void test_job_event()
   job_restart_event(scheduler, params);
   FO_ASSERT_EQUAL(job->status, JB_RESTART);
 
+  job_preempt(scheduler, job);
+  FO_ASSERT_EQUAL(job->status, JB_PAUSED);
+  FO_ASSERT_TRUE(job->preempted);
+
+  params = g_new0(arg_int, 1);
+  params->first = job;
+  params->second = jq_pk;
+  job_pause_event(scheduler, params);
+  FO_ASSERT_EQUAL(job->status, JB_PAUSED);
+  FO_ASSERT_FALSE(job->preempted);
+
+  params = g_new0(arg_int, 1);
+  params->first = job;
+  params->second = jq_pk;
+  job_restart_event(scheduler, params);
+  FO_ASSERT_EQUAL(job->status, JB_RESTART);
+
   params = g_new0(arg_int, 1);
   params->first = job;
   params->second = 1;
@@ -144,6 +165,178 @@ void test_job_fun()
   scheduler_destroy(scheduler);
 }
 
+/**
+ * \brief Test for job_metrics_event()
+ * \test
+ * -# Initialize scheduler and database
+ * -# Create new database_update_event() to load data
+ * -# Add a counter to the totals of the job as if an agent had finished
+ * -# Call job_metrics_event() and check the job line and the end marker
+ * -# Call job_metrics_event() for an invalid job and check the error
+ */
+void test_job_metrics()
+{
+  scheduler_t* scheduler;
+  job_t* job;
+  arg_int* params;
+  agent_metric* metric;
+  GOutputStream* ostr;
+  gchar* expected;
+  int jq_pk;
+
+  scheduler = scheduler_init(testdb, NULL);
+  database_init(scheduler);
+  FO_ASSERT_PTR_NOT_NULL_FATAL(scheduler->db_conn);
+
+  jq_pk = Prepare_Testing_Data_Job(scheduler);
+
+  database_update_event(scheduler, NULL);
+
+  job = g_tree_lookup(scheduler->job_list, &jq_pk);
+  FO_ASSERT_PTR_NOT_NULL_FATAL(job);
+
+  metric = g_new0(agent_metric, 1);
+  metric->value = 42;
+  g_tree_insert(job->metrics, g_strdup("bytes"), metric);
+
+  ostr = g_memory_output_stream_new(NULL, 0, g_realloc, g_free);
+  params = g_new0(arg_int, 1);
+  params->first = ostr;
+  params->second = jq_pk;
+  job_metrics_event(scheduler, params);
+
+  expected = g_strdup_printf("job:%d type:%s running:0 bytes:42 bytes/s:0.0\nend\n",
+      jq_pk, job->agent_type);
+  FO_ASSERT_STRING_EQUAL((char*)g_memory_output_stream_get_data(G_MEMORY_OUTPUT_STREAM(ostr)), expected);
+  g_free(expected);
+  g_object_unref(ostr);
+
+  ostr = g_memory_output_stream_new(NULL, 0, g_realloc, g_free);
+  params = g_new0(arg_int, 1);
+  params->first = ostr;
+  params->second = -jq_pk - 1;
+  job_metrics_event(scheduler, params);
+
+  expected = g_strdup_printf("ERROR: invalid job id = %d\nend\n", -jq_pk - 1);
+  FO_ASSERT_STRING_EQUAL((char*)g_memory_output_stream_get_data(G_MEMORY_OUTPUT_STREAM(ostr)), expected);
+  g_free(expected);
+  g_object_unref(ostr);
+
+  scheduler_destroy(scheduler);
+}
+
+/**
+ * \brief Test for the chunks of a runonpfile job
+ * \test
+ * -# Create a job and split it into two chunks by hand
+ * -# Hand out both chunks and check job_agents_wanted()
+ * -# Fail the agent of the first chunk and check it is handed out again
+ * -# Fail it more than JOB_CHUNK_RETRIES times and check the job is marked
+ * -# Finish the second chunk and check the count of finished chunks
+ */
+void test_job_chunks()
+{
+  scheduler_t* scheduler;
+  job_t* job;
+  job_chunk_t* chunk;
+  agent_t agent;
+  int i;
+
+  scheduler = scheduler_init(testdb, NULL);
+  job = job_init(scheduler->job_list, scheduler->job_queue, "ununpack", LOCAL_HOST, -1, 0, 0, 0, 0, NULL);
+  FO_ASSERT_EQUAL(job_agents_wanted(job), 1);
+  FO_ASSERT_PTR_NULL(job_next_chunk(job));
+
+  job->chunks = g_ptr_array_new();
+  job->retry = g_queue_new();
+  for(i = 0; i < 2; i++)
+  {
+    chunk = g_new0(job_chunk_t, 1);
+    chunk->data = g_strdup_printf("1 PFILES %d-%d", i * 10 + 1, i * 10 + 10);
+    g_ptr_array_add(job->chunks, chunk);
+  }
+  FO_ASSERT_EQUAL(job_agents_wanted(job), 2);
+
+  memset(&agent, 0, sizeof(agent));
+  agent.chunk = job_next_chunk(job);
+  FO_ASSERT_PTR_NOT_NULL_FATAL(agent.chunk);
+  FO_ASSERT_STRING_EQUAL(agent.chunk->data, "1 PFILES 1-10");
+  FO_ASSERT_TRUE(job_is_open(scheduler, job));
+
+  for(i = 0; i < JOB_CHUNK_RETRIES; i++)
+  {
+    FO_ASSERT_TRUE(job_chunk_failed(job, &agent));
+    FO_ASSERT_PTR_NULL(agent.chunk);
+    agent.chunk = job_next_chunk(job);
+    FO_ASSERT_STRING_EQUAL(agent.chunk->data, "1 PFILES 1-10");
+  }
+  FO_ASSERT_FALSE(job_chunk_failed(job, &agent));
+  FO_ASSERT_TRUE(job->chunk_failed);
+
+  agent.chunk = job_next_chunk(job);
+  FO_ASSERT_STRING_EQUAL(agent.chunk->data, "1 PFILES 11-20");
+  FO_ASSERT_PTR_NULL(job_next_chunk(job));
+  job_chunk_done(job, &agent);
+  FO_ASSERT_EQUAL(job->done, 1);
+  FO_ASSERT_PTR_NULL(agent.chunk);
+
+  for(i = 0; i < 2; i++)
+  {
+    chunk = g_ptr_array_index(job->chunks, i);
+    g_free(chunk->data);
+    g_free(chunk);
+  }
+
+  scheduler_destroy(scheduler);
+}
+
+/**
+ * \brief Test for the dependencies between jobs
+ * \test
+ * -# Create three jobs where the last one waits for the other two
+ * -# Complete the first job and check the last one is still waiting
+ * -# Complete the second job and check the last one is queued
+ * -# Create a job waiting for a job that fails and check it is dropped
+ */
+void test_job_depend()
+{
+  scheduler_t* scheduler;
+  job_t* first, * second, * last;
+  int id = -4;
+
+  scheduler = scheduler_init(testdb, NULL);
+  first  = job_init(scheduler->job_list, NULL, "ununpack", LOCAL_HOST, -1, 0, 0, 0, 0, NULL);
+  second = job_init(scheduler->job_list, NULL, "adj2nest", LOCAL_HOST, -2, 0, 0, 0, 0, NULL);
+  last   = job_init(scheduler->job_list, NULL, "nomos",    LOCAL_HOST, -3, 0, 0, 0, 0, NULL);
+
+  FO_ASSERT_TRUE(job_depend(last, first));
+  FO_ASSERT_TRUE(job_depend(last, second));
+  FO_ASSERT_EQUAL(g_list_length(last->depends), 2);
+
+  job_update(scheduler, first);
+  FO_ASSERT_EQUAL(first->status, JB_COMPLETE);
+  FO_ASSERT_EQUAL(g_list_length(last->depends), 1);
+  FO_ASSERT_PTR_NULL(peek_job(scheduler->job_queue));
+
+  job_update(scheduler, second);
+  FO_ASSERT_PTR_NULL(last->depends);
+  FO_ASSERT_PTR_EQUAL(peek_job(scheduler->job_queue), last);
+  FO_ASSERT_TRUE(job_depend(last, first));
+  FO_ASSERT_PTR_NULL(last->depends);
+  next_job(scheduler->job_queue);
+
+  second = job_init(scheduler->job_list, NULL, "nomos",   LOCAL_HOST, -5, 0, 0, 0, 0, NULL);
+  last   = job_init(scheduler->job_list, NULL, "buckets", LOCAL_HOST, id, 0, 0, 0, 0, NULL);
+  FO_ASSERT_TRUE(job_depend(last, second));
+  job_fail_event(scheduler, second);
+  FO_ASSERT_PTR_NULL(g_tree_lookup(scheduler->job_list, &id));
+  FO_ASSERT_PTR_NULL(second->dependents);
+  FO_ASSERT_FALSE(job_depend(first, second));
+  FO_ASSERT_PTR_NULL(peek_job(scheduler->job_queue));
+
+  scheduler_destroy(scheduler);
+}
+
 /* ************************************************************************** */
 /* **** suite declaration *************************************************** */
 /* ************************************************************************** */
@@ -152,5 +345,8 @@ CU_TestInfo tests_job[] =
 {
     {"Test job_event", test_job_event },
     {"Test job_fun",   test_job_fun   },
+    {"Test job_metrics", test_job_metrics },
+    {"Test job_chunks",  test_job_chunks  },
+    {"Test job_depend",  test_job_depend  },
     CU_TEST_INFO_NULL
 };
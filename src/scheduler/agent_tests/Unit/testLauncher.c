@@ -0,0 +1,209 @@
+/*********************************************************************
+Copyright (C) 2026 Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*********************************************************************/
+/**
+ * \file
+ * \brief Unit test for the agent launcher
+ */
+
+/* include functions to test */
+#include <testRun.h>
+#include <agent.h>
+#include <event.h>
+#include <launcher.h>
+
+/* unix includes */
+#include <arpa/inet.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* ************************************************************************** */
+/* **** launcher function tests ********************************************* */
+/* ************************************************************************** */
+
+/**
+ * \brief Takes events until the death of an agent arrives.
+ *
+ * \return the pid and status of the agent, NULL if it did not arrive in time
+ */
+static pid_t* launcher_wait_death()
+{
+  event_t* e;
+  pid_t* ret = NULL;
+  int i;
+
+  for (i = 0; i < 10 && ret == NULL; i++)
+  {
+    if ((e = event_loop_take(event_loop_get())) == NULL)
+      continue;
+    if (e->func == (event_function) agent_death_event)
+      ret = e->argument;
+    event_destroy(e);
+  }
+
+  return ret;
+}
+
+/**
+ * \brief Test for launcher_write_frame() and launcher_read_frame()
+ * \test
+ * -# Write a frame to a pipe and read it back
+ * -# Check that the id, type and payload are the same
+ * -# Check that the end of the stream and a payload above LAUNCHER_FRAME are refused
+ */
+void test_launcher_frame()
+{
+  int fds[2];
+  int32_t id;
+  uint32_t type, len;
+  char* data;
+
+  FO_ASSERT_EQUAL(pipe(fds), 0);
+
+  FO_ASSERT_TRUE(launcher_write_frame(fds[1], -7, LAUNCH_DATA, "hello\n", 6));
+  FO_ASSERT_TRUE(launcher_read_frame(fds[0], &id, &type, &data, &len));
+  FO_ASSERT_EQUAL(id, -7);
+  FO_ASSERT_EQUAL(type, LAUNCH_DATA);
+  FO_ASSERT_EQUAL(len, 6);
+  FO_ASSERT_STRING_EQUAL(data, "hello\n");
+  g_free(data);
+
+  FO_ASSERT_TRUE(launcher_write_frame(fds[1], -7, LAUNCH_DATA, "", 0));
+  FO_ASSERT_TRUE(launcher_read_frame(fds[0], &id, &type, &data, &len));
+  FO_ASSERT_EQUAL(len, 0);
+  g_free(data);
+
+  /* the end of the stream */
+  close(fds[1]);
+  FO_ASSERT_FALSE(launcher_read_frame(fds[0], &id, &type, &data, &len));
+  FO_ASSERT_PTR_NULL(data);
+  close(fds[0]);
+
+  FO_ASSERT_EQUAL(pipe(fds), 0);
+  {
+    uint32_t header[3] = { htonl(1), htonl(LAUNCH_DATA), htonl(LAUNCHER_FRAME + 1) };
+    FO_ASSERT_EQUAL(write(fds[1], header, sizeof(header)), sizeof(header));
+  }
+  FO_ASSERT_FALSE(launcher_read_frame(fds[0], &id, &type, &data, &len));
+  FO_ASSERT_PTR_NULL(data);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+/**
+ * \brief Test for launcher_spawn() with fo_launcher running on localhost
+ * \test
+ * -# Start fo_launcher without ssh and spawn cat through it
+ * -# Write a line to the pipe of the agent and check that cat echoes it
+ * -# Kill the agent through the launcher
+ * -# Check that an agent_death_event() with the id and SIGKILL is created
+ */
+void test_launcher_spawn()
+{
+  launcher_t* launcher;
+  char* cmd[] = { LAUNCHER_PATH, NULL };
+  char* args[] = { "/bin/cat", NULL };
+  int to_child[2], from_child[2];
+  struct pollfd pfd;
+  char buf[16];
+  pid_t* death;
+  int32_t id;
+
+  event_loop_get()->terminated = 0;
+  launcher = launcher_init("localhost");
+  FO_ASSERT_TRUE(launcher_start(launcher, cmd));
+  FO_ASSERT_TRUE(launcher_ready(launcher, cmd));
+
+  FO_ASSERT_EQUAL(pipe(to_child), 0);
+  FO_ASSERT_EQUAL(pipe(from_child), 0);
+
+  id = launcher_spawn(launcher, to_child[0], from_child[1], 0, args);
+  FO_ASSERT_TRUE(id < 0);
+
+  FO_ASSERT_EQUAL(write(to_child[1], "hello\n", 6), 6);
+  pfd.fd = from_child[0];
+  pfd.events = POLLIN;
+  FO_ASSERT_EQUAL(poll(&pfd, 1, 10000), 1);
+  memset(buf, '\0', sizeof(buf));
+  FO_ASSERT_EQUAL(read(from_child[0], buf, sizeof(buf) - 1), 6);
+  FO_ASSERT_STRING_EQUAL(buf, "hello\n");
+
+  FO_ASSERT_TRUE(launcher_priority(launcher, id, 5));
+  FO_ASSERT_TRUE(launcher_signal(launcher, id, SIGKILL));
+
+  death = launcher_wait_death();
+  FO_ASSERT_PTR_NOT_NULL_FATAL(death);
+  FO_ASSERT_EQUAL(death[0], id);
+  FO_ASSERT_TRUE(WIFSIGNALED(death[1]));
+  FO_ASSERT_EQUAL(WTERMSIG(death[1]), SIGKILL);
+  g_free(death);
+
+  /* the agent is gone, the launcher does not know it anymore */
+  FO_ASSERT_FALSE(launcher_signal(launcher, id, SIGKILL));
+
+  launcher_destroy(launcher);
+  close(to_child[0]);
+  close(to_child[1]);
+  close(from_child[0]);
+  close(from_child[1]);
+}
+
+/**
+ * \brief Test for a launcher that cannot be started
+ * \test
+ * -# Start a launcher that exits at once
+ * -# Check that spawning fails, so that ssh is used instead
+ * -# Check that launcher_ready() does not start it again at once
+ */
+void test_launcher_lost()
+{
+  launcher_t* launcher;
+  char* cmd[] = { "/bin/false", NULL };
+  char* args[] = { "/bin/cat", NULL };
+  int fds[2];
+  int i;
+
+  event_loop_get()->terminated = 0;
+  launcher = launcher_init("localhost");
+  FO_ASSERT_TRUE(launcher_start(launcher, cmd));
+
+  /* the launcher thread notices that the process is gone */
+  for (i = 0; i < 100 && launcher->lost == 0; i++)
+    usleep(100000);
+  FO_ASSERT_NOT_EQUAL(launcher->lost, 0);
+
+  FO_ASSERT_EQUAL(pipe(fds), 0);
+  FO_ASSERT_EQUAL(launcher_spawn(launcher, fds[0], fds[1], 0, args), 0);
+  FO_ASSERT_FALSE(launcher_ready(launcher, cmd));
+
+  launcher_destroy(launcher);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+/* ************************************************************************** */
+/* *** suite declaration **************************************************** */
+/* ************************************************************************** */
+
+CU_TestInfo tests_launcher[] =
+{
+    {"Test launcher_frame", test_launcher_frame },
+    {"Test launcher_spawn", test_launcher_spawn },
+    {"Test launcher_lost",  test_launcher_lost  },
+    CU_TEST_INFO_NULL
+};
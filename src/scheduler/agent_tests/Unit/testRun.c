@@ -101,6 +101,8 @@ CU_SuiteInfo suites[] =
     {"MetaAgent",       NULL, NULL, (CU_SetUpFunc)init_suite, (CU_TearDownFunc)clean_suite, tests_meta_agent },
     {"Agent",           NULL, NULL, (CU_SetUpFunc)init_suite, (CU_TearDownFunc)clean_suite, tests_agent },
     {"Event",           NULL, NULL, (CU_SetUpFunc)init_suite, (CU_TearDownFunc)clean_suite, tests_event },
+    {"Launcher",        NULL, NULL, (CU_SetUpFunc)init_suite, (CU_TearDownFunc)clean_suite, tests_launcher },
+    {"Stats",           NULL, NULL, (CU_SetUpFunc)init_suite, (CU_TearDownFunc)clean_suite, tests_stats },
     CU_SUITE_INFO_NULL
 };
 #else
@@ -116,6 +118,8 @@ CU_SuiteInfo suites[] =
     {"MetaAgent", init_suite, clean_suite, tests_meta_agent },
     {"Agent", init_suite, clean_suite, tests_agent },
     {"Event",init_suite,clean_suite, tests_event },
+    {"Launcher", init_suite, clean_suite, tests_launcher },
+    {"Stats", init_suite, clean_suite, tests_stats },
     CU_SUITE_INFO_NULL
 };
 #endif
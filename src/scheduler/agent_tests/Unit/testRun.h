@@ -56,6 +56,10 @@ extern CU_TestInfo tests_email[];
 
 extern CU_TestInfo tests_job[];
 
+extern CU_TestInfo tests_launcher[];
+
 extern CU_TestInfo tests_scheduler[];
+
+extern CU_TestInfo tests_stats[];
 /* scheduler private declarations */
 event_loop_t* event_loop_get();
@@ -0,0 +1,140 @@
+/*********************************************************************
+Copyright (C) 2026 Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*********************************************************************/
+/**
+ * \file
+ * \brief Unit test for the scheduler statistics
+ */
+
+/* include functions to test */
+#include <testRun.h>
+
+/* scheduler includes */
+#include <scheduler.h>
+#include <host.h>
+#include <job.h>
+#include <stats.h>
+
+/* ************************************************************************** */
+/* **** stats function tests ************************************************ */
+/* ************************************************************************** */
+
+/**
+ * \brief Test for the counters and histograms in stats_prometheus()
+ * \test
+ * -# Record job, agent and event loop statistics
+ * -# Check that the counters have the recorded values
+ * -# Check that the histogram buckets are cumulative and end with +Inf
+ * -# Check that label values are escaped
+ */
+void test_stats_counters()
+{
+  scheduler_t* scheduler;
+  GString* str;
+
+  stats_destroy();
+  scheduler = scheduler_init(testdb, NULL);
+
+  stats_job_started("nomos", 3);
+  stats_job_started("nomos", 7000);
+  stats_job_finished("nomos", 20, FALSE);
+  stats_job_finished("nomos", -1, TRUE);
+  stats_agent_failed("nomos");
+  stats_agent_restarted("nomos");
+  stats_agent_items("nomos", 42);
+  stats_agent_failed("a\"b");
+  stats_event_lag(EVENT_NORMAL, 0.05);
+
+  str = stats_prometheus(scheduler);
+
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "# TYPE fossology_job_wait_seconds histogram\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_job_wait_seconds_bucket{agent=\"nomos\",le=\"1\"} 0\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_job_wait_seconds_bucket{agent=\"nomos\",le=\"5\"} 1\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_job_wait_seconds_bucket{agent=\"nomos\",le=\"14400\"} 2\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_job_wait_seconds_bucket{agent=\"nomos\",le=\"+Inf\"} 2\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_job_wait_seconds_sum{agent=\"nomos\"} 7003\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_job_wait_seconds_count{agent=\"nomos\"} 2\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_job_run_seconds_count{agent=\"nomos\"} 1\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_jobs_finished_total{agent=\"nomos\",status=\"complete\"} 1\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_jobs_finished_total{agent=\"nomos\",status=\"failed\"} 1\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_agent_failures_total{agent=\"nomos\"} 1\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_agent_restarts_total{agent=\"nomos\"} 1\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_agent_items_total{agent=\"nomos\"} 42\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_agent_items_running{agent=\"nomos\"} 0\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "# TYPE fossology_agent_items_running gauge\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_agent_failures_total{agent=\"a\\\"b\"} 1\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_event_loop_lag_seconds_bucket{priority=\"normal\",le=\"0.01\"} 0\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_event_loop_lag_seconds_bucket{priority=\"normal\",le=\"0.05\"} 1\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_event_loop_lag_seconds_count{priority=\"normal\"} 1\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_event_loop_lag_seconds_count{priority=\"high\"} 0\n"));
+
+  g_string_free(str, TRUE);
+  scheduler_destroy(scheduler);
+}
+
+/**
+ * \brief Test for the queue and host gauges in stats_prometheus()
+ * \test
+ * -# Add a host and jobs to the job queue, one of them waits for another job
+ * -# Check that the queued and waiting jobs are counted per agent type
+ * -# Check that the host has no running agents and its slots
+ * -# Check that the startup test jobs of the agents are not counted
+ */
+void test_stats_gauges()
+{
+  scheduler_t* scheduler;
+  job_t* first;
+  job_t* job;
+  GString* str;
+
+  stats_destroy();
+  scheduler = scheduler_init(testdb, NULL);
+  host_insert(host_init("stats_host", "localhost", "directory", 4), scheduler);
+
+  first = job_init(scheduler->job_list, scheduler->job_queue, "copyright", "stats_host", 1, 0, 0, 0, 0, NULL);
+  job_init(scheduler->job_list, scheduler->job_queue, "copyright", "stats_host", 2, 0, 0, 0, 0, NULL);
+  job = job_init(scheduler->job_list, NULL, "copyright", "stats_host", 3, 0, 0, 0, 0, NULL);
+  FO_ASSERT_TRUE(job_depend(job, first));
+  job_init(scheduler->job_list, scheduler->job_queue, "monk", "stats_host", -5, 0, 0, 0, 0, NULL);
+
+  str = stats_prometheus(scheduler);
+
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "# TYPE fossology_jobs_queued gauge\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_jobs_queued{agent=\"copyright\"} 2\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_jobs_waiting{agent=\"copyright\"} 1\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_host_agents{host=\"stats_host\"} 0\n"));
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_host_slots{host=\"stats_host\"} 4\n"));
+  FO_ASSERT_PTR_NULL(strstr(str->str, "agent=\"monk\""));
+
+  /* the gauges start from zero every time */
+  g_string_free(str, TRUE);
+  str = stats_prometheus(scheduler);
+  FO_ASSERT_PTR_NOT_NULL(strstr(str->str, "fossology_jobs_queued{agent=\"copyright\"} 2\n"));
+
+  g_string_free(str, TRUE);
+  scheduler_destroy(scheduler);
+}
+
+/* ************************************************************************** */
+/* *** suite declaration **************************************************** */
+/* ************************************************************************** */
+
+CU_TestInfo tests_stats[] =
+{
+    {"Test stats_counters", test_stats_counters },
+    {"Test stats_gauges",   test_stats_gauges   },
+    CU_TEST_INFO_NULL
+};
@@ -0,0 +1,67 @@
+/*********************************************************************
+Copyright (C) 2026 Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *********************************************************************/
+
+/* fossology includes */
+#include <libfossology.h>
+
+/// the milliseconds a job takes if BENCH_RUNTIME is not set
+#define DEFAULT_RUNTIME 100
+
+/**
+ * @file
+ * @brief This is a simple test agent meant to be used by Unit and functional
+ *        tests to confirm a correctly working scheduler.
+ *
+ *        This particular agent
+ *        works on every job it is given for about BENCH_RUNTIME milliseconds,
+ *        between half and one and a half times that, and then asks for the
+ *        next one. BENCH_FAIL percent of the jobs fail. It is the fake agent
+ *        of the scheduler_bench test, which sets both environment variables.
+ *
+ * @note This is a working agent
+ */
+
+int main(int argc, char** argv)
+{
+  int runtime = DEFAULT_RUNTIME;
+  int fail = 0;
+
+  if (getenv("BENCH_RUNTIME"))
+    runtime = atoi(getenv("BENCH_RUNTIME"));
+  if (getenv("BENCH_FAIL"))
+    fail = atoi(getenv("BENCH_FAIL"));
+
+  fo_scheduler_connect(&argc, argv, NULL);
+  srand(getpid());
+
+  while (fo_scheduler_next() != NULL)
+  {
+    if (runtime > 0)
+      usleep((runtime / 2 + rand() % (runtime + 1)) * 1000);
+    fo_scheduler_heart(1);
+
+    if (rand() % 100 < fail)
+    {
+      fo_scheduler_disconnect(1);
+      return 1;
+    }
+  }
+
+  fo_scheduler_disconnect(0);
+
+  return 0;
+}
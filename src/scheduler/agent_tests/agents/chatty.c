@@ -0,0 +1,64 @@
+/*********************************************************************
+Copyright (C) 2026 Siemens AG
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+version 2 as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *********************************************************************/
+
+/* fossology includes */
+#include <libfossology.h>
+
+/// the number of lines sent if CHATTY_LINES is not set
+#define DEFAULT_LINES 10
+/// the number of lines sent per second if CHATTY_RATE is not set
+#define DEFAULT_RATE  10
+
+/**
+ * @file
+ * @brief This is a simple test agent meant to be used by Unit and functional
+ *        tests to confirm a correctly working scheduler.
+ *
+ *        This particular agent
+ *        will startup and then send CHATTY_LINES metric updates to the
+ *        scheduler, CHATTY_RATE per second, before waiting for the scheduler
+ *        to close it. It is the fake agent of the agent_stress test, which
+ *        sets both environment variables.
+ *
+ * @note This is a working agent
+ */
+
+int main(int argc, char** argv)
+{
+  int lines = DEFAULT_LINES;
+  int rate = DEFAULT_RATE;
+  int i;
+
+  if (getenv("CHATTY_LINES"))
+    lines = atoi(getenv("CHATTY_LINES"));
+  if (getenv("CHATTY_RATE") && atoi(getenv("CHATTY_RATE")) > 0)
+    rate = atoi(getenv("CHATTY_RATE"));
+
+  fo_scheduler_connect(&argc, argv, NULL);
+
+  for (i = 1; i <= lines; i++)
+  {
+    fprintf(stdout, "METRIC: chatty.lines c %d\n", i);
+    fflush(stdout);
+    usleep(1000000 / rate);
+  }
+
+  fo_scheduler_next();
+  fo_scheduler_disconnect(0);
+
+  return 0;
+}
@@ -443,7 +443,7 @@ int	IsExe	(char *Exe, int Quiet)
 
 /**
  * @brief Copy a file.
- * For speed: mmap and save.
+ * For speed: clone or copy inside the kernel when possible, see fo_CopyFd().
  * @param Src Source file path
  * @param[out] Dst Destination file path
  * @returns 0 if copy worked, 1 if failed.
@@ -451,14 +451,12 @@ int	IsExe	(char *Exe, int Quiet)
 int	CopyFile	(char *Src, char *Dst)
 {
   int Fin, Fout;
-  unsigned char * Mmap;
-  int LenIn, LenOut, Wrote;
   struct stat Stat;
+  int Strategy;
   int rc=0;
   char *Slash;
 
   if (lstat(Src,&Stat) == -1) return(1);
-  LenIn = Stat.st_size;
   if (!S_ISREG(Stat.st_mode))	return(1);
 
   Fin = open(Src,O_RDONLY);
@@ -485,28 +483,14 @@ int	CopyFile	(char *Src, char *Dst)
     SafeExit(23);
   }
 
-  /* load the source file */
-  Mmap = mmap(0,LenIn,PROT_READ,MAP_PRIVATE,Fin,0);
-  if (Mmap == NULL)
+  if (fo_CopyFd(Fin,Fout,&Strategy) != 0)
   {
     LOG_FATAL("pfile %s Unable to process file.",Pfile_Pk);
-    LOG_WARNING("pfile %s Mmap failed during copy.",Pfile_Pk);
+    LOG_WARNING("pfile %s Copy failed: %s",Pfile_Pk,strerror(errno));
     rc=1;
-    goto CopyFileEnd;
   }
+  else if (Verbose > 1) LOG_DEBUG("Copied %s > %s with %s",Src,Dst,fo_CopyStrategyName(Strategy));
 
-  /* write file at maximum speed */
-  LenOut=0;
-  Wrote=0;
-  while((LenOut < LenIn) && (Wrote >= 0))
-  {
-    Wrote = write(Fout,Mmap+LenOut,LenIn-LenOut);
-    LenOut += Wrote;
-  }
-
-  /* clean up */
-  munmap(Mmap,LenIn);
-  CopyFileEnd:
   close(Fout);
   close(Fin);
   return(rc);